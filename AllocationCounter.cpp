@@ -0,0 +1,126 @@
+//==============================================================================
+/*
+    CPSC 599.86 / 601.86 - Computer Haptics
+    Winter 2018, University of Calgary
+
+    Replacement of the global operator new and delete that counts the heap
+    allocations of each thread.
+*/
+//==============================================================================
+
+#include "AllocationCounter.h"
+#include <cstdlib>
+#include <new>
+
+//------------------------------------------------------------------------------
+
+namespace
+{
+    // trivially initialised, so it is usable before main() and in any thread
+    thread_local unsigned long long s_numAllocations = 0;
+
+    void* allocate(std::size_t a_size)
+    {
+        s_numAllocations++;
+
+        if (a_size == 0)
+        {
+            a_size = 1;
+        }
+
+        while (true)
+        {
+            void* p = malloc(a_size);
+            if (p != NULL)
+            {
+                return (p);
+            }
+
+            // the handler frees memory or throws std::bad_alloc
+            std::new_handler handler = std::get_new_handler();
+            if (handler == NULL)
+            {
+                return (NULL);
+            }
+            handler();
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+
+unsigned long long getThreadAllocationCount()
+{
+    return (s_numAllocations);
+}
+
+//------------------------------------------------------------------------------
+
+void* operator new(std::size_t a_size)
+{
+    void* p = allocate(a_size);
+    if (p == NULL)
+    {
+        throw std::bad_alloc();
+    }
+    return (p);
+}
+
+void* operator new[](std::size_t a_size)
+{
+    return (operator new(a_size));
+}
+
+void* operator new(std::size_t a_size, const std::nothrow_t&) noexcept
+{
+    try
+    {
+        return (allocate(a_size));
+    }
+    catch (...)
+    {
+        return (NULL);
+    }
+}
+
+void* operator new[](std::size_t a_size, const std::nothrow_t&) noexcept
+{
+    try
+    {
+        return (allocate(a_size));
+    }
+    catch (...)
+    {
+        return (NULL);
+    }
+}
+
+void operator delete(void* a_pointer) noexcept
+{
+    free(a_pointer);
+}
+
+void operator delete[](void* a_pointer) noexcept
+{
+    free(a_pointer);
+}
+
+void operator delete(void* a_pointer, const std::nothrow_t&) noexcept
+{
+    free(a_pointer);
+}
+
+void operator delete[](void* a_pointer, const std::nothrow_t&) noexcept
+{
+    free(a_pointer);
+}
+
+void operator delete(void* a_pointer, std::size_t) noexcept
+{
+    free(a_pointer);
+}
+
+void operator delete[](void* a_pointer, std::size_t) noexcept
+{
+    free(a_pointer);
+}
@@ -0,0 +1,22 @@
+//==============================================================================
+/*
+    CPSC 599.86 / 601.86 - Computer Haptics
+    Winter 2018, University of Calgary
+
+    Counts the heap allocations of each thread. AllocationCounter.cpp
+    replaces the global operator new, so every allocation made through new
+    (including those of CHAI3D and the standard library) is counted for the
+    thread that made it.
+*/
+//==============================================================================
+
+#ifndef ALLOCATIONCOUNTER_H
+#define ALLOCATIONCOUNTER_H
+
+//------------------------------------------------------------------------------
+
+//! Number of heap allocations made through operator new by the calling thread.
+unsigned long long getThreadAllocationCount();
+
+//------------------------------------------------------------------------------
+#endif
@@ -0,0 +1,746 @@
+//==============================================================================
+/*
+    CPSC 599.86 / 601.86 - Computer Haptics
+    Winter 2018, University of Calgary
+
+    This class loads every asset of the scene once and shares it between the
+    objects that use it.
+*/
+//==============================================================================
+
+#include "AssetCache.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <thread>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+using namespace chai3d;
+using namespace std;
+
+//------------------------------------------------------------------------------
+
+namespace
+{
+    //! Size in bytes and modification time in seconds of a file; false if it cannot be read.
+    bool getFileStamp(const string& a_filename, unsigned long long& a_size, unsigned long long& a_modified)
+    {
+        struct stat info;
+        if (stat(a_filename.c_str(), &info) != 0)
+        {
+            return (false);
+        }
+
+        a_size = (unsigned long long)info.st_size;
+        a_modified = (unsigned long long)info.st_mtime;
+        return (true);
+    }
+}
+
+
+//==============================================================================
+/*!
+    Constructor of AssetCache.
+*/
+//==============================================================================
+AssetCache::AssetCache()
+{
+    m_numHits = 0;
+}
+
+
+//==============================================================================
+/*!
+    Destructor of AssetCache. Deletes the loaded meshes, which own the
+    collision trees; the instances must have been released first.
+*/
+//==============================================================================
+AssetCache::~AssetCache()
+{
+    for (map<unsigned long long, cMultiMesh*>::iterator it = m_meshes.begin(); it != m_meshes.end(); ++it)
+    {
+        delete it->second;
+    }
+}
+
+
+//==============================================================================
+/*!
+    Hashes the contents of a file with 64-bit FNV-1a. Hashes are remembered
+    per path, so each file is read at most once.
+
+    \param  a_filename  File to hash.
+    \param  a_hash      Returned hash.
+
+    \return true if the file could be read.
+*/
+//==============================================================================
+bool AssetCache::hashFile(const string& a_filename, unsigned long long& a_hash)
+{
+    map<string, unsigned long long>::iterator known = m_fileHashes.find(a_filename);
+    if (known != m_fileHashes.end())
+    {
+        a_hash = known->second;
+        return (true);
+    }
+
+    ifstream file(a_filename.c_str(), ios::in | ios::binary);
+    if (!file)
+    {
+        return (false);
+    }
+
+    unsigned long long hash = 14695981039346656037ULL;
+    char buffer[65536];
+    while (file)
+    {
+        file.read(buffer, sizeof(buffer));
+        streamsize count = file.gcount();
+        for (streamsize i = 0; i < count; i++)
+        {
+            hash ^= (unsigned char)buffer[i];
+            hash *= 1099511628211ULL;
+        }
+    }
+
+    m_fileHashes[a_filename] = hash;
+    a_hash = hash;
+    return (true);
+}
+
+
+//==============================================================================
+/*!
+    Returns a new instance of a mesh file. The file is parsed, and its BTN
+    vectors and AABB collision tree are computed, the first time its content
+    is requested. Each instance shares the vertices, triangles and collision
+    tree of that mesh; only its transform and materials are its own.
+
+    \param  a_filename    Mesh file.
+    \param  a_toolRadius  Radius of the tool, used to build the collision tree.
+
+    \return New instance, or NULL if the file could not be loaded.
+*/
+//==============================================================================
+cMultiMesh* AssetCache::newMeshInstance(const string& a_filename, double a_toolRadius)
+{
+    unsigned long long hash;
+    if (!hashFile(a_filename, hash))
+    {
+        return (NULL);
+    }
+
+    cMultiMesh* source;
+    map<unsigned long long, cMultiMesh*>::iterator cached = m_meshes.find(hash);
+    if (cached != m_meshes.end())
+    {
+        source = cached->second;
+        m_numHits++;
+    }
+    else
+    {
+        source = newPackedMesh(hash, a_toolRadius);
+        if (source == NULL)
+        {
+            source = new cMultiMesh();
+            if (!source->loadFromFile(a_filename))
+            {
+                delete source;
+                return (NULL);
+            }
+            source->createAABBCollisionDetector(a_toolRadius);
+            source->computeBTN();
+        }
+        m_meshes[hash] = source;
+    }
+
+    // share the materials for now (callers replace them), the textures and the geometry
+    cMultiMesh* instance = source->copy(false, false, false, false);
+
+    for (unsigned int i = 0; i < source->getNumMeshes(); i++)
+    {
+        cMesh* mesh = instance->getMesh(i);
+        mesh->setCollisionDetector(source->getMesh(i)->getCollisionDetector());
+        m_instanceMeshes.push_back(mesh);
+    }
+
+    return (instance);
+}
+
+
+//==============================================================================
+/*!
+    Returns the texture of an image file, decoding it the first time its
+    content is requested. All textures use GL_REPEAT wrapping and mipmaps.
+
+    \param  a_filename  Image file.
+
+    \return Shared texture, or NULL if the file could not be loaded.
+*/
+//==============================================================================
+cTexture2dPtr AssetCache::getTexture(const string& a_filename)
+{
+    unsigned long long hash;
+    if (!hashFile(a_filename, hash))
+    {
+        return (NULL);
+    }
+
+    map<unsigned long long, cTexture2dPtr>::iterator cached = m_textures.find(hash);
+    if (cached != m_textures.end())
+    {
+        m_numHits++;
+        return (cached->second);
+    }
+
+    cImagePtr image = cImage::create();
+    if (!image->loadFromFile(a_filename))
+    {
+        return (NULL);
+    }
+
+    return (addTexture(image, hash));
+}
+
+
+//==============================================================================
+/*!
+    Decodes a batch of image files on a pool of worker threads. Files whose
+    content is already cached, or appears twice in the batch, are decoded
+    once. The decoded images are wrapped into textures on the calling thread,
+    which also does the GL upload later on, so that the following
+    getTexture() calls are cache hits. Prints the decode time of every image
+    and the wall-clock time of the batch.
+
+    \param  a_filenames   Image files to decode.
+    \param  a_numThreads  Number of worker threads, or 0 for one per hardware thread.
+*/
+//==============================================================================
+void AssetCache::preloadTextures(const vector<string>& a_filenames, unsigned int a_numThreads)
+{
+    struct DecodeJob
+    {
+        string filename;
+        unsigned long long hash;
+        cImagePtr image;
+        bool loaded;
+        double decodeTime;
+    };
+
+    cPrecisionClock clock;
+    clock.start(true);
+
+    // hash on this thread, which owns the cache, and keep one job per new content
+    vector<DecodeJob> jobs;
+    map<unsigned long long, bool> queued;
+    for (unsigned int i = 0; i < a_filenames.size(); i++)
+    {
+        unsigned long long hash;
+        if (!hashFile(a_filenames[i], hash) || (m_textures.count(hash) > 0) || queued[hash])
+        {
+            continue;
+        }
+        queued[hash] = true;
+
+        DecodeJob job;
+        job.filename = a_filenames[i];
+        job.hash = hash;
+        job.image = cImage::create();
+        job.loaded = false;
+        job.decodeTime = 0.0;
+        jobs.push_back(job);
+    }
+
+    unsigned int numThreads = a_numThreads;
+    if (numThreads == 0)
+    {
+        numThreads = max(1u, thread::hardware_concurrency());
+    }
+    numThreads = min(numThreads, (unsigned int)jobs.size());
+
+    // each worker takes the next undecoded image until none are left
+    atomic<unsigned int> nextJob(0);
+    vector<thread> workers;
+    for (unsigned int t = 0; t < numThreads; t++)
+    {
+        workers.push_back(thread([&jobs, &nextJob]()
+        {
+            unsigned int index;
+            while ((index = nextJob.fetch_add(1)) < jobs.size())
+            {
+                DecodeJob& job = jobs[index];
+                cPrecisionClock decodeClock;
+                decodeClock.start(true);
+                job.loaded = job.image->loadFromFile(job.filename);
+                job.decodeTime = decodeClock.getCurrentTimeSeconds();
+            }
+        }));
+    }
+    for (unsigned int t = 0; t < workers.size(); t++)
+    {
+        workers[t].join();
+    }
+
+    for (unsigned int i = 0; i < jobs.size(); i++)
+    {
+        if (jobs[i].loaded)
+        {
+            addTexture(jobs[i].image, jobs[i].hash);
+            printf("decoded %s in %.1f ms\n", jobs[i].filename.c_str(), jobs[i].decodeTime * 1000.0);
+        }
+        else
+        {
+            printf("failed to decode %s\n", jobs[i].filename.c_str());
+        }
+    }
+
+    printf("decoded %u images (%u requested) on %u threads in %.1f ms\n",
+           (unsigned int)jobs.size(), (unsigned int)a_filenames.size(), numThreads,
+           clock.getCurrentTimeSeconds() * 1000.0);
+}
+
+
+//==============================================================================
+/*!
+    Wraps a decoded image into a texture (GL_REPEAT wrapping, mipmaps) and
+    adds it to the cache.
+
+    \param  a_image  Decoded image.
+    \param  a_hash   Content hash of the image file.
+
+    \return  New texture.
+*/
+//==============================================================================
+cTexture2dPtr AssetCache::addTexture(cImagePtr a_image, unsigned long long a_hash)
+{
+    cTexture2dPtr texture = cTexture2d::create();
+    texture->setImage(a_image);
+    texture->setWrapModeS(GL_REPEAT);
+    texture->setWrapModeT(GL_REPEAT);
+    texture->setUseMipmaps(true);
+
+    m_textures[a_hash] = texture;
+    m_textureHashes[texture.get()] = a_hash;
+    return (texture);
+}
+
+
+//==============================================================================
+/*!
+    Returns the haptic texel map baked from three textures, baking it the
+    first time this combination of maps is requested.
+
+    \param  a_normalMap     Normal map, obtained from getTexture().
+    \param  a_heightMap     Height map, obtained from getTexture().
+    \param  a_roughnessMap  Roughness map, obtained from getTexture().
+
+    \return Shared texel map, or NULL if a map is missing or was not loaded
+            by this cache.
+*/
+//==============================================================================
+HapticTexelMapPtr AssetCache::getHapticTexels(const cTexture2dPtr& a_normalMap,
+                                              const cTexture2dPtr& a_heightMap,
+                                              const cTexture2dPtr& a_roughnessMap)
+{
+    map<const cTexture2d*, unsigned long long>::iterator normal = m_textureHashes.find(a_normalMap.get());
+    map<const cTexture2d*, unsigned long long>::iterator height = m_textureHashes.find(a_heightMap.get());
+    map<const cTexture2d*, unsigned long long>::iterator roughness = m_textureHashes.find(a_roughnessMap.get());
+
+    if ((normal == m_textureHashes.end()) || (height == m_textureHashes.end()) || (roughness == m_textureHashes.end()))
+    {
+        return (NULL);
+    }
+
+    tuple<unsigned long long, unsigned long long, unsigned long long> key(normal->second, height->second, roughness->second);
+
+    map<tuple<unsigned long long, unsigned long long, unsigned long long>, HapticTexelMapPtr>::iterator cached = m_texelMaps.find(key);
+    if (cached != m_texelMaps.end())
+    {
+        m_numHits++;
+        return (cached->second);
+    }
+
+    HapticTexelMapPtr texels = HapticTexelMap::create();
+    if (!texels->bake(a_normalMap->m_image, a_heightMap->m_image, a_roughnessMap->m_image))
+    {
+        return (NULL);
+    }
+
+    m_texelMaps[key] = texels;
+    return (texels);
+}
+
+
+//==============================================================================
+/*!
+    Returns the tangent frames of a mesh, building them the first time its
+    vertex data is requested. Instances of the same mesh share their vertex
+    data, and therefore their frames.
+
+    \param  a_mesh  Mesh whose BTN vectors have been computed.
+
+    \return Shared tangent frames.
+*/
+//==============================================================================
+TangentFramesPtr AssetCache::getTangentFrames(cMesh* a_mesh)
+{
+    const cVertexArray* vertices = a_mesh->m_vertices.get();
+
+    map<const cVertexArray*, TangentFramesPtr>::iterator cached = m_tangentFrames.find(vertices);
+    if (cached != m_tangentFrames.end())
+    {
+        m_numHits++;
+        return (cached->second);
+    }
+
+    TangentFramesPtr frames = TangentFrames::create(a_mesh);
+    m_tangentFrames[vertices] = frames;
+    return (frames);
+}
+
+
+//==============================================================================
+/*!
+    Detaches the shared collision trees from all instances, so that deleting
+    an instance (or the world holding it) does not delete a tree that other
+    instances still use. The trees are deleted with the cache.
+*/
+//==============================================================================
+void AssetCache::releaseInstances()
+{
+    for (unsigned int i = 0; i < m_instanceMeshes.size(); i++)
+    {
+        m_instanceMeshes[i]->setCollisionDetector(NULL);
+    }
+    m_instanceMeshes.clear();
+}
+
+
+//==============================================================================
+/*!
+    Detaches the shared collision trees from one instance, and forgets it,
+    so that it can be deleted while the other instances live on.
+
+    \param  a_instance  Instance returned by newMeshInstance().
+*/
+//==============================================================================
+void AssetCache::releaseInstance(cMultiMesh* a_instance)
+{
+    for (unsigned int i = 0; i < a_instance->getNumMeshes(); i++)
+    {
+        cMesh* mesh = a_instance->getMesh(i);
+        mesh->setCollisionDetector(NULL);
+        m_instanceMeshes.erase(remove(m_instanceMeshes.begin(), m_instanceMeshes.end(), mesh), m_instanceMeshes.end());
+    }
+}
+
+
+//==============================================================================
+/*!
+    Prints how many assets were loaded and how many requests they served.
+*/
+//==============================================================================
+void AssetCache::printStatistics() const
+{
+    printf("asset cache: %u meshes (%u instances), %u textures, %u texel maps, %u tangent frame sets, %u requests shared\n",
+           (unsigned int)m_meshes.size(),
+           (unsigned int)m_instanceMeshes.size(),
+           (unsigned int)m_textures.size(),
+           (unsigned int)m_texelMaps.size(),
+           (unsigned int)m_tangentFrames.size(),
+           m_numHits);
+}
+
+
+//==============================================================================
+/*!
+    Maps a scene pack and adds its assets to the cache. The content hashes
+    of the packed source files are taken from the pack, so those files are
+    not read; only their size and modification time are checked against
+    the pack. If a source file is missing, has another size, or was
+    modified after the pack was written, the pack is stale and rejected,
+    and the caller loads the source files instead. Decoded images are copied once into the textures that will be
+    uploaded to GL; haptic texels and tangent frames are used in place in the
+    mapped file. Meshes are built from the pack when they are first
+    requested.
+
+    \param  a_filename  Pack file, written by savePack().
+
+    \return true if the pack was mapped, is valid and is up to date.
+*/
+//==============================================================================
+bool AssetCache::loadPack(const string& a_filename)
+{
+    if (!m_pack.open(a_filename))
+    {
+        return (false);
+    }
+
+    // check every source file before taking anything from the pack
+    for (unsigned int i = 0; i < m_pack.getNumEntries(); i++)
+    {
+        const ScenePackEntry& entry = m_pack.getEntry(i);
+        if (entry.type != SCENE_PACK_FILE)
+        {
+            continue;
+        }
+
+        string name(entry.name, strnlen(entry.name, sizeof(entry.name)));
+        unsigned long long size, modified;
+        if (!getFileStamp(name, size, modified) || (size != entry.key[1]) || (modified > entry.key[2]))
+        {
+            printf("scene pack %s is stale: %s changed since it was written\n", a_filename.c_str(), name.c_str());
+            m_pack.close();
+            return (false);
+        }
+    }
+
+    for (unsigned int i = 0; i < m_pack.getNumEntries(); i++)
+    {
+        const ScenePackEntry& entry = m_pack.getEntry(i);
+
+        if (entry.type == SCENE_PACK_FILE)
+        {
+            string name(entry.name, strnlen(entry.name, sizeof(entry.name)));
+            m_fileHashes[name] = entry.key[0];
+        }
+        else if ((entry.type == SCENE_PACK_IMAGE) && (m_textures.count(entry.key[0]) == 0))
+        {
+            cImagePtr image = cImage::create();
+            if (image->allocate(entry.width, entry.height, entry.format) &&
+                (image->getBytesPerPixel() == entry.count) &&
+                ((unsigned long long)entry.width * entry.height * entry.count == entry.size))
+            {
+                memcpy(image->getData(), m_pack.getData(entry), (size_t)entry.size);
+                addTexture(image, entry.key[0]);
+            }
+        }
+        else if ((entry.type == SCENE_PACK_TEXELS) &&
+                 ((unsigned long long)entry.width * entry.height * sizeof(HapticTexel) == entry.size))
+        {
+            HapticTexelMapPtr texels = HapticTexelMap::create();
+            texels->setView((const HapticTexel*)m_pack.getData(entry), entry.width, entry.height);
+            m_texelMaps[make_tuple(entry.key[0], entry.key[1], entry.key[2])] = texels;
+        }
+    }
+
+    return (true);
+}
+
+
+//==============================================================================
+/*!
+    Builds a mesh file from the pack: vertices with their BTN vectors and
+    triangles are read from the pack, the packed tangent frames are used in
+    place, and the AABB collision tree is built from the packed triangles.
+
+    \param  a_hash        Content hash of the mesh file.
+    \param  a_toolRadius  Radius of the tool, used to build the collision tree.
+
+    \return New mesh, or NULL if the pack does not hold this mesh file or
+            its entries are inconsistent (the caller then loads the file).
+*/
+//==============================================================================
+cMultiMesh* AssetCache::newPackedMesh(unsigned long long a_hash, double a_toolRadius)
+{
+    const unsigned long long key[3] = { a_hash, 0, 0 };
+    if (m_pack.findEntry(SCENE_PACK_MESH_VERTICES, key, 0) == NULL)
+    {
+        return (NULL);
+    }
+
+    // check every entry against its size, and every index against the vertices, before building anything
+    for (unsigned int m = 0; ; m++)
+    {
+        const ScenePackEntry* vertexEntry = m_pack.findEntry(SCENE_PACK_MESH_VERTICES, key, m);
+        const ScenePackEntry* triangleEntry = m_pack.findEntry(SCENE_PACK_MESH_TRIANGLES, key, m);
+        if ((vertexEntry == NULL) || (triangleEntry == NULL))
+        {
+            break;
+        }
+
+        if (((unsigned long long)vertexEntry->count * sizeof(ScenePackVertex) != vertexEntry->size) ||
+            ((unsigned long long)triangleEntry->count * 3 * sizeof(unsigned int) != triangleEntry->size))
+        {
+            return (NULL);
+        }
+
+        const unsigned int* triangles = (const unsigned int*)m_pack.getData(*triangleEntry);
+        for (unsigned long long i = 0; i < 3ull * triangleEntry->count; i++)
+        {
+            if (triangles[i] >= vertexEntry->count)
+            {
+                return (NULL);
+            }
+        }
+
+        const ScenePackEntry* frameEntry = m_pack.findEntry(SCENE_PACK_TANGENT_FRAMES, key, m);
+        if ((frameEntry != NULL) &&
+            ((unsigned long long)frameEntry->count * sizeof(TangentFrame) != frameEntry->size))
+        {
+            return (NULL);
+        }
+    }
+
+    cMultiMesh* multiMesh = new cMultiMesh();
+
+    for (unsigned int m = 0; ; m++)
+    {
+        const ScenePackEntry* vertexEntry = m_pack.findEntry(SCENE_PACK_MESH_VERTICES, key, m);
+        const ScenePackEntry* triangleEntry = m_pack.findEntry(SCENE_PACK_MESH_TRIANGLES, key, m);
+        if ((vertexEntry == NULL) || (triangleEntry == NULL))
+        {
+            break;
+        }
+
+        cMesh* mesh = multiMesh->newMesh();
+
+        const ScenePackVertex* vertices = (const ScenePackVertex*)m_pack.getData(*vertexEntry);
+        for (unsigned int i = 0; i < vertexEntry->count; i++)
+        {
+            const ScenePackVertex& v = vertices[i];
+            unsigned int index = mesh->newVertex(cVector3d(v.pos[0], v.pos[1], v.pos[2]));
+            mesh->m_vertices->setNormal(index, cVector3d(v.normal[0], v.normal[1], v.normal[2]));
+            mesh->m_vertices->setTangent(index, cVector3d(v.tangent[0], v.tangent[1], v.tangent[2]));
+            mesh->m_vertices->setBitangent(index, cVector3d(v.bitangent[0], v.bitangent[1], v.bitangent[2]));
+            mesh->m_vertices->setTexCoord(index, cVector3d(v.texCoord[0], v.texCoord[1], v.texCoord[2]));
+        }
+
+        const unsigned int* triangles = (const unsigned int*)m_pack.getData(*triangleEntry);
+        for (unsigned int i = 0; i < triangleEntry->count; i++)
+        {
+            mesh->newTriangle(triangles[3*i], triangles[3*i + 1], triangles[3*i + 2]);
+        }
+
+        const ScenePackEntry* frameEntry = m_pack.findEntry(SCENE_PACK_TANGENT_FRAMES, key, m);
+        if ((frameEntry != NULL) && (frameEntry->count == mesh->getNumTriangles()))
+        {
+            m_tangentFrames[mesh->m_vertices.get()] = TangentFrames::create((const TangentFrame*)m_pack.getData(*frameEntry), frameEntry->count);
+        }
+    }
+
+    multiMesh->createAABBCollisionDetector(a_toolRadius);
+    return (multiMesh);
+}
+
+
+//==============================================================================
+/*!
+    Writes every asset loaded so far into a scene pack: the content hashes,
+    sizes and modification times of the source files, the meshes with their BTN vectors and tangent
+    frames, the decoded images and the baked haptic texels.
+
+    \param  a_filename  Pack file to write.
+
+    \return true if the pack was written.
+*/
+//==============================================================================
+bool AssetCache::savePack(const string& a_filename)
+{
+    ScenePackWriter writer;
+
+    for (map<string, unsigned long long>::iterator it = m_fileHashes.begin(); it != m_fileHashes.end(); ++it)
+    {
+        ScenePackEntry entry;
+        memset(&entry, 0, sizeof(entry));
+        if (it->first.size() >= sizeof(entry.name))
+        {
+            printf("path too long for a scene pack: %s\n", it->first.c_str());
+            return (false);
+        }
+        entry.type = SCENE_PACK_FILE;
+        entry.key[0] = it->second;
+        if (!getFileStamp(it->first, entry.key[1], entry.key[2]))
+        {
+            printf("could not read %s\n", it->first.c_str());
+            return (false);
+        }
+        strcpy(entry.name, it->first.c_str());
+        writer.addEntry(entry, NULL, 0);
+    }
+
+    for (map<unsigned long long, cMultiMesh*>::iterator it = m_meshes.begin(); it != m_meshes.end(); ++it)
+    {
+        for (unsigned int m = 0; m < it->second->getNumMeshes(); m++)
+        {
+            cMesh* mesh = it->second->getMesh(m);
+
+            ScenePackEntry entry;
+            memset(&entry, 0, sizeof(entry));
+            entry.key[0] = it->first;
+            entry.index = m;
+
+            vector<ScenePackVertex> vertices(mesh->getNumVertices());
+            for (unsigned int i = 0; i < vertices.size(); i++)
+            {
+                cVector3d pos = mesh->m_vertices->getLocalPos(i);
+                cVector3d normal = mesh->m_vertices->getNormal(i);
+                cVector3d tangent = mesh->m_vertices->getTangent(i);
+                cVector3d bitangent = mesh->m_vertices->getBitangent(i);
+                cVector3d texCoord = mesh->m_vertices->getTexCoord(i);
+                for (int k = 0; k < 3; k++)
+                {
+                    vertices[i].pos[k] = pos(k);
+                    vertices[i].normal[k] = normal(k);
+                    vertices[i].tangent[k] = tangent(k);
+                    vertices[i].bitangent[k] = bitangent(k);
+                    vertices[i].texCoord[k] = texCoord(k);
+                }
+            }
+            entry.type = SCENE_PACK_MESH_VERTICES;
+            entry.count = (unsigned int)vertices.size();
+            writer.addEntry(entry, vertices.empty() ? NULL : &vertices[0], vertices.size() * sizeof(ScenePackVertex));
+
+            vector<unsigned int> triangles(3 * mesh->getNumTriangles());
+            for (unsigned int i = 0; i < mesh->getNumTriangles(); i++)
+            {
+                triangles[3*i] = mesh->m_triangles->getVertexIndex0(i);
+                triangles[3*i + 1] = mesh->m_triangles->getVertexIndex1(i);
+                triangles[3*i + 2] = mesh->m_triangles->getVertexIndex2(i);
+            }
+            entry.type = SCENE_PACK_MESH_TRIANGLES;
+            entry.count = mesh->getNumTriangles();
+            writer.addEntry(entry, triangles.empty() ? NULL : &triangles[0], triangles.size() * sizeof(unsigned int));
+
+            TangentFramesPtr frames = getTangentFrames(mesh);
+            entry.type = SCENE_PACK_TANGENT_FRAMES;
+            entry.count = frames->getNumFrames();
+            writer.addEntry(entry, frames->getFrames(), frames->getNumFrames() * sizeof(TangentFrame));
+        }
+    }
+
+    for (map<unsigned long long, cTexture2dPtr>::iterator it = m_textures.begin(); it != m_textures.end(); ++it)
+    {
+        cImagePtr image = it->second->m_image;
+
+        ScenePackEntry entry;
+        memset(&entry, 0, sizeof(entry));
+        entry.type = SCENE_PACK_IMAGE;
+        entry.key[0] = it->first;
+        entry.width = image->getWidth();
+        entry.height = image->getHeight();
+        entry.format = image->getFormat();
+        entry.count = image->getBytesPerPixel();
+        writer.addEntry(entry, image->getData(), (size_t)entry.width * entry.height * entry.count);
+    }
+
+    for (map<tuple<unsigned long long, unsigned long long, unsigned long long>, HapticTexelMapPtr>::iterator it = m_texelMaps.begin(); it != m_texelMaps.end(); ++it)
+    {
+        const HapticTexelMap& texels = *it->second;
+
+        ScenePackEntry entry;
+        memset(&entry, 0, sizeof(entry));
+        entry.type = SCENE_PACK_TEXELS;
+        entry.key[0] = get<0>(it->first);
+        entry.key[1] = get<1>(it->first);
+        entry.key[2] = get<2>(it->first);
+        entry.width = texels.getWidth();
+        entry.height = texels.getHeight();
+        writer.addEntry(entry, texels.getTexels(), (size_t)entry.width * entry.height * sizeof(HapticTexel));
+    }
+
+    return (writer.save(a_filename));
+}
@@ -0,0 +1,119 @@
+//==============================================================================
+/*
+    CPSC 599.86 / 601.86 - Computer Haptics
+    Winter 2018, University of Calgary
+
+    This class loads every asset of the scene once and shares it between the
+    objects that use it. Assets are identified by a hash of their file
+    contents, so two paths holding the same bytes also share one asset.
+
+    - Meshes are parsed, given their BTN vectors and their AABB collision
+      tree once. Each object is an instance that shares the vertices,
+      triangles and collision tree of the loaded mesh by reference.
+    - Textures are decoded once and shared by every slot that uses the same
+      image (albedo, normal, height or roughness). preloadTextures() decodes
+      a batch of images concurrently on a pool of worker threads.
+    - Baked haptic texels and tangent frames are built once per combination
+      of maps and per mesh geometry.
+
+    The cache can also be filled from a scene pack (see ScenePack.h) written
+    by savePack(), in which case source files are neither read nor decoded;
+    only their size and modification time are checked against the pack.
+*/
+//==============================================================================
+
+#ifndef ASSETCACHE_H
+#define ASSETCACHE_H
+
+#include "chai3d.h"
+#include "HapticTexelMap.h"
+#include "TangentFrames.h"
+#include "ScenePack.h"
+#include <map>
+#include <string>
+#include <tuple>
+#include <vector>
+
+//------------------------------------------------------------------------------
+
+class AssetCache
+{
+public:
+
+    //! Constructor of AssetCache.
+    AssetCache();
+
+    //! Destructor of AssetCache. releaseInstances() must have been called.
+    ~AssetCache();
+
+    //! Returns a new instance of a mesh file, sharing its geometry and collision tree.
+    chai3d::cMultiMesh* newMeshInstance(const std::string& a_filename, double a_toolRadius);
+
+    //! Returns the shared texture of an image file (GL_REPEAT wrapping, mipmaps).
+    chai3d::cTexture2dPtr getTexture(const std::string& a_filename);
+
+    //! Decodes image files concurrently so that later getTexture() calls are cache hits.
+    void preloadTextures(const std::vector<std::string>& a_filenames, unsigned int a_numThreads = 0);
+
+    //! Returns the shared texel map baked from three textures of this cache.
+    HapticTexelMapPtr getHapticTexels(const chai3d::cTexture2dPtr& a_normalMap,
+                                      const chai3d::cTexture2dPtr& a_heightMap,
+                                      const chai3d::cTexture2dPtr& a_roughnessMap);
+
+    //! Returns the shared tangent frames of a mesh instance.
+    TangentFramesPtr getTangentFrames(chai3d::cMesh* a_mesh);
+
+    //! Detaches the shared collision trees from the instances. Call before deleting them.
+    void releaseInstances();
+
+    //! Detaches the shared collision trees from one instance. Call before deleting it.
+    void releaseInstance(chai3d::cMultiMesh* a_instance);
+
+    //! Prints how many assets were loaded and how many instances share them.
+    void printStatistics() const;
+
+    //! Maps a scene pack and serves the assets it contains from it; false if it is invalid or older than a source file.
+    bool loadPack(const std::string& a_filename);
+
+    //! Writes every asset loaded so far into a scene pack.
+    bool savePack(const std::string& a_filename);
+
+protected:
+
+    //! Hashes the contents of a file (64-bit FNV-1a). Returns false if it cannot be read.
+    bool hashFile(const std::string& a_filename, unsigned long long& a_hash);
+
+    //! Wraps a decoded image into a texture and adds it to the cache.
+    chai3d::cTexture2dPtr addTexture(chai3d::cImagePtr a_image, unsigned long long a_hash);
+
+    //! Builds a mesh from the pack. Returns NULL if the pack does not hold it or its entries are inconsistent.
+    chai3d::cMultiMesh* newPackedMesh(unsigned long long a_hash, double a_toolRadius);
+
+    //! Mapped scene pack, if one was loaded. Packed texels and frames point into it.
+    ScenePack m_pack;
+
+    //! Content hash of every file requested so far, by path.
+    std::map<std::string, unsigned long long> m_fileHashes;
+
+    //! Loaded meshes by content hash. These are never added to the world.
+    std::map<unsigned long long, chai3d::cMultiMesh*> m_meshes;
+
+    //! Decoded textures by content hash, and the content hash of each texture.
+    std::map<unsigned long long, chai3d::cTexture2dPtr> m_textures;
+    std::map<const chai3d::cTexture2d*, unsigned long long> m_textureHashes;
+
+    //! Baked texel maps by (normal, height, roughness) content hashes.
+    std::map<std::tuple<unsigned long long, unsigned long long, unsigned long long>, HapticTexelMapPtr> m_texelMaps;
+
+    //! Tangent frames by shared vertex array.
+    std::map<const chai3d::cVertexArray*, TangentFramesPtr> m_tangentFrames;
+
+    //! Meshes of all instances handed out, which share a collision tree.
+    std::vector<chai3d::cMesh*> m_instanceMeshes;
+
+    //! Number of requests served from the cache.
+    unsigned int m_numHits;
+};
+
+//------------------------------------------------------------------------------
+#endif
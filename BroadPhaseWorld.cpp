@@ -0,0 +1,432 @@
+//==============================================================================
+/*
+    CPSC 599.86 / 601.86 - Computer Haptics
+    Winter 2018, University of Calgary
+
+    A world with a uniform grid broad phase for the proxy's collision queries.
+*/
+//==============================================================================
+
+#include "BroadPhaseWorld.h"
+#include <algorithm>
+#include <cmath>
+
+using namespace chai3d;
+using namespace std;
+
+//------------------------------------------------------------------------------
+
+namespace
+{
+    // largest number of cells along an axis of the grid
+    const int C_MAX_CELLS_PER_AXIS = 256;
+
+    //! True if two boxes overlap.
+    inline bool overlaps(const cVector3d& a_minA, const cVector3d& a_maxA,
+                         const cVector3d& a_minB, const cVector3d& a_maxB)
+    {
+        return ((a_minA.x() <= a_maxB.x()) && (a_maxA.x() >= a_minB.x()) &&
+                (a_minA.y() <= a_maxB.y()) && (a_maxA.y() >= a_minB.y()) &&
+                (a_minA.z() <= a_maxB.z()) && (a_maxA.z() >= a_minB.z()));
+    }
+}
+
+
+//==============================================================================
+/*!
+    Constructor of BroadPhaseWorld.
+*/
+//==============================================================================
+BroadPhaseWorld::BroadPhaseWorld() :
+    m_useBroadPhase(true),
+    m_sharedByTools(false),
+    m_tileStreamer(NULL)
+{
+    m_dims[0] = m_dims[1] = m_dims[2] = 0;
+}
+
+
+//==============================================================================
+/*!
+    Bins the static meshes into a uniform grid. Every child of the world
+    that is a mesh or a multi-mesh with haptics enabled is indexed by the
+    world bounds of its boundary box; every other child is kept in a list
+    tested on every query. The cell size is the largest extent of an
+    indexed object, so that an object overlaps at most two cells per axis,
+    unless the grid would have more than C_MAX_CELLS_PER_AXIS cells along
+    an axis.
+
+    The haptic loop must not be running.
+*/
+//==============================================================================
+void BroadPhaseWorld::buildBroadPhase()
+{
+    clearBroadPhase();
+    computeGlobalPositions(true);
+
+    cVector3d gridMax;
+    double largestExtent = 0.0;
+
+    for (unsigned int i = 0; i < getNumChildren(); ++i)
+    {
+        cGenericObject* child = getChild(i);
+
+        // the streamed tiles change under the rendering thread; they are queried through their snapshot
+        if ((m_tileStreamer != NULL) && (child == m_tileStreamer->getRoot()))
+        {
+            continue;
+        }
+
+        // each tool is written by its own haptic thread, and never constrains a proxy
+        if (dynamic_cast<cGenericTool*>(child) != NULL)
+        {
+            continue;
+        }
+
+        bool isMesh = (dynamic_cast<cMesh*>(child) != NULL) || (dynamic_cast<cMultiMesh*>(child) != NULL);
+
+        if (!isMesh || !child->getHapticEnabled())
+        {
+            m_unindexedChildren.push_back(child);
+            continue;
+        }
+
+        child->computeBoundaryBox(true);
+        cVector3d localMin = child->getBoundaryMin();
+        cVector3d localMax = child->getBoundaryMax();
+
+        // world bounds of the eight corners of the local boundary box
+        IndexedObject entry;
+        entry.object = child;
+        for (int corner = 0; corner < 8; ++corner)
+        {
+            cVector3d local((corner & 1) ? localMax.x() : localMin.x(),
+                            (corner & 2) ? localMax.y() : localMin.y(),
+                            (corner & 4) ? localMax.z() : localMin.z());
+            cVector3d global = child->getGlobalPos() + child->getGlobalRot() * local;
+
+            for (int k = 0; k < 3; ++k)
+            {
+                entry.boundsMin(k) = (corner == 0) ? global(k) : min(entry.boundsMin(k), global(k));
+                entry.boundsMax(k) = (corner == 0) ? global(k) : max(entry.boundsMax(k), global(k));
+            }
+        }
+
+        for (int k = 0; k < 3; ++k)
+        {
+            m_gridMin(k) = m_objects.empty() ? entry.boundsMin(k) : min(m_gridMin(k), entry.boundsMin(k));
+            gridMax(k) = m_objects.empty() ? entry.boundsMax(k) : max(gridMax(k), entry.boundsMax(k));
+            largestExtent = max(largestExtent, entry.boundsMax(k) - entry.boundsMin(k));
+        }
+
+        m_objects.push_back(entry);
+    }
+
+    if (m_objects.empty())
+    {
+        return;
+    }
+
+    for (int k = 0; k < 3; ++k)
+    {
+        double extent = gridMax(k) - m_gridMin(k);
+        int dims = (largestExtent > 0.0) ? (int)ceil(extent / largestExtent) : 1;
+        m_dims[k] = max(1, min(dims, C_MAX_CELLS_PER_AXIS));
+        m_cellSize(k) = (extent > 0.0) ? (extent / m_dims[k]) : 1.0;
+    }
+
+    // count the objects of each cell, then fill the cells in one array
+    unsigned int numCells = getNumCells();
+    m_cellStart.assign(numCells + 1, 0);
+
+    for (int pass = 0; pass < 2; ++pass)
+    {
+        vector<unsigned int> fill;
+        if (pass == 1)
+        {
+            for (unsigned int c = 0; c < numCells; ++c)
+            {
+                m_cellStart[c + 1] += m_cellStart[c];
+            }
+            m_cellObjects.resize(m_cellStart[numCells]);
+            fill.assign(m_cellStart.begin(), m_cellStart.end() - 1);
+        }
+
+        for (unsigned int i = 0; i < m_objects.size(); ++i)
+        {
+            int first[3], last[3];
+            getCellRange(m_objects[i].boundsMin, m_objects[i].boundsMax, first, last);
+            for (int k = 0; k < 3; ++k)
+            {
+                m_objects[i].firstCell[k] = first[k];
+            }
+
+            for (int z = first[2]; z <= last[2]; ++z)
+                for (int y = first[1]; y <= last[1]; ++y)
+                    for (int x = first[0]; x <= last[0]; ++x)
+                    {
+                        unsigned int cell = (z * m_dims[1] + y) * m_dims[0] + x;
+                        if (pass == 0)
+                            m_cellStart[cell + 1]++;
+                        else
+                            m_cellObjects[fill[cell]++] = i;
+                    }
+        }
+    }
+}
+
+
+//==============================================================================
+/*!
+    Drops the index, so that queries walk every child of the world again.
+*/
+//==============================================================================
+void BroadPhaseWorld::clearBroadPhase()
+{
+    m_objects.clear();
+    m_unindexedChildren.clear();
+    m_cellStart.clear();
+    m_cellObjects.clear();
+    m_dims[0] = m_dims[1] = m_dims[2] = 0;
+}
+
+
+//==============================================================================
+/*!
+    Computes the range of cells overlapped by a box, clamped to the grid.
+
+    \param  a_min    Minimum corner of the box.
+    \param  a_max    Maximum corner of the box.
+    \param  a_first  Returned first cell along each axis.
+    \param  a_last   Returned last cell along each axis; below a_first if the box misses the grid.
+*/
+//==============================================================================
+void BroadPhaseWorld::getCellRange(const cVector3d& a_min, const cVector3d& a_max,
+                                   int a_first[3], int a_last[3]) const
+{
+    for (int k = 0; k < 3; ++k)
+    {
+        double first = floor((a_min(k) - m_gridMin(k)) / m_cellSize(k));
+        double last = floor((a_max(k) - m_gridMin(k)) / m_cellSize(k));
+
+        if ((last < 0.0) || (first >= m_dims[k]))
+        {
+            a_first[k] = 0;
+            a_last[k] = -1;
+            continue;
+        }
+
+        a_first[k] = (first < 0.0) ? 0 : (int)first;
+        a_last[k] = (last >= m_dims[k]) ? (m_dims[k] - 1) : (int)last;
+    }
+}
+
+
+//==============================================================================
+/*!
+    Runs the collision detection of an indexed object, if its bounds overlap
+    the query box.
+
+    \param  a_index          Index of the object.
+    \param  a_segmentPointA  Start of the segment, in world coordinates.
+    \param  a_segmentPointB  End of the segment, in world coordinates.
+    \param  a_min            Minimum corner of the query box.
+    \param  a_max            Maximum corner of the query box.
+    \param  a_recorder       Recorder of the collisions.
+    \param  a_settings       Settings of the query.
+
+    \return true if the object was hit.
+*/
+//==============================================================================
+bool BroadPhaseWorld::testObject(unsigned int a_index,
+                                 const cVector3d& a_segmentPointA,
+                                 const cVector3d& a_segmentPointB,
+                                 const cVector3d& a_min,
+                                 const cVector3d& a_max,
+                                 cCollisionRecorder& a_recorder,
+                                 cCollisionSettings& a_settings)
+{
+    const IndexedObject& entry = m_objects[a_index];
+    if (!overlaps(a_min, a_max, entry.boundsMin, entry.boundsMax))
+    {
+        return (false);
+    }
+
+    return (entry.object->computeCollisionDetection(a_segmentPointA, a_segmentPointB, a_recorder, a_settings));
+}
+
+
+//==============================================================================
+/*!
+    Collision query of the proxy. Without an index this is CHAI3D's walk
+    over every child (except the tools, and the root of the streamed tiles,
+    which are queried through the streamer). Otherwise the unindexed
+    children are tested as before, and the indexed objects only if they lie
+    in a cell overlapped by the segment's box grown by the collision
+    radius. An object spanning several cells is tested in the first of
+    them the query overlaps, so that the query writes nothing but the
+    recorder. The world itself is assumed to sit at the origin, so the
+    segment is already in the frame of its children.
+
+    \param  a_segmentPointA  Start of the segment.
+    \param  a_segmentPointB  End of the segment.
+    \param  a_recorder       Recorder of the collisions.
+    \param  a_settings       Settings of the query.
+
+    \return true if an object was hit.
+*/
+//==============================================================================
+bool BroadPhaseWorld::computeCollisionDetection(const cVector3d& a_segmentPointA,
+                                                const cVector3d& a_segmentPointB,
+                                                cCollisionRecorder& a_recorder,
+                                                cCollisionSettings& a_settings)
+{
+    if (!getEnabled())
+    {
+        return (false);
+    }
+
+    if (!m_useBroadPhase || m_objects.empty())
+    {
+        bool hit = false;
+        if (m_tileStreamer != NULL)
+        {
+            hit = m_tileStreamer->computeCollisionDetection(a_segmentPointA, a_segmentPointB, a_recorder, a_settings);
+        }
+
+        // every child but the tools and the root of the streamed tiles
+        for (unsigned int i = 0; i < getNumChildren(); ++i)
+        {
+            cGenericObject* child = getChild(i);
+            if (((m_tileStreamer != NULL) && (child == m_tileStreamer->getRoot())) ||
+                (dynamic_cast<cGenericTool*>(child) != NULL))
+            {
+                continue;
+            }
+            hit = child->computeCollisionDetection(a_segmentPointA, a_segmentPointB, a_recorder, a_settings) || hit;
+        }
+        return (hit);
+    }
+
+    bool hit = false;
+
+    if (m_tileStreamer != NULL)
+    {
+        hit = m_tileStreamer->computeCollisionDetection(a_segmentPointA, a_segmentPointB, a_recorder, a_settings);
+    }
+
+    for (size_t i = 0; i < m_unindexedChildren.size(); ++i)
+    {
+        hit = m_unindexedChildren[i]->computeCollisionDetection(a_segmentPointA, a_segmentPointB, a_recorder, a_settings) || hit;
+    }
+
+    // box of the segment, grown by the radius of the proxy
+    double radius = a_settings.m_collisionRadius;
+    cVector3d queryMin, queryMax;
+    for (int k = 0; k < 3; ++k)
+    {
+        queryMin(k) = min(a_segmentPointA(k), a_segmentPointB(k)) - radius;
+        queryMax(k) = max(a_segmentPointA(k), a_segmentPointB(k)) + radius;
+    }
+
+    int first[3], last[3];
+    getCellRange(queryMin, queryMax, first, last);
+
+    unsigned int numCells = (unsigned int)(max(0, last[0] - first[0] + 1) *
+                                           max(0, last[1] - first[1] + 1) *
+                                           max(0, last[2] - first[2] + 1));
+
+    // a segment spanning more cells than there are objects is cheaper to test against each object
+    if (numCells > m_objects.size())
+    {
+        for (unsigned int i = 0; i < m_objects.size(); ++i)
+        {
+            hit = testObject(i, a_segmentPointA, a_segmentPointB, queryMin, queryMax, a_recorder, a_settings) || hit;
+        }
+        return (hit);
+    }
+
+    for (int z = first[2]; z <= last[2]; ++z)
+        for (int y = first[1]; y <= last[1]; ++y)
+            for (int x = first[0]; x <= last[0]; ++x)
+            {
+                unsigned int cell = (z * m_dims[1] + y) * m_dims[0] + x;
+                for (unsigned int c = m_cellStart[cell]; c < m_cellStart[cell + 1]; ++c)
+                {
+                    // only in the first cell both the object and the query overlap
+                    const int* firstCell = m_objects[m_cellObjects[c]].firstCell;
+                    if ((x != max(firstCell[0], first[0])) ||
+                        (y != max(firstCell[1], first[1])) ||
+                        (z != max(firstCell[2], first[2])))
+                    {
+                        continue;
+                    }
+
+                    hit = testObject(m_cellObjects[c], a_segmentPointA, a_segmentPointB, queryMin, queryMax, a_recorder, a_settings) || hit;
+                }
+            }
+
+    return (hit);
+}
+
+
+//==============================================================================
+/*!
+    Interaction query of the potential field algorithm. The indexed trays
+    carry no effects and are skipped; every other child is walked as
+    CHAI3D's world does, except the tools, and the streamed tiles are
+    walked through the streamer. Without an index only the tools and the
+    root of the streamed tiles are skipped. The world itself is assumed to
+    sit at the origin.
+
+    CHAI3D's walk stores the interaction state of the tool in every object
+    it visits. The threads of several tools would write it at once, so a
+    world shared by tools returns no force without walking.
+
+    \param  a_toolPos       Position of the tool.
+    \param  a_toolVel       Velocity of the tool.
+    \param  a_IDN           Identification number of the force algorithm.
+    \param  a_interactions  Recorder of the interactions.
+
+    \return Interaction force.
+*/
+//==============================================================================
+cVector3d BroadPhaseWorld::computeInteractions(const cVector3d& a_toolPos,
+                                               const cVector3d& a_toolVel,
+                                               const unsigned int a_IDN,
+                                               cInteractionRecorder& a_interactions)
+{
+    cVector3d force(0.0, 0.0, 0.0);
+    if (!getEnabled() || m_sharedByTools)
+    {
+        return (force);
+    }
+
+    if (m_tileStreamer != NULL)
+    {
+        force.add(m_tileStreamer->computeInteractions(a_toolPos, a_toolVel, a_IDN, a_interactions));
+    }
+
+    if (!m_useBroadPhase || m_objects.empty())
+    {
+        // every child but the tools and the root of the streamed tiles
+        for (unsigned int i = 0; i < getNumChildren(); ++i)
+        {
+            cGenericObject* child = getChild(i);
+            if (((m_tileStreamer != NULL) && (child == m_tileStreamer->getRoot())) ||
+                (dynamic_cast<cGenericTool*>(child) != NULL))
+            {
+                continue;
+            }
+            force.add(child->computeInteractions(a_toolPos, a_toolVel, a_IDN, a_interactions));
+        }
+        return (force);
+    }
+
+    for (size_t i = 0; i < m_unindexedChildren.size(); ++i)
+    {
+        force.add(m_unindexedChildren[i]->computeInteractions(a_toolPos, a_toolVel, a_IDN, a_interactions));
+    }
+
+    return (force);
+}
@@ -0,0 +1,133 @@
+//==============================================================================
+/*
+    CPSC 599.86 / 601.86 - Computer Haptics
+    Winter 2018, University of Calgary
+
+    A world with a broad phase for the proxy's collision queries. CHAI3D's
+    world tests the proxy segment against every child, each with its own
+    AABB tree, so the cost of a haptic tick grows with the number of
+    objects. Here the static meshes are binned once into a uniform grid over
+    their world bounds; a query only visits the cells overlapped by the
+    segment (grown by the collision radius), and only the objects in those
+    cells run their own collision detection.
+
+    Every child that is not indexed (the camera, the debug widgets, ...)
+    is still tested on every query, as before, but for the tools: a tool
+    is never a surface for a proxy. Indexed objects are assumed not to
+    move; whoever adds, removes or moves one calls buildBroadPhase() again,
+    with the haptic loop stopped.
+
+    Queries keep no state in the world, so the haptic threads of several
+    tools can query it at once without locks.
+
+    Tiles streamed in around the tool (see TileStreamer) are queried
+    through the streamer's own snapshot; its root is never walked here.
+
+    The interaction query of the potential field skips the indexed trays,
+    which carry no effects, and walks the other children and the streamed
+    tiles. CHAI3D's walk stores the state of the tool in every object it
+    visits, so a world shared by several tools (setSharedByTools()) runs no
+    interaction walk at all.
+*/
+//==============================================================================
+
+#ifndef BROADPHASEWORLD_H
+#define BROADPHASEWORLD_H
+
+#include "chai3d.h"
+#include "TileStreamer.h"
+#include <vector>
+
+//------------------------------------------------------------------------------
+
+class BroadPhaseWorld : public chai3d::cWorld
+{
+public:
+
+    //! Constructor of BroadPhaseWorld. Queries walk every child until buildBroadPhase() is called.
+    BroadPhaseWorld();
+
+    //! Indexes the meshes and multi-meshes with haptics enabled; every other child stays unindexed.
+    void buildBroadPhase();
+
+    //! Drops the index; queries walk every child again.
+    void clearBroadPhase();
+
+    //! Streamer of the tiles around the tool, whose root is a child of this world (NULL for none). Call before buildBroadPhase().
+    void setTileStreamer(TileStreamer* a_streamer) { m_tileStreamer = a_streamer; }
+
+    //! Marks the world as queried by the haptic threads of several tools; the interaction query then walks nothing.
+    void setSharedByTools(bool a_shared) { m_sharedByTools = a_shared; }
+
+    //! Enables or disables the broad phase, keeping the index.
+    void setUseBroadPhase(bool a_useBroadPhase) { m_useBroadPhase = a_useBroadPhase; }
+
+    //! Number of objects in the index.
+    unsigned int getNumIndexedObjects() const { return ((unsigned int)m_objects.size()); }
+
+    //! Number of cells of the grid.
+    unsigned int getNumCells() const { return (m_dims[0] * m_dims[1] * m_dims[2]); }
+
+    //! Collision query of the proxy; visits only the indexed objects near the segment. Safe from several threads.
+    virtual bool computeCollisionDetection(const chai3d::cVector3d& a_segmentPointA,
+                                           const chai3d::cVector3d& a_segmentPointB,
+                                           chai3d::cCollisionRecorder& a_recorder,
+                                           chai3d::cCollisionSettings& a_settings);
+
+    //! Interaction query of the potential field; walks every child but the indexed trays and the tools.
+    virtual chai3d::cVector3d computeInteractions(const chai3d::cVector3d& a_toolPos,
+                                                  const chai3d::cVector3d& a_toolVel,
+                                                  const unsigned int a_IDN,
+                                                  chai3d::cInteractionRecorder& a_interactions);
+
+protected:
+
+    //! An indexed object and its bounds in the world.
+    struct IndexedObject
+    {
+        chai3d::cGenericObject* object;
+        chai3d::cVector3d boundsMin;
+        chai3d::cVector3d boundsMax;
+
+        //! First cell it overlaps along each axis.
+        int firstCell[3];
+    };
+
+    //! Range of cells overlapped by a box, clamped to the grid.
+    void getCellRange(const chai3d::cVector3d& a_min, const chai3d::cVector3d& a_max,
+                      int a_first[3], int a_last[3]) const;
+
+    //! Tests a segment against an indexed object if its bounds overlap the query box.
+    bool testObject(unsigned int a_index,
+                    const chai3d::cVector3d& a_segmentPointA,
+                    const chai3d::cVector3d& a_segmentPointB,
+                    const chai3d::cVector3d& a_min,
+                    const chai3d::cVector3d& a_max,
+                    chai3d::cCollisionRecorder& a_recorder,
+                    chai3d::cCollisionSettings& a_settings);
+
+    bool m_useBroadPhase;
+
+    //! true if several haptic threads query the world.
+    bool m_sharedByTools;
+
+    //! Streamer of the tiles, or NULL.
+    TileStreamer* m_tileStreamer;
+
+    std::vector<IndexedObject> m_objects;
+
+    //! Children tested on every query.
+    std::vector<chai3d::cGenericObject*> m_unindexedChildren;
+
+    //! Grid over the bounds of the indexed objects.
+    chai3d::cVector3d m_gridMin;
+    chai3d::cVector3d m_cellSize;
+    int m_dims[3];
+
+    //! Objects of cell c are m_cellObjects[m_cellStart[c]] to m_cellObjects[m_cellStart[c + 1] - 1].
+    std::vector<unsigned int> m_cellStart;
+    std::vector<unsigned int> m_cellObjects;
+};
+
+//------------------------------------------------------------------------------
+#endif
@@ -0,0 +1,278 @@
+//==============================================================================
+/*
+    CPSC 599.86 / 601.86 - Computer Haptics
+    Winter 2018, University of Calgary
+
+    Mid-rate control loop owning the workspace drift and the camera.
+*/
+//==============================================================================
+
+#include "ControlLoop.h"
+#include "HapticTelemetry.h"
+#include <algorithm>
+#include <chrono>
+
+using namespace chai3d;
+using namespace std;
+
+//------------------------------------------------------------------------------
+
+namespace
+{
+    // the drift rates were tuned as distances per 1 ms haptic tick
+    const double C_DRIFT_TICK = 0.001;
+
+    // longest step integrated at once, so that a stalled thread does not make the avatar jump
+    const double C_MAX_STEP_TIME = 0.05;
+}
+
+
+//==============================================================================
+/*!
+    Constructor of ControlLoop.
+*/
+//==============================================================================
+ControlLoop::ControlLoop() :
+    m_workspaceRadius(0.0375),
+    m_hasToolPos(false),
+    m_running(false)
+{
+}
+
+
+//==============================================================================
+/*!
+    Destructor of ControlLoop.
+*/
+//==============================================================================
+ControlLoop::~ControlLoop()
+{
+    stop();
+}
+
+
+//==============================================================================
+/*!
+    Sets the initial camera pose. The camera then keeps its offset to the
+    tool in the xy plane.
+
+    \param  a_position  Initial position of the camera.
+    \param  a_lookAt    Initial target of the camera.
+*/
+//==============================================================================
+void ControlLoop::setCamera(const cVector3d& a_position, const cVector3d& a_lookAt)
+{
+    m_cameraPosition = a_position;
+    m_cameraLookAt = a_lookAt;
+}
+
+
+//==============================================================================
+/*!
+    Starts the control thread.
+
+    \param  a_rateHz  Rate of the control steps.
+*/
+//==============================================================================
+void ControlLoop::start(unsigned int a_rateHz)
+{
+    if (m_running.exchange(true))
+    {
+        return;
+    }
+
+    m_thread = thread(&ControlLoop::run, this, a_rateHz);
+}
+
+
+//==============================================================================
+/*!
+    Stops the control thread.
+*/
+//==============================================================================
+void ControlLoop::stop()
+{
+    if (!m_running.exchange(false))
+    {
+        return;
+    }
+
+    m_thread.join();
+}
+
+
+//==============================================================================
+/*!
+    Body of the control thread. Steps are paced on absolute deadlines so
+    that the rate does not drift, and each step integrates the time actually
+    elapsed since the previous one.
+
+    \param  a_rateHz  Rate of the control steps.
+*/
+//==============================================================================
+void ControlLoop::run(unsigned int a_rateHz)
+{
+    chrono::steady_clock::duration period = chrono::duration_cast<chrono::steady_clock::duration>(
+        chrono::duration<double>(1.0 / max(a_rateHz, 1u)));
+
+    chrono::steady_clock::time_point last = chrono::steady_clock::now();
+    chrono::steady_clock::time_point next = last + period;
+
+    while (m_running.load())
+    {
+        this_thread::sleep_until(next);
+        next += period;
+
+        chrono::steady_clock::time_point now = chrono::steady_clock::now();
+        double dt = chrono::duration<double>(now - last).count();
+        last = now;
+
+        step(min(dt, C_MAX_STEP_TIME));
+    }
+}
+
+
+//==============================================================================
+/*!
+    Runs one control step. When the device leaves the workspace radius, the
+    tool drifts in the direction of the device, faster the further out the
+    device is; the target published for the haptic loop is where the tool
+    should be after this step. The camera keeps its initial offset to the
+    tool in the xy plane.
+
+    \param  a_dt  Time since the previous step, in seconds.
+*/
+//==============================================================================
+void ControlLoop::step(double a_dt)
+{
+    ToolStateRecord state;
+    if (!m_toolState.read(state))
+    {
+        return;
+    }
+
+    cVector3d toolPos = loadTelemetry(state.toolPos);
+    cVector3d devicePos = loadTelemetry(state.devicePos);
+
+    if (!m_hasToolPos)
+    {
+        m_cameraToolPos = toolPos;
+        m_hasToolPos = true;
+    }
+
+    /////////////////////////////////////////////////////////////////////
+    // WORKSPACE DRIFT
+    /////////////////////////////////////////////////////////////////////
+
+    cVector3d position = cVector3d(devicePos.x(), devicePos.y(), 0.0);
+
+    if (position.x() < 0.0)
+        position = cVector3d(position.x() - 0.01, position.y(), 0.0);
+    else
+        position = cVector3d(position.x() + 0.02, position.y(), 0.0);
+
+    cVector3d positionDirection = position;
+    positionDirection.normalize();
+
+    // the target is a whole control step ahead; the haptic loop gets there at the drift rate,
+    // one step per tick, rather than in one jump
+    cVector3d toolTarget = toolPos;
+    double stepPerTick = 0.0;
+    if (position.length() > m_workspaceRadius)
+    {
+        stepPerTick = min((max((position.length() - m_workspaceRadius) * 0.015, 0.00001)), C_MAX_DRIFT_STEP);
+        toolTarget = toolPos + positionDirection * (stepPerTick * a_dt / C_DRIFT_TICK);
+    }
+
+    ToolOffsetRecord offset;
+    storeTelemetry(toolTarget, offset.toolTarget);
+    offset.stepPerTick = stepPerTick;
+    m_toolOffset.publish(offset);
+
+    /////////////////////////////////////////////////////////////////////
+    // CAMERA
+    /////////////////////////////////////////////////////////////////////
+
+    // the camera mimics the avatar's movement along the x and y plane
+    cVector3d toolPosDxDy = toolPos - m_cameraToolPos;
+    toolPosDxDy = cVector3d(toolPosDxDy.x(), toolPosDxDy.y(), 0.0);
+
+    CameraPoseRecord camera;
+    storeTelemetry(m_cameraPosition + toolPosDxDy, camera.position);
+    storeTelemetry(m_cameraLookAt + toolPosDxDy, camera.lookAt);
+
+    // only publish when the camera moves, so that the graphics thread can skip unchanged poses
+    CameraPoseRecord previous;
+    if (!m_cameraPose.read(previous) || (memcmp(&previous, &camera, sizeof(camera)) != 0))
+    {
+        m_cameraPose.publish(camera);
+    }
+}
+
+
+//==============================================================================
+/*!
+    Publishes the device and tool positions for the next control step.
+
+    \param  a_devicePos  Device position in the workspace.
+    \param  a_toolPos    Local position of the tool.
+*/
+//==============================================================================
+void ControlLoop::publishToolState(const cVector3d& a_devicePos, const cVector3d& a_toolPos)
+{
+    ToolStateRecord state;
+    storeTelemetry(a_devicePos, state.devicePos);
+    storeTelemetry(a_toolPos, state.toolPos);
+    m_toolState.publish(state);
+}
+
+
+//==============================================================================
+/*!
+    Copies the latest drift target of the tool and its drift rate, in one
+    attempt: the haptic thread calls this every tick, and must not wait for
+    a control step preempted in the middle of its publish.
+
+    \param  a_target       Returned local position the tool should drift to.
+    \param  a_stepPerTick  Returned distance to move towards it per haptic tick.
+
+    \return false if the control loop has not published a target yet, or is
+            publishing one; the caller then keeps the previous target.
+*/
+//==============================================================================
+bool ControlLoop::readToolTarget(cVector3d& a_target, double& a_stepPerTick) const
+{
+    ToolOffsetRecord offset;
+    if (!m_toolOffset.tryRead(offset))
+    {
+        return (false);
+    }
+
+    a_target = loadTelemetry(offset.toolTarget);
+    a_stepPerTick = offset.stepPerTick;
+    return (true);
+}
+
+
+//==============================================================================
+/*!
+    Copies the latest camera pose.
+
+    \param  a_position  Returned position of the camera.
+    \param  a_lookAt    Returned target of the camera.
+
+    \return false if the control loop has not published a pose yet.
+*/
+//==============================================================================
+bool ControlLoop::readCameraPose(cVector3d& a_position, cVector3d& a_lookAt) const
+{
+    CameraPoseRecord camera;
+    if (!m_cameraPose.read(camera))
+    {
+        return (false);
+    }
+
+    a_position = loadTelemetry(camera.position);
+    a_lookAt = loadTelemetry(camera.lookAt);
+    return (true);
+}
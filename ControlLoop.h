@@ -0,0 +1,127 @@
+//==============================================================================
+/*
+    CPSC 599.86 / 601.86 - Computer Haptics
+    Winter 2018, University of Calgary
+
+    Mid-rate control loop (200 Hz by default) owning the workspace drift of
+    the avatar and the camera that follows it. It used to run inside the
+    haptic tick, which moved the camera from the 1 kHz thread while the
+    graphics thread rendered it.
+
+    The loops exchange records through single-writer SeqLock mailboxes, and
+    the haptic loop never waits for the control loop: it reads the drift
+    target in one attempt (SeqLock::tryRead()) and keeps the previous one
+    while a control step is publishing. Only the control thread, at the
+    lower priority, may retry a read.
+    - the haptic loop publishes the device and tool positions every tick;
+    - the control loop publishes the position the tool should drift to,
+      with the drift rate per tick; the haptic loop approaches the target
+      at that rate, so the avatar moves as steadily between control steps
+      as it did when the tick drifted it;
+    - the control loop publishes the camera pose, which the graphics
+      thread applies before rendering.
+*/
+//==============================================================================
+
+#ifndef CONTROLLOOP_H
+#define CONTROLLOOP_H
+
+#include "chai3d.h"
+#include "SeqLock.h"
+#include <atomic>
+#include <thread>
+
+//------------------------------------------------------------------------------
+
+//! Largest drift rate: distance the haptic loop moves the tool towards its drift target in one tick.
+const double C_MAX_DRIFT_STEP = 0.0001;
+
+//! Published by the haptic loop every tick.
+struct ToolStateRecord
+{
+    //! Device position in the workspace.
+    double devicePos[3];
+
+    //! Local position of the tool (the origin of the workspace in the world).
+    double toolPos[3];
+};
+
+//! Published by the control loop every step.
+struct ToolOffsetRecord
+{
+    //! Local position the tool should drift to.
+    double toolTarget[3];
+
+    //! Distance the tool should move towards the target per haptic tick (0 when not drifting).
+    double stepPerTick;
+};
+
+//! Published by the control loop every step.
+struct CameraPoseRecord
+{
+    double position[3];
+    double lookAt[3];
+};
+
+//------------------------------------------------------------------------------
+
+class ControlLoop
+{
+public:
+
+    //! Constructor of ControlLoop.
+    ControlLoop();
+
+    //! Destructor of ControlLoop. Stops the thread.
+    ~ControlLoop();
+
+    //! Initial camera pose; the camera then follows the tool in the xy plane. Call before start().
+    void setCamera(const chai3d::cVector3d& a_position, const chai3d::cVector3d& a_lookAt);
+
+    //! Radius of the device workspace beyond which the avatar drifts.
+    void setWorkspaceRadius(double a_radius) { m_workspaceRadius = a_radius; }
+
+    //! Starts the control thread.
+    void start(unsigned int a_rateHz = 200);
+
+    //! Stops the control thread.
+    void stop();
+
+    //! Runs one control step of a_dt seconds. Called by the control thread.
+    void step(double a_dt);
+
+    //! Publishes the device and tool positions. Haptic thread only.
+    void publishToolState(const chai3d::cVector3d& a_devicePos, const chai3d::cVector3d& a_toolPos);
+
+    //! Latest drift target of the tool, and the distance to move towards it per tick, without waiting. Returns false if none has been published yet or a publish is in progress.
+    bool readToolTarget(chai3d::cVector3d& a_target, double& a_stepPerTick) const;
+
+    //! Latest camera pose. Returns false if none has been published yet.
+    bool readCameraPose(chai3d::cVector3d& a_position, chai3d::cVector3d& a_lookAt) const;
+
+    //! Number of camera poses published so far; changes when the camera should move.
+    unsigned int getNumCameraPoses() const { return (m_cameraPose.getNumPublished()); }
+
+protected:
+
+    //! Body of the control thread.
+    void run(unsigned int a_rateHz);
+
+    double m_workspaceRadius;
+
+    //! Initial camera pose, and the tool position it corresponds to (valid once m_hasToolPos is set).
+    chai3d::cVector3d m_cameraPosition;
+    chai3d::cVector3d m_cameraLookAt;
+    chai3d::cVector3d m_cameraToolPos;
+    bool m_hasToolPos;
+
+    SeqLock<ToolStateRecord> m_toolState;
+    SeqLock<ToolOffsetRecord> m_toolOffset;
+    SeqLock<CameraPoseRecord> m_cameraPose;
+
+    std::thread m_thread;
+    std::atomic<bool> m_running;
+};
+
+//------------------------------------------------------------------------------
+#endif
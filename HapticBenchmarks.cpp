@@ -0,0 +1,768 @@
+//==============================================================================
+/*
+    CPSC 599.86 / 601.86 - Computer Haptics
+    Winter 2018, University of Calgary
+
+    Microbenchmarks for the haptic rendering path. They are run from the
+    command line of the application (see main()) once the scene has been
+    built, and print their results to the console.
+*/
+//==============================================================================
+
+#include "HapticBenchmarks.h"
+#include "SceneAssets.h"
+#include "SceneSetup.h"
+#include "TransformPropagator.h"
+#include "ProceduralTextures.h"
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <thread>
+
+using namespace chai3d;
+using namespace std;
+
+//------------------------------------------------------------------------------
+
+// number of lookups timed per material and per path
+static const int C_BENCH_SAMPLES = 200000;
+
+// Small deterministic generator so that every path sees the same coordinates.
+static double nextCoordinate(unsigned int& a_state)
+{
+    a_state = a_state * 1664525u + 1013904223u;
+    return ((double)(a_state >> 8) / (double)(1u << 24));
+}
+
+// Samples one image the way the haptic thread used to, through cImage.
+static cColorb sampleImage(const cImagePtr& a_image, const cVector3d& a_texCoord)
+{
+    double pixelX, pixelY;
+    cColorb pixelColor;
+    a_image->getPixelLocationInterpolated(a_texCoord, pixelX, pixelY, true);
+    a_image->getPixelColorInterpolated(pixelX, pixelY, pixelColor);
+    return (pixelColor);
+}
+
+
+//==============================================================================
+/*!
+    For every material, times C_BENCH_SAMPLES lookups of normal, height and
+    roughness through the three cImage maps, through the baked texel map one
+    channel at a time, and through its SIMD blend. Reports the largest
+    difference of the SIMD path to cImage and to the scalar path so that it
+    can be checked for equivalence.
+
+    \param  a_materials     Materials to benchmark.
+    \param  a_names         Display name of each material.
+    \param  a_numMaterials  Number of materials.
+*/
+//==============================================================================
+void benchmarkHapticTexels(MyMaterial* const a_materials[],
+                           const string a_names[],
+                           int a_numMaterials)
+{
+    cout << "Haptic texel sampling (" << C_BENCH_SAMPLES << " lookups per path, SIMD path: " << HapticTexelMap::getSimdPath() << ")" << endl;
+    cout << "material                         cImage ns  scalar ns    SIMD ns   speedup   max |diff|   SIMD |diff|" << endl;
+
+    cPrecisionClock clock;
+
+    for (int m = 0; m < a_numMaterials; ++m)
+    {
+        MyMaterial* material = a_materials[m];
+        if ((material == NULL) || (material->hapticTexels == NULL) || material->hapticTexels->isEmpty())
+        {
+            continue;
+        }
+
+        cImagePtr normalImage = material->normalMap->m_image;
+        cImagePtr heightImage = material->heightMap->m_image;
+        cImagePtr roughnessImage = material->roughnessMap->m_image;
+        const HapticTexelMap& texels = *material->hapticTexels;
+
+        // sink values keep the optimiser from discarding the lookups
+        double sinkImage = 0.0;
+        double sinkScalar = 0.0;
+        double sinkSimd = 0.0;
+
+        // current path: three cImage lookups per query
+        unsigned int state = 1234u;
+        clock.reset();
+        clock.start(true);
+        for (int i = 0; i < C_BENCH_SAMPLES; ++i)
+        {
+            cVector3d texCoord(nextCoordinate(state), nextCoordinate(state), 0.0);
+            cColorb n = sampleImage(normalImage, texCoord);
+            cColorb h = sampleImage(heightImage, texCoord);
+            cColorb r = sampleImage(roughnessImage, texCoord);
+            sinkImage += n.getR() + n.getG() + n.getB() + h.getLuminance() + r.getR() + r.getG() + r.getB();
+        }
+        double imageTime = clock.getCurrentTimeSeconds();
+
+        // baked path, one channel at a time
+        state = 1234u;
+        clock.reset();
+        clock.start(true);
+        for (int i = 0; i < C_BENCH_SAMPLES; ++i)
+        {
+            double u = nextCoordinate(state);
+            double v = nextCoordinate(state);
+            HapticTexel texel;
+            texels.sampleScalar(u, v, texel);
+            sinkScalar += texel.normal[0] + texel.normal[1] + texel.normal[2] + texel.height + texel.roughness;
+        }
+        double scalarTime = clock.getCurrentTimeSeconds();
+
+        // baked path, all channels in one vectorized blend
+        state = 1234u;
+        clock.reset();
+        clock.start(true);
+        for (int i = 0; i < C_BENCH_SAMPLES; ++i)
+        {
+            double u = nextCoordinate(state);
+            double v = nextCoordinate(state);
+            HapticTexel texel;
+            texels.sample(u, v, texel);
+            sinkSimd += texel.normal[0] + texel.normal[1] + texel.normal[2] + texel.height + texel.roughness;
+        }
+        double simdTime = clock.getCurrentTimeSeconds();
+
+        // equivalence over a smaller set of queries: the SIMD path against
+        // cImage, and against the scalar path it replaces
+        double maxDiff = 0.0;
+        double maxSimdDiff = 0.0;
+        state = 4321u;
+        for (int i = 0; i < 10000; ++i)
+        {
+            cVector3d texCoord(nextCoordinate(state), nextCoordinate(state), 0.0);
+            cColorb n = sampleImage(normalImage, texCoord);
+            cColorb h = sampleImage(heightImage, texCoord);
+            cColorb r = sampleImage(roughnessImage, texCoord);
+
+            HapticTexel texel;
+            texels.sample(texCoord.x(), texCoord.y(), texel);
+
+            HapticTexel reference;
+            texels.sampleScalar(texCoord.x(), texCoord.y(), reference);
+
+            double diff[5] =
+            {
+                fabs((n.getR() - 127.5) / 127.5 - texel.normal[0]),
+                fabs((n.getG() - 127.5) / 127.5 - texel.normal[1]),
+                fabs((n.getB() - 127.5) / 127.5 - texel.normal[2]),
+                fabs(h.getLuminance() / 255.0 - texel.height),
+                fabs((r.getR() + r.getG() + r.getB()) / (3.0 * 255.0) - texel.roughness)
+            };
+            for (int k = 0; k < 5; ++k)
+            {
+                maxDiff = cMax(maxDiff, diff[k]);
+            }
+            for (int k = 0; k < 3; ++k)
+            {
+                maxSimdDiff = cMax(maxSimdDiff, (double)fabs(texel.normal[k] - reference.normal[k]));
+            }
+            maxSimdDiff = cMax(maxSimdDiff, (double)fabs(texel.height - reference.height));
+            maxSimdDiff = cMax(maxSimdDiff, (double)fabs(texel.roughness - reference.roughness));
+        }
+
+        double imageNs = 1.0e9 * imageTime / C_BENCH_SAMPLES;
+        double scalarNs = 1.0e9 * scalarTime / C_BENCH_SAMPLES;
+        double simdNs = 1.0e9 * simdTime / C_BENCH_SAMPLES;
+
+        char line[256];
+        snprintf(line, sizeof(line), "%-32s %9.1f  %9.1f  %9.1f  %7.2fx   %.4f       %.2e",
+                 a_names[m].c_str(), imageNs, scalarNs, simdNs, imageNs / cMax(simdNs, 1e-9), maxDiff, maxSimdDiff);
+        cout << line << (((sinkImage + sinkScalar + sinkSimd) == -1.0) ? " " : "") << endl;
+    }
+
+    cout << endl;
+}
+
+
+//==============================================================================
+/*!
+    For every material, strokes across the baked texel map at speeds from a
+    quarter of a texel to 32 texels per tick, and samples the height once
+    per tick at the full resolution and at the mip level the force kernel
+    picks for that speed. Reports the time per lookup and the RMS of the
+    tick-to-tick height change: at high speeds the full resolution reads
+    unrelated texels on successive ticks, which the device renders as buzz.
+
+    \param  a_materials     Materials to benchmark.
+    \param  a_names         Display name of each material.
+    \param  a_numMaterials  Number of materials.
+*/
+//==============================================================================
+void benchmarkHapticMips(MyMaterial* const a_materials[],
+                         const string a_names[],
+                         int a_numMaterials)
+{
+    static const double speeds[] = { 0.25, 1.0, 4.0, 16.0, 32.0 };
+    static const int numSpeeds = sizeof(speeds) / sizeof(speeds[0]);
+
+    cout << "Haptic mip levels (" << C_BENCH_SAMPLES << " ticks per stroke)" << endl;
+    cout << "material                         texels/tick  level   full ns    mip ns   full rms   mip rms" << endl;
+
+    cPrecisionClock clock;
+
+    for (int m = 0; m < a_numMaterials; ++m)
+    {
+        MyMaterial* material = a_materials[m];
+        if ((material == NULL) || (material->hapticTexels == NULL) || material->hapticTexels->isEmpty())
+        {
+            continue;
+        }
+
+        const HapticTexelMap& texels = *material->hapticTexels;
+        double size = (double)cMax(texels.getWidth(), texels.getHeight());
+
+        for (int s = 0; s < numSpeeds; ++s)
+        {
+            // a diagonal stroke, at the steady state of the filtered footprint
+            double step = speeds[s] / size;
+            double du = step * cos(0.3);
+            double dv = step * sin(0.3);
+            float level = texels.getLevelForFootprint(step);
+
+            double times[2];
+            double rms[2];
+            for (int path = 0; path < 2; ++path)
+            {
+                double previous = 0.0;
+                double sumSquares = 0.0;
+
+                clock.reset();
+                clock.start(true);
+                for (int i = 0; i < C_BENCH_SAMPLES; ++i)
+                {
+                    double u = 0.1 + du * i;
+                    double v = 0.2 + dv * i;
+
+                    HapticTexel texel;
+                    if (path == 0)
+                    {
+                        texels.sample(u, v, texel);
+                    }
+                    else
+                    {
+                        texels.sample(u, v, level, texel);
+                    }
+
+                    if (i > 0)
+                    {
+                        sumSquares += (texel.height - previous) * (texel.height - previous);
+                    }
+                    previous = texel.height;
+                }
+                times[path] = clock.getCurrentTimeSeconds();
+                rms[path] = sqrt(sumSquares / (C_BENCH_SAMPLES - 1));
+            }
+
+            char line[256];
+            snprintf(line, sizeof(line), "%-32s %11.2f  %5.2f  %8.1f  %8.1f   %.5f   %.5f",
+                     (s == 0) ? a_names[m].c_str() : "", speeds[s], level,
+                     1.0e9 * times[0] / C_BENCH_SAMPLES, 1.0e9 * times[1] / C_BENCH_SAMPLES, rms[0], rms[1]);
+            cout << line << endl;
+        }
+    }
+
+    cout << endl;
+}
+
+
+//==============================================================================
+/*!
+    For every procedural profile, times C_BENCH_SAMPLES evaluations of the
+    profile function, wrapped as the kernels used to wrap it, against as
+    many lookups into its baked table, and reports the largest and mean
+    difference between the two. Step profiles (the bands) differ by up to
+    the full step within one table interval of an edge.
+*/
+//==============================================================================
+void benchmarkProceduralTextures()
+{
+    struct Profile
+    {
+        const char* name;
+        PeriodicProfile function;
+        const PeriodicTable* table;
+    };
+
+    const ProceduralTextures& textures = *getProceduralTextures();
+    const Profile profiles[] =
+    {
+        { "bump tilt", bumpTiltProfile, &textures.bumpTilt },
+        { "bump bands", bumpBandProfile, &textures.bumpBands },
+        { "stick-slip strips", stickSlipProfile, &textures.stickSlip }
+    };
+
+    cout << "Procedural textures (" << C_BENCH_SAMPLES << " evaluations per path, " << PeriodicTable::C_SIZE << " entry tables)" << endl;
+    cout << "profile                  function ns   table ns   speedup   max |diff|   mean |diff|" << endl;
+
+    cPrecisionClock clock;
+
+    for (int p = 0; p < 3; ++p)
+    {
+        const Profile& profile = profiles[p];
+
+        // sink values keep the optimiser from discarding the evaluations
+        double sinkFunction = 0.0;
+        double sinkTable = 0.0;
+
+        // current path: wrap loops and transcendentals on every call
+        unsigned int state = 1234u;
+        clock.reset();
+        clock.start(true);
+        for (int i = 0; i < C_BENCH_SAMPLES; ++i)
+        {
+            double distance = 4.0 * nextCoordinate(state) - 2.0;
+            while (distance > 1.0)
+                distance -= 1.0;
+            while (distance < -1.0)
+                distance += 1.0;
+            if (distance < 0.0)
+                distance = 1.0 + distance;
+            sinkFunction += profile.function(distance);
+        }
+        double functionTime = clock.getCurrentTimeSeconds();
+
+        // baked path: one wrapped table lookup
+        state = 1234u;
+        clock.reset();
+        clock.start(true);
+        for (int i = 0; i < C_BENCH_SAMPLES; ++i)
+        {
+            sinkTable += profile.table->evaluate(4.0 * nextCoordinate(state) - 2.0);
+        }
+        double tableTime = clock.getCurrentTimeSeconds();
+
+        // equivalence over one period
+        double maxDiff = 0.0;
+        double sumDiff = 0.0;
+        state = 4321u;
+        for (int i = 0; i < 10000; ++i)
+        {
+            double t = nextCoordinate(state);
+            double diff = fabs(profile.function(t) - profile.table->evaluate(t));
+            maxDiff = cMax(maxDiff, diff);
+            sumDiff += diff;
+        }
+
+        double functionNs = 1.0e9 * functionTime / C_BENCH_SAMPLES;
+        double tableNs = 1.0e9 * tableTime / C_BENCH_SAMPLES;
+
+        char line[256];
+        snprintf(line, sizeof(line), "%-24s %11.1f  %9.1f  %7.2fx   %.6f     %.6f",
+                 profile.name, functionNs, tableNs, functionNs / cMax(tableNs, 1e-9), maxDiff, sumDiff / 10000.0);
+        cout << line << (((sinkFunction + sinkTable) == -1.0) ? " " : "") << endl;
+    }
+
+    cout << endl;
+}
+
+
+//------------------------------------------------------------------------------
+
+// The normal map transform updateForce() used before tangent frames were
+// cached: the normal map normal is swizzled and rotated about two axes by the
+// angles between the surface normal and the global axes (the rotations are
+// those of glm::rotateX and glm::rotateZ).
+static cVector3d legacyNormalToWorld(const float a_normal[3], const cVector3d& a_surfaceNormal)
+{
+    cVector3d normalMapNormal(a_normal[1], a_normal[0], a_normal[2]);
+    normalMapNormal.normalize();
+
+    float thetaX = acos(a_surfaceNormal.dot(cVector3d(1.0, 0.0, 0.0)));
+    float thetaY = acos(a_surfaceNormal.dot(cVector3d(0.0, 1.0, 0.0)));
+
+    float v[3] = { (float)normalMapNormal.y(), (float)normalMapNormal.z(), (float)normalMapNormal.x() };
+
+    thetaX = (thetaX < (M_PI * 0.5)) ? (float)((M_PI * 0.5) - thetaX) : (float)-(thetaX - (M_PI * 0.5));
+    float y = v[1] * cos(thetaX) - v[2] * sin(thetaX);
+    float z = v[1] * sin(thetaX) + v[2] * cos(thetaX);
+    v[1] = y;
+    v[2] = z;
+
+    thetaY = (thetaY < (M_PI * 0.5)) ? (float)-((M_PI * 0.5) - thetaY) : (float)(thetaY - (M_PI * 0.5));
+    float x = v[0] * cos(thetaY) - v[1] * sin(thetaY);
+    y = v[0] * sin(thetaY) + v[1] * cos(thetaY);
+    v[0] = x;
+    v[1] = y;
+
+    cVector3d result(v[2], v[0], v[1]);
+    result.normalize();
+    return (result);
+}
+
+
+//==============================================================================
+/*!
+    Times the legacy acos/rotation transform against the cached tangent frame
+    transform on the flat tops of a mesh (frame normal along +z, where the
+    proxy touches the trays), and checks the angle between the two results
+    against C_FRAME_ANGLE_TOLERANCE. Normals are taken from a baked texel map
+    at random texture coordinates. The legacy transform ignores the sign of
+    the surface normal, so it is only a reference on the upward faces.
+
+    \param  a_mesh    Mesh the frames were built from.
+    \param  a_frames  Cached tangent frames of the mesh.
+    \param  a_texels  Baked texel map providing the normal map normals.
+
+    \return false if the two transforms differ by more than the tolerance.
+*/
+//==============================================================================
+bool benchmarkTangentFrames(cMesh* a_mesh,
+                            const TangentFrames& a_frames,
+                            const HapticTexelMap& a_texels)
+{
+    // largest angle (degrees) allowed between the cached and the legacy transform
+    const double C_FRAME_ANGLE_TOLERANCE = 0.1;
+
+    // collect the flat tops
+    vector<unsigned int> flatTriangles;
+    for (unsigned int i = 0; i < a_frames.getNumFrames(); ++i)
+    {
+        if (a_frames.getFrame(i).normal[2] > 0.999f)
+        {
+            flatTriangles.push_back(i);
+        }
+    }
+
+    cout << "Normal map transform on " << flatTriangles.size() << " flat tops of "
+         << a_frames.getNumFrames() << " triangles" << endl;
+
+    if (flatTriangles.empty() || a_texels.isEmpty())
+    {
+        cout << "  nothing to check" << endl << endl;
+        return (false);
+    }
+
+    // precompute the inputs so that only the transforms are timed
+    const int numQueries = 4096;
+    vector<HapticTexel> texels(numQueries);
+    vector<unsigned int> triangles(numQueries);
+    unsigned int state = 99u;
+    for (int i = 0; i < numQueries; ++i)
+    {
+        double u = nextCoordinate(state);
+        double v = nextCoordinate(state);
+        a_texels.sample(u, v, texels[i]);
+        triangles[i] = flatTriangles[(state >> 4) % flatTriangles.size()];
+    }
+
+    cMatrix3d rotation = a_mesh->getGlobalRot();
+    const int numRounds = 50;
+    cPrecisionClock clock;
+    cVector3d sink(0.0, 0.0, 0.0);
+
+    clock.reset();
+    clock.start(true);
+    for (int r = 0; r < numRounds; ++r)
+    {
+        for (int i = 0; i < numQueries; ++i)
+        {
+            const TangentFrame& frame = a_frames.getFrame(triangles[i]);
+            cVector3d surfaceNormal(frame.normal[0], frame.normal[1], frame.normal[2]);
+            sink += legacyNormalToWorld(texels[i].normal, rotation * surfaceNormal);
+        }
+    }
+    double legacyTime = clock.getCurrentTimeSeconds();
+
+    clock.reset();
+    clock.start(true);
+    for (int r = 0; r < numRounds; ++r)
+    {
+        for (int i = 0; i < numQueries; ++i)
+        {
+            cVector3d n = rotation * a_frames.getFrame(triangles[i]).normalMapToMesh(texels[i].normal);
+            n.normalize();
+            sink += n;
+        }
+    }
+    double frameTime = clock.getCurrentTimeSeconds();
+
+    // accuracy against the legacy output
+    double maxAngle = 0.0;
+    double sumAngle = 0.0;
+    for (int i = 0; i < numQueries; ++i)
+    {
+        const TangentFrame& frame = a_frames.getFrame(triangles[i]);
+        cVector3d surfaceNormal = rotation * cVector3d(frame.normal[0], frame.normal[1], frame.normal[2]);
+
+        cVector3d legacy = legacyNormalToWorld(texels[i].normal, surfaceNormal);
+        cVector3d cached = rotation * frame.normalMapToMesh(texels[i].normal);
+        cached.normalize();
+
+        double angle = acos(cClamp(cDot(legacy, cached), -1.0, 1.0)) * 180.0 / M_PI;
+        maxAngle = cMax(maxAngle, angle);
+        sumAngle += angle;
+    }
+
+    int numTransforms = numRounds * numQueries;
+    char line[256];
+    snprintf(line, sizeof(line), "legacy %.1f ns, cached frame %.1f ns, angle to legacy: mean %.3f deg, max %.3f deg",
+             1.0e9 * legacyTime / numTransforms, 1.0e9 * frameTime / numTransforms,
+             sumAngle / numQueries, maxAngle);
+    cout << line << ((sink.x() == -1.0) ? " " : "") << endl;
+
+    bool passed = (maxAngle <= C_FRAME_ANGLE_TOLERANCE);
+    snprintf(line, sizeof(line), "accuracy check %s (max angle %.3f deg, tolerance %.3f deg)",
+             passed ? "passed" : "FAILED", maxAngle, C_FRAME_ANGLE_TOLERANCE);
+    cout << line << endl << endl;
+    return (passed);
+}
+
+
+//==============================================================================
+/*!
+    Times filling an asset cache with every asset of the scene, once from the
+    source files (parse, decode, bake) and once from a scene pack (map and
+    build meshes). Each path is run several times; the first run of each also
+    pays for reading the files into the OS cache. GL upload happens on first
+    render in both cases and is not timed.
+
+    \param  a_packFile    Scene pack written by the scenepack tool.
+    \param  a_toolRadius  Radius of the tool, used to build the collision trees.
+*/
+//==============================================================================
+void benchmarkStartup(const string& a_packFile, double a_toolRadius)
+{
+    const int numRuns = 3;
+
+    cout << "Scene startup (" << numRuns << " runs per path)" << endl;
+
+    double fileTimes[numRuns];
+    double packTimes[numRuns];
+    bool packLoaded = true;
+
+    for (int run = 0; run < numRuns; ++run)
+    {
+        cPrecisionClock clock;
+
+        clock.start(true);
+        AssetCache* fileCache = new AssetCache();
+        loadSceneAssets(fileCache, a_toolRadius);
+        delete fileCache;
+        fileTimes[run] = clock.getCurrentTimeSeconds();
+
+        clock.start(true);
+        AssetCache* packCache = new AssetCache();
+        packLoaded = packCache->loadPack(a_packFile) && packLoaded;
+        loadSceneAssets(packCache, a_toolRadius);
+        delete packCache;
+        packTimes[run] = clock.getCurrentTimeSeconds();
+    }
+
+    if (!packLoaded)
+    {
+        cout << "  " << a_packFile << " could not be loaded; run scenepack first" << endl << endl;
+        return;
+    }
+
+    char line[256];
+    for (int run = 0; run < numRuns; ++run)
+    {
+        snprintf(line, sizeof(line), "  run %d: source files %.1f ms, scene pack %.1f ms",
+                 run + 1, fileTimes[run] * 1000.0, packTimes[run] * 1000.0);
+        cout << line << endl;
+    }
+    cout << endl;
+}
+
+
+//==============================================================================
+/*!
+    Times one haptic tick's worth of global pose updates, walking the whole
+    world against the incremental TransformPropagator, as the grid of static
+    objects grows. Each grid cell holds a multi-mesh with one mesh, like a
+    tray; a sphere standing in for the tool moves every tick, and a second
+    object standing in for the camera every tenth tick.
+
+    \param  a_maxGridSize  Largest number of objects along a side of the grid.
+*/
+//==============================================================================
+void benchmarkTransformPropagation(int a_maxGridSize)
+{
+    const int numTicks = 20000;
+
+    cout << "Global pose updates per tick (" << numTicks << " ticks per grid)" << endl;
+
+    for (int gridSize = 3; gridSize <= a_maxGridSize; gridSize *= 2)
+    {
+        cWorld* world = new cWorld();
+        for (int i = 0; i < gridSize; ++i)
+        {
+            for (int j = 0; j < gridSize; ++j)
+            {
+                cMultiMesh* object = new cMultiMesh();
+                object->newMesh();
+                object->setLocalPos(i * C_TRAY_SPACING, j * C_TRAY_SPACING);
+                world->addChild(object);
+            }
+        }
+
+        cShapeSphere* tool = new cShapeSphere(0.001);
+        world->addChild(tool);
+        cShapeSphere* camera = new cShapeSphere(0.001);
+        world->addChild(camera);
+
+        TransformPropagator transforms(world);
+        transforms.addMovingObject(tool);
+        transforms.addMovingObject(camera);
+        transforms.update();
+
+        unsigned int state = 7u;
+        cPrecisionClock clock;
+
+        clock.reset();
+        clock.start(true);
+        for (int t = 0; t < numTicks; ++t)
+        {
+            tool->setLocalPos(nextCoordinate(state), nextCoordinate(state), 0.0);
+            if (t % 10 == 0)
+                camera->setLocalPos(nextCoordinate(state), 0.0, 1.0);
+            world->computeGlobalPositions();
+        }
+        double fullTime = clock.getCurrentTimeSeconds();
+
+        clock.reset();
+        clock.start(true);
+        for (int t = 0; t < numTicks; ++t)
+        {
+            tool->setLocalPos(nextCoordinate(state), nextCoordinate(state), 0.0);
+            if (t % 10 == 0)
+                camera->setLocalPos(nextCoordinate(state), 0.0, 1.0);
+            transforms.update();
+        }
+        double incrementalTime = clock.getCurrentTimeSeconds();
+
+        // the tool hangs off the world, so its global pose is its local one
+        double error = (tool->getGlobalPos() - tool->getLocalPos()).length();
+
+        char line[256];
+        snprintf(line, sizeof(line), "  %5d objects: whole world %.2f us, incremental %.2f us (%llu subtrees, error %g)",
+                 gridSize * gridSize, 1.0e6 * fullTime / numTicks, 1.0e6 * incrementalTime / numTicks,
+                 transforms.getNumSubtreeUpdates(), error);
+        cout << line << endl;
+
+        delete world;
+    }
+    cout << endl;
+}
+
+
+//------------------------------------------------------------------------------
+
+// Ticks a loop on absolute deadlines for a_numTicks, entering the real-time mode first if a_config is not NULL.
+static void runPacedTicks(HapticLoop* a_loop,
+                          unsigned long long a_numTicks,
+                          unsigned int a_rateHz,
+                          const HapticRealTimeConfig* a_config,
+                          HapticRealTimeReport* a_report,
+                          LatencyHistogram* a_periods,
+                          LatencyHistogram* a_lateness)
+{
+    if (a_config != NULL)
+    {
+        enterHapticRealTime(*a_config, 0, *a_report);
+    }
+
+    chrono::steady_clock::duration period = chrono::duration_cast<chrono::steady_clock::duration>(
+        chrono::duration<double>(1.0 / a_rateHz));
+
+    chrono::steady_clock::time_point next = chrono::steady_clock::now() + period;
+    chrono::steady_clock::time_point last = next;
+
+    for (unsigned long long t = 0; t < a_numTicks; ++t)
+    {
+        this_thread::sleep_until(next);
+
+        chrono::steady_clock::time_point now = chrono::steady_clock::now();
+        a_lateness->record((unsigned long long)chrono::duration_cast<chrono::nanoseconds>(now - next).count());
+        if (t > 0)
+        {
+            a_periods->record((unsigned long long)chrono::duration_cast<chrono::nanoseconds>(now - last).count());
+        }
+        last = now;
+
+        a_loop->tick();
+
+        // after an overrun, start again from now rather than catching up with a burst of ticks
+        next += period;
+        if (next < now)
+        {
+            next = now + period;
+        }
+    }
+}
+
+
+// Prints the percentiles of a histogram in microseconds.
+static void printJitterLine(const char* a_name, const LatencyHistogram& a_histogram)
+{
+    LatencySnapshot snapshot;
+    a_histogram.snapshot(snapshot);
+
+    char line[256];
+    snprintf(line, sizeof(line), "    %-9s p50 %8.1f us   p99 %8.1f us   p99.9 %8.1f us   max %8.1f us",
+             a_name, 1.0e-3 * snapshot.getPercentile(0.5), 1.0e-3 * snapshot.getPercentile(0.99),
+             1.0e-3 * snapshot.getPercentile(0.999), 1.0e-3 * snapshot.getMax());
+    cout << line << endl;
+}
+
+
+//==============================================================================
+/*!
+    Runs a haptic loop paced at a_rateHz for a_seconds, first from a normal
+    thread, then from a thread in real-time mode, and prints the
+    distribution of the tick period and of the lateness of every wake-up
+    past its deadline. The normal run comes first, since the memory lock of
+    the real-time mode stays on for the rest of the process. Nothing else
+    may tick the loop meanwhile.
+
+    \param  a_loop     Loop to tick.
+    \param  a_seconds  Duration of each run.
+    \param  a_rateHz   Tick rate.
+    \param  a_config   Settings of the real-time mode (enabled for the second run regardless).
+*/
+//==============================================================================
+void benchmarkHapticJitter(HapticLoop* a_loop,
+                           double a_seconds,
+                           unsigned int a_rateHz,
+                           const HapticRealTimeConfig& a_config)
+{
+    a_rateHz = max(a_rateHz, 1u);
+    unsigned long long numTicks = (unsigned long long)(max(a_seconds, 0.1) * a_rateHz);
+
+    HapticRealTimeConfig config = a_config;
+    config.enabled = true;
+    HapticRealTimeReport report;
+
+    // the histograms are large; keep them off the stacks of the threads
+    unique_ptr<LatencyHistogram> periods[2];
+    unique_ptr<LatencyHistogram> lateness[2];
+    for (int mode = 0; mode < 2; ++mode)
+    {
+        periods[mode].reset(new LatencyHistogram());
+        lateness[mode].reset(new LatencyHistogram());
+
+        thread ticker(runPacedTicks, a_loop, numTicks, a_rateHz, (mode == 1) ? &config : NULL, &report,
+                      periods[mode].get(), lateness[mode].get());
+        ticker.join();
+    }
+
+    string text;
+    formatHapticRealTimeReport(report, text);
+
+    cout << "Haptic tick jitter (" << numTicks << " ticks at " << a_rateHz << " Hz per mode)" << endl;
+    cout << "  real-time mode:" << endl << text;
+
+    const char* modeNames[2] = { "normal thread:", "real-time thread:" };
+    for (int mode = 0; mode < 2; ++mode)
+    {
+        cout << "  " << modeNames[mode] << endl;
+        printJitterLine("period", *periods[mode]);
+        printJitterLine("lateness", *lateness[mode]);
+    }
+    cout << endl;
+}
@@ -0,0 +1,54 @@
+//==============================================================================
+/*
+    CPSC 599.86 / 601.86 - Computer Haptics
+    Winter 2018, University of Calgary
+
+    Microbenchmarks for the haptic rendering path. They are run from the
+    command line of the application (see main()) once the scene has been
+    built, and print their results to the console.
+*/
+//==============================================================================
+
+#ifndef HAPTICBENCHMARKS_H
+#define HAPTICBENCHMARKS_H
+
+#include "HapticLoop.h"
+#include "HapticRealTime.h"
+#include "MyMaterial.h"
+#include "TangentFrames.h"
+#include <string>
+
+//------------------------------------------------------------------------------
+
+//! Compares the baked texel map against sampling the three cImage maps.
+void benchmarkHapticTexels(MyMaterial* const a_materials[],
+                           const std::string a_names[],
+                           int a_numMaterials);
+
+//! Compares full resolution and mip level lookups along strokes of growing speed.
+void benchmarkHapticMips(MyMaterial* const a_materials[],
+                         const std::string a_names[],
+                         int a_numMaterials);
+
+//! Compares the baked procedural profiles against evaluating them directly.
+void benchmarkProceduralTextures();
+
+//! Compares the cached tangent frames against the acos/rotation normal transform; returns false if the accuracy check fails.
+bool benchmarkTangentFrames(chai3d::cMesh* a_mesh,
+                            const TangentFrames& a_frames,
+                            const HapticTexelMap& a_texels);
+
+//! Compares loading the scene assets from a scene pack against loading the source files.
+void benchmarkStartup(const std::string& a_packFile, double a_toolRadius);
+
+//! Compares walking the whole world against incremental global pose updates, for growing object grids.
+void benchmarkTransformPropagation(int a_maxGridSize);
+
+//! Compares the tick period and wake-up lateness of a paced haptic loop, as a normal thread and in real-time mode.
+void benchmarkHapticJitter(HapticLoop* a_loop,
+                           double a_seconds,
+                           unsigned int a_rateHz,
+                           const HapticRealTimeConfig& a_config);
+
+//------------------------------------------------------------------------------
+#endif
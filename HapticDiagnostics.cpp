@@ -0,0 +1,199 @@
+//==============================================================================
+/*
+    CPSC 599.86 / 601.86 - Computer Haptics
+    Winter 2018, University of Calgary
+
+    Diagnostics for the haptic rendering path. Records go into a fixed ring
+    of slots (bounded multi-producer queue with per-slot sequence numbers),
+    so recording never allocates, locks or waits. When the ring is full the
+    record is dropped and counted, and the drain thread reports the count.
+*/
+//==============================================================================
+
+#include "HapticDiagnostics.h"
+
+#include <chrono>
+#include <cstdio>
+#include <thread>
+
+//------------------------------------------------------------------------------
+
+namespace
+{
+    // number of slots; must be a power of two
+    const unsigned int RING_SIZE = 1024;
+
+    // interval at which the drain thread empties the ring
+    const unsigned int DRAIN_PERIOD_MS = 50;
+
+    struct Record
+    {
+        std::atomic<unsigned int> sequence;
+        int level;
+        const char* message;
+        double value;
+        unsigned int count;
+    };
+
+    Record s_ring[RING_SIZE];
+    std::atomic<unsigned int> s_enqueuePos(0);
+    unsigned int s_dequeuePos = 0;
+    std::atomic<unsigned int> s_numDropped(0);
+
+    std::atomic<bool> s_running(false);
+    std::thread s_drainThread;
+
+    const char* levelName(int a_level)
+    {
+        switch (a_level)
+        {
+            case HAPTIC_DIAG_LEVEL_ERROR:   return ("error");
+            case HAPTIC_DIAG_LEVEL_WARNING: return ("warning");
+            default:                        return ("trace");
+        }
+    }
+
+    // prints every complete record; only called from one thread at a time
+    void drain()
+    {
+        while (true)
+        {
+            Record& record = s_ring[s_dequeuePos & (RING_SIZE - 1)];
+            unsigned int sequence = record.sequence.load(std::memory_order_acquire);
+            if (sequence != s_dequeuePos + 1)
+            {
+                break;
+            }
+
+            if (record.count > 1)
+            {
+                printf("[haptic %s] %s (%u occurrences)\n", levelName(record.level), record.message, record.count);
+            }
+            else if (record.level == HAPTIC_DIAG_LEVEL_ERROR)
+            {
+                printf("[haptic %s] %s\n", levelName(record.level), record.message);
+            }
+            else
+            {
+                printf("[haptic %s] %s: %g\n", levelName(record.level), record.message, record.value);
+            }
+
+            // hand the slot back to the producers for the next lap
+            record.sequence.store(s_dequeuePos + RING_SIZE, std::memory_order_release);
+            s_dequeuePos++;
+        }
+
+        unsigned int numDropped = s_numDropped.exchange(0, std::memory_order_relaxed);
+        if (numDropped > 0)
+        {
+            printf("[haptic diagnostics] %u records dropped\n", numDropped);
+        }
+
+        fflush(stdout);
+    }
+
+    void drainLoop()
+    {
+        while (s_running.load(std::memory_order_acquire))
+        {
+            drain();
+            std::this_thread::sleep_for(std::chrono::milliseconds(DRAIN_PERIOD_MS));
+        }
+        drain();
+    }
+
+    struct RingInitializer
+    {
+        RingInitializer()
+        {
+            for (unsigned int i = 0; i < RING_SIZE; i++)
+            {
+                s_ring[i].sequence.store(i, std::memory_order_relaxed);
+            }
+        }
+    };
+
+    RingInitializer s_ringInitializer;
+}
+
+
+//==============================================================================
+/*!
+    Records a message for the drain thread. Never blocks: if the ring is full
+    the record is dropped.
+
+    \param  a_level    Diagnostic level of the record.
+    \param  a_message  Message; must have static storage duration.
+    \param  a_value    Value printed after the message.
+    \param  a_count    Number of occurrences the record stands for.
+*/
+//==============================================================================
+void HapticDiagnostics::record(int a_level, const char* a_message, double a_value, unsigned int a_count)
+{
+    unsigned int pos = s_enqueuePos.load(std::memory_order_relaxed);
+    Record* record;
+
+    while (true)
+    {
+        record = &s_ring[pos & (RING_SIZE - 1)];
+        unsigned int sequence = record->sequence.load(std::memory_order_acquire);
+        int diff = (int)(sequence - pos);
+
+        if (diff == 0)
+        {
+            // slot is free; claim it unless another producer got there first
+            if (s_enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+            {
+                break;
+            }
+        }
+        else if (diff < 0)
+        {
+            // ring is full
+            s_numDropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        else
+        {
+            pos = s_enqueuePos.load(std::memory_order_relaxed);
+        }
+    }
+
+    record->level = a_level;
+    record->message = a_message;
+    record->value = a_value;
+    record->count = a_count;
+    record->sequence.store(pos + 1, std::memory_order_release);
+}
+
+
+//==============================================================================
+/*!
+    Starts the thread that drains recorded messages to the console.
+*/
+//==============================================================================
+void HapticDiagnostics::start()
+{
+    if (s_running.exchange(true))
+    {
+        return;
+    }
+
+    s_drainThread = std::thread(drainLoop);
+}
+
+
+//==============================================================================
+/*!
+    Stops the drain thread once the remaining messages have been printed.
+*/
+//==============================================================================
+void HapticDiagnostics::stop()
+{
+    if (!s_running.exchange(false))
+    {
+        return;
+    }
+
+    s_drainThread.join();
+}
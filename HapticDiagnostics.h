@@ -0,0 +1,94 @@
+//==============================================================================
+/*
+    CPSC 599.86 / 601.86 - Computer Haptics
+    Winter 2018, University of Calgary
+
+    Diagnostics for the haptic rendering path. Console output inside the
+    1 kHz loop wrecks its timing, so haptic code never prints: it records a
+    message (a string literal) and a value into a preallocated lock-free
+    buffer, and a background thread drains the buffer to the console.
+
+    Levels are selected at compile time with HAPTIC_DIAG_LEVEL. Macros of
+    disabled levels compile to nothing, arguments included.
+
+        HAPTIC_DIAG_ERROR_ONCE(message)     first occurrence, then rate-limited
+        HAPTIC_DIAG_WARNING(message, value) every occurrence
+        HAPTIC_DIAG_TRACE(message, value)   every occurrence
+*/
+//==============================================================================
+
+#ifndef HAPTICDIAGNOSTICS_H
+#define HAPTICDIAGNOSTICS_H
+
+#include <atomic>
+
+//------------------------------------------------------------------------------
+
+#define HAPTIC_DIAG_LEVEL_NONE      0
+#define HAPTIC_DIAG_LEVEL_ERROR     1
+#define HAPTIC_DIAG_LEVEL_WARNING   2
+#define HAPTIC_DIAG_LEVEL_TRACE     3
+
+// default level; override with e.g. /D HAPTIC_DIAG_LEVEL=3 to enable traces
+#ifndef HAPTIC_DIAG_LEVEL
+#define HAPTIC_DIAG_LEVEL HAPTIC_DIAG_LEVEL_ERROR
+#endif
+
+//------------------------------------------------------------------------------
+
+//! Occurrence counter of one rate-limited report site.
+struct HapticDiagnosticSite
+{
+    std::atomic<unsigned int> m_count;
+};
+
+//------------------------------------------------------------------------------
+
+namespace HapticDiagnostics
+{
+    //! Records a message; never blocks. a_message must have static storage duration.
+    void record(int a_level, const char* a_message, double a_value, unsigned int a_count);
+
+    //! Records the first occurrence of a site, then occurrences 2, 4, 8, ...
+    inline void recordRateLimited(HapticDiagnosticSite& a_site, int a_level, const char* a_message)
+    {
+        unsigned int count = a_site.m_count.fetch_add(1, std::memory_order_relaxed) + 1;
+        if ((count & (count - 1)) == 0)
+        {
+            record(a_level, a_message, 0.0, count);
+        }
+    }
+
+    //! Starts the thread that drains recorded messages to the console.
+    void start();
+
+    //! Drains the remaining messages and stops the drain thread.
+    void stop();
+}
+
+//------------------------------------------------------------------------------
+
+#if HAPTIC_DIAG_LEVEL >= HAPTIC_DIAG_LEVEL_ERROR
+#define HAPTIC_DIAG_ERROR_ONCE(message) \
+    do { static HapticDiagnosticSite site_ = { {0} }; \
+         HapticDiagnostics::recordRateLimited(site_, HAPTIC_DIAG_LEVEL_ERROR, message); } while (0)
+#else
+#define HAPTIC_DIAG_ERROR_ONCE(message) do { } while (0)
+#endif
+
+#if HAPTIC_DIAG_LEVEL >= HAPTIC_DIAG_LEVEL_WARNING
+#define HAPTIC_DIAG_WARNING(message, value) \
+    HapticDiagnostics::record(HAPTIC_DIAG_LEVEL_WARNING, message, (double)(value), 1)
+#else
+#define HAPTIC_DIAG_WARNING(message, value) do { } while (0)
+#endif
+
+#if HAPTIC_DIAG_LEVEL >= HAPTIC_DIAG_LEVEL_TRACE
+#define HAPTIC_DIAG_TRACE(message, value) \
+    HapticDiagnostics::record(HAPTIC_DIAG_LEVEL_TRACE, message, (double)(value), 1)
+#else
+#define HAPTIC_DIAG_TRACE(message, value) do { } while (0)
+#endif
+
+//------------------------------------------------------------------------------
+#endif
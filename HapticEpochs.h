@@ -0,0 +1,92 @@
+//==============================================================================
+/*
+    CPSC 599.86 / 601.86 - Computer Haptics
+    Winter 2018, University of Calgary
+
+    Quiescent-state counters of the haptic threads, for the data they read
+    without locks (material parameters, streamed tiles). Each haptic thread
+    counts its own ticks in a counter of its own, on its own cache line;
+    a writer that replaces a block stamps it with every counter, and frees
+    it once each thread has moved past its stamp. With one haptic thread
+    this is the single tick counter used so far.
+*/
+//==============================================================================
+
+#ifndef HAPTICEPOCHS_H
+#define HAPTICEPOCHS_H
+
+#include <atomic>
+
+//------------------------------------------------------------------------------
+
+//! Largest number of haptic threads reading the same data.
+const unsigned int C_MAX_HAPTIC_THREADS = 8;
+
+class HapticEpochs
+{
+public:
+
+    //! Counters of every haptic thread when a block was retired.
+    struct Stamp
+    {
+        unsigned long long epochs[C_MAX_HAPTIC_THREADS];
+    };
+
+    //! Constructor of HapticEpochs, for one haptic thread.
+    HapticEpochs() : m_numThreads(1)
+    {
+        for (unsigned int i = 0; i < C_MAX_HAPTIC_THREADS; ++i)
+        {
+            m_threads[i].epoch.store(0);
+        }
+    }
+
+    //! Sets the number of haptic threads (at most C_MAX_HAPTIC_THREADS). Call before they start.
+    void setNumThreads(unsigned int a_numThreads)
+    {
+        m_numThreads = (a_numThreads < 1) ? 1 : ((a_numThreads > C_MAX_HAPTIC_THREADS) ? C_MAX_HAPTIC_THREADS : a_numThreads);
+    }
+
+    //! Number of haptic threads.
+    unsigned int getNumThreads() const { return (m_numThreads); }
+
+    //! Called by haptic thread a_thread at the end of every tick; never blocks.
+    void quiescentState(unsigned int a_thread) { m_threads[a_thread].epoch.fetch_add(1); }
+
+    //! Stamps a block being retired with the counters of every haptic thread.
+    void stamp(Stamp& a_stamp) const
+    {
+        for (unsigned int i = 0; i < m_numThreads; ++i)
+        {
+            a_stamp.epochs[i] = m_threads[i].epoch.load();
+        }
+    }
+
+    //! True once every haptic thread has completed more than a_margin ticks since the stamp.
+    bool hasPassed(const Stamp& a_stamp, unsigned long long a_margin = 0) const
+    {
+        for (unsigned int i = 0; i < m_numThreads; ++i)
+        {
+            if (m_threads[i].epoch.load() <= a_stamp.epochs[i] + a_margin)
+            {
+                return (false);
+            }
+        }
+        return (true);
+    }
+
+protected:
+
+    //! Counter of one haptic thread, alone on its cache line.
+    struct Counter
+    {
+        std::atomic<unsigned long long> epoch;
+        char padding[64 - sizeof(std::atomic<unsigned long long>)];
+    };
+
+    Counter m_threads[C_MAX_HAPTIC_THREADS];
+    unsigned int m_numThreads;
+};
+
+//------------------------------------------------------------------------------
+#endif
@@ -0,0 +1,459 @@
+//==============================================================================
+/*
+    CPSC 599.86 / 601.86 - Computer Haptics
+    Winter 2018, University of Calgary
+
+    Latency histograms of the stages of a haptic tick, and of the period
+    between ticks, reported as percentiles.
+*/
+//==============================================================================
+
+#include "HapticLatency.h"
+#include <cmath>
+
+using namespace std;
+
+//------------------------------------------------------------------------------
+
+namespace
+{
+    // interval at which the reporter thread checks whether it should stop
+    const unsigned int POLL_PERIOD_MS = 50;
+
+    // log2 of LatencyHistogram::SUB_BUCKETS
+    const unsigned int SUB_BUCKET_BITS = 5;
+
+    // index of the highest set bit of a non-zero value
+    unsigned int highestBit(unsigned long long a_value)
+    {
+        unsigned int bit = 0;
+        if (a_value >> 32) { a_value >>= 32; bit += 32; }
+        if (a_value >> 16) { a_value >>= 16; bit += 16; }
+        if (a_value >> 8)  { a_value >>= 8;  bit += 8; }
+        if (a_value >> 4)  { a_value >>= 4;  bit += 4; }
+        if (a_value >> 2)  { a_value >>= 2;  bit += 2; }
+        if (a_value >> 1)  { bit += 1; }
+        return (bit);
+    }
+}
+
+
+//==============================================================================
+/*!
+    Returns the number of values of a snapshot.
+
+    \return Number of values.
+*/
+//==============================================================================
+unsigned long long LatencySnapshot::getCount() const
+{
+    unsigned long long count = 0;
+    for (unsigned int i = 0; i < counts.size(); i++)
+    {
+        count += counts[i];
+    }
+    return (count);
+}
+
+
+//==============================================================================
+/*!
+    Returns a percentile of a snapshot: the upper bound of the bucket holding
+    the value of that rank.
+
+    \param  a_quantile  Fraction of the values, in [0, 1].
+
+    \return Value in nanoseconds, or 0 if the snapshot is empty.
+*/
+//==============================================================================
+double LatencySnapshot::getPercentile(double a_quantile) const
+{
+    unsigned long long count = getCount();
+    if (count == 0)
+    {
+        return (0.0);
+    }
+
+    unsigned long long rank = (unsigned long long)ceil(a_quantile * (double)count);
+    if (rank < 1)
+    {
+        rank = 1;
+    }
+
+    unsigned long long cumulative = 0;
+    for (unsigned int i = 0; i < counts.size(); i++)
+    {
+        cumulative += counts[i];
+        if (cumulative >= rank)
+        {
+            return ((double)LatencyHistogram::getBucketUpperBound(i));
+        }
+    }
+
+    return (getMax());
+}
+
+
+//==============================================================================
+/*!
+    Returns the largest value of a snapshot: the upper bound of its highest
+    non-empty bucket.
+
+    \return Value in nanoseconds, or 0 if the snapshot is empty.
+*/
+//==============================================================================
+double LatencySnapshot::getMax() const
+{
+    for (unsigned int i = (unsigned int)counts.size(); i > 0; i--)
+    {
+        if (counts[i - 1] > 0)
+        {
+            return ((double)LatencyHistogram::getBucketUpperBound(i - 1));
+        }
+    }
+    return (0.0);
+}
+
+
+//==============================================================================
+/*!
+    Removes the counts of an earlier snapshot of the same histogram, leaving
+    the histogram of the values recorded in between.
+
+    \param  a_earlier  Earlier snapshot.
+*/
+//==============================================================================
+void LatencySnapshot::subtract(const LatencySnapshot& a_earlier)
+{
+    for (unsigned int i = 0; (i < counts.size()) && (i < a_earlier.counts.size()); i++)
+    {
+        counts[i] -= a_earlier.counts[i];
+    }
+}
+
+
+//==============================================================================
+/*!
+    Constructor of LatencyHistogram.
+*/
+//==============================================================================
+LatencyHistogram::LatencyHistogram()
+{
+    for (unsigned int i = 0; i < NUM_BUCKETS; i++)
+    {
+        m_buckets[i].store(0, memory_order_relaxed);
+    }
+}
+
+
+//==============================================================================
+/*!
+    Copies the counts of the histogram. The writer may be recording at the
+    same time; each count is read atomically.
+
+    \param  a_snapshot  Returned counts.
+*/
+//==============================================================================
+void LatencyHistogram::snapshot(LatencySnapshot& a_snapshot) const
+{
+    a_snapshot.counts.resize(NUM_BUCKETS);
+    for (unsigned int i = 0; i < NUM_BUCKETS; i++)
+    {
+        a_snapshot.counts[i] = m_buckets[i].load(memory_order_relaxed);
+    }
+}
+
+
+//==============================================================================
+/*!
+    Returns the bucket of a duration. Durations below 2 x SUB_BUCKETS ns
+    have a bucket each; above, every power of two is split into SUB_BUCKETS
+    buckets of equal width.
+
+    \param  a_nanoseconds  Duration.
+
+    \return Bucket index.
+*/
+//==============================================================================
+unsigned int LatencyHistogram::getBucket(unsigned long long a_nanoseconds)
+{
+    if (a_nanoseconds < 2 * SUB_BUCKETS)
+    {
+        return ((unsigned int)a_nanoseconds);
+    }
+
+    unsigned int shift = highestBit(a_nanoseconds) - SUB_BUCKET_BITS;
+    unsigned long long bucket = (unsigned long long)shift * SUB_BUCKETS + (a_nanoseconds >> shift);
+
+    return ((bucket < NUM_BUCKETS) ? (unsigned int)bucket : NUM_BUCKETS - 1);
+}
+
+
+//==============================================================================
+/*!
+    Returns the largest duration that falls into a bucket.
+
+    \param  a_bucket  Bucket index.
+
+    \return Duration in nanoseconds.
+*/
+//==============================================================================
+unsigned long long LatencyHistogram::getBucketUpperBound(unsigned int a_bucket)
+{
+    if (a_bucket < 2 * SUB_BUCKETS)
+    {
+        return (a_bucket);
+    }
+
+    unsigned int shift = a_bucket / SUB_BUCKETS - 1;
+    unsigned long long mantissa = a_bucket - shift * SUB_BUCKETS;
+    return (((mantissa + 1) << shift) - 1);
+}
+
+
+//==============================================================================
+/*!
+    Constructor of HapticLatencyMonitor.
+*/
+//==============================================================================
+HapticLatencyMonitor::HapticLatencyMonitor() :
+    m_lastTickStart(0),
+    m_running(false),
+    m_dumpFile(NULL),
+    m_reportCount(0)
+{
+}
+
+
+//==============================================================================
+/*!
+    Destructor of HapticLatencyMonitor.
+*/
+//==============================================================================
+HapticLatencyMonitor::~HapticLatencyMonitor()
+{
+    stop();
+}
+
+
+//==============================================================================
+/*!
+    Records the start of a tick. The time since the start of the previous
+    tick goes into the period histogram.
+
+    \param  a_now  Start of the tick (hapticLatencyNow()).
+*/
+//==============================================================================
+void HapticLatencyMonitor::recordTickStart(unsigned long long a_now)
+{
+    if (m_lastTickStart != 0)
+    {
+        m_histograms[HAPTIC_STAGE_PERIOD].record(a_now - m_lastTickStart);
+    }
+    m_lastTickStart = a_now;
+}
+
+
+//==============================================================================
+/*!
+    Starts the reporter thread.
+
+    \param  a_dumpFile  File every report is appended to, or an empty string.
+    \param  a_periodMs  Reporting period in milliseconds.
+*/
+//==============================================================================
+void HapticLatencyMonitor::start(const string& a_dumpFile, unsigned int a_periodMs)
+{
+    if (m_running.exchange(true))
+    {
+        return;
+    }
+
+    if (!a_dumpFile.empty())
+    {
+        m_dumpFile = fopen(a_dumpFile.c_str(), "a");
+        if (m_dumpFile == NULL)
+        {
+            printf("could not open %s; latency reports are only shown on screen\n", a_dumpFile.c_str());
+        }
+    }
+
+    m_reporter = thread(&HapticLatencyMonitor::report, this, a_periodMs);
+}
+
+
+//==============================================================================
+/*!
+    Stops the reporter thread and closes the dump file.
+*/
+//==============================================================================
+void HapticLatencyMonitor::stop()
+{
+    if (!m_running.exchange(false))
+    {
+        return;
+    }
+
+    m_reporter.join();
+
+    if (m_dumpFile != NULL)
+    {
+        fclose(m_dumpFile);
+        m_dumpFile = NULL;
+    }
+}
+
+
+//==============================================================================
+/*!
+    Copies the latest report.
+
+    \param  a_text  Returned report; keeps its capacity if it is large enough.
+*/
+//==============================================================================
+void HapticLatencyMonitor::getReport(string& a_text)
+{
+    lock_guard<mutex> lock(m_reportMutex);
+    a_text.assign(m_report);
+}
+
+
+//==============================================================================
+/*!
+    Formats the statistics of every value recorded so far.
+
+    \param  a_text  Returned text, one line per stage.
+*/
+//==============================================================================
+void HapticLatencyMonitor::formatTotals(string& a_text) const
+{
+    LatencySnapshot snapshots[HAPTIC_NUM_STAGES];
+    for (int i = 0; i < HAPTIC_NUM_STAGES; i++)
+    {
+        m_histograms[i].snapshot(snapshots[i]);
+    }
+    format(snapshots, a_text);
+}
+
+
+//==============================================================================
+/*!
+    Returns the name of a stage in the reports.
+
+    \param  a_stage  Stage (HapticLatencyStage).
+
+    \return Name of the stage.
+*/
+//==============================================================================
+const char* HapticLatencyMonitor::getStageName(int a_stage)
+{
+    switch (a_stage)
+    {
+        case HAPTIC_STAGE_GLOBAL_POSITIONS:     return ("global poses");
+        case HAPTIC_STAGE_UPDATE_FROM_DEVICE:   return ("updateFromDevice");
+        case HAPTIC_STAGE_DRIFT:                return ("workspace drift");
+        case HAPTIC_STAGE_INTERACTION_FORCES:   return ("computeInteractionForces");
+        case HAPTIC_STAGE_CONTACT_CONTEXT:      return ("  contact context");
+        case HAPTIC_STAGE_MOVE_PROXY:           return ("  testFrictionAndMoveProxy");
+        case HAPTIC_STAGE_UPDATE_FORCE:         return ("  updateForce");
+        case HAPTIC_STAGE_APPLY_TO_DEVICE:      return ("applyToDevice");
+        case HAPTIC_STAGE_TICK:                 return ("tick");
+        case HAPTIC_STAGE_PERIOD:               return ("period");
+        default:                                return ("?");
+    }
+}
+
+
+//==============================================================================
+/*!
+    Formats p50, p99, p99.9 and max of every stage in microseconds, and the
+    jitter of the tick period (how far p99.9 and max lie above p50).
+
+    \param  a_snapshots  One snapshot per stage.
+    \param  a_text       Returned text; keeps its capacity if it is large enough.
+*/
+//==============================================================================
+void HapticLatencyMonitor::format(const LatencySnapshot a_snapshots[HAPTIC_NUM_STAGES], string& a_text)
+{
+    char line[160];
+
+    snprintf(line, sizeof(line), "%llu ticks (us)    p50     p99   p99.9     max\n",
+             a_snapshots[HAPTIC_STAGE_TICK].getCount());
+    a_text.assign(line);
+
+    for (int i = 0; i < HAPTIC_NUM_STAGES; i++)
+    {
+        const LatencySnapshot& snapshot = a_snapshots[i];
+        snprintf(line, sizeof(line), "%-27s %7.1f %7.1f %7.1f %7.1f\n", getStageName(i),
+                 0.001 * snapshot.getPercentile(0.5), 0.001 * snapshot.getPercentile(0.99),
+                 0.001 * snapshot.getPercentile(0.999), 0.001 * snapshot.getMax());
+        a_text.append(line);
+    }
+
+    const LatencySnapshot& period = a_snapshots[HAPTIC_STAGE_PERIOD];
+    double median = period.getPercentile(0.5);
+    snprintf(line, sizeof(line), "period jitter: p99.9 +%.1f us, max +%.1f us over p50\n",
+             0.001 * (period.getPercentile(0.999) - median), 0.001 * (period.getMax() - median));
+    a_text.append(line);
+}
+
+
+//==============================================================================
+/*!
+    Body of the reporter thread. Every period it formats the histograms of
+    the values recorded during that period, publishes the text for
+    getReport() and appends it to the dump file.
+
+    \param  a_periodMs  Reporting period in milliseconds.
+*/
+//==============================================================================
+void HapticLatencyMonitor::report(unsigned int a_periodMs)
+{
+    LatencySnapshot previous[HAPTIC_NUM_STAGES];
+    LatencySnapshot interval[HAPTIC_NUM_STAGES];
+    for (int i = 0; i < HAPTIC_NUM_STAGES; i++)
+    {
+        m_histograms[i].snapshot(previous[i]);
+    }
+
+    string text;
+    text.reserve(2048);
+
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    chrono::steady_clock::time_point next = start + chrono::milliseconds(a_periodMs);
+
+    while (m_running.load())
+    {
+        this_thread::sleep_for(chrono::milliseconds(POLL_PERIOD_MS));
+
+        chrono::steady_clock::time_point now = chrono::steady_clock::now();
+        if (now < next)
+        {
+            continue;
+        }
+        next += chrono::milliseconds(a_periodMs);
+
+        for (int i = 0; i < HAPTIC_NUM_STAGES; i++)
+        {
+            m_histograms[i].snapshot(interval[i]);
+            LatencySnapshot current = interval[i];
+            interval[i].subtract(previous[i]);
+            previous[i].counts.swap(current.counts);
+        }
+
+        format(interval, text);
+
+        if (m_dumpFile != NULL)
+        {
+            double seconds = chrono::duration<double>(now - start).count();
+            fprintf(m_dumpFile, "t = %.1f s\n%s\n", seconds, text.c_str());
+            fflush(m_dumpFile);
+        }
+
+        {
+            lock_guard<mutex> lock(m_reportMutex);
+            m_report.assign(text);
+        }
+        m_reportCount.fetch_add(1, memory_order_release);
+    }
+}
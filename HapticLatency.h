@@ -0,0 +1,184 @@
+//==============================================================================
+/*
+    CPSC 599.86 / 601.86 - Computer Haptics
+    Winter 2018, University of Calgary
+
+    Latency histograms of the stages of a haptic tick, and of the period
+    between ticks. An average rate hides the occasional long tick that the
+    user feels, so every duration is kept in a log-linear histogram (32
+    buckets per power of two, i.e. within about 3% of the true value) and
+    reported as percentiles.
+
+    The haptic thread records without locking, allocating or waiting: each
+    bucket is an atomic counter with a single writer. A reporter thread
+    takes a snapshot every second, subtracts the previous one to get the
+    histogram of that interval, formats p50 / p99 / p99.9 / max per stage
+    for the on-screen label, and appends it to a dump file.
+*/
+//==============================================================================
+
+#ifndef HAPTICLATENCY_H
+#define HAPTICLATENCY_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+//------------------------------------------------------------------------------
+
+//! Stages of a haptic tick, in the order they run.
+enum HapticLatencyStage
+{
+    HAPTIC_STAGE_GLOBAL_POSITIONS,
+    HAPTIC_STAGE_UPDATE_FROM_DEVICE,
+    HAPTIC_STAGE_DRIFT,
+    HAPTIC_STAGE_INTERACTION_FORCES,
+
+    //! Phases of HAPTIC_STAGE_INTERACTION_FORCES, recorded by MyProxyAlgorithm.
+    HAPTIC_STAGE_CONTACT_CONTEXT,
+    HAPTIC_STAGE_MOVE_PROXY,
+    HAPTIC_STAGE_UPDATE_FORCE,
+
+    HAPTIC_STAGE_APPLY_TO_DEVICE,
+
+    //! The whole tick.
+    HAPTIC_STAGE_TICK,
+
+    //! Time from the start of one tick to the start of the next.
+    HAPTIC_STAGE_PERIOD,
+
+    HAPTIC_NUM_STAGES
+};
+
+//! Monotonic time in nanoseconds, for timing stages.
+inline unsigned long long hapticLatencyNow()
+{
+    return ((unsigned long long)std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+//------------------------------------------------------------------------------
+
+//! Counts of a latency histogram at one time.
+struct LatencySnapshot
+{
+    std::vector<unsigned long long> counts;
+
+    //! Total number of values.
+    unsigned long long getCount() const;
+
+    //! Value (ns) at or below which a fraction a_quantile of the values lie; 0 if empty.
+    double getPercentile(double a_quantile) const;
+
+    //! Largest value (ns), to the histogram's precision; 0 if empty.
+    double getMax() const;
+
+    //! Removes the counts of an earlier snapshot, leaving the histogram of the interval.
+    void subtract(const LatencySnapshot& a_earlier);
+};
+
+//------------------------------------------------------------------------------
+
+//! Log-linear histogram of durations in nanoseconds, with a single writer.
+class LatencyHistogram
+{
+public:
+
+    //! Number of linear buckets per power of two.
+    static const unsigned int SUB_BUCKETS = 32;
+
+    //! Total number of buckets; durations beyond the last bucket (~280 s) are clamped.
+    static const unsigned int NUM_BUCKETS = 44 * SUB_BUCKETS;
+
+    //! Constructor of LatencyHistogram.
+    LatencyHistogram();
+
+    //! Records a duration. Only one thread may record into a histogram.
+    void record(unsigned long long a_nanoseconds)
+    {
+        std::atomic<unsigned long long>& bucket = m_buckets[getBucket(a_nanoseconds)];
+        bucket.store(bucket.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+
+    //! Copies the counts. Safe from any thread.
+    void snapshot(LatencySnapshot& a_snapshot) const;
+
+    //! Bucket of a duration.
+    static unsigned int getBucket(unsigned long long a_nanoseconds);
+
+    //! Largest duration that falls into a bucket.
+    static unsigned long long getBucketUpperBound(unsigned int a_bucket);
+
+protected:
+
+    std::atomic<unsigned long long> m_buckets[NUM_BUCKETS];
+};
+
+//------------------------------------------------------------------------------
+
+class HapticLatencyMonitor
+{
+public:
+
+    //! Constructor of HapticLatencyMonitor.
+    HapticLatencyMonitor();
+
+    //! Destructor of HapticLatencyMonitor. Stops the reporter thread.
+    ~HapticLatencyMonitor();
+
+    //! Records the duration of a stage. Haptic thread only.
+    void record(HapticLatencyStage a_stage, unsigned long long a_nanoseconds) { m_histograms[a_stage].record(a_nanoseconds); }
+
+    //! Records the start of a tick, for the tick-to-tick period. Haptic thread only.
+    void recordTickStart(unsigned long long a_now);
+
+    //! Starts reporting every a_periodMs; a_dumpFile (if not empty) gets every report appended.
+    void start(const std::string& a_dumpFile, unsigned int a_periodMs = 1000);
+
+    //! Stops the reporter thread.
+    void stop();
+
+    //! Number of reports so far; changes when getReport() has a new text.
+    unsigned int getReportCount() const { return (m_reportCount.load(std::memory_order_acquire)); }
+
+    //! Copies the latest report (one line per stage) into a_text.
+    void getReport(std::string& a_text);
+
+    //! Formats the statistics of all ticks recorded so far.
+    void formatTotals(std::string& a_text) const;
+
+    //! Copies the histogram of one stage over all ticks recorded so far.
+    void getTotals(HapticLatencyStage a_stage, LatencySnapshot& a_snapshot) const { m_histograms[a_stage].snapshot(a_snapshot); }
+
+    //! Name of a stage in the reports.
+    static const char* getStageName(int a_stage);
+
+protected:
+
+    //! Formats the statistics of one snapshot per stage.
+    static void format(const LatencySnapshot a_snapshots[HAPTIC_NUM_STAGES], std::string& a_text);
+
+    //! Body of the reporter thread.
+    void report(unsigned int a_periodMs);
+
+    LatencyHistogram m_histograms[HAPTIC_NUM_STAGES];
+
+    //! Start of the previous tick (haptic thread only); 0 before the first tick.
+    unsigned long long m_lastTickStart;
+
+    std::thread m_reporter;
+    std::atomic<bool> m_running;
+    FILE* m_dumpFile;
+
+    //! Latest report, guarded by m_reportMutex; never taken by the haptic thread.
+    std::mutex m_reportMutex;
+    std::string m_report;
+    std::atomic<unsigned int> m_reportCount;
+};
+
+//------------------------------------------------------------------------------
+#endif
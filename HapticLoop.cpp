@@ -0,0 +1,257 @@
+//==============================================================================
+/*
+    CPSC 599.86 / 601.86 - Computer Haptics
+    Winter 2018, University of Calgary
+
+    One tick of the haptic loop, shared by the application and the headless
+    simulation.
+*/
+//==============================================================================
+
+#include "HapticLoop.h"
+
+using namespace chai3d;
+using namespace std;
+
+//==============================================================================
+/*!
+    Constructor of HapticLoop.
+
+    \param  a_world    World holding the tool and the objects.
+    \param  a_tool     Tool driven by the device.
+    \param  a_device   Device of the tool.
+    \param  a_library  Material parameters read by the haptic kernels.
+*/
+//==============================================================================
+HapticLoop::HapticLoop(cWorld* a_world,
+                       cToolCursor* a_tool,
+                       cGenericHapticDevicePtr a_device,
+                       MaterialLibrary* a_library) :
+    m_world(a_world),
+    m_tool(a_tool),
+    m_device(a_device),
+    m_library(a_library),
+    m_transforms(a_world),
+    m_controlLoop(NULL),
+    m_driftStepPerTick(0.0),
+    m_hasDriftTarget(false),
+    m_tileStreamer(NULL),
+    m_hapticThread(0),
+    m_servoLoop(NULL),
+    m_recording(NULL),
+    m_latencyMonitor(NULL)
+{
+    m_transforms.addMovingObject(m_tool);
+}
+
+
+//==============================================================================
+/*!
+    Records the device pose at every tick into a trajectory, with times
+    from this call, so that the session can be replayed by a
+    VirtualHapticDevice.
+
+    \param  a_recording  Trajectory to append to, or NULL to stop recording.
+*/
+//==============================================================================
+void HapticLoop::setRecording(HapticTrajectory* a_recording)
+{
+    m_recording = a_recording;
+    m_recordingClock.start(true);
+}
+
+
+//==============================================================================
+/*!
+    Sets the streamer of the tiles around the tool. Its root is kept out of
+    the full walks of the global poses, since the rendering thread adds and
+    removes its children, and the tiles the tick saw are released at the
+    end of every tick.
+
+    \param  a_streamer  Streamer, or NULL.
+*/
+//==============================================================================
+void HapticLoop::setTileStreamer(TileStreamer* a_streamer)
+{
+    m_tileStreamer = a_streamer;
+
+    if (m_tileStreamer != NULL)
+    {
+        m_transforms.excludeObject(m_tileStreamer->getRoot());
+    }
+}
+
+
+//==============================================================================
+/*!
+    Makes this loop one of several sharing the world, each driving its own
+    tool from its own haptic thread. The loop then recomputes the global
+    poses of its tool only, never walking the world the other threads
+    read, and reports the end of its ticks to the material library and the
+    streamer as haptic thread a_thread. Their number of haptic threads, and
+    the poses of the static objects, must be set before the threads start.
+
+    \param  a_thread  Index of the haptic thread running this loop.
+*/
+//==============================================================================
+void HapticLoop::setSharedWorld(unsigned int a_thread)
+{
+    m_hapticThread = a_thread;
+    m_transforms.setSharedWorld(true);
+}
+
+
+//==============================================================================
+/*!
+    Sets the servo loop rendering the force. The proxy fills a contact model
+    at the end of every force computation, and every tick publishes it with
+    the pose of the tool; the force the tool sends to the device is dropped.
+
+    \param  a_servoLoop  Servo loop, or NULL.
+    \param  a_proxy      Force algorithm of the tool.
+*/
+//==============================================================================
+void HapticLoop::setServoLoop(ServoLoop* a_servoLoop, MyProxyAlgorithm* a_proxy)
+{
+    m_servoLoop = a_servoLoop;
+
+    if (m_servoLoop != NULL)
+    {
+        m_contactModel.reset(new LocalContactModel());
+        m_contactModel->inContact = false;
+        a_proxy->setContactModel(m_contactModel.get());
+    }
+    else
+    {
+        a_proxy->setContactModel(NULL);
+        m_contactModel.reset();
+    }
+}
+
+
+//==============================================================================
+/*!
+    Runs one tick of the loop.
+*/
+//==============================================================================
+void HapticLoop::tick()
+{
+    unsigned long long tickStart = startStage();
+    if (m_latencyMonitor != NULL)
+    {
+        m_latencyMonitor->recordTickStart(tickStart);
+    }
+
+    /////////////////////////////////////////////////////////////////////
+    // READ HAPTIC DEVICE
+    /////////////////////////////////////////////////////////////////////
+
+    // read position
+    cVector3d position;
+    m_device->getPosition(position);
+
+    // read orientation
+    cMatrix3d rotation;
+    m_device->getRotation(rotation);
+
+    // read user-switch status (button 0)
+    bool button = false;
+    m_device->getUserSwitch(0, button);
+
+    if (m_recording != NULL)
+    {
+        m_recording->addSample(m_recordingClock.getCurrentTimeSeconds(), position, rotation);
+    }
+
+    unsigned long long stageStart = startStage();
+
+    // only the subtree of the tool, if it moved
+    m_transforms.update();
+
+    endStage(HAPTIC_STAGE_GLOBAL_POSITIONS, stageStart);
+
+    /////////////////////////////////////////////////////////////////////
+    // UPDATE 3D CURSOR MODEL
+    /////////////////////////////////////////////////////////////////////
+
+    m_tool->updateFromDevice();
+
+    endStage(HAPTIC_STAGE_UPDATE_FROM_DEVICE, stageStart);
+
+    /////////////////////////////////////////////////////////////////////
+    // WORKSPACE DRIFT
+    /////////////////////////////////////////////////////////////////////
+
+    if (m_controlLoop != NULL)
+    {
+        cVector3d toolPos = m_tool->getLocalPos();
+        m_controlLoop->publishToolState(position, toolPos);
+
+        // approach the drift target of the control loop at its drift rate; if the control
+        // loop is publishing, keep the previous target rather than wait
+        cVector3d target;
+        double stepPerTick;
+        if (m_controlLoop->readToolTarget(target, stepPerTick))
+        {
+            m_driftTarget = target;
+            m_driftStepPerTick = stepPerTick;
+            m_hasDriftTarget = true;
+        }
+
+        if (m_hasDriftTarget)
+        {
+            double maxStep = cMin(m_driftStepPerTick, C_MAX_DRIFT_STEP);
+            cVector3d offset = m_driftTarget - toolPos;
+            double distance = offset.length();
+            if (distance > maxStep)
+            {
+                offset = offset * (maxStep / distance);
+            }
+            if (distance > 0.0)
+            {
+                m_tool->setLocalPos(toolPos + offset);
+            }
+        }
+    }
+
+    endStage(HAPTIC_STAGE_DRIFT, stageStart);
+
+    /////////////////////////////////////////////////////////////////////
+    // COMPUTE FORCES
+    /////////////////////////////////////////////////////////////////////
+
+    m_tool->computeInteractionForces();
+
+    // the kernels hold no material parameters past this point
+    m_library->quiescentState(m_hapticThread);
+
+    // nor any streamed tile
+    if (m_tileStreamer != NULL)
+    {
+        m_tileStreamer->quiescentState(m_hapticThread);
+    }
+
+    if (m_servoLoop != NULL)
+    {
+        // the tool is translated and scaled, never rotated
+        cVector3d toolPos = m_tool->getGlobalPos();
+        for (int i = 0; i < 3; ++i)
+        {
+            m_contactModel->toolPos[i] = toolPos(i);
+        }
+        m_contactModel->workspaceScale = m_tool->getWorkspaceScaleFactor();
+
+        m_servoLoop->getContactModelChannel()->publish(*m_contactModel);
+    }
+
+    endStage(HAPTIC_STAGE_INTERACTION_FORCES, stageStart);
+
+    /////////////////////////////////////////////////////////////////////
+    // APPLY FORCES
+    /////////////////////////////////////////////////////////////////////
+
+    m_tool->applyToDevice();
+
+    endStage(HAPTIC_STAGE_APPLY_TO_DEVICE, stageStart);
+    endStage(HAPTIC_STAGE_TICK, tickStart);
+}
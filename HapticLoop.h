@@ -0,0 +1,118 @@
+//==============================================================================
+/*
+    CPSC 599.86 / 601.86 - Computer Haptics
+    Winter 2018, University of Calgary
+
+    One tick of the haptic loop: read the device, update the avatar, move
+    it towards the drift target of the control loop, compute the
+    interaction forces and send them to the device. The application
+    runs it from its haptics thread; the headless simulation runs it
+    directly against a VirtualHapticDevice.
+*/
+//==============================================================================
+
+#ifndef HAPTICLOOP_H
+#define HAPTICLOOP_H
+
+#include "chai3d.h"
+#include "ControlLoop.h"
+#include "HapticLatency.h"
+#include "HapticTrajectory.h"
+#include "MaterialLibrary.h"
+#include "MyProxyAlgorithm.h"
+#include "ServoLoop.h"
+#include "TileStreamer.h"
+#include "TransformPropagator.h"
+#include <memory>
+
+//------------------------------------------------------------------------------
+
+class HapticLoop
+{
+public:
+
+    //! Constructor of HapticLoop.
+    HapticLoop(chai3d::cWorld* a_world,
+               chai3d::cToolCursor* a_tool,
+               chai3d::cGenericHapticDevicePtr a_device,
+               MaterialLibrary* a_library);
+
+    //! Control loop exchanging the tool position and drift target with every tick (NULL for no drift). Call before the first tick.
+    void setControlLoop(ControlLoop* a_controlLoop) { m_controlLoop = a_controlLoop; }
+
+    //! Records the device pose at every tick into a trajectory (NULL to stop).
+    void setRecording(HapticTrajectory* a_recording);
+
+    //! Records the duration of every stage of a tick into a monitor (NULL to stop).
+    void setLatencyMonitor(HapticLatencyMonitor* a_monitor) { m_latencyMonitor = a_monitor; }
+
+    //! Streamer of the tiles around the tool (NULL for none); its tiles are released at the end of every tick. Call before the first tick.
+    void setTileStreamer(TileStreamer* a_streamer);
+
+    //! Servo loop rendering the force from the contact model of every tick (NULL for none); the device must then be its collision device. Call before the first tick.
+    void setServoLoop(ServoLoop* a_servoLoop, MyProxyAlgorithm* a_proxy);
+
+    //! Makes this loop one of several sharing the world, run by haptic thread a_thread: it only updates the poses of its own tool. Call before the first tick.
+    void setSharedWorld(unsigned int a_thread);
+
+    //! Makes the next tick recompute every global pose, after static objects were added, removed or moved. Safe from any thread.
+    void invalidateTransforms() { m_transforms.invalidate(); }
+
+    //! Incremental global pose updates of the world.
+    const TransformPropagator& getTransforms() const { return (m_transforms); }
+
+    //! Runs one tick of the loop.
+    void tick();
+
+protected:
+
+    //! Current time if a latency monitor is set, 0 otherwise.
+    unsigned long long startStage() const { return ((m_latencyMonitor != NULL) ? hapticLatencyNow() : 0); }
+
+    //! Records the duration of a stage started at a_start, and starts the next one.
+    void endStage(HapticLatencyStage a_stage, unsigned long long& a_start)
+    {
+        if (m_latencyMonitor != NULL)
+        {
+            unsigned long long now = hapticLatencyNow();
+            m_latencyMonitor->record(a_stage, now - a_start);
+            a_start = now;
+        }
+    }
+
+    chai3d::cWorld* m_world;
+    chai3d::cToolCursor* m_tool;
+    chai3d::cGenericHapticDevicePtr m_device;
+    MaterialLibrary* m_library;
+
+    //! Global poses of the world; only the tool moves.
+    TransformPropagator m_transforms;
+
+    //! Control loop owning the drift, or NULL.
+    ControlLoop* m_controlLoop;
+
+    //! Last drift target read from the control loop, and its rate; kept while the control loop is publishing.
+    chai3d::cVector3d m_driftTarget;
+    double m_driftStepPerTick;
+    bool m_hasDriftTarget;
+
+    //! Streamer of the tiles, or NULL.
+    TileStreamer* m_tileStreamer;
+
+    //! Haptic thread running this loop, for the quiescent states of the lock-free data.
+    unsigned int m_hapticThread;
+
+    //! Servo loop, or NULL, and the contact model the proxy fills for it every tick.
+    ServoLoop* m_servoLoop;
+    std::unique_ptr<LocalContactModel> m_contactModel;
+
+    //! Trajectory recording the device, or NULL.
+    HapticTrajectory* m_recording;
+    chai3d::cPrecisionClock m_recordingClock;
+
+    //! Monitor of the stage durations, or NULL.
+    HapticLatencyMonitor* m_latencyMonitor;
+};
+
+//------------------------------------------------------------------------------
+#endif
@@ -0,0 +1,354 @@
+//==============================================================================
+/*
+    CPSC 599.86 / 601.86 - Computer Haptics
+    Winter 2018, University of Calgary
+
+    Real-time mode of a haptic thread on Linux.
+*/
+//==============================================================================
+
+#include "HapticRealTime.h"
+#include "HapticThreads.h"
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#if defined(__linux__)
+#include <alloca.h>
+#include <malloc.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#endif
+
+using namespace std;
+
+//------------------------------------------------------------------------------
+
+namespace
+{
+    // size of a page, the unit the stack is touched in
+    const unsigned int C_PAGE_SIZE = 4096;
+
+#if defined(__linux__)
+    //! Touches a_bytes of stack below the caller, so that the ticks never fault the stack in.
+    __attribute__((noinline)) void prefaultStack(unsigned int a_bytes)
+    {
+        volatile unsigned char* stack = (volatile unsigned char*)alloca(a_bytes);
+        for (unsigned int i = 0; i < a_bytes; i += C_PAGE_SIZE)
+        {
+            stack[i] = 0;
+        }
+    }
+
+    //! Size of the locked memory of the process in kB (VmLck in /proc/self/status), or -1.
+    long readLockedKb()
+    {
+        FILE* file = fopen("/proc/self/status", "r");
+        if (file == NULL)
+        {
+            return (-1);
+        }
+
+        long lockedKb = -1;
+        char line[256];
+        while (fgets(line, sizeof(line), file) != NULL)
+        {
+            if (strncmp(line, "VmLck:", 6) == 0)
+            {
+                lockedKb = strtol(line + 6, NULL, 10);
+                break;
+            }
+        }
+
+        fclose(file);
+        return (lockedKb);
+    }
+#endif
+}
+
+
+//==============================================================================
+/*!
+    Returns the settings of the real-time mode, disabled.
+
+    \return Default settings.
+*/
+//==============================================================================
+HapticRealTimeConfig getDefaultRealTimeConfig()
+{
+    HapticRealTimeConfig config;
+    config.enabled = false;
+    config.priority = 80;
+    config.core = -1;
+    config.lockMemory = true;
+    config.stackPrefaultBytes = 256 * 1024;
+    return (config);
+}
+
+
+//==============================================================================
+/*!
+    Parses a real-time option of the command line: --sched-fifo enters the
+    mode, --rt-priority P sets the SCHED_FIFO priority, --rt-core C the core
+    of the first haptic thread, and --rt-no-mlock leaves the memory
+    unlocked. The last three imply --sched-fifo.
+
+    \param  a_argc    Number of arguments.
+    \param  a_argv    Arguments.
+    \param  a_index   Index of the option; moved past its value, if any.
+    \param  a_config  Settings to update.
+
+    \return true if the argument was a real-time option.
+*/
+//==============================================================================
+bool parseRealTimeOption(int a_argc, char* a_argv[], int& a_index, HapticRealTimeConfig& a_config)
+{
+    string option = a_argv[a_index];
+    bool hasValue = (a_index + 1 < a_argc);
+
+    if (option == "--sched-fifo")
+    {
+        a_config.enabled = true;
+    }
+    else if ((option == "--rt-priority") && hasValue)
+    {
+        a_config.enabled = true;
+        a_config.priority = atoi(a_argv[++a_index]);
+    }
+    else if ((option == "--rt-core") && hasValue)
+    {
+        a_config.enabled = true;
+        a_config.core = atoi(a_argv[++a_index]);
+    }
+    else if (option == "--rt-no-mlock")
+    {
+        a_config.enabled = true;
+        a_config.lockMemory = false;
+    }
+    else
+    {
+        return (false);
+    }
+
+    return (true);
+}
+
+
+//==============================================================================
+/*!
+    Returns the cores the kernel isolated from the scheduler with the
+    isolcpus boot parameter, read from /sys/devices/system/cpu/isolated
+    (e.g. "2-3,6").
+
+    \return Isolated cores, in increasing order.
+*/
+//==============================================================================
+vector<int> getIsolatedCores()
+{
+    vector<int> cores;
+
+#if defined(__linux__)
+    FILE* file = fopen("/sys/devices/system/cpu/isolated", "r");
+    if (file == NULL)
+    {
+        return (cores);
+    }
+
+    char line[1024];
+    if (fgets(line, sizeof(line), file) != NULL)
+    {
+        const char* p = line;
+        while ((*p >= '0') && (*p <= '9'))
+        {
+            char* end;
+            int first = (int)strtol(p, &end, 10);
+            int last = first;
+            if (*end == '-')
+            {
+                last = (int)strtol(end + 1, &end, 10);
+            }
+            for (int core = first; core <= last; ++core)
+            {
+                cores.push_back(core);
+            }
+
+            p = (*end == ',') ? (end + 1) : end;
+        }
+    }
+
+    fclose(file);
+#endif
+
+    return (cores);
+}
+
+
+//==============================================================================
+/*!
+    Switches the calling thread to the real-time mode: SCHED_FIFO at the
+    configured priority, pinned to its core, with the memory of the process
+    locked and the stack of the thread prefaulted. Each setting is then read
+    back, and the report holds what the thread actually obtained. Call from
+    the haptic thread itself, before its first tick.
+
+    The core of haptic thread i is the configured core plus i. Without one,
+    the thread takes the i-th isolated core, or the core getHapticThreadCore()
+    gives it if the kernel isolated too few.
+
+    \param  a_config  Settings of the mode.
+    \param  a_thread  Index of the calling haptic thread.
+    \param  a_report  Returned report.
+*/
+//==============================================================================
+void enterHapticRealTime(const HapticRealTimeConfig& a_config, unsigned int a_thread, HapticRealTimeReport& a_report)
+{
+    a_report.fifo = false;
+    a_report.priority = 0;
+    a_report.core = -1;
+    a_report.isolated = false;
+    a_report.memoryLocked = false;
+    a_report.lockedKb = -1;
+    a_report.stackPrefaulted = 0;
+    a_report.errors.clear();
+
+    // pick the core
+    vector<int> isolated = getIsolatedCores();
+    int core;
+    if (a_config.core >= 0)
+    {
+        core = a_config.core + (int)a_thread;
+    }
+    else if (a_thread < isolated.size())
+    {
+        core = isolated[a_thread];
+    }
+    else
+    {
+        core = getHapticThreadCore(a_thread);
+    }
+
+#if defined(__linux__)
+    // memory first: the pages faulted in from here on are locked as they come
+    if (a_config.lockMemory)
+    {
+        if (mlockall(MCL_CURRENT | MCL_FUTURE) == 0)
+        {
+#if defined(__GLIBC__)
+            // keep the heap the process frees, and serve large blocks from it rather than fresh mappings
+            mallopt(M_TRIM_THRESHOLD, -1);
+            mallopt(M_MMAP_MAX, 0);
+#endif
+        }
+        else
+        {
+            a_report.errors += string("memory lock refused (") + strerror(errno) +
+                               "): needs CAP_IPC_LOCK or a memlock limit (ulimit -l) above the size of the process\n";
+        }
+
+        a_report.lockedKb = readLockedKb();
+        a_report.memoryLocked = (a_report.lockedKb > 0);
+    }
+
+    if (a_config.stackPrefaultBytes > 0)
+    {
+        prefaultStack(a_config.stackPrefaultBytes);
+        a_report.stackPrefaulted = a_config.stackPrefaultBytes;
+    }
+
+    // then the core
+    if (core >= 0)
+    {
+        if (pinCurrentThreadToCore(core))
+        {
+            cpu_set_t cores;
+            CPU_ZERO(&cores);
+            if ((pthread_getaffinity_np(pthread_self(), sizeof(cores), &cores) == 0) &&
+                (CPU_COUNT(&cores) == 1) && CPU_ISSET(core, &cores))
+            {
+                a_report.core = core;
+            }
+        }
+        if (a_report.core < 0)
+        {
+            a_report.errors += "could not pin the thread to core " + to_string(core) + "\n";
+        }
+    }
+    else
+    {
+        a_report.errors += "no core to pin the thread to: the machine has too few cores\n";
+    }
+
+    for (size_t i = 0; i < isolated.size(); ++i)
+    {
+        if (isolated[i] == a_report.core)
+        {
+            a_report.isolated = true;
+        }
+    }
+
+    // and the priority last, once the thread no longer faults or migrates
+    sched_param param;
+    memset(&param, 0, sizeof(param));
+    param.sched_priority = a_config.priority;
+    int result = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+    if (result != 0)
+    {
+        a_report.errors += string("SCHED_FIFO refused (") + strerror(result) +
+                           "): needs CAP_SYS_NICE or an rtprio limit (ulimit -r) of at least " +
+                           to_string(a_config.priority) + "\n";
+    }
+
+    int policy = 0;
+    if (pthread_getschedparam(pthread_self(), &policy, &param) == 0)
+    {
+        a_report.fifo = (policy == SCHED_FIFO);
+        a_report.priority = param.sched_priority;
+    }
+#else
+    // only the affinity is portable
+    if (pinCurrentThreadToCore(core))
+    {
+        a_report.core = core;
+    }
+    a_report.errors += "SCHED_FIFO and memory locking are only available on Linux\n";
+#endif
+}
+
+
+//==============================================================================
+/*!
+    Formats a report of the real-time mode, one line per setting.
+
+    \param  a_report  Report to format.
+    \param  a_text    Returned text.
+*/
+//==============================================================================
+void formatHapticRealTimeReport(const HapticRealTimeReport& a_report, string& a_text)
+{
+    char line[256];
+    a_text.clear();
+
+    if (a_report.fifo)
+        snprintf(line, sizeof(line), "  scheduling: SCHED_FIFO, priority %d\n", a_report.priority);
+    else
+        snprintf(line, sizeof(line), "  scheduling: normal (not real-time)\n");
+    a_text += line;
+
+    if (a_report.core >= 0)
+        snprintf(line, sizeof(line), "  core:       %d (%s)\n", a_report.core,
+                 a_report.isolated ? "isolated" : "shared with other threads; see isolcpus");
+    else
+        snprintf(line, sizeof(line), "  core:       not pinned\n");
+    a_text += line;
+
+    if (a_report.memoryLocked)
+        snprintf(line, sizeof(line), "  memory:     locked (%ld kB), %u kB of stack prefaulted\n",
+                 a_report.lockedKb, a_report.stackPrefaulted / 1024);
+    else
+        snprintf(line, sizeof(line), "  memory:     not locked, %u kB of stack prefaulted\n", a_report.stackPrefaulted / 1024);
+    a_text += line;
+
+    a_text += a_report.errors;
+}
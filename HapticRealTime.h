@@ -0,0 +1,92 @@
+//==============================================================================
+/*
+    CPSC 599.86 / 601.86 - Computer Haptics
+    Winter 2018, University of Calgary
+
+    Real-time mode of a haptic thread on Linux. CTHREAD_PRIORITY_HAPTICS is
+    a best effort that fails silently without privileges, and a normal
+    thread is preempted by the desktop, migrated between cores and stalled
+    by page faults, which shows in the p99.9 of the tick. In real-time
+    mode the thread:
+    - runs under SCHED_FIFO, ahead of every normal thread;
+    - is pinned to one core, preferably one the kernel isolated from the
+      scheduler (isolcpus=...), so that nothing else runs there;
+    - never page-faults: the pages of the process are locked (mlockall),
+      the heap keeps the memory it frees, and the stack the thread will use
+      is touched up front.
+
+    Each setting needs a privilege (CAP_SYS_NICE or "ulimit -r" for the
+    priority, CAP_IPC_LOCK or "ulimit -l" for the memory lock). The thread
+    checks what it actually obtained and reports it; a refused setting does
+    not prevent the others.
+*/
+//==============================================================================
+
+#ifndef HAPTICREALTIME_H
+#define HAPTICREALTIME_H
+
+#include <string>
+#include <vector>
+
+//------------------------------------------------------------------------------
+
+//! Settings of the real-time mode.
+struct HapticRealTimeConfig
+{
+    //! True to enter the mode.
+    bool enabled;
+
+    //! SCHED_FIFO priority, 1 to 99.
+    int priority;
+
+    //! Core of haptic thread 0 (thread i gets core + i), or -1 to use the isolated cores, if enough are.
+    int core;
+
+    //! Locks the pages of the process in memory.
+    bool lockMemory;
+
+    //! Bytes of stack touched before the first tick.
+    unsigned int stackPrefaultBytes;
+};
+
+//! What the real-time mode achieved, as checked after entering it.
+struct HapticRealTimeReport
+{
+    //! True if the thread runs under SCHED_FIFO, at the given priority.
+    bool fifo;
+    int priority;
+
+    //! Core the thread is pinned to (-1 if none), and whether the kernel isolated it.
+    int core;
+    bool isolated;
+
+    //! True if the pages of the process are locked, and the size locked in kB (VmLck).
+    bool memoryLocked;
+    long lockedKb;
+
+    //! Bytes of stack touched.
+    unsigned int stackPrefaulted;
+
+    //! Why the settings that failed were refused, one line each.
+    std::string errors;
+};
+
+//------------------------------------------------------------------------------
+
+//! Settings of the mode, disabled: priority 80, isolated cores, memory locked, 256 kB of stack.
+HapticRealTimeConfig getDefaultRealTimeConfig();
+
+//! Parses the real-time options at argv[a_index] (--sched-fifo, --rt-priority P, --rt-core C, --rt-no-mlock); returns false if it is none of them.
+bool parseRealTimeOption(int a_argc, char* a_argv[], int& a_index, HapticRealTimeConfig& a_config);
+
+//! Cores the kernel isolated from the scheduler, empty if none or unknown.
+std::vector<int> getIsolatedCores();
+
+//! Switches the calling thread, haptic thread a_thread, to the real-time mode, then checks what it obtained.
+void enterHapticRealTime(const HapticRealTimeConfig& a_config, unsigned int a_thread, HapticRealTimeReport& a_report);
+
+//! Formats a report, one line per setting.
+void formatHapticRealTimeReport(const HapticRealTimeReport& a_report, std::string& a_text);
+
+//------------------------------------------------------------------------------
+#endif
@@ -0,0 +1,67 @@
+//==============================================================================
+/*
+    CPSC 599.86 / 601.86 - Computer Haptics
+    Winter 2018, University of Calgary
+
+    The record the haptic thread publishes once per tick for the graphics
+    loop and any other consumer (see MyProxyAlgorithm::getTelemetry()).
+    Vectors are stored as plain arrays so that the record stays trivially
+    copyable.
+*/
+//==============================================================================
+
+#ifndef HAPTICTELEMETRY_H
+#define HAPTICTELEMETRY_H
+
+#include "chai3d.h"
+#include "SeqLock.h"
+
+//------------------------------------------------------------------------------
+
+struct HapticTelemetryRecord
+{
+    //! Haptic tick that produced this record.
+    unsigned long long tick;
+
+    //! Number of surfaces constraining the proxy.
+    unsigned int numContacts;
+
+    double proxyGlobalPos[3];
+    double deviceGlobalPos[3];
+
+    //! Force sent to the device.
+    double force[3];
+
+    //! Shaded mesh normal and normal map normal at the last textured contact.
+    double surfaceNormal[3];
+    double normalMapNormal[3];
+
+    //! Height and roughness sampled at the last textured contact.
+    double height;
+    double roughness;
+
+    //! Texture coordinate and haptic mip level of this tick's contact (zero without contact).
+    double texCoord[3];
+    double mipLevel;
+};
+
+typedef SeqLock<HapticTelemetryRecord> HapticTelemetryChannel;
+
+//------------------------------------------------------------------------------
+
+//! Stores a vector into a telemetry field.
+inline void storeTelemetry(const chai3d::cVector3d& a_vector, double a_field[3])
+{
+    a_field[0] = a_vector(0);
+    a_field[1] = a_vector(1);
+    a_field[2] = a_vector(2);
+}
+
+//! Reads a vector from a telemetry field.
+inline chai3d::cVector3d loadTelemetry(const double a_field[3])
+{
+    return (chai3d::cVector3d(a_field[0], a_field[1], a_field[2]));
+}
+
+//------------------------------------------------------------------------------
+#endif
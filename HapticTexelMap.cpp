@@ -0,0 +1,523 @@
+//==============================================================================
+/*
+    CPSC 599.86 / 601.86 - Computer Haptics
+    Winter 2018, University of Calgary
+
+    This class holds the haptic maps of a material (normal, height and
+    roughness) baked into one interleaved array of float texels. The haptic
+    thread fetches every channel it needs with a single bilinear lookup
+    instead of sampling three byte images through cImage.
+*/
+//==============================================================================
+
+#include "HapticTexelMap.h"
+
+// SSE2 is part of every x64 target; AVX only when the compiler is told so
+// (/arch:AVX or -mavx). Neither is used when C_HAPTIC_TEXELS_NO_SIMD is set.
+#if !defined(C_HAPTIC_TEXELS_NO_SIMD)
+#if defined(__AVX__)
+#define C_HAPTIC_TEXELS_AVX
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#define C_HAPTIC_TEXELS_SSE2
+#include <emmintrin.h>
+#endif
+#endif
+
+using namespace chai3d;
+using namespace std;
+
+//------------------------------------------------------------------------------
+
+// Reads the colour of an image at texel (x, y) of a (w x h) grid. Images that
+// do not match the grid resolution are resampled bilinearly.
+static void fetchResampled(const cImagePtr& a_image,
+                           unsigned int a_x, unsigned int a_y,
+                           unsigned int a_w, unsigned int a_h,
+                           cColorb& a_color)
+{
+    if ((a_image->getWidth() == a_w) && (a_image->getHeight() == a_h))
+    {
+        a_image->getPixelColor(a_x, a_y, a_color);
+        return;
+    }
+
+    double sx = ((double)a_x + 0.5) * (double)a_image->getWidth() / (double)a_w - 0.5;
+    double sy = ((double)a_y + 0.5) * (double)a_image->getHeight() / (double)a_h - 0.5;
+
+    a_image->getPixelColorInterpolated(cMax(sx, 0.0), cMax(sy, 0.0), a_color);
+}
+
+
+//==============================================================================
+/*!
+    Constructor of HapticTexelMap.
+*/
+//==============================================================================
+HapticTexelMap::HapticTexelMap()
+{
+    m_texels = NULL;
+    m_width = 0;
+    m_height = 0;
+}
+
+
+//==============================================================================
+/*!
+    Bakes the normal, height and roughness maps into one interleaved texel
+    array. The channels are decoded exactly as the haptic rendering code used
+    to decode them from the byte images:
+
+        normal    = (colour - 127.5) / 127.5 per channel
+        height    = luminance / 255
+        roughness = (r + g + b) / (3 * 255)
+
+    \param  a_normalMap     Normal map image.
+    \param  a_heightMap     Height map image.
+    \param  a_roughnessMap  Roughness map image.
+
+    \return true if all three images were available.
+*/
+//==============================================================================
+bool HapticTexelMap::bake(cImagePtr a_normalMap,
+                          cImagePtr a_heightMap,
+                          cImagePtr a_roughnessMap)
+{
+    if ((a_normalMap == NULL) || (a_heightMap == NULL) || (a_roughnessMap == NULL))
+    {
+        return (false);
+    }
+
+    // bake at the resolution of the largest map so that no detail is lost
+    unsigned int w = cMax(a_normalMap->getWidth(), cMax(a_heightMap->getWidth(), a_roughnessMap->getWidth()));
+    unsigned int h = cMax(a_normalMap->getHeight(), cMax(a_heightMap->getHeight(), a_roughnessMap->getHeight()));
+
+    if ((w == 0) || (h == 0))
+    {
+        return (false);
+    }
+
+    m_storage.resize((size_t)w * (size_t)h);
+
+    for (unsigned int y = 0; y < h; ++y)
+    {
+        for (unsigned int x = 0; x < w; ++x)
+        {
+            HapticTexel& texel = m_storage[(size_t)y * w + x];
+            cColorb color;
+
+            fetchResampled(a_normalMap, x, y, w, h, color);
+            texel.normal[0] = (float)((color.getR() - 127.5) / 127.5);
+            texel.normal[1] = (float)((color.getG() - 127.5) / 127.5);
+            texel.normal[2] = (float)((color.getB() - 127.5) / 127.5);
+
+            fetchResampled(a_heightMap, x, y, w, h, color);
+            texel.height = (float)(color.getLuminance() / 255.0);
+
+            fetchResampled(a_roughnessMap, x, y, w, h, color);
+            texel.roughness = (float)((color.getR() + color.getG() + color.getB()) / (3.0 * 255.0));
+
+            texel.pad[0] = texel.pad[1] = texel.pad[2] = 0.0f;
+        }
+    }
+
+    m_texels = &m_storage[0];
+    m_width = w;
+    m_height = h;
+
+    buildPyramid();
+
+    return (true);
+}
+
+
+//==============================================================================
+/*!
+    Uses texels stored elsewhere, typically in a mapped scene pack, instead
+    of baking them. The texels are not copied; the mip levels below them
+    are built here.
+
+    \param  a_texels  Interleaved texels, row-major. Must outlive this map.
+    \param  a_width   Width of the map in texels.
+    \param  a_height  Height of the map in texels.
+*/
+//==============================================================================
+void HapticTexelMap::setView(const HapticTexel* a_texels, unsigned int a_width, unsigned int a_height)
+{
+    m_storage.clear();
+    m_texels = a_texels;
+    m_width = a_width;
+    m_height = a_height;
+
+    buildPyramid();
+}
+
+
+//==============================================================================
+/*!
+    Builds the mip levels below the full resolution. Each texel of a level
+    is the mean of the 2x2 texels of the level above, down to a single
+    texel. Along an odd side the last texel also takes in the last row or
+    column (a 3-tap box), so every texel of the level above is counted and
+    the edge of an odd-sized map is not lost. The pyramid adds a
+    third of the full resolution in memory.
+*/
+//==============================================================================
+void HapticTexelMap::buildPyramid()
+{
+    m_levels.clear();
+    m_pyramidStorage.clear();
+
+    if (m_texels == NULL)
+    {
+        return;
+    }
+
+    Level level;
+    level.texels = m_texels;
+    level.width = m_width;
+    level.height = m_height;
+    m_levels.push_back(level);
+
+    // reserve first so that the level pointers stay valid
+    unsigned int numLevels = 1;
+    for (unsigned int w = m_width, h = m_height; (w > 1) || (h > 1); ++numLevels)
+    {
+        w = cMax(w / 2, 1u);
+        h = cMax(h / 2, 1u);
+    }
+    m_pyramidStorage.reserve(numLevels - 1);
+
+    while ((level.width > 1) || (level.height > 1))
+    {
+        const Level& src = m_levels.back();
+        unsigned int w = cMax(src.width / 2, 1u);
+        unsigned int h = cMax(src.height / 2, 1u);
+
+        m_pyramidStorage.push_back(vector<HapticTexel>((size_t)w * (size_t)h));
+        vector<HapticTexel>& dst = m_pyramidStorage.back();
+
+        for (unsigned int y = 0; y < h; ++y)
+        {
+            // the last row of an odd height folds into the last texel of the column
+            unsigned int y0 = cMin(2 * y, src.height - 1);
+            unsigned int y1 = (y == h - 1) ? (src.height - 1) : (2 * y + 1);
+
+            for (unsigned int x = 0; x < w; ++x)
+            {
+                unsigned int x0 = cMin(2 * x, src.width - 1);
+                unsigned int x1 = (x == w - 1) ? (src.width - 1) : (2 * x + 1);
+
+                float sum[8] = { 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f };
+                for (unsigned int sy = y0; sy <= y1; ++sy)
+                {
+                    for (unsigned int sx = x0; sx <= x1; ++sx)
+                    {
+                        const float* t = (const float*)&src.texels[sy * src.width + sx];
+                        for (int k = 0; k < 8; ++k)
+                        {
+                            sum[k] += t[k];
+                        }
+                    }
+                }
+
+                float scale = 1.0f / (float)((y1 - y0 + 1) * (x1 - x0 + 1));
+                float* out = (float*)&dst[(size_t)y * w + x];
+                for (int k = 0; k < 8; ++k)
+                {
+                    out[k] = scale * sum[k];
+                }
+            }
+        }
+
+        level.texels = &dst[0];
+        level.width = w;
+        level.height = h;
+        m_levels.push_back(level);
+    }
+}
+
+
+//==============================================================================
+/*!
+    Finds the four texels around a texture coordinate of a level and their
+    bilinear weights. Texture coordinates outside [0, 1] wrap around,
+    matching the GL_REPEAT wrap mode the maps are rendered with.
+
+    \param  a_level    Level to sample.
+    \param  a_u        Texture coordinate along the image width.
+    \param  a_v        Texture coordinate along the image height.
+    \param  a_texels   Returned texels (x0, y0), (x1, y0), (x0, y1), (x1, y1).
+    \param  a_weights  Returned weights of the four texels.
+*/
+//==============================================================================
+void HapticTexelMap::getFootprint(const Level& a_level, double a_u, double a_v,
+                                  const HapticTexel* a_texels[4], float a_weights[4])
+{
+    double px = a_u * (double)a_level.width - 0.5;
+    double py = a_v * (double)a_level.height - 0.5;
+
+    double fx = floor(px);
+    double fy = floor(py);
+
+    float tx = (float)(px - fx);
+    float ty = (float)(py - fy);
+
+    int w = (int)a_level.width;
+    int h = (int)a_level.height;
+
+    int x0 = (int)fx % w;
+    int y0 = (int)fy % h;
+    if (x0 < 0) x0 += w;
+    if (y0 < 0) y0 += h;
+
+    int x1 = (x0 + 1 < w) ? x0 + 1 : 0;
+    int y1 = (y0 + 1 < h) ? y0 + 1 : 0;
+
+    a_texels[0] = &a_level.texels[y0 * w + x0];
+    a_texels[1] = &a_level.texels[y0 * w + x1];
+    a_texels[2] = &a_level.texels[y1 * w + x0];
+    a_texels[3] = &a_level.texels[y1 * w + x1];
+
+    a_weights[0] = (1.0f - tx) * (1.0f - ty);
+    a_weights[1] = tx * (1.0f - ty);
+    a_weights[2] = (1.0f - tx) * ty;
+    a_weights[3] = tx * ty;
+}
+
+
+//==============================================================================
+/*!
+    Blends four texels with their weights, eight floats at a time; the
+    padding is blended along and stays zero. Texels are loaded unaligned
+    since neither the baked storage nor a mapped pack guarantees 32-byte
+    alignment.
+
+    \param  a_texels   Texels to blend.
+    \param  a_weights  Weight of each texel.
+    \param  a_texel    Returned blended texel.
+*/
+//==============================================================================
+void HapticTexelMap::blend(const HapticTexel* const a_texels[4], const float a_weights[4], HapticTexel& a_texel)
+{
+#if defined(C_HAPTIC_TEXELS_AVX)
+    __m256 sum = _mm256_mul_ps(_mm256_set1_ps(a_weights[0]), _mm256_loadu_ps((const float*)a_texels[0]));
+    sum = _mm256_add_ps(sum, _mm256_mul_ps(_mm256_set1_ps(a_weights[1]), _mm256_loadu_ps((const float*)a_texels[1])));
+    sum = _mm256_add_ps(sum, _mm256_mul_ps(_mm256_set1_ps(a_weights[2]), _mm256_loadu_ps((const float*)a_texels[2])));
+    sum = _mm256_add_ps(sum, _mm256_mul_ps(_mm256_set1_ps(a_weights[3]), _mm256_loadu_ps((const float*)a_texels[3])));
+
+    _mm256_storeu_ps((float*)&a_texel, sum);
+#elif defined(C_HAPTIC_TEXELS_SSE2)
+    // normal and height in the low half, roughness and padding in the high half
+    __m128 lo = _mm_setzero_ps();
+    __m128 hi = _mm_setzero_ps();
+    for (int i = 0; i < 4; ++i)
+    {
+        const float* texel = (const float*)a_texels[i];
+        __m128 weight = _mm_set1_ps(a_weights[i]);
+        lo = _mm_add_ps(lo, _mm_mul_ps(weight, _mm_loadu_ps(texel)));
+        hi = _mm_add_ps(hi, _mm_mul_ps(weight, _mm_loadu_ps(texel + 4)));
+    }
+
+    _mm_storeu_ps((float*)&a_texel, lo);
+    _mm_storeu_ps((float*)&a_texel + 4, hi);
+#else
+    const float* t[4] = { (const float*)a_texels[0], (const float*)a_texels[1],
+                          (const float*)a_texels[2], (const float*)a_texels[3] };
+    float* out = (float*)&a_texel;
+    for (int k = 0; k < 8; ++k)
+    {
+        out[k] = a_weights[0] * t[0][k] + a_weights[1] * t[1][k] + a_weights[2] * t[2][k] + a_weights[3] * t[3][k];
+    }
+#endif
+}
+
+
+//==============================================================================
+/*!
+    Samples every channel of the full resolution map with one bilinear
+    lookup.
+
+    \param  a_u      Texture coordinate along the image width.
+    \param  a_v      Texture coordinate along the image height.
+    \param  a_texel  Returned interpolated texel.
+*/
+//==============================================================================
+void HapticTexelMap::sample(double a_u, double a_v, HapticTexel& a_texel) const
+{
+    const HapticTexel* t[4];
+    float wt[4];
+    getFootprint(m_levels[0], a_u, a_v, t, wt);
+    blend(t, wt, a_texel);
+}
+
+
+//==============================================================================
+/*!
+    Samples every channel of the map at a fractional mip level: the two
+    nearest levels are sampled bilinearly and blended by the fraction.
+
+    \param  a_u      Texture coordinate along the image width.
+    \param  a_v      Texture coordinate along the image height.
+    \param  a_level  Mip level, clamped to the pyramid (see getLevelForFootprint()).
+    \param  a_texel  Returned interpolated texel.
+*/
+//==============================================================================
+void HapticTexelMap::sample(double a_u, double a_v, float a_level, HapticTexel& a_texel) const
+{
+    int last = (int)m_levels.size() - 1;
+    float level = cClamp(a_level, 0.0f, (float)last);
+
+    int l0 = (int)level;
+    float f = level - (float)l0;
+
+    const HapticTexel* t[4];
+    float wt[4];
+    getFootprint(m_levels[l0], a_u, a_v, t, wt);
+
+    if ((f == 0.0f) || (l0 == last))
+    {
+        blend(t, wt, a_texel);
+        return;
+    }
+
+    for (int i = 0; i < 4; ++i)
+    {
+        wt[i] *= 1.0f - f;
+    }
+    HapticTexel fine;
+    blend(t, wt, fine);
+
+    getFootprint(m_levels[l0 + 1], a_u, a_v, t, wt);
+    for (int i = 0; i < 4; ++i)
+    {
+        wt[i] *= f;
+    }
+    blend(t, wt, a_texel);
+
+    float* out = (float*)&a_texel;
+    const float* in = (const float*)&fine;
+    for (int k = 0; k < 8; ++k)
+    {
+        out[k] += in[k];
+    }
+}
+
+
+//==============================================================================
+/*!
+    Returns the mip level whose texels span a given distance in texture
+    coordinates, so that a proxy crossing that distance per tick reads
+    about one texel per tick. Distances shorter than a texel of the full
+    resolution give level 0.
+
+    \param  a_footprint  Distance in texture coordinates (fraction of the map).
+
+    \return Fractional mip level in [0, getNumLevels() - 1].
+*/
+//==============================================================================
+float HapticTexelMap::getLevelForFootprint(double a_footprint) const
+{
+    double texels = a_footprint * (double)cMax(m_width, m_height);
+    if (texels <= 1.0)
+    {
+        return (0.0f);
+    }
+
+    return ((float)cMin(log2(texels), (double)(m_levels.size() - 1)));
+}
+
+
+//==============================================================================
+/*!
+    Copies the texels of a mip level around a texture coordinate into a
+    square patch, so that another thread can sample the surface near a
+    contact without touching the map. Texels past the edges of the map wrap
+    around; the patch coordinates do not, so that a coordinate extrapolated
+    from the contact without wrapping falls into the patch.
+
+    \param  a_u          Texture coordinate along the image width.
+    \param  a_v          Texture coordinate along the image height.
+    \param  a_level      Mip level, clamped to the pyramid.
+    \param  a_size       Side of the patch in texels.
+    \param  a_patch      Returned a_size x a_size texels, row-major.
+    \param  a_origin     Returned texture coordinate of the centre of texel (0, 0).
+    \param  a_texelSize  Returned size of a texel in texture coordinates.
+*/
+//==============================================================================
+void HapticTexelMap::copyPatch(double a_u, double a_v, unsigned int a_level, int a_size,
+                               HapticTexel* a_patch, double a_origin[2], double a_texelSize[2]) const
+{
+    const Level& level = m_levels[cMin(a_level, (unsigned int)m_levels.size() - 1)];
+    int w = (int)level.width;
+    int h = (int)level.height;
+
+    // texel of the contact, in the middle of the patch
+    int x0 = (int)floor(a_u * (double)w) - a_size / 2;
+    int y0 = (int)floor(a_v * (double)h) - a_size / 2;
+
+    for (int y = 0; y < a_size; ++y)
+    {
+        int sy = (y0 + y) % h;
+        if (sy < 0) sy += h;
+
+        for (int x = 0; x < a_size; ++x)
+        {
+            int sx = (x0 + x) % w;
+            if (sx < 0) sx += w;
+
+            a_patch[y * a_size + x] = level.texels[sy * w + sx];
+        }
+    }
+
+    a_texelSize[0] = 1.0 / (double)w;
+    a_texelSize[1] = 1.0 / (double)h;
+    a_origin[0] = ((double)x0 + 0.5) * a_texelSize[0];
+    a_origin[1] = ((double)y0 + 0.5) * a_texelSize[1];
+}
+
+
+//==============================================================================
+/*!
+    Samples every channel of the full resolution map with one bilinear
+    lookup, one channel at a time. This is the reference the SIMD path is
+    checked against.
+
+    \param  a_u      Texture coordinate along the image width.
+    \param  a_v      Texture coordinate along the image height.
+    \param  a_texel  Returned interpolated texel.
+*/
+//==============================================================================
+void HapticTexelMap::sampleScalar(double a_u, double a_v, HapticTexel& a_texel) const
+{
+    const HapticTexel* t[4];
+    float wt[4];
+    getFootprint(m_levels[0], a_u, a_v, t, wt);
+
+    for (int i = 0; i < 3; ++i)
+    {
+        a_texel.normal[i] = wt[0] * t[0]->normal[i] + wt[1] * t[1]->normal[i] + wt[2] * t[2]->normal[i] + wt[3] * t[3]->normal[i];
+    }
+    a_texel.height = wt[0] * t[0]->height + wt[1] * t[1]->height + wt[2] * t[2]->height + wt[3] * t[3]->height;
+    a_texel.roughness = wt[0] * t[0]->roughness + wt[1] * t[1]->roughness + wt[2] * t[2]->roughness + wt[3] * t[3]->roughness;
+    a_texel.pad[0] = a_texel.pad[1] = a_texel.pad[2] = 0.0f;
+}
+
+
+//==============================================================================
+/*!
+    Returns the instruction set sample() was compiled for.
+
+    \return "AVX", "SSE2" or "scalar".
+*/
+//==============================================================================
+const char* HapticTexelMap::getSimdPath()
+{
+#if defined(C_HAPTIC_TEXELS_AVX)
+    return ("AVX");
+#elif defined(C_HAPTIC_TEXELS_SSE2)
+    return ("SSE2");
+#else
+    return ("scalar");
+#endif
+}
@@ -0,0 +1,144 @@
+//==============================================================================
+/*
+    CPSC 599.86 / 601.86 - Computer Haptics
+    Winter 2018, University of Calgary
+
+    This class holds the haptic maps of a material (normal, height and
+    roughness) baked into one interleaved array of float texels. The haptic
+    thread fetches every channel it needs with a single bilinear lookup
+    instead of sampling three byte images through cImage.
+
+    A texel is eight floats, so the lookup blends the four texels around a
+    coordinate with one AVX register per texel (two SSE registers without
+    AVX). The scalar path is kept for other targets and as the reference.
+
+    The map also keeps a box-filtered mip pyramid on the CPU. When the
+    proxy crosses several texels per haptic tick, sampling the full
+    resolution aliases into buzz; the force kernels then sample the level
+    whose texels are about as large as the distance travelled per tick,
+    blending the two nearest levels so that the force does not step as
+    the speed changes.
+*/
+//==============================================================================
+
+#ifndef HAPTICTEXELMAP_H
+#define HAPTICTEXELMAP_H
+
+#include "chai3d.h"
+#include <vector>
+
+//------------------------------------------------------------------------------
+class HapticTexelMap;
+typedef std::shared_ptr<HapticTexelMap> HapticTexelMapPtr;
+//------------------------------------------------------------------------------
+
+//! A baked haptic texel, padded to eight floats (32 bytes) for a fixed stride.
+struct HapticTexel
+{
+    //! Normal map colour (R, G, B) decoded from [0, 255] to [-1, 1].
+    float normal[3];
+
+    //! Height map luminance in [0, 1].
+    float height;
+
+    //! Mean of the roughness map channels in [0, 1].
+    float roughness;
+
+    float pad[3];
+};
+
+// the SIMD lookup blends a texel as eight contiguous floats
+static_assert(sizeof(HapticTexel) == 8 * sizeof(float), "HapticTexel must be eight packed floats");
+
+//------------------------------------------------------------------------------
+
+class HapticTexelMap
+{
+public:
+
+    //! Constructor of HapticTexelMap.
+    HapticTexelMap();
+
+    //! Shared HapticTexelMap allocator.
+    static HapticTexelMapPtr create() { return (std::make_shared<HapticTexelMap>()); }
+
+    //! Bakes the three maps into interleaved texels at the largest map resolution.
+    bool bake(chai3d::cImagePtr a_normalMap,
+              chai3d::cImagePtr a_heightMap,
+              chai3d::cImagePtr a_roughnessMap);
+
+    //! Uses texels stored elsewhere (e.g. a mapped scene pack) without copying them.
+    void setView(const HapticTexel* a_texels, unsigned int a_width, unsigned int a_height);
+
+    //! Samples all channels bilinearly at a texture coordinate, wrapping with GL_REPEAT.
+    void sample(double a_u, double a_v, HapticTexel& a_texel) const;
+
+    //! Samples all channels trilinearly at a fractional mip level (0 is the full resolution).
+    void sample(double a_u, double a_v, float a_level, HapticTexel& a_texel) const;
+
+    //! Mip level whose texels span a distance in texture coordinates, e.g. the distance travelled in one tick.
+    float getLevelForFootprint(double a_footprint) const;
+
+    //! Copies the a_size x a_size texels of a mip level around a texture coordinate, wrapping around the edges.
+    void copyPatch(double a_u, double a_v, unsigned int a_level, int a_size,
+                   HapticTexel* a_patch, double a_origin[2], double a_texelSize[2]) const;
+
+    //! Number of mip levels, including the full resolution.
+    unsigned int getNumLevels() const { return ((unsigned int)m_levels.size()); }
+
+    //! Same lookup as sample(), one channel at a time without SIMD.
+    void sampleScalar(double a_u, double a_v, HapticTexel& a_texel) const;
+
+    //! Instruction set used by sample() in this build ("AVX", "SSE2" or "scalar").
+    static const char* getSimdPath();
+
+    //! Returns true if nothing has been baked yet.
+    bool isEmpty() const { return (m_texels == NULL); }
+
+    //! Width of the baked map in texels.
+    unsigned int getWidth() const { return (m_width); }
+
+    //! Height of the baked map in texels.
+    unsigned int getHeight() const { return (m_height); }
+
+    //! Read-only access to the interleaved texel array (row-major).
+    const HapticTexel* getTexels() const { return (m_texels); }
+
+protected:
+
+    //! One level of the mip pyramid.
+    struct Level
+    {
+        const HapticTexel* texels;
+        unsigned int width;
+        unsigned int height;
+    };
+
+    //! Builds the levels below the full resolution, down to a single texel.
+    void buildPyramid();
+
+    //! Finds the four texels around a coordinate of a level and their bilinear weights.
+    static void getFootprint(const Level& a_level, double a_u, double a_v,
+                             const HapticTexel* a_texels[4], float a_weights[4]);
+
+    //! Blends four texels with their weights.
+    static void blend(const HapticTexel* const a_texels[4], const float a_weights[4], HapticTexel& a_texel);
+
+    //! Texel storage owned by this map.
+    std::vector<HapticTexel> m_storage;
+
+    //! Texels used for sampling.
+    const HapticTexel* m_texels;
+
+    unsigned int m_width;
+    unsigned int m_height;
+
+    //! Mip levels; level 0 is m_texels.
+    std::vector<Level> m_levels;
+
+    //! Storage of the levels below the full resolution.
+    std::vector<std::vector<HapticTexel> > m_pyramidStorage;
+};
+
+//------------------------------------------------------------------------------
+#endif
@@ -0,0 +1,219 @@
+//==============================================================================
+/*
+    CPSC 599.86 / 601.86 - Computer Haptics
+    Winter 2018, University of Calgary
+
+    Haptic threads of the tools, pinned to cores of their own.
+*/
+//==============================================================================
+
+#include "HapticThreads.h"
+#include <chrono>
+
+#if defined(_WIN32)
+#include <windows.h>
+#elif defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+using namespace std;
+
+//------------------------------------------------------------------------------
+
+//==============================================================================
+/*!
+    Returns the number of cores the threads may run on.
+
+    \return Number of cores, at least 1.
+*/
+//==============================================================================
+unsigned int getNumCores()
+{
+    unsigned int numCores = thread::hardware_concurrency();
+    return ((numCores > 0) ? numCores : 1);
+}
+
+
+//==============================================================================
+/*!
+    Returns the dedicated core of a haptic thread: core 0 is left to the
+    rendering thread and the system, and haptic thread i gets core i + 1.
+
+    \param  a_thread  Index of the haptic thread.
+
+    \return Core, or -1 if the machine has too few cores to dedicate one.
+*/
+//==============================================================================
+int getHapticThreadCore(unsigned int a_thread)
+{
+    unsigned int core = a_thread + 1;
+    return ((core < getNumCores()) ? (int)core : -1);
+}
+
+
+//==============================================================================
+/*!
+    Pins the calling thread to a core.
+
+    \param  a_core  Core to run on.
+
+    \return true if the thread is now pinned.
+*/
+//==============================================================================
+bool pinCurrentThreadToCore(int a_core)
+{
+    if (a_core < 0)
+    {
+        return (false);
+    }
+
+#if defined(_WIN32)
+    if (a_core >= (int)(8 * sizeof(DWORD_PTR)))
+    {
+        return (false);
+    }
+    return (SetThreadAffinityMask(GetCurrentThread(), (DWORD_PTR)1 << a_core) != 0);
+#elif defined(__linux__)
+    cpu_set_t cores;
+    CPU_ZERO(&cores);
+    CPU_SET(a_core, &cores);
+    return (pthread_setaffinity_np(pthread_self(), sizeof(cores), &cores) == 0);
+#else
+    return (false);
+#endif
+}
+
+
+//==============================================================================
+/*!
+    Constructor of HapticToolThread.
+
+    \param  a_loop  Loop of the tool.
+*/
+//==============================================================================
+HapticToolThread::HapticToolThread(HapticLoop* a_loop) :
+    m_loop(a_loop),
+    m_running(false),
+    m_numTicks(0),
+    m_core(-1),
+    m_runTime(0.0),
+    m_realTime(getDefaultRealTimeConfig()),
+    m_hapticThread(0)
+{
+    m_realTimeReport.fifo = false;
+    m_realTimeReport.priority = 0;
+    m_realTimeReport.core = -1;
+    m_realTimeReport.isolated = false;
+    m_realTimeReport.memoryLocked = false;
+    m_realTimeReport.lockedKb = -1;
+    m_realTimeReport.stackPrefaulted = 0;
+}
+
+
+//==============================================================================
+/*!
+    Destructor of HapticToolThread.
+*/
+//==============================================================================
+HapticToolThread::~HapticToolThread()
+{
+    stop();
+}
+
+
+//==============================================================================
+/*!
+    Starts the thread. It ticks the loop back to back, like the haptics
+    thread of the application, until it is stopped or isFinished().
+
+    \param  a_core  Core to pin the thread to, or -1.
+*/
+//==============================================================================
+void HapticToolThread::start(int a_core)
+{
+    if (m_running.exchange(true))
+    {
+        return;
+    }
+
+    // a thread that finished by itself is still to be joined
+    join();
+    m_numTicks.store(0);
+    m_thread = thread(&HapticToolThread::run, this, a_core);
+}
+
+
+//==============================================================================
+/*!
+    Runs the thread in real-time mode (see HapticRealTime.h) from the next
+    start(): it then takes the core of haptic thread a_thread rather than
+    the one given to start().
+
+    \param  a_config  Settings of the mode; ignored unless enabled.
+    \param  a_thread  Index of the haptic thread.
+*/
+//==============================================================================
+void HapticToolThread::setRealTime(const HapticRealTimeConfig& a_config, unsigned int a_thread)
+{
+    m_realTime = a_config;
+    m_hapticThread = a_thread;
+}
+
+
+//==============================================================================
+/*!
+    Stops the thread.
+*/
+//==============================================================================
+void HapticToolThread::stop()
+{
+    m_running.store(false);
+    join();
+}
+
+
+//==============================================================================
+/*!
+    Waits until the thread has ended.
+*/
+//==============================================================================
+void HapticToolThread::join()
+{
+    if (m_thread.joinable())
+    {
+        m_thread.join();
+    }
+}
+
+
+//==============================================================================
+/*!
+    Body of the thread.
+
+    \param  a_core  Core to pin the thread to, or -1.
+*/
+//==============================================================================
+void HapticToolThread::run(int a_core)
+{
+    if (m_realTime.enabled)
+    {
+        enterHapticRealTime(m_realTime, m_hapticThread, m_realTimeReport);
+        m_core.store(m_realTimeReport.core);
+    }
+    else if (pinCurrentThreadToCore(a_core))
+    {
+        m_core.store(a_core);
+    }
+
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+
+    while (m_running.load() && !isFinished())
+    {
+        m_loop->tick();
+        m_numTicks.fetch_add(1, memory_order_relaxed);
+    }
+
+    m_runTime = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    m_running.store(false);
+}
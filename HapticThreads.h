@@ -0,0 +1,96 @@
+//==============================================================================
+/*
+    CPSC 599.86 / 601.86 - Computer Haptics
+    Winter 2018, University of Calgary
+
+    Haptic threads of the tools. Each tool has its own HapticLoop, its own
+    proxy algorithm and its own thread, pinned to a core of its own, so
+    that the tools neither share a core nor migrate between cores. All of
+    them query the same world, which they only read: the trays, their
+    collision trees and kernels are built, indexed and posed before the
+    threads start, and each loop writes the poses of its own tool only
+    (HapticLoop::setSharedWorld()). No lock is taken on the tick path.
+
+    Core 0 is left to the rendering thread and the system; haptic thread i
+    gets core i + 1, when the machine has that many.
+*/
+//==============================================================================
+
+#ifndef HAPTICTHREADS_H
+#define HAPTICTHREADS_H
+
+#include "HapticLoop.h"
+#include "HapticRealTime.h"
+#include <atomic>
+#include <thread>
+
+//------------------------------------------------------------------------------
+
+//! Number of cores the threads may run on.
+unsigned int getNumCores();
+
+//! Dedicated core of haptic thread a_thread, or -1 if the machine has too few cores.
+int getHapticThreadCore(unsigned int a_thread);
+
+//! Pins the calling thread to a core. Returns false if the platform or the system refused.
+bool pinCurrentThreadToCore(int a_core);
+
+//------------------------------------------------------------------------------
+
+class HapticToolThread
+{
+public:
+
+    //! Constructor of HapticToolThread. a_loop is only ticked by this thread once started.
+    HapticToolThread(HapticLoop* a_loop);
+
+    //! Destructor of HapticToolThread. Stops the thread.
+    virtual ~HapticToolThread();
+
+    //! Starts ticking the loop as fast as it runs, pinned to a_core (unpinned if negative).
+    void start(int a_core);
+
+    //! Runs the thread, haptic thread a_thread, in real-time mode from the next start(); a_core is then ignored.
+    void setRealTime(const HapticRealTimeConfig& a_config, unsigned int a_thread);
+
+    //! What the real-time mode achieved, once the thread has stopped.
+    const HapticRealTimeReport& getRealTimeReport() const { return (m_realTimeReport); }
+
+    //! Stops the thread.
+    void stop();
+
+    //! Waits until the loop is finished (see isFinished()); the thread must not be stopped meanwhile.
+    void join();
+
+    //! Number of ticks run so far.
+    unsigned long long getNumTicks() const { return (m_numTicks.load(std::memory_order_relaxed)); }
+
+    //! Seconds from the first tick to the last, once the thread has stopped.
+    double getRunTime() const { return (m_runTime); }
+
+    //! Core the thread is pinned to, or -1.
+    int getCore() const { return (m_core.load()); }
+
+protected:
+
+    //! True once the thread should stop by itself (never, by default).
+    virtual bool isFinished() { return (false); }
+
+    //! Body of the thread.
+    void run(int a_core);
+
+    HapticLoop* m_loop;
+
+    std::thread m_thread;
+    std::atomic<bool> m_running;
+    std::atomic<unsigned long long> m_numTicks;
+    std::atomic<int> m_core;
+    double m_runTime;
+
+    HapticRealTimeConfig m_realTime;
+    unsigned int m_hapticThread;
+    HapticRealTimeReport m_realTimeReport;
+};
+
+//------------------------------------------------------------------------------
+#endif
@@ -0,0 +1,219 @@
+//==============================================================================
+/*
+    CPSC 599.86 / 601.86 - Computer Haptics
+    Winter 2018, University of Calgary
+
+    A trajectory of the haptic device: timed positions and orientations,
+    recorded or scripted, and played back by VirtualHapticDevice.
+*/
+//==============================================================================
+
+#include "HapticTrajectory.h"
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+
+using namespace chai3d;
+using namespace std;
+
+//------------------------------------------------------------------------------
+
+namespace
+{
+    bool isEarlier(double a_time, const HapticTrajectorySample& a_sample)
+    {
+        return (a_time < a_sample.time);
+    }
+}
+
+
+//==============================================================================
+/*!
+    Appends a sample.
+
+    \param  a_time      Time of the sample in seconds.
+    \param  a_position  Position of the device.
+    \param  a_rotation  Orientation of the device.
+*/
+//==============================================================================
+void HapticTrajectory::addSample(double a_time, const cVector3d& a_position, const cMatrix3d& a_rotation)
+{
+    HapticTrajectorySample sample;
+    sample.time = a_time;
+    sample.position = a_position;
+    sample.rotation = a_rotation;
+    m_samples.push_back(sample);
+}
+
+
+//==============================================================================
+/*!
+    Appends a straight move from the last sample to a position, keeping the
+    orientation. The first move of an empty trajectory starts at time 0.
+
+    \param  a_position  Position at the end of the move.
+    \param  a_duration  Duration of the move in seconds.
+*/
+//==============================================================================
+void HapticTrajectory::moveTo(const cVector3d& a_position, double a_duration)
+{
+    if (m_samples.empty())
+    {
+        addSample(0.0, a_position, cIdentity3d());
+        return;
+    }
+
+    cMatrix3d rotation = m_samples.back().rotation;
+    addSample(m_samples.back().time + a_duration, a_position, rotation);
+}
+
+
+//==============================================================================
+/*!
+    Returns the pose of the device at a time. The position is interpolated
+    linearly between the samples around the time; the orientation is the
+    one of the earlier sample. Before the first and after the last sample
+    the pose of that sample is returned.
+
+    \param  a_time      Time in seconds.
+    \param  a_position  Returned position.
+    \param  a_rotation  Returned orientation.
+*/
+//==============================================================================
+void HapticTrajectory::getSample(double a_time, cVector3d& a_position, cMatrix3d& a_rotation) const
+{
+    if (m_samples.empty())
+    {
+        a_position.zero();
+        a_rotation.identity();
+        return;
+    }
+
+    // first sample later than the time
+    vector<HapticTrajectorySample>::const_iterator next = upper_bound(m_samples.begin(), m_samples.end(), a_time, isEarlier);
+
+    if (next == m_samples.begin())
+    {
+        a_position = next->position;
+        a_rotation = next->rotation;
+        return;
+    }
+
+    const HapticTrajectorySample& previous = *(next - 1);
+    a_rotation = previous.rotation;
+
+    if (next == m_samples.end())
+    {
+        a_position = previous.position;
+        return;
+    }
+
+    double t = (a_time - previous.time) / (next->time - previous.time);
+    a_position = previous.position + (next->position - previous.position) * t;
+}
+
+
+//==============================================================================
+/*!
+    Loads a trajectory file, replacing the samples.
+
+    \param  a_filename  Trajectory file.
+
+    \return true if the file was read and is valid.
+*/
+//==============================================================================
+bool HapticTrajectory::load(const string& a_filename)
+{
+    ifstream file(a_filename.c_str());
+    if (!file)
+    {
+        return (false);
+    }
+
+    vector<HapticTrajectorySample> samples;
+    string line;
+    int lineNumber = 0;
+
+    while (getline(file, line))
+    {
+        lineNumber++;
+
+        size_t comment = line.find('#');
+        if (comment != string::npos)
+        {
+            line.erase(comment);
+        }
+
+        istringstream fields(line);
+        vector<double> values;
+        double value;
+        while (fields >> value)
+        {
+            values.push_back(value);
+        }
+
+        if (values.empty() && fields.eof())
+        {
+            continue;
+        }
+
+        bool valid = fields.eof() && ((values.size() == 4) || (values.size() == 13)) &&
+                     (samples.empty() || (values[0] >= samples.back().time));
+        if (!valid)
+        {
+            printf("%s:%d: expected an increasing time, a position and an optional rotation matrix\n", a_filename.c_str(), lineNumber);
+            return (false);
+        }
+
+        HapticTrajectorySample sample;
+        sample.time = values[0];
+        sample.position.set(values[1], values[2], values[3]);
+        sample.rotation.identity();
+        if (values.size() == 13)
+        {
+            for (int i = 0; i < 3; i++)
+            {
+                for (int j = 0; j < 3; j++)
+                {
+                    sample.rotation(i, j) = values[4 + 3 * i + j];
+                }
+            }
+        }
+        samples.push_back(sample);
+    }
+
+    m_samples.swap(samples);
+    return (true);
+}
+
+
+//==============================================================================
+/*!
+    Writes a trajectory file.
+
+    \param  a_filename  Trajectory file.
+
+    \return true if the file was written.
+*/
+//==============================================================================
+bool HapticTrajectory::save(const string& a_filename) const
+{
+    FILE* file = fopen(a_filename.c_str(), "w");
+    if (file == NULL)
+    {
+        return (false);
+    }
+
+    fprintf(file, "# time x y z r00 r01 r02 r10 r11 r12 r20 r21 r22\n");
+    for (unsigned int i = 0; i < m_samples.size(); i++)
+    {
+        const HapticTrajectorySample& sample = m_samples[i];
+        const cMatrix3d& r = sample.rotation;
+        fprintf(file, "%.6f %.9f %.9f %.9f %.9f %.9f %.9f %.9f %.9f %.9f %.9f %.9f %.9f\n",
+                sample.time, sample.position.x(), sample.position.y(), sample.position.z(),
+                r(0, 0), r(0, 1), r(0, 2), r(1, 0), r(1, 1), r(1, 2), r(2, 0), r(2, 1), r(2, 2));
+    }
+
+    return (fclose(file) == 0);
+}
@@ -0,0 +1,74 @@
+//==============================================================================
+/*
+    CPSC 599.86 / 601.86 - Computer Haptics
+    Winter 2018, University of Calgary
+
+    A trajectory of the haptic device: timed positions and orientations,
+    recorded from a real device by the application or scripted, and played
+    back by VirtualHapticDevice.
+
+    Trajectory file format, one sample per line ('#' starts a comment):
+
+        time  x  y  z  [r00 r01 r02  r10 r11 r12  r20 r21 r22]
+
+    Times are in seconds and increasing, positions in meters. The rotation
+    matrix is optional and defaults to the identity.
+*/
+//==============================================================================
+
+#ifndef HAPTICTRAJECTORY_H
+#define HAPTICTRAJECTORY_H
+
+#include "chai3d.h"
+#include <string>
+#include <vector>
+
+//------------------------------------------------------------------------------
+
+struct HapticTrajectorySample
+{
+    double time;
+    chai3d::cVector3d position;
+    chai3d::cMatrix3d rotation;
+};
+
+//------------------------------------------------------------------------------
+
+class HapticTrajectory
+{
+public:
+
+    //! Removes all samples.
+    void clear() { m_samples.clear(); }
+
+    //! Reserves room for a number of samples, so that recording does not allocate.
+    void reserve(unsigned int a_numSamples) { m_samples.reserve(a_numSamples); }
+
+    //! Appends a sample. Its time must not be earlier than the last sample.
+    void addSample(double a_time, const chai3d::cVector3d& a_position, const chai3d::cMatrix3d& a_rotation);
+
+    //! Appends a straight move from the last sample to a position, taking a_duration seconds.
+    void moveTo(const chai3d::cVector3d& a_position, double a_duration);
+
+    //! Position (interpolated) and orientation (of the earlier sample) at a time.
+    void getSample(double a_time, chai3d::cVector3d& a_position, chai3d::cMatrix3d& a_rotation) const;
+
+    //! Time of the last sample.
+    double getDuration() const { return (m_samples.empty() ? 0.0 : m_samples.back().time); }
+
+    //! Number of samples.
+    unsigned int getNumSamples() const { return ((unsigned int)m_samples.size()); }
+
+    //! Loads a trajectory file. Returns false if it cannot be read or is invalid.
+    bool load(const std::string& a_filename);
+
+    //! Writes a trajectory file.
+    bool save(const std::string& a_filename) const;
+
+protected:
+
+    std::vector<HapticTrajectorySample> m_samples;
+};
+
+//------------------------------------------------------------------------------
+#endif
@@ -0,0 +1,181 @@
+//==============================================================================
+/*
+    CPSC 599.86 / 601.86 - Computer Haptics
+    Winter 2018, University of Calgary
+
+    Material kernels implement the texture-specific part of the haptic
+    rendering: a force kernel that perturbs the contact force (called from
+    MyProxyAlgorithm::updateForce()) and a friction kernel that modulates the
+    friction coefficients (called from testFrictionAndMoveProxy()).
+*/
+//==============================================================================
+
+#include "MaterialKernels.h"
+#include "HapticDiagnostics.h"
+
+using namespace chai3d;
+
+//------------------------------------------------------------------------------
+
+// kernels that a material type does not provide
+const FrictionKernelFunction MaterialKernelImpl<MATERIAL_KERNEL_PROCEDURAL_BUMPS>::friction = NULL;
+const ForceKernelFunction MaterialKernelImpl<MATERIAL_KERNEL_PROCEDURAL_FRICTION>::force = NULL;
+
+
+//==============================================================================
+/*!
+    Force shading and haptic texture from the normal and height maps (Ho et
+    al. 1999). The normal map normal is blended with the mesh surface normal
+    according to the penetration depth and the height at the contact.
+*/
+//==============================================================================
+void MaterialKernelImpl<MATERIAL_KERNEL_MAPPED>::force(const MaterialKernel& a_kernel, ForceKernelState& a_state)
+{
+	const MaterialParams& params = *a_kernel.params->load(std::memory_order_acquire);
+	cVector3d meshSurfaceNormal, normalMapNormal, perturbedNormal;
+	double penetrationDepth, height;
+
+	// The contact context holds the normal, height and roughness, sampled once this tick at
+	// the mip level of the stroke speed.
+	const ContactContext& contact = *a_state.contact;
+	const HapticTexel& texel = contact.texel;
+
+	meshSurfaceNormal = a_state.meshSurfaceNormal;
+
+	// The baked normal is relative to the implicit (127.5, 127.5, 127.5) normal origin and
+	// expressed in tangent space (R along the tangent, G against the bitangent, B along the
+	// normal). The cached frame of the contact triangle brings it into the mesh frame, and
+	// the object's rotation brings it into the world.
+	normalMapNormal = contact.object->getGlobalRot() * contact.tangentFrame->normalMapToMesh(texel.normal);
+	normalMapNormal.normalize();
+
+	// Get the height at the collision point and use to scale the penetration depth.
+	penetrationDepth = (a_state.proxyGlobalPos - a_state.deviceGlobalPos).length();
+
+	height = texel.height;
+
+	penetrationDepth += height;
+	penetrationDepth += (1.0 - params.smoothnessConstant);
+
+	// Calculate the blending factors to blend the normal map normal with the surface normal.
+	double perturbedNormalFactor = params.smoothnessConstant * height;
+
+	a_state.surfaceNormal = meshSurfaceNormal;
+	a_state.normalMapNormal = normalMapNormal;
+	a_state.height = height;
+	a_state.roughness = texel.roughness;
+
+	double forceMagnitude = a_state.force.length();
+	perturbedNormal = normalMapNormal;
+
+	// If penetration depth is large, blend normal map normal with surface normal to avoid force
+	// direction discontinuitues.
+	if (penetrationDepth > perturbedNormalFactor)
+	{
+		a_state.force =
+			(penetrationDepth - perturbedNormalFactor)*meshSurfaceNormal +
+			perturbedNormalFactor * perturbedNormal;
+	}
+	else
+	{
+		a_state.force = perturbedNormalFactor * perturbedNormal;
+	}
+
+	a_state.force = cVector3d(a_state.force.x(), a_state.force.y(), a_state.force.z() + (height * (1.5 - params.smoothnessConstant)));
+
+	// If friction is on, use the previously saved tangential force to alter the global force.
+	if (a_state.frictionOn)
+		a_state.force += (a_state.tangentialForce * 0.25);
+
+	a_state.force.normalize();
+	a_state.force *= forceMagnitude;
+}
+
+
+//==============================================================================
+/*!
+    Friction mapping: the roughness map scales the maximum friction of the
+    material.
+*/
+//==============================================================================
+void MaterialKernelImpl<MATERIAL_KERNEL_MAPPED>::friction(const MaterialKernel& a_kernel, FrictionKernelState& a_state)
+{
+	const MaterialParams& params = *a_kernel.params->load(std::memory_order_acquire);
+
+	// Get the roughness value sampled into the contact context.
+	double roughness = a_state.contact->texel.roughness;
+
+	roughness *= 0.25;
+
+	// Modulate friction using material properties and roughness map values.
+	if (a_state.frictionOn)
+	{
+		a_state.staticFriction = params.maxStaticFriction * roughness * params.frictionFactor;
+		a_state.dynamicFriction = params.maxDynamicFriction * roughness * params.frictionFactor;
+	}
+	else
+	{
+		a_state.staticFriction = 0.0;
+		a_state.dynamicFriction = 0.0;
+	}
+}
+
+
+//==============================================================================
+/*!
+    Procedural bumps: the force is tilted along y while passing over the white
+    bands of the texture, and scaled by the height read from the albedo (see
+    bumpTiltProfile() and bumpBandProfile()).
+*/
+//==============================================================================
+void MaterialKernelImpl<MATERIAL_KERNEL_PROCEDURAL_BUMPS>::force(const MaterialKernel& a_kernel, ForceKernelState& a_state)
+{
+	double pixelX, pixelY;
+	cColorb pixelColor;
+
+	a_kernel.albedo->getPixelLocationInterpolated(a_state.contact->texCoord, pixelX, pixelY, true);
+	a_kernel.albedo->getPixelColorInterpolated(pixelX, pixelY, pixelColor);
+
+	double g, b;
+	g = (double)pixelColor.getG();
+	b = (double)pixelColor.getB();
+
+	// Height used to scale force when passing over bumps.
+	double height = (g + b) / (255.0*2.0);
+
+
+	// The tilt across the bumps and the bands are baked periodic profiles; the lookups wrap
+	// the texture coordinate themselves.
+	const ProceduralTextures& textures = *a_kernel.procedural;
+	double distance = a_state.contact->texCoord.x();
+	double yVariant = textures.bumpTilt.evaluate(distance);
+
+	// Save the magnitude of force, and use height to increase it over the white bands.
+	double magnitudeOfForce = a_state.force.length();
+	magnitudeOfForce += height*2.0*textures.bumpBands.evaluate(distance);
+
+	// Add to the y component of the global force to simulate bumps
+	a_state.force += cVector3d(0.0, yVariant*magnitudeOfForce*0.25, 0.0);
+	a_state.force.normalize();
+	a_state.force = a_state.force * magnitudeOfForce;
+}
+
+
+//==============================================================================
+/*!
+    Procedural friction: friction rises sharply over the rocky bands of the
+    texture and drops to zero between them (see stickSlipProfile()).
+*/
+//==============================================================================
+void MaterialKernelImpl<MATERIAL_KERNEL_PROCEDURAL_FRICTION>::friction(const MaterialKernel& a_kernel, FrictionKernelState& a_state)
+{
+	const MaterialParams& params = *a_kernel.params->load(std::memory_order_acquire);
+
+	// Friction over the rocky strips is a baked periodic profile along v.
+	double frictionMultiplier = a_kernel.procedural->stickSlip.evaluate(a_state.contact->texCoord.y());
+	HAPTIC_DIAG_TRACE("Friction Multiplier", frictionMultiplier);
+
+	// Use friction variant to modulate fricton.
+	a_state.staticFriction = params.baseStaticFriction * frictionMultiplier;
+	a_state.dynamicFriction = params.baseDynamicFriction * frictionMultiplier;
+}
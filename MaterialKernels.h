@@ -0,0 +1,218 @@
+//==============================================================================
+/*
+    CPSC 599.86 / 601.86 - Computer Haptics
+    Winter 2018, University of Calgary
+
+    Material kernels implement the texture-specific part of the haptic
+    rendering: a force kernel that perturbs the contact force (called from
+    MyProxyAlgorithm::updateForce()) and a friction kernel that modulates the
+    friction coefficients (called from testFrictionAndMoveProxy()).
+
+    A kernel is resolved once, when the material is attached to its mesh, and
+    stored on the mesh (m_userData) as a plain MaterialKernel. The haptic tick
+    then calls it directly, without RTTI, reference counting or branching on
+    the material type. Material parameters are read through an atomic slot,
+    so they can be replaced while the haptic thread runs (see
+    MaterialLibrary). A new texture type only needs a new MaterialKernelType
+    and a specialisation of MaterialKernelImpl.
+*/
+//==============================================================================
+
+#ifndef MATERIALKERNELS_H
+#define MATERIALKERNELS_H
+
+#include "chai3d.h"
+#include "HapticTexelMap.h"
+#include "TangentFrames.h"
+#include "ProceduralTextures.h"
+#include <atomic>
+
+//------------------------------------------------------------------------------
+
+//! Kinds of material kernels.
+enum MaterialKernelType
+{
+    //! Normal, height and roughness maps (force shading and friction mapping).
+    MATERIAL_KERNEL_MAPPED,
+
+    //! Procedural bumps across the texture width.
+    MATERIAL_KERNEL_PROCEDURAL_BUMPS,
+
+    //! Procedural friction bands across the texture height.
+    MATERIAL_KERNEL_PROCEDURAL_FRICTION
+};
+
+//------------------------------------------------------------------------------
+
+//! Material parameters read by the kernels on every haptic tick.
+struct MaterialParams
+{
+    double smoothnessConstant;
+    double frictionFactor;
+
+    double baseStaticFriction;
+    double baseDynamicFriction;
+
+    double maxStaticFriction;
+    double maxDynamicFriction;
+};
+
+//! Current parameters of a material. A block is immutable once published; edits swap the pointer.
+typedef std::atomic<const MaterialParams*> MaterialParamsSlot;
+
+//------------------------------------------------------------------------------
+
+struct MaterialKernel;
+
+//! Contact of the current haptic tick, built once after collision detection and shared by the friction and force stages.
+struct ContactContext
+{
+    // true once built for the current tick
+    bool valid;
+
+    // object and triangle of the nearest contact, and the kernel bound to the object (NULL for none)
+    const chai3d::cGenericObject* object;
+    unsigned int triangleIndex;
+    const MaterialKernel* kernel;
+
+    // contact texture coordinate, wrapped to [0, 1]
+    chai3d::cVector3d texCoord;
+
+    // distance the contact travels in texture coordinates per tick (low-pass filtered), and the mip level it selects
+    double texCoordFootprint;
+    float mipLevel;
+
+    // tangent frame of the contact triangle and the haptic channels at the contact (kernels that use the texels only)
+    const TangentFrame* tangentFrame;
+    HapticTexel texel;
+
+    // friction coefficients of the contact, set by the friction stage; the surface's material is never written
+    double staticFriction;
+    double dynamicFriction;
+};
+
+//! Inputs and outputs of a force kernel.
+struct ForceKernelState
+{
+    // contact of this tick
+    const ContactContext* contact;
+
+    // shaded (interpolated) surface normal at the contact, in world coordinates
+    chai3d::cVector3d meshSurfaceNormal;
+
+    chai3d::cVector3d proxyGlobalPos;
+    chai3d::cVector3d deviceGlobalPos;
+    chai3d::cVector3d tangentialForce;
+    bool frictionOn;
+
+    // force to render; holds the base force on input
+    chai3d::cVector3d force;
+
+    // debug outputs
+    chai3d::cVector3d surfaceNormal;
+    chai3d::cVector3d normalMapNormal;
+    double height;
+    double roughness;
+};
+
+//! Inputs and outputs of a friction kernel.
+struct FrictionKernelState
+{
+    // contact of this tick
+    const ContactContext* contact;
+    bool frictionOn;
+
+    // friction coefficients to apply to the contact surface
+    double staticFriction;
+    double dynamicFriction;
+};
+
+//------------------------------------------------------------------------------
+
+typedef void (*ForceKernelFunction)(const MaterialKernel& a_kernel, ForceKernelState& a_state);
+typedef void (*FrictionKernelFunction)(const MaterialKernel& a_kernel, FrictionKernelState& a_state);
+
+//! A material kernel, resolved at load time and called directly by the haptic thread.
+struct MaterialKernel
+{
+    //! Force kernel, or NULL to render the base force unchanged.
+    ForceKernelFunction force;
+
+    //! Friction kernel, or NULL to leave the surface friction unchanged.
+    FrictionKernelFunction friction;
+
+    //! Parameters, loaded once per kernel call.
+    const MaterialParamsSlot* params;
+
+    //! True if the kernels read the haptic texels, which are then sampled into the contact context.
+    bool usesTexels;
+
+    //! Data of the owning material. The material outlives the kernel.
+    const HapticTexelMap* texels;
+    const TangentFrames* tangentFrames;
+    const chai3d::cImage* albedo;
+
+    //! Baked profiles of the procedural textures, shared by all materials.
+    const ProceduralTextures* procedural;
+};
+
+//------------------------------------------------------------------------------
+
+//! Force and friction kernels of one material type (specialised per type).
+template <MaterialKernelType TYPE>
+struct MaterialKernelImpl;
+
+template <>
+struct MaterialKernelImpl<MATERIAL_KERNEL_MAPPED>
+{
+    static void force(const MaterialKernel& a_kernel, ForceKernelState& a_state);
+    static void friction(const MaterialKernel& a_kernel, FrictionKernelState& a_state);
+    static const bool usesTexels = true;
+};
+
+template <>
+struct MaterialKernelImpl<MATERIAL_KERNEL_PROCEDURAL_BUMPS>
+{
+    static void force(const MaterialKernel& a_kernel, ForceKernelState& a_state);
+    static const FrictionKernelFunction friction;
+    static const bool usesTexels = false;
+};
+
+template <>
+struct MaterialKernelImpl<MATERIAL_KERNEL_PROCEDURAL_FRICTION>
+{
+    static const ForceKernelFunction force;
+    static void friction(const MaterialKernel& a_kernel, FrictionKernelState& a_state);
+    static const bool usesTexels = false;
+};
+
+//------------------------------------------------------------------------------
+
+//! Builds the kernel of material type TYPE.
+template <MaterialKernelType TYPE>
+MaterialKernel makeMaterialKernel(const MaterialParamsSlot* a_params,
+                                  const HapticTexelMap* a_texels,
+                                  const TangentFrames* a_tangentFrames,
+                                  const chai3d::cImage* a_albedo,
+                                  const ProceduralTextures* a_procedural)
+{
+    MaterialKernel kernel;
+    kernel.force = MaterialKernelImpl<TYPE>::force;
+    kernel.friction = MaterialKernelImpl<TYPE>::friction;
+    kernel.params = a_params;
+    kernel.usesTexels = MaterialKernelImpl<TYPE>::usesTexels;
+    kernel.texels = a_texels;
+    kernel.tangentFrames = a_tangentFrames;
+    kernel.albedo = a_albedo;
+    kernel.procedural = a_procedural;
+    return (kernel);
+}
+
+//! Returns the kernel stored on an object, or NULL if it has none.
+inline const MaterialKernel* getMaterialKernel(const chai3d::cGenericObject* a_object)
+{
+    return (static_cast<const MaterialKernel*>(a_object->m_userData));
+}
+
+//------------------------------------------------------------------------------
+#endif
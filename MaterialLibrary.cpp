@@ -0,0 +1,341 @@
+//==============================================================================
+/*
+    CPSC 599.86 / 601.86 - Computer Haptics
+    Winter 2018, University of Calgary
+
+    This class holds the parameters of every named material of the scene,
+    loaded from a config file and reloaded whenever the file changes.
+
+    Config file format, one material per line ('#' starts a comment):
+
+        name  smoothness  friction-factor  base-static  base-dynamic  max-static  max-dynamic
+*/
+//==============================================================================
+
+#include "MaterialLibrary.h"
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <sys/stat.h>
+
+using namespace std;
+
+//------------------------------------------------------------------------------
+
+namespace
+{
+    // Reads the modification time and size of a file; returns false if it does not exist.
+    bool getFileVersion(const string& a_filename, time_t& a_modified, long long& a_size)
+    {
+        struct stat status;
+        if (stat(a_filename.c_str(), &status) != 0)
+        {
+            return (false);
+        }
+        a_modified = status.st_mtime;
+        a_size = (long long)status.st_size;
+        return (true);
+    }
+}
+
+
+//==============================================================================
+/*!
+    Constructor of MaterialLibrary.
+*/
+//==============================================================================
+MaterialLibrary::MaterialLibrary() : m_watching(false)
+{
+}
+
+
+//==============================================================================
+/*!
+    Destructor of MaterialLibrary. Stops the watching thread and frees every
+    parameter block.
+*/
+//==============================================================================
+MaterialLibrary::~MaterialLibrary()
+{
+    stopWatching();
+
+    for (unsigned int i = 0; i < m_retired.size(); i++)
+    {
+        delete m_retired[i].params;
+    }
+    for (unsigned int i = 0; i < m_slots.size(); i++)
+    {
+        delete m_slots[i]->params.load();
+        delete m_slots[i];
+    }
+}
+
+
+//==============================================================================
+/*!
+    Returns the parameters used for a material that the config file does not
+    mention.
+
+    \return Default parameters.
+*/
+//==============================================================================
+MaterialParams MaterialLibrary::getDefaultParams()
+{
+    MaterialParams params;
+    params.smoothnessConstant = 0.5;
+    params.frictionFactor = 1.0;
+    params.baseStaticFriction = 0.3;
+    params.baseDynamicFriction = 0.1;
+    params.maxStaticFriction = 2.0;
+    params.maxDynamicFriction = 1.7;
+    return (params);
+}
+
+
+//==============================================================================
+/*!
+    Returns the parameter slot of a material. The slot lives as long as the
+    library; its contents change whenever the config file is reloaded.
+
+    \param  a_name  Name of the material in the config file.
+
+    \return Parameter slot, holding the default parameters if the material
+            has not been loaded.
+*/
+//==============================================================================
+const MaterialParamsSlot* MaterialLibrary::getParams(const string& a_name)
+{
+    lock_guard<mutex> lock(m_mutex);
+    return (&findSlot(a_name)->params);
+}
+
+
+//==============================================================================
+/*!
+    Returns the slot of a material, creating it with default parameters.
+
+    \param  a_name  Name of the material.
+
+    \return Slot of the material.
+*/
+//==============================================================================
+MaterialLibrary::Slot* MaterialLibrary::findSlot(const string& a_name)
+{
+    for (unsigned int i = 0; i < m_slots.size(); i++)
+    {
+        if (m_slots[i]->name == a_name)
+        {
+            return (m_slots[i]);
+        }
+    }
+
+    Slot* slot = new Slot();
+    slot->name = a_name;
+    slot->params.store(new MaterialParams(getDefaultParams()));
+    m_slots.push_back(slot);
+    return (slot);
+}
+
+
+//==============================================================================
+/*!
+    Loads a config file. The whole file is parsed and validated first; if
+    it has an error nothing is published, so a half-saved edit never reaches
+    the haptic thread. Otherwise every material whose parameters changed
+    gets a new parameter block.
+
+    \param  a_filename  Config file.
+
+    \return true if the file was read and is valid.
+*/
+//==============================================================================
+bool MaterialLibrary::load(const string& a_filename)
+{
+    ifstream file(a_filename.c_str());
+    if (!file)
+    {
+        return (false);
+    }
+
+    map<string, MaterialParams> loaded;
+    string line;
+    int lineNumber = 0;
+
+    while (getline(file, line))
+    {
+        lineNumber++;
+
+        size_t comment = line.find('#');
+        if (comment != string::npos)
+        {
+            line.erase(comment);
+        }
+
+        istringstream fields(line);
+        string name;
+        if (!(fields >> name))
+        {
+            continue;
+        }
+
+        MaterialParams params = getDefaultParams();
+        fields >> params.smoothnessConstant >> params.frictionFactor
+               >> params.baseStaticFriction >> params.baseDynamicFriction
+               >> params.maxStaticFriction >> params.maxDynamicFriction;
+
+        string extra;
+        bool valid = !fields.fail() && !(fields >> extra);
+
+        const double values[] = { params.smoothnessConstant, params.frictionFactor,
+                                  params.baseStaticFriction, params.baseDynamicFriction,
+                                  params.maxStaticFriction, params.maxDynamicFriction };
+        for (int i = 0; valid && (i < 6); i++)
+        {
+            valid = std::isfinite(values[i]) && (values[i] >= 0.0);
+        }
+
+        if (!valid)
+        {
+            printf("%s:%d: expected a name and six non-negative numbers; file not applied\n", a_filename.c_str(), lineNumber);
+            return (false);
+        }
+
+        loaded[name] = params;
+    }
+
+    lock_guard<mutex> lock(m_mutex);
+
+    int numChanged = 0;
+    for (map<string, MaterialParams>::iterator it = loaded.begin(); it != loaded.end(); ++it)
+    {
+        Slot* slot = findSlot(it->first);
+        if (memcmp(slot->params.load(), &it->second, sizeof(MaterialParams)) != 0)
+        {
+            publish(slot, it->second);
+            numChanged++;
+        }
+    }
+
+    reclaim();
+
+    printf("%s: %d materials, %d changed\n", a_filename.c_str(), (int)loaded.size(), numChanged);
+    return (true);
+}
+
+
+//==============================================================================
+/*!
+    Swaps a new parameter block into a slot. The old block is retired with
+    the current haptic epochs: a haptic tick that loaded it has not finished
+    until the epoch of its thread moves past that value.
+
+    \param  a_slot    Slot to update.
+    \param  a_params  New parameters.
+*/
+//==============================================================================
+void MaterialLibrary::publish(Slot* a_slot, const MaterialParams& a_params)
+{
+    const MaterialParams* previous = a_slot->params.exchange(new MaterialParams(a_params));
+
+    RetiredParams retired;
+    retired.params = previous;
+    m_hapticEpochs.stamp(retired.stamp);
+    m_retired.push_back(retired);
+}
+
+
+//==============================================================================
+/*!
+    Frees the retired parameter blocks that no haptic thread can still be
+    reading.
+*/
+//==============================================================================
+void MaterialLibrary::reclaim()
+{
+    unsigned int kept = 0;
+    for (unsigned int i = 0; i < m_retired.size(); i++)
+    {
+        if (m_hapticEpochs.hasPassed(m_retired[i].stamp))
+        {
+            delete m_retired[i].params;
+        }
+        else
+        {
+            m_retired[kept++] = m_retired[i];
+        }
+    }
+    m_retired.resize(kept);
+}
+
+
+//==============================================================================
+/*!
+    Starts a thread that polls a config file and reloads it whenever its
+    modification time or size changes.
+
+    \param  a_filename  Config file.
+    \param  a_periodMs  Polling period in milliseconds.
+*/
+//==============================================================================
+void MaterialLibrary::startWatching(const string& a_filename, unsigned int a_periodMs)
+{
+    if (m_watching.exchange(true))
+    {
+        return;
+    }
+
+    m_watcher = thread(&MaterialLibrary::watch, this, a_filename, a_periodMs);
+}
+
+
+//==============================================================================
+/*!
+    Stops the watching thread.
+*/
+//==============================================================================
+void MaterialLibrary::stopWatching()
+{
+    if (!m_watching.exchange(false))
+    {
+        return;
+    }
+
+    m_watcher.join();
+}
+
+
+//==============================================================================
+/*!
+    Body of the watching thread.
+
+    \param  a_filename  Config file.
+    \param  a_periodMs  Polling period in milliseconds.
+*/
+//==============================================================================
+void MaterialLibrary::watch(string a_filename, unsigned int a_periodMs)
+{
+    time_t modified = 0;
+    long long size = -1;
+    getFileVersion(a_filename, modified, size);
+
+    while (m_watching.load())
+    {
+        this_thread::sleep_for(chrono::milliseconds(a_periodMs));
+
+        time_t newModified;
+        long long newSize;
+        if (getFileVersion(a_filename, newModified, newSize) && ((newModified != modified) || (newSize != size)))
+        {
+            modified = newModified;
+            size = newSize;
+            load(a_filename);
+        }
+
+        lock_guard<mutex> lock(m_mutex);
+        reclaim();
+    }
+}
@@ -0,0 +1,105 @@
+//==============================================================================
+/*
+    CPSC 599.86 / 601.86 - Computer Haptics
+    Winter 2018, University of Calgary
+
+    This class holds the parameters of every named material of the scene,
+    loaded from a config file (materials.cfg) and reloaded whenever the file
+    changes, while the haptic thread keeps running.
+
+    Each material has one slot, an atomic pointer to an immutable
+    MaterialParams block that the kernels read. An edit builds new blocks
+    and swaps them in; the haptic thread only ever loads a pointer, so it
+    never locks, allocates or sees a half-updated block. Replaced blocks are
+    freed once the haptic thread has finished the tick that may still be
+    reading them: it calls quiescentState() at the end of every tick.
+*/
+//==============================================================================
+
+#ifndef MATERIALLIBRARY_H
+#define MATERIALLIBRARY_H
+
+#include "HapticEpochs.h"
+#include "MaterialKernels.h"
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+//------------------------------------------------------------------------------
+
+class MaterialLibrary
+{
+public:
+
+    //! Constructor of MaterialLibrary.
+    MaterialLibrary();
+
+    //! Destructor of MaterialLibrary. The haptic thread must no longer read the slots.
+    ~MaterialLibrary();
+
+    //! Returns the parameter slot of a material, creating it with default parameters.
+    const MaterialParamsSlot* getParams(const std::string& a_name);
+
+    //! Loads a config file and publishes the parameters that changed.
+    bool load(const std::string& a_filename);
+
+    //! Starts a thread that reloads a config file whenever it changes.
+    void startWatching(const std::string& a_filename, unsigned int a_periodMs = 250);
+
+    //! Stops the watching thread.
+    void stopWatching();
+
+    //! Sets the number of haptic threads reading the parameters. Call before they start.
+    void setNumHapticThreads(unsigned int a_numThreads) { m_hapticEpochs.setNumThreads(a_numThreads); }
+
+    //! Called by haptic thread a_thread at the end of every tick; it holds no parameter pointer past this call.
+    void quiescentState(unsigned int a_thread = 0) { m_hapticEpochs.quiescentState(a_thread); }
+
+    //! Parameters of a material that the config file does not mention.
+    static MaterialParams getDefaultParams();
+
+protected:
+
+    struct Slot
+    {
+        std::string name;
+        MaterialParamsSlot params;
+    };
+
+    struct RetiredParams
+    {
+        const MaterialParams* params;
+
+        //! Haptic epochs when the block was replaced; freed once every haptic thread has moved past them.
+        HapticEpochs::Stamp stamp;
+    };
+
+    //! Returns the slot of a material, creating it. m_mutex must be held.
+    Slot* findSlot(const std::string& a_name);
+
+    //! Swaps new parameters into a slot and retires the old block. m_mutex must be held.
+    void publish(Slot* a_slot, const MaterialParams& a_params);
+
+    //! Frees the retired blocks the haptic thread can no longer read. m_mutex must be held.
+    void reclaim();
+
+    //! Body of the watching thread.
+    void watch(std::string a_filename, unsigned int a_periodMs);
+
+    //! Serialises the writers (loading, watching); never taken by the haptic thread.
+    std::mutex m_mutex;
+
+    std::vector<Slot*> m_slots;
+    std::vector<RetiredParams> m_retired;
+
+    //! Number of haptic ticks completed by each haptic thread.
+    HapticEpochs m_hapticEpochs;
+
+    std::thread m_watcher;
+    std::atomic<bool> m_watching;
+};
+
+//------------------------------------------------------------------------------
+#endif
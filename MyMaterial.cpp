@@ -21,4 +21,70 @@ using namespace chai3d;
 MyMaterial::MyMaterial()
 {
     m_myMaterialProperty = 1.0;
+
+    params = NULL;
+
+    kernel.force = NULL;
+    kernel.friction = NULL;
+    kernel.params = NULL;
+    kernel.usesTexels = false;
+    kernel.texels = NULL;
+    kernel.tangentFrames = NULL;
+    kernel.albedo = NULL;
+    kernel.procedural = NULL;
+}
+
+
+//==============================================================================
+/*!
+    Resolves the haptic kernel of this material once, at load time, and
+    stores a pointer to it in the m_userData of the mesh so that the haptic
+    thread can call it directly. Call this after the maps, tangent frames and
+    params slot have been set. Parameters published to the slot later are
+    seen by the kernel on its next call.
+
+    \param  a_type  Kind of kernel that renders this material.
+    \param  a_mesh  Mesh this material is attached to.
+
+    \return true if the data the kernel needs is available.
+*/
+//==============================================================================
+bool MyMaterial::bindKernel(MaterialKernelType a_type, cMesh* a_mesh)
+{
+    const cImage* albedo = ((a_mesh->m_texture != NULL) ? a_mesh->m_texture->m_image.get() : NULL);
+
+    if (params == NULL)
+    {
+        return (false);
+    }
+
+    switch (a_type)
+    {
+        case MATERIAL_KERNEL_MAPPED:
+            if ((hapticTexels == NULL) || hapticTexels->isEmpty() || (tangentFrames == NULL))
+            {
+                return (false);
+            }
+            kernel = makeMaterialKernel<MATERIAL_KERNEL_MAPPED>(params, hapticTexels.get(), tangentFrames.get(), albedo, getProceduralTextures());
+            break;
+
+        case MATERIAL_KERNEL_PROCEDURAL_BUMPS:
+            if (albedo == NULL)
+            {
+                return (false);
+            }
+            kernel = makeMaterialKernel<MATERIAL_KERNEL_PROCEDURAL_BUMPS>(params, hapticTexels.get(), tangentFrames.get(), albedo, getProceduralTextures());
+            break;
+
+        case MATERIAL_KERNEL_PROCEDURAL_FRICTION:
+            kernel = makeMaterialKernel<MATERIAL_KERNEL_PROCEDURAL_FRICTION>(params, hapticTexels.get(), tangentFrames.get(), albedo, getProceduralTextures());
+            break;
+
+        default:
+            return (false);
+    }
+
+    a_mesh->m_userData = &kernel;
+
+    return (true);
 }
@@ -13,6 +13,9 @@
 #define MYMATERIAL_H
 
 #include "chai3d.h"
+#include "HapticTexelMap.h"
+#include "TangentFrames.h"
+#include "MaterialKernels.h"
 
 //------------------------------------------------------------------------------
 struct MyMaterial;
@@ -28,28 +31,35 @@ public:
 
     //! Shared MyMaterial allocator.
     static MyMaterialPtr create() { return (std::make_shared<MyMaterial>()); }
+
+    //! Resolves the haptic kernel of this material and stores it on the mesh.
+    bool bindKernel(MaterialKernelType a_type, chai3d::cMesh* a_mesh);
 	
 
     //--------------------------------------------------------------------------
     // [CPSC.86] CUSTOM MATERIAL PROPERTIES
     //--------------------------------------------------------------------------
 
-	double baseStaticFriction;
-	double baseDynamicFriction;
-
-	double maxStaticFriction;
-	double maxDynamicFriction;
+	// Friction limits, smoothness and friction factor read by the haptic kernels,
+	// owned by the MaterialLibrary and replaced whenever the config file changes.
+	const MaterialParamsSlot* params;
 
 	chai3d::cTexture2dPtr normalMap;
 	chai3d::cTexture2dPtr heightMap;
 	chai3d::cTexture2dPtr roughnessMap;
 
+	// Interleaved copy of the three maps above, sampled by the haptic thread.
+	HapticTexelMapPtr hapticTexels;
+
+	// Per-triangle tangent frames of the mesh this material is attached to.
+	TangentFramesPtr tangentFrames;
+
 	int objectID;
 
     double m_myMaterialProperty;
 
-	double smoothnessConstant;
-	double frictionFactor;
+	// Kernel resolved by bindKernel(); the mesh points to it.
+	MaterialKernel kernel;
 };
 
 //------------------------------------------------------------------------------
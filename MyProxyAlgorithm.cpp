@@ -15,22 +15,15 @@
 //==============================================================================
 
 #include "MyProxyAlgorithm.h"
-#include "MyMaterial.h"
+#include "MaterialKernels.h"
+#include "HapticDiagnostics.h"
+#include "ServoLoop.h"
 
-#define GLM_ENABLE_EXPERIMENTAL
-
-
-#include <../glm/glm/vec3.hpp>
-#include <../glm/glm/gtc/matrix_transform.hpp>
-#include <../glm/glm/mat4x4.hpp>
-#include <../glm/glm/gtx/rotate_vector.hpp>
-
-
-
-
-using namespace glm;
 using namespace chai3d;
 
+// weight of the latest tick in the filtered texture distance per tick (about 10 ticks)
+static const double C_FOOTPRINT_FILTER = 0.1;
+
 //==============================================================================
 /*!
     This method uses the information computed earlier in
@@ -63,9 +56,19 @@ using namespace chai3d;
 
 void MyProxyAlgorithm::updateForce()
 {
+	// the friction stage has usually built the contact context already; it is timed apart
+	if (m_numCollisionEvents > 0)
+		updateContactContext();
+
+	unsigned long long updateStart = (latencyMonitor != NULL) ? hapticLatencyNow() : 0;
+
     // get the base class to do basic force computation first
     cAlgorithmFingerProxy::updateForce();
 
+	// the servo loop renders its texture on top of the base force
+	cVector3d baseForce = m_lastGlobalForce;
+	cVector3d shadedNormal(0.0, 0.0, 0.0);
+
     // TODO: compute force shading and texture forces here
 
     if (m_numCollisionEvents > 0)
@@ -73,221 +76,66 @@ void MyProxyAlgorithm::updateForce()
         // this is how you access collision information from the first constraint
         cCollisionEvent* c0 = &m_collisionRecorderConstraint0.m_nearestCollision;
 
-		if (MyMaterialPtr material = std::dynamic_pointer_cast<MyMaterial>(c0->m_object->m_material))
-		{
-			// you can access your custom material properties here
-			cColorf color = c0->m_object->m_texture->m_color;
+		shadedNormal = computeShadedSurfaceNormal(c0);
+		shadedNormal.normalize();
 
-			double pixelX, pixelY;
-			cColorb pixelColor;
-			cVector3d texCoord;
-			cVector3d perturbedNormal;
+		const MaterialKernel* kernel = contact.kernel;
 
-			std::string textureFilename;
-			cImagePtr image = c0->m_object->m_texture->m_image;
+		if (kernel != NULL && kernel->force != NULL)
+		{
+			ForceKernelState state;
+			state.contact = &contact;
+			state.meshSurfaceNormal = shadedNormal;
+			state.proxyGlobalPos = m_proxyGlobalPos;
+			state.deviceGlobalPos = m_deviceGlobalPos;
+			state.tangentialForce = getTangentialForce();
+			state.frictionOn = frictionOn.load(std::memory_order_relaxed);
+			state.force = m_lastGlobalForce;
+			state.surfaceNormal = surfaceNorm;
+			state.normalMapNormal = normalMapNorm;
+			state.height = heightAtContact;
+			state.roughness = roughnessAtContact;
+
+			kernel->force(*kernel, state);
+
+			m_lastGlobalForce = state.force;
+			surfaceNorm = state.surfaceNormal;
+			normalMapNorm = state.normalMapNormal;
+			heightAtContact = state.height;
+			roughnessAtContact = state.roughness;
+		}
+    }
+	else
+	{
+		// the next contact starts from rest
+		previousContactObject = NULL;
+		texCoordFootprint = 0.0;
+	}
 
-			if (image == NULL || c0 == NULL)
-			{
-				std::cout << "Null Ptr Update Forces.\n";
-				return;
-			}
+	if (contactModel != NULL)
+		fillContactModel(baseForce, shadedNormal);
 
-			texCoord = c0->m_triangles->getTexCoordAtPosition(c0->m_index, c0->m_localPos);
+	if (latencyMonitor != NULL)
+	{
+		latencyMonitor->record(HAPTIC_STAGE_UPDATE_FORCE, hapticLatencyNow() - updateStart);
 
-			if (texCoord.x() > 1.0)
-				texCoord = cVector3d(texCoord.x() - 1.0, texCoord.y(), texCoord.z());
-			if (texCoord.y() > 1.0)
-				texCoord = cVector3d(texCoord.x(), texCoord.y() - 1.0, texCoord.z());
-			if (texCoord.x() < 0.0)
-				texCoord = cVector3d(1.0 + texCoord.x(), texCoord.y(), texCoord.z());
-			if (texCoord.y() < 0.0)
-				texCoord = cVector3d(texCoord.x(), 1.0 + texCoord.y(), texCoord.z());
-
-
-			// For Bumps texture -- procedural implementation
-			if (material->objectID == 3)
-			{
-				image = c0->m_object->m_texture->m_image;
-				image->getPixelLocationInterpolated(texCoord, pixelX, pixelY, true);
-				image->getPixelColorInterpolated(pixelX, pixelY, pixelColor);
-
-				m_colorAtCollision = pixelColor;
-
-				double g, b;
-				g = (double)pixelColor.getG();
-				b = (double)pixelColor.getB();
-
-				// Height used to scale force when passing over bumps.
-				double height = (g + b) / (255.0*2.0);
-
-
-				double distance = texCoord.x();
-
-				// Texture wrapping in effect, need to get value between 0 and 1.
-				// If greater than 1, decrease by 1 until between 0 and 1.  
-				while (distance > 1.0)
-					distance -= 1.0;
-
-				// If less than 1, increase until between -1 and 0. Then take 1.0 + distance. (if texCoord is -0.25, this is extracting 0.75 from the texture)
-				while (distance < -1.0)
-					distance += 1.0;
-
-				if (distance < 0.0)
-					distance = 1.0 + distance;
-
-				// yVariant is used to vary the force in the y direction.
-				// negator is used to negate the y variant when passing over the middle of the bump.
-				double yVariant = sin(0.7 + 19.5*M_PI*distance);
-				double negator = sin(0.7 +1.5*M_PI + 19.5*M_PI*distance);
-
-//				std::cout << "Sin Tex coord Clamped: " << yVariant << std::endl;
-
-				// Save the magnitude of force.
-				double magnitudeOfForce = m_lastGlobalForce.length();
-				double blendDistance = 0.15;
-				double blendAmount = 1.0;
-
-				// yVariant is between 0 and 1 when passing over white bands.
-				if (yVariant > 0.0)
-				{
-					// Blend perturbation over short distance to avoid sharp changes in force direction.
-					if (yVariant < blendAmount)
-						blendAmount = yVariant / blendDistance;
-
-					yVariant = 1.0 - yVariant;
-
-					yVariant *= blendAmount;
-
-					if (negator < 0.0)
-						yVariant = -yVariant;
-
-					// Use height to increase magnitude of force.
-					magnitudeOfForce += height*2.0;
-				}
-				else
-					yVariant = 0.0;
-
-				// Add to the y component of the global force to simulate bumps
-				m_lastGlobalForce += cVector3d(0.0, yVariant*magnitudeOfForce*0.25, 0.0);
-				m_lastGlobalForce.normalize();
-				m_lastGlobalForce = m_lastGlobalForce * magnitudeOfForce;
-			}
-			else if (material->objectID != 5)
-			{
-				cVector3d meshSurfaceNormal, normalMapNormal, savedTangentialForce;
-				double epsilon, penetrationDepth, height;
-
-				savedTangentialForce = getTangentialForce();
-
-				material->normalMap->m_image->getPixelLocationInterpolated(texCoord, pixelX, pixelY, true);
-				material->normalMap->m_image->getPixelColorInterpolated(pixelX, pixelY, pixelColor);
-				m_normalColorAtCollision = pixelColor;
-
-				// Get normal relative to implicit (127.5, 127.5, 127.5) normal origin.
-				// This is because normals are directions expressed in values ranging from 0 to 255.
-				// If a value is 255, it is maximum in that direction, 0 is maximum in opposite direction.
-				normalMapNormal = cVector3d(pixelColor.getG() - 127.5, pixelColor.getR() - 127.5, pixelColor.getB() - 127.5);
-				normalMapNormal.normalize();
-
-
-				meshSurfaceNormal = computeShadedSurfaceNormal(c0);
-				meshSurfaceNormal.normalize();
-		
-				
-				// Get angle between surface normal and implicit global unit axes
-				float thetaX, thetaY, thetaZ;
-				thetaX = acos(meshSurfaceNormal.dot(cVector3d(1.0, 0.0, 0.0)));
-				thetaY = acos(meshSurfaceNormal.dot(cVector3d(0.0, 1.0, 0.0)));
-				thetaZ = acos(meshSurfaceNormal.dot(cVector3d(0.0, 0.0, 1.0)));
-
-				// Rotate the normal map normal by the same angle that the surface normal deviates from these
-				// axes.
-				vec3 glmNormalMapNormal = vec3(normalMapNormal.y(), normalMapNormal.z(), normalMapNormal.x());
-
-				// If normal is 80 degrees off of positive x in Chai3d, we rotate -10 degrees about positive
-				// x in glm.
-				// If normal is 170 degrees off of positive x in Chai3d, we rotate 80 degrees about positive
-				// x in glm.
-				if (thetaX < (M_PI * 0.5))
-				{
-					thetaX = (M_PI * 0.5) - thetaX;
-				}
-				else
-				{
-					thetaX = thetaX - (M_PI * 0.5);
-					thetaX = -thetaX;
-				}
-				vec3 xAxis = vec3(1.0, 0.0, 0.0);
-				glmNormalMapNormal = rotateX(glmNormalMapNormal, thetaX);
-
-				// If normal is 80 degrees off of positive y in Chai3d, we rotate -10 degrees about positive
-				// z in glm.
-				// If normal is 170 degrees off of positive y in Chai3d, we rotate 80 degrees about positive
-				// z in gml
-				if (thetaY < (M_PI * 0.5))
-				{
-					thetaY = (M_PI * 0.5) - thetaY;
-					thetaY = -thetaY;
-				}
-				else
-					thetaY = thetaY - (M_PI * 0.5);
-
-				vec3 zAxis = vec3(0.0, 0.0, 1.0);
-				glmNormalMapNormal = rotateZ(glmNormalMapNormal, thetaY);
-
-
-				normalMapNormal = cVector3d(glmNormalMapNormal.z, glmNormalMapNormal.x, glmNormalMapNormal.y);
-				normalMapNormal.normalize();
-				// NEW CALCULATIONS END
-				
-				// Get the height at the collision point and use to scale the penetration depth.
-				penetrationDepth = (m_proxyGlobalPos - m_deviceGlobalPos).length();
-
-				material->heightMap->m_image->getPixelLocationInterpolated(texCoord, pixelX, pixelY, true);
-				material->heightMap->m_image->getPixelColorInterpolated(pixelX, pixelY, pixelColor);
-				height = pixelColor.getLuminance() / 255.0;
-
-				penetrationDepth += height;
-				penetrationDepth += (1.0 - material->smoothnessConstant);
-
-				// Calculate the blending factors to blend the normal map normal with the surface normal.
-				double perturbedNormalFactor = material->smoothnessConstant * height;
-				double meshNormalFactor = penetrationDepth - perturbedNormalFactor;
-				meshNormalFactor = ((meshNormalFactor >= 0.0) ? meshNormalFactor : 0.0);
-				meshNormalFactor = ((meshNormalFactor <= 1.0) ? meshNormalFactor : 1.0);
-
-
-				surfaceNorm = meshSurfaceNormal;
-				normalMapNorm = normalMapNormal;
-				
-
-				double forceMagnitude = m_lastGlobalForce.length();
-				perturbedNormal = normalMapNormal;
-
-				// If penetration depth is large, blend normal map normal with surface normal to avoid force
-				// direction discontinuitues.
-				if (penetrationDepth > perturbedNormalFactor)
-				{
-					m_lastGlobalForce =  
-						(penetrationDepth - perturbedNormalFactor)*meshSurfaceNormal +
-						perturbedNormalFactor * perturbedNormal;
-				}
-				else
-				{
-					m_lastGlobalForce = perturbedNormalFactor * perturbedNormal;
-				}
-
-				m_lastGlobalForce = cVector3d(m_lastGlobalForce.x(), m_lastGlobalForce.y(), m_lastGlobalForce.z() + (height * (1.5 - material->smoothnessConstant)));
-				
-				// If friction is on, use the previously saved tangential force to alter the global force.
-				if (frictionOn)
-					m_lastGlobalForce += (savedTangentialForce * 0.25);
-	
-				m_lastGlobalForce.normalize();
-				m_lastGlobalForce *= forceMagnitude;
-			}
+		// the context is built and the proxy moves along a surface only while in contact
+		if (contactTime > 0)
+		{
+			latencyMonitor->record(HAPTIC_STAGE_CONTACT_CONTEXT, contactTime);
+			contactTime = 0;
 		}
-    }
+		if (moveProxyTime > 0)
+		{
+			latencyMonitor->record(HAPTIC_STAGE_MOVE_PROXY, moveProxyTime);
+			moveProxyTime = 0;
+		}
+	}
+
+	publishTelemetry();
+
+	// the next tick detects its own contacts
+	contact.valid = false;
 }
 
 
@@ -320,111 +168,403 @@ void MyProxyAlgorithm::testFrictionAndMoveProxy(const cVector3d& a_goal,
                                                 cVector3d &a_normal,
                                                 cGenericObject* a_parent)
 {
-	cCollisionEvent* c0 = &m_collisionRecorderConstraint0.m_nearestCollision;
+	// the context is timed as a stage of its own
+	updateContactContext();
+
+	unsigned long long moveStart = (latencyMonitor != NULL) ? hapticLatencyNow() : 0;
+
+	const MaterialKernel* kernel = contact.kernel;
+
+	// Surfaces without a friction kernel keep the friction of their material, which is
+	// only read here; the scene graph is never written from the haptic thread.
+	contact.staticFriction = a_parent->m_material->getStaticFriction();
+	contact.dynamicFriction = a_parent->m_material->getDynamicFriction();
 
-	if (c0)
+	if (kernel == NULL)
 	{
-		MyMaterialPtr material = std::dynamic_pointer_cast<MyMaterial>(c0->m_object->m_material);
-		std::string textureFilename;
-		cImagePtr image = c0->m_object->m_texture->m_image;
+		HAPTIC_DIAG_ERROR_ONCE("Null Ptr Friction: contact object has no material kernel");
+	}
+	else if (kernel->friction != NULL)
+	{
+		FrictionKernelState state;
+		state.contact = &contact;
+		state.frictionOn = frictionOn.load(std::memory_order_relaxed);
 
-		if (image == NULL || material == NULL)
-		{
-			std::cout << "Null Ptr Friction.\n";
-			return;
-		}
+		kernel->friction(*kernel, state);
 
-		textureFilename = image->getFilename();
-
-		double pixelX, pixelY;
-		cColorb pixelColor;
-		cVector3d texCoord;
-		double r, g, b;
-
-		texCoord = c0->m_triangles->getTexCoordAtPosition(c0->m_index, c0->m_localPos);
-		
-		if (texCoord.x() > 1.0)
-			texCoord = cVector3d(texCoord.x() - 1.0, texCoord.y(), texCoord.z());
-		if (texCoord.y() > 1.0)
-			texCoord = cVector3d(texCoord.x(), texCoord.y() - 1.0, texCoord.z());
-		if (texCoord.x() < 0.0)
-			texCoord = cVector3d(1.0 + texCoord.x(), texCoord.y(), texCoord.z());
-		if (texCoord.y() < 0.0)
-			texCoord = cVector3d(texCoord.x(), 1.0 + texCoord.y(), texCoord.z());
-
-		// Procedural friction modulation for rocky/blue banded texture
-		if (material->objectID == 5)
-		{
-			double distance = texCoord.y();
+		contact.staticFriction = state.staticFriction;
+		contact.dynamicFriction = state.dynamicFriction;
+	}
 
-			// Texture wrapping in effect, need to get value between 0 and 1.
-			// If greater than 1, decrease by 1 until between 0 and 1.  
-			while (distance > 1.0)
-				distance -= 1.0;
+	moveProxyInFrictionCone(a_goal, a_proxy, a_normal, contact.staticFriction, contact.dynamicFriction);
 
-			// If less than 1, increase until between -1 and 0. Then take 1.0 + distance. (if texCoord is -0.25, this is extracting 0.75 from the texture)
-			while (distance < -1.0)
-				distance += 1.0;
+	// called up to once per constraint; updateForce() records the sum
+	if (latencyMonitor != NULL)
+	{
+		moveProxyTime += hapticLatencyNow() - moveStart;
+	}
+}
 
-			if (distance < 0.0)
-				distance = 1.0 + distance;
 
-			double frictionVariant = sin(9.75*M_PI*distance + 0.5);
 
-			double staticFric;
-			double dynamicFric;
 
-			// Friction variant is > 0.0 when over the rocky surfaces.
-			frictionVariant = ((frictionVariant > 0.0) ? frictionVariant : 0.0);
+//==============================================================================
+/*!
+    Moves the proxy towards the goal within the friction cone of the given
+    coefficients. This is cAlgorithmFingerProxy::testFrictionAndMoveProxy()
+    with the coefficients passed in rather than read from the material of
+    the surface, so that they can change every tick without writing to the
+    scene.
+
+    \param  a_goal            The location to which we'd like to move the proxy.
+    \param  a_proxy           The current position of the proxy.
+    \param  a_normal          The surface normal at the obstructing surface.
+    \param  a_staticFriction   Static friction coefficient of the contact.
+    \param  a_dynamicFriction  Dynamic friction coefficient of the contact.
+*/
+//==============================================================================
+void MyProxyAlgorithm::moveProxyInFrictionCone(const cVector3d& a_goal,
+                                               const cVector3d& a_proxy,
+                                               const cVector3d& a_normal,
+                                               double a_staticFriction,
+                                               double a_dynamicFriction)
+{
+    // check if friction is enabled
+    if (!m_useFriction)
+    {
+        m_nextBestProxyGlobalPos = a_goal;
+        return;
+    }
 
-			double frictionMultiplier = pow((1.0 + frictionVariant), 3);
-			frictionMultiplier -= 1.0;
-			std::cout << "Friction Multiplier: " << frictionMultiplier << std::endl;
+    // compute penetration depth; how far is the device "behind" the
+    // plane of the obstructing surface
+    cVector3d projectedGoal = cProjectPointOnPlane(m_deviceGlobalPos, a_proxy, a_normal);
+    double penetrationDepth = (m_deviceGlobalPos - projectedGoal).length();
 
-			// Use friction variant to modulate fricton.
-			staticFric = material->baseStaticFriction * frictionMultiplier;
-			dynamicFric = material->baseDynamicFriction * frictionMultiplier;
-			
-			a_parent->setFriction(staticFric, dynamicFric, true);
-		}
-		else if (material->objectID != 3)
-		{
-			// Get the roughness value from the roughness map.
-			material->roughnessMap->m_image->getPixelLocationInterpolated(texCoord, pixelX, pixelY, true);
-			material->roughnessMap->m_image->getPixelColorInterpolated(pixelX, pixelY, pixelColor);
+    double mud = a_dynamicFriction;
+    double mus = a_staticFriction;
 
-			m_roughnessAtCollision = pixelColor;
+    // no friction; don't try to compute friction cones
+    if ((mud == 0) && (mus == 0))
+    {
+        m_nextBestProxyGlobalPos = a_goal;
+        return;
+    }
 
-			r = pixelColor.getR();
-			g = pixelColor.getG();
-			b = pixelColor.getB();
+    // the corresponding friction cone radii
+    double atmd = atan(mud);
+    double atms = atan(mus);
 
-			double roughness = (r + g + b) / (3.0*255.0);
+    // compute a vector from the device to the proxy, for computing
+    // the angle of the friction cone
+    cVector3d vDeviceProxy = a_proxy - m_deviceGlobalPos;
+    vDeviceProxy.normalize();
 
-			roughness *= 0.25;
+    // now compute the angle of the friction cone...
+    double theta = acos(vDeviceProxy.dot(a_normal));
 
-			// Modulate friction using material properties and roughness map values.
-			if (frictionOn)
-				a_parent->setFriction(material->maxStaticFriction * roughness * material->frictionFactor, material->maxDynamicFriction * roughness * material->frictionFactor, true);
-			else
-				a_parent->setFriction(0.0, 0.0, true);
-		}
-	}
+    // manage the "slip-friction" state machine
 
+    // if the dynamic friction radius is for some reason larger than the
+    // static friction radius, always slip
+    if (mud > mus)
+    {
+        m_slipping = true;
+    }
 
-	cAlgorithmFingerProxy::testFrictionAndMoveProxy(a_goal, a_proxy, a_normal, a_parent);
-}
+    // if we're slipping...
+    else if (m_slipping)
+    {
+        m_slipping = !(theta < (atmd * m_frictionDynHysteresisMultiplier));
+    }
 
+    // if we're not slipping...
+    else
+    {
+        m_slipping = (theta > atms);
+    }
+
+    // the friction coefficient we're going to use...
+    double mu = m_slipping ? mud : mus;
+
+    // calculate the friction radius as the absolute value of the penetration
+    // depth times the coefficient of friction
+    double frictionRadius = fabs(penetrationDepth * mu);
+
+    // calculate the distance between the proxy position and the current
+    // goal position.
+    double r = a_proxy.distance(a_goal);
+
+    // if this distance is smaller than C_SMALL, we consider the proxy
+    // to be at the same position as the goal, and we're done...
+    if (r < C_SMALL)
+    {
+        m_nextBestProxyGlobalPos = a_proxy;
+    }
+
+    // if the proxy is outside the friction cone, update its position to
+    // be on the perimeter of the friction cone...
+    else if (r > frictionRadius)
+    {
+        m_nextBestProxyGlobalPos = a_goal + (frictionRadius / r) * (a_proxy - a_goal);
+    }
 
+    // otherwise, if the proxy is inside the friction cone, the proxy
+    // should not be moved (set next best position to current position)
+    else
+    {
+        m_nextBestProxyGlobalPos = a_proxy;
+    }
+}
 
 
 MyProxyAlgorithm::MyProxyAlgorithm()
 {
 	frictionOn = false;
+	heightAtContact = 0.0;
+	roughnessAtContact = 0.0;
+	previousContactObject = NULL;
+	texCoordFootprint = 0.0;
+	tickCount = 0;
+	contact.valid = false;
+	latencyMonitor = NULL;
+	contactTime = 0;
+	moveProxyTime = 0;
+	contactModel = NULL;
 }
 
 
 void MyProxyAlgorithm::setFrictionOn(bool iWantItOn)
 {
-	frictionOn = iWantItOn;
+	frictionOn.store(iWantItOn, std::memory_order_relaxed);
+}
+
+
+//==============================================================================
+/*!
+    Builds the contact context of this tick from the nearest contact of the
+    first constraint: its texture coordinate, the distance travelled per
+    tick and the mip level it selects, the kernel bound to the object and,
+    for kernels that read them, the tangent frame and the haptic channels.
+    The first stage to need it builds it; updateForce() drops it at the end
+    of the tick. Call only while in contact.
+*/
+//==============================================================================
+void MyProxyAlgorithm::updateContactContext()
+{
+	if (contact.valid)
+		return;
+
+	unsigned long long contactStart = (latencyMonitor != NULL) ? hapticLatencyNow() : 0;
+
+	cCollisionEvent* c0 = &m_collisionRecorderConstraint0.m_nearestCollision;
+
+	contact.object = c0->m_object;
+	contact.triangleIndex = c0->m_index;
+
+	// the kernel was bound to the mesh when its material was attached
+	contact.kernel = getMaterialKernel(c0->m_object);
+
+	contact.texCoord = computeContactTexCoord(c0);
+	updateTexCoordFootprint(contact.object, contact.texCoord);
+	contact.texCoordFootprint = texCoordFootprint;
+
+	const MaterialKernel* kernel = contact.kernel;
+	if ((kernel != NULL) && kernel->usesTexels)
+	{
+		// one lookup gives the normal, height and roughness to both stages
+		contact.mipLevel = kernel->texels->getLevelForFootprint(texCoordFootprint);
+		kernel->texels->sample(contact.texCoord.x(), contact.texCoord.y(), contact.mipLevel, contact.texel);
+		contact.tangentFrame = &kernel->tangentFrames->getFrame(contact.triangleIndex);
+	}
+	else
+	{
+		contact.mipLevel = 0.0f;
+		contact.tangentFrame = NULL;
+	}
+
+	// set by the friction stage
+	contact.staticFriction = 0.0;
+	contact.dynamicFriction = 0.0;
+
+	contact.valid = true;
+
+	if (latencyMonitor != NULL)
+	{
+		contactTime = hapticLatencyNow() - contactStart;
+	}
+}
+
+
+//==============================================================================
+/*!
+    Returns the texture coordinate of a contact, wrapped once into [0, 1].
+*/
+//==============================================================================
+cVector3d MyProxyAlgorithm::computeContactTexCoord(cCollisionEvent* a_event)
+{
+	cVector3d texCoord = a_event->m_triangles->getTexCoordAtPosition(a_event->m_index, a_event->m_localPos);
+
+	if (texCoord.x() > 1.0)
+		texCoord = cVector3d(texCoord.x() - 1.0, texCoord.y(), texCoord.z());
+	if (texCoord.y() > 1.0)
+		texCoord = cVector3d(texCoord.x(), texCoord.y() - 1.0, texCoord.z());
+	if (texCoord.x() < 0.0)
+		texCoord = cVector3d(1.0 + texCoord.x(), texCoord.y(), texCoord.z());
+	if (texCoord.y() < 0.0)
+		texCoord = cVector3d(texCoord.x(), 1.0 + texCoord.y(), texCoord.z());
+
+	return texCoord;
+}
+
+
+//==============================================================================
+/*!
+    Updates the distance the contact travels in texture coordinates per
+    tick, i.e. the proxy velocity over the haptic rate, in texture space.
+    The distance wraps around like the coordinates do, and is low-pass
+    filtered so that the mip level does not chatter with the device noise.
+    A contact on a new object starts from the last distance; its coordinates
+    are unrelated to those of the previous object.
+*/
+//==============================================================================
+void MyProxyAlgorithm::updateTexCoordFootprint(const cGenericObject* object, const cVector3d& texCoord)
+{
+	if (object == previousContactObject)
+	{
+		double du = fabs(texCoord.x() - previousTexCoord.x());
+		double dv = fabs(texCoord.y() - previousTexCoord.y());
+		du = cMin(du, 1.0 - du);
+		dv = cMin(dv, 1.0 - dv);
+
+		double step = sqrt(du * du + dv * dv);
+		texCoordFootprint += C_FOOTPRINT_FILTER * (step - texCoordFootprint);
+	}
+
+	previousContactObject = object;
+	previousTexCoord = texCoord;
+}
+
+
+//==============================================================================
+/*!
+    Fills the contact model of the servo loop from the contact of this tick:
+    the proxy and device positions, the force and its base, the plane of
+    the contact and, for the mapped kernel, what the servo loop needs to
+    shade the force itself between ticks: the tangent frame, the gradient of
+    the texture coordinate along the surface and a patch of the texels
+    around the contact at the mip level of the stroke.
+*/
+//==============================================================================
+void MyProxyAlgorithm::fillContactModel(const cVector3d& baseForce, const cVector3d& shadedNormal)
+{
+	LocalContactModel& model = *contactModel;
+
+	model.inContact = (m_numCollisionEvents > 0) && contact.valid;
+	if (!model.inContact)
+		return;
+
+	model.frictionOn = frictionOn.load(std::memory_order_relaxed);
+
+	cVector3d tangentialForce = getTangentialForce();
+	for (int i = 0; i < 3; ++i)
+	{
+		model.proxyPos[i] = m_proxyGlobalPos(i);
+		model.devicePos[i] = m_deviceGlobalPos(i);
+		model.normal[i] = shadedNormal(i);
+		model.force[i] = m_lastGlobalForce(i);
+		model.baseForce[i] = baseForce(i);
+		model.tangentialForce[i] = tangentialForce(i);
+	}
+
+	double penetration = (m_proxyGlobalPos - m_deviceGlobalPos).length();
+	model.stiffness = (penetration > C_SMALL) ? (baseForce.length() / penetration) : 0.0;
+
+	// only the mapped force kernel is re-evaluated by the servo loop; the others are held
+	const MaterialKernel* kernel = contact.kernel;
+	model.textured = (kernel != NULL) && kernel->usesTexels &&
+		(kernel->force == MaterialKernelImpl<MATERIAL_KERNEL_MAPPED>::force);
+	if (!model.textured)
+		return;
+
+	model.smoothness = kernel->params->load(std::memory_order_acquire)->smoothnessConstant;
+
+	cMatrix3d rotation = contact.object->getGlobalRot();
+	const TangentFrame& frame = *contact.tangentFrame;
+	cVector3d tangent = rotation * cVector3d(frame.tangent[0], frame.tangent[1], frame.tangent[2]);
+	cVector3d bitangent = rotation * cVector3d(frame.bitangent[0], frame.bitangent[1], frame.bitangent[2]);
+	cVector3d normal = rotation * cVector3d(frame.normal[0], frame.normal[1], frame.normal[2]);
+	// the green channel of the normal maps points against the bitangent
+	for (int i = 0; i < 3; ++i)
+	{
+		model.frame[i][0] = tangent(i);
+		model.frame[i][1] = -bitangent(i);
+		model.frame[i][2] = normal(i);
+	}
+
+	// Gradient of the texture coordinate in the plane of the contact triangle: the vector g
+	// of the plane with g.e1 = du1 and g.e2 = du2 along both edges (same for v).
+	cCollisionEvent* c0 = &m_collisionRecorderConstraint0.m_nearestCollision;
+	cVertexArrayPtr vertices = c0->m_triangles->m_vertices;
+	unsigned int i0 = c0->m_triangles->getVertexIndex0(c0->m_index);
+	unsigned int i1 = c0->m_triangles->getVertexIndex1(c0->m_index);
+	unsigned int i2 = c0->m_triangles->getVertexIndex2(c0->m_index);
+
+	cVector3d e1 = vertices->getLocalPos(i1) - vertices->getLocalPos(i0);
+	cVector3d e2 = vertices->getLocalPos(i2) - vertices->getLocalPos(i0);
+	cVector3d t1 = vertices->getTexCoord(i1) - vertices->getTexCoord(i0);
+	cVector3d t2 = vertices->getTexCoord(i2) - vertices->getTexCoord(i0);
+
+	double g11 = e1.dot(e1);
+	double g12 = e1.dot(e2);
+	double g22 = e2.dot(e2);
+	double det = g11 * g22 - g12 * g12;
+
+	cVector3d gradU(0.0, 0.0, 0.0);
+	cVector3d gradV(0.0, 0.0, 0.0);
+	if (fabs(det) > C_SMALL)
+	{
+		gradU = ((g22 * t1.x() - g12 * t2.x()) / det) * e1 + ((g11 * t2.x() - g12 * t1.x()) / det) * e2;
+		gradV = ((g22 * t1.y() - g12 * t2.y()) / det) * e1 + ((g11 * t2.y() - g12 * t1.y()) / det) * e2;
+		gradU = rotation * gradU;
+		gradV = rotation * gradV;
+	}
+
+	model.texCoord[0] = contact.texCoord.x();
+	model.texCoord[1] = contact.texCoord.y();
+	for (int i = 0; i < 3; ++i)
+	{
+		model.texCoordGradU[i] = gradU(i);
+		model.texCoordGradV[i] = gradV(i);
+	}
+
+	kernel->texels->copyPatch(contact.texCoord.x(), contact.texCoord.y(), (unsigned int)contact.mipLevel,
+		C_CONTACT_PATCH_SIZE, model.patch, model.patchOrigin, model.patchTexelSize);
+}
+
+
+//==============================================================================
+/*!
+    Publishes the telemetry record of the current tick. Called by the haptic
+    thread at the end of updateForce(); never blocks.
+*/
+//==============================================================================
+void MyProxyAlgorithm::publishTelemetry()
+{
+	HapticTelemetryRecord record;
+	record.tick = ++tickCount;
+	record.numContacts = m_numCollisionEvents;
+	storeTelemetry(m_proxyGlobalPos, record.proxyGlobalPos);
+	storeTelemetry(m_deviceGlobalPos, record.deviceGlobalPos);
+	storeTelemetry(m_lastGlobalForce, record.force);
+	storeTelemetry(surfaceNorm, record.surfaceNormal);
+	storeTelemetry(normalMapNorm, record.normalMapNormal);
+	record.height = heightAtContact;
+	record.roughness = roughnessAtContact;
+
+	// reused from the contact context rather than recomputed
+	storeTelemetry(contact.valid ? contact.texCoord : cVector3d(0.0, 0.0, 0.0), record.texCoord);
+	record.mipLevel = contact.valid ? contact.mipLevel : 0.0;
+
+	telemetry.publish(record);
 }
\ No newline at end of file
@@ -18,33 +18,65 @@
 #define MYPROXYALGORITHM_H
 
 #include "chai3d.h"
+#include "HapticTelemetry.h"
+#include "HapticLatency.h"
+#include "MaterialKernels.h"
+#include <atomic>
+
+struct LocalContactModel;
 
 //------------------------------------------------------------------------------
 
 class MyProxyAlgorithm : public chai3d::cAlgorithmFingerProxy
 {
 public:
-	chai3d::cVector3d m_debugVector;
-	chai3d::cColorb m_colorAtCollision;
-	chai3d::cColorb m_roughnessAtCollision;
-	chai3d::cColorb m_heightAtCollision;
-	chai3d::cColorb m_normalColorAtCollision;
+	MyProxyAlgorithm();
+	void setFrictionOn(bool iWantItOn);
 
+	//! Telemetry published by the haptic thread once per tick. Safe to read from any thread.
+	const HapticTelemetryChannel& getTelemetry() const { return telemetry; }
 
-	chai3d::cVector3d normalMapNorm;
-	chai3d::cVector3d surfaceNorm;
-	chai3d::cVector3d perturbedNorm;
-	chai3d::cVector3d deltaHVector;
-	double penDepthDebug, dHx, dHy, dHz;
+	//! Records the durations of testFrictionAndMoveProxy() and updateForce() into a monitor (NULL to stop).
+	void setLatencyMonitor(HapticLatencyMonitor* monitor) { latencyMonitor = monitor; }
 
-	MyProxyAlgorithm();
-	void setFrictionOn(bool iWantItOn);
+	//! Fills a contact model for the servo loop at the end of every tick (NULL to stop). Set before the haptic thread starts.
+	void setContactModel(LocalContactModel* model) { contactModel = model; }
 
 protected:
 
 
 	chai3d::cVector3d previousPerturbedNormal;
-	bool frictionOn;
+
+	// Toggled from the graphics thread, read by the haptic thread.
+	std::atomic<bool> frictionOn;
+
+	// Normals and maps at the last textured contact (haptic thread only).
+	chai3d::cVector3d normalMapNorm;
+	chai3d::cVector3d surfaceNorm;
+	double heightAtContact;
+	double roughnessAtContact;
+
+	// Contact of the previous tick, and the distance travelled per tick in texture
+	// coordinates that selects the haptic mip level (haptic thread only).
+	const chai3d::cGenericObject* previousContactObject;
+	chai3d::cVector3d previousTexCoord;
+	double texCoordFootprint;
+
+	// Ticks rendered so far and the channel they are published to.
+	unsigned long long tickCount;
+	HapticTelemetryChannel telemetry;
+
+	// Contact of the current tick, shared by the friction and force stages (haptic thread only).
+	ContactContext contact;
+
+	// Monitor of the force computation phases, and the time spent building the contact
+	// context and moving the proxy this tick.
+	HapticLatencyMonitor* latencyMonitor;
+	unsigned long long contactTime;
+	unsigned long long moveProxyTime;
+
+	// Contact model filled for the servo loop, or NULL (haptic thread only).
+	LocalContactModel* contactModel;
 
 
     //! This method computes the resulting force which will be sent to the haptic device.
@@ -55,6 +87,28 @@ protected:
                                           const chai3d::cVector3d& a_proxy,
                                           chai3d::cVector3d& a_normal,
                                           chai3d::cGenericObject* a_parent);
+
+	//! Moves the proxy within the friction cone of the given coefficients, without touching the scene.
+	void moveProxyInFrictionCone(const chai3d::cVector3d& a_goal,
+	                             const chai3d::cVector3d& a_proxy,
+	                             const chai3d::cVector3d& a_normal,
+	                             double a_staticFriction,
+	                             double a_dynamicFriction);
+
+	//! Builds the contact context of this tick from the nearest contact, unless it is already built.
+	void updateContactContext();
+
+	//! Returns the texture coordinate of a contact, wrapped into [0, 1].
+	chai3d::cVector3d computeContactTexCoord(chai3d::cCollisionEvent* a_event);
+
+	//! Updates the texture distance travelled per tick from the contact of this tick.
+	void updateTexCoordFootprint(const chai3d::cGenericObject* object, const chai3d::cVector3d& texCoord);
+
+	//! Fills the contact model of the servo loop from the contact of this tick.
+	void fillContactModel(const chai3d::cVector3d& baseForce, const chai3d::cVector3d& shadedNormal);
+
+	//! Publishes the telemetry record of the current tick.
+	void publishTelemetry();
 };
 
 //------------------------------------------------------------------------------
@@ -0,0 +1,146 @@
+//==============================================================================
+/*
+    CPSC 599.86 / 601.86 - Computer Haptics
+    Winter 2018, University of Calgary
+
+    Periodic profiles of the procedural haptic textures, baked into lookup
+    tables at load time.
+*/
+//==============================================================================
+
+#include "ProceduralTextures.h"
+#include "chai3d.h"
+
+using namespace chai3d;
+
+//==============================================================================
+/*!
+    Constructor of PeriodicTable.
+*/
+//==============================================================================
+PeriodicTable::PeriodicTable()
+{
+    for (int i = 0; i <= C_SIZE; ++i)
+    {
+        m_values[i] = 0.0f;
+    }
+}
+
+
+//==============================================================================
+/*!
+    Samples one period of a profile at C_SIZE + 1 points, both ends
+    included, so that a profile which does not match across the wrap keeps
+    its step at the seam instead of being smeared over the last interval.
+
+    \param  a_profile  Profile to sample, as a function of the coordinate in [0, 1].
+*/
+//==============================================================================
+void PeriodicTable::bake(PeriodicProfile a_profile)
+{
+    for (int i = 0; i <= C_SIZE; ++i)
+    {
+        m_values[i] = (float)a_profile((double)i / (double)C_SIZE);
+    }
+}
+
+
+//==============================================================================
+/*!
+    Tilt of the force along y while passing over the bumps: a half sine
+    over each white band, ramped in at its edges to avoid sharp changes in
+    force direction, and negated past the middle of the bump.
+
+    \param  a_t  Texture coordinate along u, in [0, 1].
+
+    \return Tilt, as a fraction of the force magnitude before scaling.
+*/
+//==============================================================================
+double bumpTiltProfile(double a_t)
+{
+	// yVariant is used to vary the force in the y direction.
+	// negator is used to negate the y variant when passing over the middle of the bump.
+	double yVariant = sin(0.7 + 19.5*M_PI*a_t);
+	double negator = sin(0.7 + 1.5*M_PI + 19.5*M_PI*a_t);
+
+	double blendDistance = 0.15;
+	double blendAmount = 1.0;
+
+	// yVariant is between 0 and 1 when passing over white bands.
+	if (yVariant <= 0.0)
+		return 0.0;
+
+	// Blend perturbation over short distance to avoid sharp changes in force direction.
+	if (yVariant < blendAmount)
+		blendAmount = yVariant / blendDistance;
+
+	yVariant = 1.0 - yVariant;
+	yVariant *= blendAmount;
+
+	if (negator < 0.0)
+		yVariant = -yVariant;
+
+	return yVariant;
+}
+
+
+//==============================================================================
+/*!
+    White bands of the bumps, where the force is scaled up by the height.
+
+    \param  a_t  Texture coordinate along u, in [0, 1].
+
+    \return 1 over a band, 0 between bands.
+*/
+//==============================================================================
+double bumpBandProfile(double a_t)
+{
+	return (sin(0.7 + 19.5*M_PI*a_t) > 0.0) ? 1.0 : 0.0;
+}
+
+
+//==============================================================================
+/*!
+    Friction over the rocky strips: it rises sharply over each strip and
+    drops to zero between them.
+
+    \param  a_t  Texture coordinate along v, in [0, 1].
+
+    \return Multiplier of the base friction coefficients.
+*/
+//==============================================================================
+double stickSlipProfile(double a_t)
+{
+	double frictionVariant = sin(9.75*M_PI*a_t + 0.5);
+
+	// Friction variant is > 0.0 when over the rocky surfaces.
+	frictionVariant = ((frictionVariant > 0.0) ? frictionVariant : 0.0);
+
+	return pow((1.0 + frictionVariant), 3) - 1.0;
+}
+
+
+//==============================================================================
+/*!
+    Returns the tables of every procedural profile, baking them on the
+    first call. Materials fetch them once when their kernel is bound; the
+    haptic thread only reads them through the kernel.
+
+    \return Baked tables, valid until the program exits.
+*/
+//==============================================================================
+const ProceduralTextures* getProceduralTextures()
+{
+    struct Baked : public ProceduralTextures
+    {
+        Baked()
+        {
+            bumpTilt.bake(bumpTiltProfile);
+            bumpBands.bake(bumpBandProfile);
+            stickSlip.bake(stickSlipProfile);
+        }
+    };
+
+    static const Baked textures;
+    return (&textures);
+}
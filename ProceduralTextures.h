@@ -0,0 +1,89 @@
+//==============================================================================
+/*
+    CPSC 599.86 / 601.86 - Computer Haptics
+    Winter 2018, University of Calgary
+
+    Periodic profiles of the procedural haptic textures (bumps, bands,
+    stick-slip strips). A profile is declared as a plain function of the
+    texture coordinate over one period, and baked at load time into a
+    fixed-size lookup table. The haptic tick then wraps the coordinate and
+    interpolates the table, without evaluating any transcendental function.
+    A new procedural texture only needs a new profile function and a table
+    in ProceduralTextures.
+*/
+//==============================================================================
+
+#ifndef PROCEDURALTEXTURES_H
+#define PROCEDURALTEXTURES_H
+
+#include <cmath>
+
+//------------------------------------------------------------------------------
+
+//! A profile over one period, as a function of the coordinate in [0, 1].
+typedef double (*PeriodicProfile)(double a_t);
+
+//------------------------------------------------------------------------------
+
+//! One period of a profile sampled into a fixed-size table.
+class PeriodicTable
+{
+public:
+
+    //! Number of intervals the period is sampled with.
+    static const int C_SIZE = 4096;
+
+    //! Constructor of PeriodicTable. The table is zero until baked.
+    PeriodicTable();
+
+    //! Samples one period of a profile into the table.
+    void bake(PeriodicProfile a_profile);
+
+    //! Value at a coordinate, wrapped into the period and linearly interpolated.
+    inline double evaluate(double a_t) const
+    {
+        double x = (a_t - floor(a_t)) * (double)C_SIZE;
+        int i = (int)x;
+
+        // a tiny negative coordinate wraps to exactly 1.0
+        if (i >= C_SIZE)
+        {
+            i = C_SIZE - 1;
+        }
+
+        double f = x - (double)i;
+        return (m_values[i] + f * (m_values[i + 1] - m_values[i]));
+    }
+
+protected:
+
+    //! Samples at i / C_SIZE, both ends of the period included.
+    float m_values[C_SIZE + 1];
+};
+
+//------------------------------------------------------------------------------
+
+//! Signed tilt of the force across the bumps (procedural bumps, along u).
+double bumpTiltProfile(double a_t);
+
+//! 1 over the white bands of the bumps, 0 between them (procedural bumps, along u).
+double bumpBandProfile(double a_t);
+
+//! Friction multiplier of the rocky stick-slip strips (procedural friction, along v).
+double stickSlipProfile(double a_t);
+
+//------------------------------------------------------------------------------
+
+//! Baked tables of every procedural profile.
+struct ProceduralTextures
+{
+    PeriodicTable bumpTilt;
+    PeriodicTable bumpBands;
+    PeriodicTable stickSlip;
+};
+
+//! Tables shared by all materials, baked on the first call. Call at load time, not from the haptic thread.
+const ProceduralTextures* getProceduralTextures();
+
+//------------------------------------------------------------------------------
+#endif
@@ -0,0 +1,130 @@
+//==============================================================================
+/*
+    CPSC 599.86 / 601.86 - Computer Haptics
+    Winter 2018, University of Calgary
+
+    The assets of the 3x3 grid of textured objects, shared by the
+    application, the scenepack tool and the startup benchmark.
+*/
+//==============================================================================
+
+#include "SceneAssets.h"
+
+using namespace chai3d;
+using namespace std;
+
+//------------------------------------------------------------------------------
+
+const std::string trayMeshFile = "tray.obj";
+
+const std::string scenePackFile = "scene.pack";
+
+const std::string materialConfigFile = "materials.cfg";
+
+const std::string textureFiles[3][3] =
+{
+    { "Organic_Scales_001_colour.jpg", "Bricks_color.jpg", "Fabric_002_colour.jpg" },
+    { "bumps.png", "Metal_plate_001_colour.jpg", "friction.jpg" },
+    { "Leather_padded_001_colour.jpg", "Cobblestone_color.jpg", "Cork_001_colour.jpg" }
+};
+
+const std::string normalMaps[3][3] =
+{
+    { "Organic_Scales_001_normal.jpg", "Bricks_normal.jpg", "Fabric_002_normal.jpg" },
+    { "bumps.png", "Metal_plate_001_normal.jpg", "friction.jpg" },
+    { "Leather_padded_001_normal.jpg", "Cobblestone_normal.jpg", "Cork_001_normal.jpg" }
+};
+
+const std::string heightMaps[3][3] =
+{
+    { "Organic_Scales_001_height.jpg", "Bricks_height.jpg", "Fabric_002_height.jpg" },
+    { "bumps.png", "Metal_plate_001_height.jpg", "friction.jpg" },
+    { "Leather_padded_001_height.jpg", "Cobblestone_height.jpg", "Cork_001_height.jpg" }
+};
+
+const std::string roughnessMaps[3][3] =
+{
+    { "Organic_Scales_001_roughness.jpg", "Bricks_roughness.jpg", "Fabric_002_roughness.jpg" },
+    { "bumps.png", "Metal_plate_001_roughness.jpg", "friction.jpg" },
+    { "Leather_padded_001_roughness.jpg", "Cobblestone_roughness.jpg", "Cork_001_roughness.jpg" }
+};
+
+
+const std::string materialNames[3][3] =
+{
+    { "Scales", "Bricks", "Fabric" },
+    { "Bumps", "Metal", "Friction" },
+    { "Leather", "Cobblestone", "Cork" }
+};
+
+const MaterialKernelType materialKernels[3][3] =
+{
+    { MATERIAL_KERNEL_MAPPED, MATERIAL_KERNEL_MAPPED, MATERIAL_KERNEL_MAPPED },
+    { MATERIAL_KERNEL_PROCEDURAL_BUMPS, MATERIAL_KERNEL_MAPPED, MATERIAL_KERNEL_PROCEDURAL_FRICTION },
+    { MATERIAL_KERNEL_MAPPED, MATERIAL_KERNEL_MAPPED, MATERIAL_KERNEL_MAPPED }
+};
+
+//==============================================================================
+/*!
+    Returns the paths of all the maps of the grid.
+
+    \return Albedo, normal, height and roughness map of each object, row by row.
+*/
+//==============================================================================
+vector<string> getSceneImageFiles()
+{
+    vector<string> files;
+    for (int i = 0; i < 3; ++i)
+    {
+        for (int j = 0; j < 3; ++j)
+        {
+            files.push_back("images/" + textureFiles[i][j]);
+            files.push_back("images/" + normalMaps[i][j]);
+            files.push_back("images/" + heightMaps[i][j]);
+            files.push_back("images/" + roughnessMaps[i][j]);
+        }
+    }
+    return (files);
+}
+
+
+//==============================================================================
+/*!
+    Requests every asset of the grid from a cache the way main() does, so
+    that the cache holds the meshes, images, texel maps and tangent frames
+    of the scene. The mesh instances are deleted again.
+
+    \param  a_cache       Cache to fill.
+    \param  a_toolRadius  Radius of the tool, used to build the collision trees.
+*/
+//==============================================================================
+void loadSceneAssets(AssetCache* a_cache, double a_toolRadius)
+{
+    a_cache->preloadTextures(getSceneImageFiles());
+
+    vector<cMultiMesh*> instances;
+    for (int i = 0; i < 3; ++i)
+    {
+        for (int j = 0; j < 3; ++j)
+        {
+            cMultiMesh* object = a_cache->newMeshInstance(trayMeshFile, a_toolRadius);
+            if (object == NULL)
+            {
+                continue;
+            }
+            instances.push_back(object);
+
+            a_cache->getTexture("images/" + textureFiles[i][j]);
+            a_cache->getHapticTexels(a_cache->getTexture("images/" + normalMaps[i][j]),
+                                     a_cache->getTexture("images/" + heightMaps[i][j]),
+                                     a_cache->getTexture("images/" + roughnessMaps[i][j]));
+            a_cache->getTangentFrames(object->getMesh(0));
+        }
+    }
+
+    a_cache->releaseInstances();
+    for (unsigned int i = 0; i < instances.size(); i++)
+    {
+        delete instances[i];
+    }
+}
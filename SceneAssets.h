@@ -0,0 +1,49 @@
+//==============================================================================
+/*
+    CPSC 599.86 / 601.86 - Computer Haptics
+    Winter 2018, University of Calgary
+
+    The assets of the 3x3 grid of textured objects, shared by the
+    application, the scenepack tool and the startup benchmark.
+*/
+//==============================================================================
+
+#ifndef SCENEASSETS_H
+#define SCENEASSETS_H
+
+#include "AssetCache.h"
+#include "MaterialKernels.h"
+#include <string>
+#include <vector>
+
+//------------------------------------------------------------------------------
+
+//! Mesh file of every object of the grid.
+extern const std::string trayMeshFile;
+
+//! Scene pack written by the scenepack tool and loaded by the application.
+extern const std::string scenePackFile;
+
+//! Material parameters, reloaded by the application whenever the file changes.
+extern const std::string materialConfigFile;
+
+//! Albedo, normal, height and roughness maps of each object, relative to images/.
+extern const std::string textureFiles[3][3];
+extern const std::string normalMaps[3][3];
+extern const std::string heightMaps[3][3];
+extern const std::string roughnessMaps[3][3];
+
+//! Name of each object's material in the material config file, and the kernel rendering it.
+extern const std::string materialNames[3][3];
+extern const MaterialKernelType materialKernels[3][3];
+
+//------------------------------------------------------------------------------
+
+//! Paths of all the maps of the grid, in the order the grid uses them.
+std::vector<std::string> getSceneImageFiles();
+
+//! Requests every asset of the grid from a cache, then releases the instances.
+void loadSceneAssets(AssetCache* a_cache, double a_toolRadius);
+
+//------------------------------------------------------------------------------
+#endif
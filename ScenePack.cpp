@@ -0,0 +1,304 @@
+//==============================================================================
+/*
+    CPSC 599.86 / 601.86 - Computer Haptics
+    Winter 2018, University of Calgary
+
+    A scene pack holds the pre-processed assets of the scene in a single
+    versioned binary file that the application maps and uses in place.
+*/
+//==============================================================================
+
+#include "ScenePack.h"
+#include "HapticTexelMap.h"
+#include "TangentFrames.h"
+#include <cstdio>
+#include <cstring>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+//------------------------------------------------------------------------------
+
+namespace
+{
+    const char SCENE_PACK_MAGIC[8] = { 'H', 'A', 'P', 'T', 'P', 'A', 'C', 'K' };
+
+    size_t alignUp(size_t a_value)
+    {
+        return ((a_value + SCENE_PACK_ALIGNMENT - 1) & ~(size_t)(SCENE_PACK_ALIGNMENT - 1));
+    }
+}
+
+
+//==============================================================================
+/*!
+    Constructor of ScenePack.
+*/
+//==============================================================================
+ScenePack::ScenePack()
+{
+    m_data = NULL;
+    m_size = 0;
+    m_entries = NULL;
+    m_numEntries = 0;
+    m_file = NULL;
+    m_mapping = NULL;
+}
+
+
+//==============================================================================
+/*!
+    Destructor of ScenePack.
+*/
+//==============================================================================
+ScenePack::~ScenePack()
+{
+    close();
+}
+
+
+//==============================================================================
+/*!
+    Maps a pack file read-only and checks its magic, version, record sizes
+    and that every entry lies inside the file.
+
+    \param  a_filename  Pack file.
+
+    \return true if the pack was mapped and is valid.
+*/
+//==============================================================================
+bool ScenePack::open(const string& a_filename)
+{
+    close();
+
+#if defined(_WIN32)
+    HANDLE file = CreateFileA(a_filename.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        return (false);
+    }
+
+    LARGE_INTEGER size;
+    HANDLE mapping = NULL;
+    if (GetFileSizeEx(file, &size) && (size.QuadPart > 0))
+    {
+        mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    }
+    if (mapping == NULL)
+    {
+        CloseHandle(file);
+        return (false);
+    }
+
+    m_data = (const unsigned char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (m_data == NULL)
+    {
+        CloseHandle(mapping);
+        CloseHandle(file);
+        return (false);
+    }
+
+    m_file = file;
+    m_mapping = mapping;
+    m_size = (size_t)size.QuadPart;
+#else
+    int file = ::open(a_filename.c_str(), O_RDONLY);
+    if (file < 0)
+    {
+        return (false);
+    }
+
+    struct stat status;
+    if ((fstat(file, &status) != 0) || (status.st_size <= 0))
+    {
+        ::close(file);
+        return (false);
+    }
+
+    void* data = mmap(NULL, (size_t)status.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+    ::close(file);
+    if (data == MAP_FAILED)
+    {
+        return (false);
+    }
+
+    m_data = (const unsigned char*)data;
+    m_size = (size_t)status.st_size;
+#endif
+
+    // validate the header and the entry table
+    const ScenePackHeader* header = (const ScenePackHeader*)m_data;
+    bool valid = (m_size >= sizeof(ScenePackHeader)) &&
+                 (memcmp(header->magic, SCENE_PACK_MAGIC, sizeof(SCENE_PACK_MAGIC)) == 0) &&
+                 (header->version == SCENE_PACK_VERSION) &&
+                 (header->vertexSize == sizeof(ScenePackVertex)) &&
+                 (header->tangentFrameSize == sizeof(TangentFrame)) &&
+                 (header->texelSize == sizeof(HapticTexel)) &&
+                 (m_size >= sizeof(ScenePackHeader) + (size_t)header->numEntries * sizeof(ScenePackEntry));
+
+    if (valid)
+    {
+        m_entries = (const ScenePackEntry*)(m_data + sizeof(ScenePackHeader));
+        m_numEntries = header->numEntries;
+
+        for (unsigned int i = 0; i < m_numEntries; i++)
+        {
+            if ((m_entries[i].offset > m_size) || (m_entries[i].size > m_size - m_entries[i].offset))
+            {
+                valid = false;
+            }
+        }
+    }
+
+    if (!valid)
+    {
+        close();
+        return (false);
+    }
+
+    return (true);
+}
+
+
+//==============================================================================
+/*!
+    Unmaps the pack file.
+*/
+//==============================================================================
+void ScenePack::close()
+{
+    if (m_data != NULL)
+    {
+#if defined(_WIN32)
+        UnmapViewOfFile(m_data);
+        CloseHandle((HANDLE)m_mapping);
+        CloseHandle((HANDLE)m_file);
+#else
+        munmap((void*)m_data, m_size);
+#endif
+    }
+
+    m_data = NULL;
+    m_size = 0;
+    m_entries = NULL;
+    m_numEntries = 0;
+    m_file = NULL;
+    m_mapping = NULL;
+}
+
+
+//==============================================================================
+/*!
+    Finds an entry by type, key and index.
+
+    \param  a_type   Entry type (ScenePackEntryType).
+    \param  a_key    Key of the entry; unused key words are zero.
+    \param  a_index  Index of the entry (e.g. mesh index).
+
+    \return Entry, or NULL if the pack has none.
+*/
+//==============================================================================
+const ScenePackEntry* ScenePack::findEntry(unsigned int a_type, const unsigned long long a_key[3], unsigned int a_index) const
+{
+    for (unsigned int i = 0; i < m_numEntries; i++)
+    {
+        const ScenePackEntry& entry = m_entries[i];
+        if ((entry.type == a_type) && (entry.index == a_index) &&
+            (entry.key[0] == a_key[0]) && (entry.key[1] == a_key[1]) && (entry.key[2] == a_key[2]))
+        {
+            return (&entry);
+        }
+    }
+
+    return (NULL);
+}
+
+
+//==============================================================================
+/*!
+    Adds an entry to the pack. The data is copied into an aligned block.
+
+    \param  a_entry  Entry; its offset and size are filled in.
+    \param  a_data   Data of the entry, or NULL.
+    \param  a_size   Size of the data in bytes.
+*/
+//==============================================================================
+void ScenePackWriter::addEntry(const ScenePackEntry& a_entry, const void* a_data, size_t a_size)
+{
+    size_t offset = alignUp(m_payload.size());
+    m_payload.resize(offset + a_size, 0);
+    if (a_size > 0)
+    {
+        memcpy(&m_payload[offset], a_data, a_size);
+    }
+
+    ScenePackEntry entry = a_entry;
+    entry.offset = offset;
+    entry.size = a_size;
+    m_entries.push_back(entry);
+}
+
+
+//==============================================================================
+/*!
+    Writes the header, the entry table and the data of all entries.
+
+    \param  a_filename  Pack file to write.
+
+    \return true if the file was written.
+*/
+//==============================================================================
+bool ScenePackWriter::save(const string& a_filename) const
+{
+    ScenePackHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, SCENE_PACK_MAGIC, sizeof(SCENE_PACK_MAGIC));
+    header.version = SCENE_PACK_VERSION;
+    header.numEntries = (unsigned int)m_entries.size();
+    header.vertexSize = sizeof(ScenePackVertex);
+    header.tangentFrameSize = sizeof(TangentFrame);
+    header.texelSize = sizeof(HapticTexel);
+
+    // the data follows the entry table, starting on an aligned offset
+    size_t tableEnd = sizeof(ScenePackHeader) + m_entries.size() * sizeof(ScenePackEntry);
+    size_t payloadStart = alignUp(tableEnd);
+
+    vector<ScenePackEntry> entries = m_entries;
+    for (unsigned int i = 0; i < entries.size(); i++)
+    {
+        entries[i].offset += payloadStart;
+    }
+
+    FILE* file = fopen(a_filename.c_str(), "wb");
+    if (file == NULL)
+    {
+        return (false);
+    }
+
+    vector<unsigned char> padding(payloadStart - tableEnd, 0);
+
+    bool ok = (fwrite(&header, sizeof(header), 1, file) == 1);
+    if (ok && !entries.empty())
+    {
+        ok = (fwrite(&entries[0], sizeof(ScenePackEntry), entries.size(), file) == entries.size());
+    }
+    if (ok && !padding.empty())
+    {
+        ok = (fwrite(&padding[0], 1, padding.size(), file) == padding.size());
+    }
+    if (ok && !m_payload.empty())
+    {
+        ok = (fwrite(&m_payload[0], 1, m_payload.size(), file) == m_payload.size());
+    }
+
+    ok = (fclose(file) == 0) && ok;
+    return (ok);
+}
@@ -0,0 +1,164 @@
+//==============================================================================
+/*
+    CPSC 599.86 / 601.86 - Computer Haptics
+    Winter 2018, University of Calgary
+
+    A scene pack holds the pre-processed assets of the scene in a single
+    versioned binary file, written offline by the scenepack tool:
+
+        ScenePackHeader
+        ScenePackEntry[numEntries]
+        entry data, each block aligned to SCENE_PACK_ALIGNMENT bytes
+
+    Mesh vertices (with their BTN vectors), triangles, tangent frames,
+    decoded images and baked haptic texels are stored exactly as they are
+    used in memory, so the application maps the file and uses the data in
+    place. Packs are written in the byte order of the machine that builds
+    them and are rejected if the version or record sizes do not match.
+*/
+//==============================================================================
+
+#ifndef SCENEPACK_H
+#define SCENEPACK_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+//------------------------------------------------------------------------------
+
+#define SCENE_PACK_VERSION      2
+#define SCENE_PACK_ALIGNMENT    64
+
+//! Kinds of pack entries.
+enum ScenePackEntryType
+{
+    //! Source file: name is its path, key[0] its content hash, key[1] its size and key[2] its modification time (s). No data.
+    SCENE_PACK_FILE = 1,
+
+    //! Vertices (ScenePackVertex[count]) of mesh index of the mesh file key[0].
+    SCENE_PACK_MESH_VERTICES,
+
+    //! Triangles (3 x unsigned int [count]) of mesh index of the mesh file key[0].
+    SCENE_PACK_MESH_TRIANGLES,
+
+    //! Tangent frames (TangentFrame[count]) of mesh index of the mesh file key[0].
+    SCENE_PACK_TANGENT_FRAMES,
+
+    //! Decoded image file key[0]: width x height pixels of count bytes, in GL format.
+    SCENE_PACK_IMAGE,
+
+    //! Haptic texels (HapticTexel[width x height]) baked from image files key[0..2].
+    SCENE_PACK_TEXELS
+};
+
+//------------------------------------------------------------------------------
+
+struct ScenePackHeader
+{
+    char magic[8];
+    unsigned int version;
+    unsigned int numEntries;
+
+    //! Record sizes the pack was written with.
+    unsigned int vertexSize;
+    unsigned int tangentFrameSize;
+    unsigned int texelSize;
+    unsigned int reserved;
+};
+
+struct ScenePackEntry
+{
+    unsigned int type;
+    unsigned int index;
+    unsigned long long key[3];
+
+    //! Location of the data from the start of the file.
+    unsigned long long offset;
+    unsigned long long size;
+
+    unsigned int count;
+    unsigned int width;
+    unsigned int height;
+    unsigned int format;
+
+    char name[128];
+};
+
+//! A mesh vertex as stored in a pack.
+struct ScenePackVertex
+{
+    double pos[3];
+    double normal[3];
+    double tangent[3];
+    double bitangent[3];
+    double texCoord[3];
+};
+
+//------------------------------------------------------------------------------
+
+//! A scene pack mapped read-only into memory.
+class ScenePack
+{
+public:
+
+    //! Constructor of ScenePack.
+    ScenePack();
+
+    //! Destructor of ScenePack. Unmaps the file.
+    ~ScenePack();
+
+    //! Maps a pack file and validates its header and entry table.
+    bool open(const std::string& a_filename);
+
+    //! Unmaps the file. Data obtained from the pack must no longer be used.
+    void close();
+
+    //! Number of entries in the pack.
+    unsigned int getNumEntries() const { return (m_numEntries); }
+
+    //! Entry a_index of the pack.
+    const ScenePackEntry& getEntry(unsigned int a_index) const { return (m_entries[a_index]); }
+
+    //! Finds an entry by type, key and index. Returns NULL if there is none.
+    const ScenePackEntry* findEntry(unsigned int a_type, const unsigned long long a_key[3], unsigned int a_index = 0) const;
+
+    //! Data of an entry, in the mapped file.
+    const void* getData(const ScenePackEntry& a_entry) const { return (m_data + a_entry.offset); }
+
+protected:
+
+    const unsigned char* m_data;
+    size_t m_size;
+
+    const ScenePackEntry* m_entries;
+    unsigned int m_numEntries;
+
+    //! Platform handles of the mapping.
+    void* m_file;
+    void* m_mapping;
+};
+
+//------------------------------------------------------------------------------
+
+//! Collects pack entries and writes them to a file.
+class ScenePackWriter
+{
+public:
+
+    //! Adds an entry; its data is copied. offset and size are filled in.
+    void addEntry(const ScenePackEntry& a_entry, const void* a_data, size_t a_size);
+
+    //! Writes the pack. Returns false if the file cannot be written.
+    bool save(const std::string& a_filename) const;
+
+protected:
+
+    std::vector<ScenePackEntry> m_entries;
+
+    //! Entry data, each block aligned; offsets are relative to its start.
+    std::vector<unsigned char> m_payload;
+};
+
+//------------------------------------------------------------------------------
+#endif
@@ -0,0 +1,214 @@
+//==============================================================================
+/*
+    CPSC 599.86 / 601.86 - Computer Haptics
+    Winter 2018, University of Calgary
+
+    Builds the haptic part of the world: the grid of textured trays and the
+    tool with the custom proxy algorithm.
+*/
+//==============================================================================
+
+#include "SceneSetup.h"
+#include "SceneAssets.h"
+#include <iostream>
+
+using namespace chai3d;
+using namespace std;
+
+//==============================================================================
+/*!
+    Creates one tray of the tray pattern, which repeats the 3x3 grid of
+    surfaces in every direction. The tray is an instance of the tray mesh
+    from the cache, with its albedo map and a MyMaterial holding its haptic
+    maps, texels, tangent frames and parameter slot. Its haptic kernel is
+    bound here.
+
+    \param  a_cache       Cache providing the meshes and maps.
+    \param  a_library     Library providing the material parameters.
+    \param  a_toolRadius  Radius of the tool, used to build the collision trees.
+    \param  a_i           Column of the tray; any integer.
+    \param  a_j           Row of the tray; any integer.
+    \param  a_material    Returned material of the tray, if not NULL.
+
+    \return The tray, positioned but not added to a world.
+*/
+//==============================================================================
+cMultiMesh* createTray(AssetCache* a_cache,
+                       MaterialLibrary* a_library,
+                       double a_toolRadius,
+                       int a_i,
+                       int a_j,
+                       MyMaterial** a_material)
+{
+    // surface of the 3x3 pattern this tray repeats
+    int i = ((a_i % 3) + 3) % 3;
+    int j = ((a_j % 3) + 3) % 3;
+
+    // instance of the tray, sharing its geometry, BTN vectors and collision tree
+    cMultiMesh* object = a_cache->newMeshInstance(trayMeshFile, a_toolRadius);
+
+    // obtain the first (and only) mesh from the object
+    cMesh* mesh = object->getMesh(0);
+
+    // replace the object's material with a custom one
+    MyMaterialPtr material = MyMaterial::create();
+    mesh->m_material = material;
+    mesh->m_material->setWhite();
+    mesh->m_material->setUseHapticShading(true);
+    mesh->m_material->setUseHapticTexture(true);
+    object->setStiffness(2000.0, true);
+
+    // assign the colour texture map
+    mesh->m_texture = a_cache->getTexture("images/" + textureFiles[i][j]);
+    mesh->setUseTexture(true);
+
+    cTexture2dPtr normalMap = a_cache->getTexture("images/" + normalMaps[i][j]);
+    cTexture2dPtr heightMap = a_cache->getTexture("images/" + heightMaps[i][j]);
+    cTexture2dPtr roughnessMap = a_cache->getTexture("images/" + roughnessMaps[i][j]);
+
+    material->normalMap = normalMap;
+    material->heightMap = heightMap;
+    material->roughnessMap = roughnessMap;
+    material->hapticTexels = a_cache->getHapticTexels(normalMap, heightMap, roughnessMap);
+    material->tangentFrames = a_cache->getTangentFrames(mesh);
+    material->objectID = i * 3 + j;
+    material->params = a_library->getParams(materialNames[i][j]);
+
+    // resolve the haptic kernel once; the haptic thread calls it through the mesh
+    if (!material->bindKernel(materialKernels[i][j], mesh))
+    {
+        cout << "failed to bind haptic kernel for " << textureFiles[i][j] << endl;
+    }
+
+    // set the position of this object
+    double xpos = -C_TRAY_SPACING + a_i * C_TRAY_SPACING;
+    double ypos = -C_TRAY_SPACING + a_j * C_TRAY_SPACING;
+    object->setLocalPos(xpos, ypos);
+
+    if (a_material != NULL)
+    {
+        *a_material = material.get();
+    }
+
+    return (object);
+}
+
+
+//==============================================================================
+/*!
+    Adds the 3x3 grid of trays (columns and rows 0 to 2 of the tray
+    pattern) to a world.
+
+    \param  a_world        World to add the trays to.
+    \param  a_cache        Cache providing the meshes and maps.
+    \param  a_library      Library providing the material parameters.
+    \param  a_toolRadius   Radius of the tool, used to build the collision trees.
+    \param  a_objects      Returned trays, by grid cell.
+    \param  a_materials    Returned materials, in row-major order.
+*/
+//==============================================================================
+void createTrayGrid(cWorld* a_world,
+                    AssetCache* a_cache,
+                    MaterialLibrary* a_library,
+                    double a_toolRadius,
+                    cMultiMesh* a_objects[3][3],
+                    MyMaterial* a_materials[9])
+{
+    for (int i = 0; i < 3; ++i)
+    {
+        for (int j = 0; j < 3; ++j)
+        {
+            a_objects[i][j] = createTray(a_cache, a_library, a_toolRadius, i, j, &a_materials[i * 3 + j]);
+            a_world->addChild(a_objects[i][j]);
+        }
+    }
+}
+
+
+//==============================================================================
+/*!
+    Extends the 3x3 grid of trays to a larger square grid with the same
+    spacing, for scaling tests. Cell (i, j) repeats tray (i % 3, j % 3): an
+    instance of the same mesh sharing its material, texture and haptic
+    kernel, so the new trays cost no texture or parameter memory.
+
+    \param  a_world       World holding the 3x3 grid.
+    \param  a_cache       Cache providing the mesh.
+    \param  a_toolRadius  Radius of the tool, used to build the collision trees.
+    \param  a_objects     Trays of the 3x3 grid.
+    \param  a_gridSize    Number of trays along a side of the extended grid.
+*/
+//==============================================================================
+void extendTrayGrid(cWorld* a_world,
+                    AssetCache* a_cache,
+                    double a_toolRadius,
+                    cMultiMesh* a_objects[3][3],
+                    int a_gridSize)
+{
+    for (int i = 0; i < a_gridSize; ++i)
+    {
+        for (int j = 0; j < a_gridSize; ++j)
+        {
+            if ((i < 3) && (j < 3))
+            {
+                continue;
+            }
+
+            cMesh* source = a_objects[i % 3][j % 3]->getMesh(0);
+
+            cMultiMesh* object = a_cache->newMeshInstance(trayMeshFile, a_toolRadius);
+            cMesh* mesh = object->getMesh(0);
+            mesh->m_material = source->m_material;
+            mesh->m_texture = source->m_texture;
+            mesh->setUseTexture(true);
+            mesh->m_userData = source->m_userData;
+            object->setStiffness(2000.0, true);
+
+            double xpos = -C_TRAY_SPACING + i * C_TRAY_SPACING;
+            double ypos = -C_TRAY_SPACING + j * C_TRAY_SPACING;
+            object->setLocalPos(xpos, ypos);
+
+            a_world->addChild(object);
+        }
+    }
+}
+
+
+//==============================================================================
+/*!
+    Adds a tool driven by a device to a world, replaces its proxy algorithm
+    with MyProxyAlgorithm and starts it (which opens the device).
+
+    \param  a_world             World to add the tool to.
+    \param  a_device            Device driving the tool.
+    \param  a_toolRadius        Radius of the proxy.
+    \param  a_proxyAlgorithm    Returned proxy algorithm, owned by the tool.
+
+    \return The tool.
+*/
+//==============================================================================
+cToolCursor* createTool(cWorld* a_world,
+                        cGenericHapticDevicePtr a_device,
+                        double a_toolRadius,
+                        MyProxyAlgorithm*& a_proxyAlgorithm)
+{
+    cToolCursor* tool = new cToolCursor(a_world);
+    a_world->addChild(tool);
+
+    // [CPSC.86] replace the tool's proxy rendering algorithm with our own
+    a_proxyAlgorithm = new MyProxyAlgorithm;
+    delete tool->m_hapticPoint->m_algorithmFingerProxy;
+    tool->m_hapticPoint->m_algorithmFingerProxy = a_proxyAlgorithm;
+
+    tool->m_hapticPoint->m_sphereProxy->m_material->setWhite();
+
+    tool->setRadius(C_CURSOR_DISPLAY_RADIUS, a_toolRadius);
+
+    tool->setHapticDevice(a_device);
+
+    tool->setWaitForSmallForce(true);
+
+    tool->start();
+
+    return (tool);
+}
@@ -0,0 +1,60 @@
+//==============================================================================
+/*
+    CPSC 599.86 / 601.86 - Computer Haptics
+    Winter 2018, University of Calgary
+
+    Builds the haptic part of the world: the grid of textured trays and the
+    tool with the custom proxy algorithm. Shared by the application and the
+    headless simulation, which add no window, camera or light of their own
+    to it.
+*/
+//==============================================================================
+
+#ifndef SCENESETUP_H
+#define SCENESETUP_H
+
+#include "chai3d.h"
+#include "AssetCache.h"
+#include "MaterialLibrary.h"
+#include "MyMaterial.h"
+#include "MyProxyAlgorithm.h"
+
+//------------------------------------------------------------------------------
+
+//! Distance between the centres of neighbouring trays of the grid.
+const double C_TRAY_SPACING = 0.09;
+
+//! Radius the cursor of a tool is drawn at, whatever its collision radius.
+const double C_CURSOR_DISPLAY_RADIUS = 0.001;
+
+//! Creates tray (a_i, a_j) of the pattern repeating the 3x3 grid in every direction, with its material and haptic kernel bound.
+chai3d::cMultiMesh* createTray(AssetCache* a_cache,
+                               MaterialLibrary* a_library,
+                               double a_toolRadius,
+                               int a_i,
+                               int a_j,
+                               MyMaterial** a_material = NULL);
+
+//! Adds the 3x3 grid of trays to a world, with their materials and haptic kernels bound.
+void createTrayGrid(chai3d::cWorld* a_world,
+                    AssetCache* a_cache,
+                    MaterialLibrary* a_library,
+                    double a_toolRadius,
+                    chai3d::cMultiMesh* a_objects[3][3],
+                    MyMaterial* a_materials[9]);
+
+//! Extends the 3x3 grid of trays to a_gridSize x a_gridSize by repeating its trays, sharing their materials and kernels.
+void extendTrayGrid(chai3d::cWorld* a_world,
+                    AssetCache* a_cache,
+                    double a_toolRadius,
+                    chai3d::cMultiMesh* a_objects[3][3],
+                    int a_gridSize);
+
+//! Adds a tool driven by a device to a world, rendering with MyProxyAlgorithm, and starts it.
+chai3d::cToolCursor* createTool(chai3d::cWorld* a_world,
+                                chai3d::cGenericHapticDevicePtr a_device,
+                                double a_toolRadius,
+                                MyProxyAlgorithm*& a_proxyAlgorithm);
+
+//------------------------------------------------------------------------------
+#endif
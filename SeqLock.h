@@ -0,0 +1,106 @@
+//==============================================================================
+/*
+    CPSC 599.86 / 601.86 - Computer Haptics
+    Winter 2018, University of Calgary
+
+    A single-writer sequence lock holding one fixed-size record. The writer
+    (typically the haptic thread) publishes without ever waiting; readers
+    copy the latest complete record and retry if a publish overlapped their
+    copy, so they never observe a half-written value.
+
+    read() spins while a publish is in progress, so a reader can wait for
+    as long as the writer is preempted mid-publish. A thread that must not
+    wait for a lower priority writer (the haptic and servo threads) uses
+    tryRead() instead: one attempt, which fails rather than waits, after
+    which the reader keeps the last record it got.
+*/
+//==============================================================================
+
+#ifndef SEQLOCK_H
+#define SEQLOCK_H
+
+#include <atomic>
+#include <cstring>
+#include <type_traits>
+
+//------------------------------------------------------------------------------
+
+template <class T>
+class SeqLock
+{
+    static_assert(std::is_trivially_copyable<T>::value, "SeqLock records must be trivially copyable");
+
+public:
+
+    //! Constructor of SeqLock. Nothing is published yet.
+    SeqLock() : m_sequence(0)
+    {
+        memset(&m_value, 0, sizeof(T));
+    }
+
+    //! Publishes a new record. Must only be called from one thread.
+    void publish(const T& a_value)
+    {
+        unsigned int sequence = m_sequence.load(std::memory_order_relaxed);
+
+        // an odd sequence tells readers that a write is in progress
+        m_sequence.store(sequence + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+
+        memcpy(&m_value, &a_value, sizeof(T));
+
+        m_sequence.store(sequence + 2, std::memory_order_release);
+    }
+
+    //! Copies the latest complete record. Returns false if nothing has been published yet.
+    bool read(T& a_value) const
+    {
+        while (true)
+        {
+            unsigned int before = m_sequence.load(std::memory_order_acquire);
+            if (before & 1)
+            {
+                continue;
+            }
+
+            memcpy(&a_value, &m_value, sizeof(T));
+
+            std::atomic_thread_fence(std::memory_order_acquire);
+            unsigned int after = m_sequence.load(std::memory_order_relaxed);
+
+            if (before == after)
+            {
+                return (before != 0);
+            }
+        }
+    }
+
+    //! Copies the latest complete record in one attempt, without waiting. Returns false if nothing has been published yet, or if a publish was in progress or overlapped the copy; a_value is then torn and must be discarded.
+    bool tryRead(T& a_value) const
+    {
+        unsigned int before = m_sequence.load(std::memory_order_acquire);
+        if ((before == 0) || (before & 1))
+        {
+            return (false);
+        }
+
+        memcpy(&a_value, &m_value, sizeof(T));
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return (m_sequence.load(std::memory_order_relaxed) == before);
+    }
+
+    //! Number of records published so far.
+    unsigned int getNumPublished() const
+    {
+        return (m_sequence.load(std::memory_order_acquire) / 2);
+    }
+
+protected:
+
+    std::atomic<unsigned int> m_sequence;
+    T m_value;
+};
+
+//------------------------------------------------------------------------------
+#endif
@@ -0,0 +1,533 @@
+//==============================================================================
+/*
+    CPSC 599.86 / 601.86 - Computer Haptics
+    Winter 2018, University of Calgary
+
+    High-rate servo loop rendering the textured force from a local model of
+    the contact published by the collision loop.
+*/
+//==============================================================================
+
+#include "ServoLoop.h"
+#include <chrono>
+
+using namespace chai3d;
+using namespace std;
+
+//------------------------------------------------------------------------------
+
+// Bilinear lookup into the patch of a contact model. Coordinates past the
+// patch are clamped to its border texels.
+static void samplePatch(const LocalContactModel& a_model, double a_u, double a_v, HapticTexel& a_texel)
+{
+    double px = (a_u - a_model.patchOrigin[0]) / a_model.patchTexelSize[0];
+    double py = (a_v - a_model.patchOrigin[1]) / a_model.patchTexelSize[1];
+
+    double last = (double)(C_CONTACT_PATCH_SIZE - 1);
+    px = cClamp(px, 0.0, last);
+    py = cClamp(py, 0.0, last);
+
+    int x0 = (int)px;
+    int y0 = (int)py;
+    int x1 = cMin(x0 + 1, C_CONTACT_PATCH_SIZE - 1);
+    int y1 = cMin(y0 + 1, C_CONTACT_PATCH_SIZE - 1);
+
+    float tx = (float)(px - x0);
+    float ty = (float)(py - y0);
+
+    const float* t00 = (const float*)&a_model.patch[y0 * C_CONTACT_PATCH_SIZE + x0];
+    const float* t10 = (const float*)&a_model.patch[y0 * C_CONTACT_PATCH_SIZE + x1];
+    const float* t01 = (const float*)&a_model.patch[y1 * C_CONTACT_PATCH_SIZE + x0];
+    const float* t11 = (const float*)&a_model.patch[y1 * C_CONTACT_PATCH_SIZE + x1];
+
+    float* out = (float*)&a_texel;
+    for (int k = 0; k < 8; ++k)
+    {
+        out[k] = (1.0f - tx) * (1.0f - ty) * t00[k] + tx * (1.0f - ty) * t10[k] +
+                 (1.0f - tx) * ty * t01[k] + tx * ty * t11[k];
+    }
+}
+
+
+//==============================================================================
+/*!
+    Constructor of ServoLoop.
+
+    \param  a_device  Device rendered by the servo loop.
+*/
+//==============================================================================
+ServoLoop::ServoLoop(cGenericHapticDevicePtr a_device) :
+    m_device(a_device),
+    m_model(new LocalContactModel()),
+    m_modelVersion(0),
+    m_nextModel(new LocalContactModel()),
+    m_running(false),
+    m_numSteps(0)
+{
+    cHapticDeviceInfo specifications = m_device->getSpecifications();
+    m_maxForce = specifications.m_maxLinearForce;
+
+    m_collisionDevice = make_shared<ServoCollisionDevice>(specifications, &m_devicePose);
+
+    // no force until the collision loop has published a contact
+    m_model->inContact = false;
+}
+
+
+//==============================================================================
+/*!
+    Destructor of ServoLoop.
+*/
+//==============================================================================
+ServoLoop::~ServoLoop()
+{
+    stop();
+}
+
+
+//==============================================================================
+/*!
+    Returns the device to give the tool of the collision loop. Its poses are
+    those the servo loop last read; the forces commanded to it are dropped.
+
+    \return Collision device.
+*/
+//==============================================================================
+cGenericHapticDevicePtr ServoLoop::getCollisionDevice() const
+{
+    return (m_collisionDevice);
+}
+
+
+//==============================================================================
+/*!
+    Opens and calibrates the device, and publishes its first pose so that the
+    collision loop has one before the first servo step.
+
+    \return true if the device opened.
+*/
+//==============================================================================
+bool ServoLoop::open()
+{
+    if (!m_device->open())
+    {
+        return (false);
+    }
+    m_device->calibrate();
+
+    cVector3d position;
+    readDevice(position);
+    return (true);
+}
+
+
+//==============================================================================
+/*!
+    Sends a zero force and closes the device. Call once the servo thread has
+    stopped.
+*/
+//==============================================================================
+void ServoLoop::close()
+{
+    m_device->setForceAndTorqueAndGripperForce(cVector3d(0.0, 0.0, 0.0), cVector3d(0.0, 0.0, 0.0), 0.0);
+    m_device->close();
+}
+
+
+//==============================================================================
+/*!
+    Starts the servo thread.
+
+    \param  a_rateHz  Rate of the servo steps.
+*/
+//==============================================================================
+void ServoLoop::start(unsigned int a_rateHz)
+{
+    if (m_running.exchange(true))
+    {
+        return;
+    }
+
+    m_thread = thread(&ServoLoop::run, this, a_rateHz);
+}
+
+
+//==============================================================================
+/*!
+    Stops the servo thread.
+*/
+//==============================================================================
+void ServoLoop::stop()
+{
+    if (!m_running.exchange(false))
+    {
+        return;
+    }
+
+    m_thread.join();
+}
+
+
+//==============================================================================
+/*!
+    Body of the servo thread. Steps are paced on absolute deadlines, like
+    those of the control loop, but the thread yields instead of sleeping:
+    at several kHz a sleep overshoots a whole period on most systems.
+
+    \param  a_rateHz  Rate of the servo steps.
+*/
+//==============================================================================
+void ServoLoop::run(unsigned int a_rateHz)
+{
+    chrono::steady_clock::duration period = chrono::duration_cast<chrono::steady_clock::duration>(
+        chrono::duration<double>(1.0 / max(a_rateHz, 1u)));
+
+    chrono::steady_clock::time_point next = chrono::steady_clock::now();
+
+    while (m_running.load())
+    {
+        while (chrono::steady_clock::now() < next)
+        {
+            this_thread::yield();
+        }
+        next += period;
+
+        step();
+    }
+}
+
+
+//==============================================================================
+/*!
+    Reads the device and publishes its pose for the collision loop.
+
+    \param  a_position  Returned device position.
+*/
+//==============================================================================
+void ServoLoop::readDevice(cVector3d& a_position)
+{
+    cMatrix3d rotation;
+    unsigned int userSwitches = 0;
+
+    m_device->getPosition(a_position);
+    m_device->getRotation(rotation);
+    m_device->getUserSwitches(userSwitches);
+
+    ServoDeviceRecord record;
+    for (int i = 0; i < 3; ++i)
+    {
+        record.position[i] = a_position(i);
+        for (int j = 0; j < 3; ++j)
+        {
+            record.rotation[i][j] = rotation(i, j);
+        }
+    }
+    record.userSwitches = userSwitches;
+
+    m_devicePose.publish(record);
+}
+
+
+//==============================================================================
+/*!
+    Runs one servo step: reads the device, picks up the latest contact model
+    if the collision loop published a new one, and sends the force of the
+    device position against it.
+*/
+//==============================================================================
+void ServoLoop::step()
+{
+    cVector3d position;
+    readDevice(position);
+
+    // copy the model only when it changed; it holds a patch of texels. If the collision
+    // loop is publishing, keep rendering the previous model and try again next step
+    unsigned int version = m_contactModel.getNumPublished();
+    if ((version != m_modelVersion) && m_contactModel.tryRead(*m_nextModel))
+    {
+        m_model.swap(m_nextModel);
+        m_modelVersion = version;
+    }
+
+    const LocalContactModel& model = *m_model;
+    cVector3d force(0.0, 0.0, 0.0);
+    if (model.inContact)
+    {
+        cVector3d devicePos = cVector3d(model.toolPos[0], model.toolPos[1], model.toolPos[2]) +
+                              model.workspaceScale * position;
+        force = evaluate(model, devicePos);
+    }
+
+    double magnitude = force.length();
+    if (magnitude > m_maxForce)
+    {
+        force *= m_maxForce / magnitude;
+    }
+
+    m_device->setForceAndTorqueAndGripperForce(force, cVector3d(0.0, 0.0, 0.0), 0.0);
+
+    m_numSteps.fetch_add(1, memory_order_relaxed);
+}
+
+
+//==============================================================================
+/*!
+    Evaluates the force of a device position against a contact model.
+
+    The proxy stays on the plane of the contact: it follows the device along
+    the plane, keeping the tangential offset (the friction) of the collision
+    loop, and the normal spring follows the device depth. For textured
+    contacts the texture coordinate follows the device along the surface,
+    and the force is shaded from the texel there exactly as the mapped force
+    kernel does it. At the device position of the model, the result is the
+    force of the collision loop.
+
+    \param  a_model      Contact model.
+    \param  a_devicePos  Device position in the world.
+
+    \return Force to render, in the world.
+*/
+//==============================================================================
+cVector3d ServoLoop::evaluate(const LocalContactModel& a_model, const cVector3d& a_devicePos)
+{
+    cVector3d normal(a_model.normal[0], a_model.normal[1], a_model.normal[2]);
+    cVector3d proxyPos(a_model.proxyPos[0], a_model.proxyPos[1], a_model.proxyPos[2]);
+    cVector3d modelDevicePos(a_model.devicePos[0], a_model.devicePos[1], a_model.devicePos[2]);
+
+    // the device left the surface since the model was published
+    double depth = (proxyPos - a_devicePos).dot(normal);
+    if (!a_model.inContact || (depth <= 0.0))
+    {
+        return (cVector3d(0.0, 0.0, 0.0));
+    }
+
+    cVector3d modelForce(a_model.force[0], a_model.force[1], a_model.force[2]);
+    if (!a_model.textured)
+    {
+        // hold the force of the collision loop, with its normal spring following the device
+        return (modelForce + (a_model.stiffness * (modelDevicePos - a_devicePos).dot(normal)) * normal);
+    }
+
+    cVector3d offset = proxyPos - modelDevicePos;
+    cVector3d tangentialOffset = offset - offset.dot(normal) * normal;
+    cVector3d servoProxyPos = a_devicePos + depth * normal + tangentialOffset;
+    double forceMagnitude = a_model.stiffness * (servoProxyPos - a_devicePos).length();
+
+    // texture coordinate of the device along the surface
+    cVector3d motion = a_devicePos - modelDevicePos;
+    double u = a_model.texCoord[0] +
+               a_model.texCoordGradU[0] * motion(0) + a_model.texCoordGradU[1] * motion(1) + a_model.texCoordGradU[2] * motion(2);
+    double v = a_model.texCoord[1] +
+               a_model.texCoordGradV[0] * motion(0) + a_model.texCoordGradV[1] * motion(1) + a_model.texCoordGradV[2] * motion(2);
+
+    HapticTexel texel;
+    samplePatch(a_model, u, v, texel);
+
+    // the force shading of the mapped kernel (see MaterialKernelImpl<MATERIAL_KERNEL_MAPPED>::force())
+    cVector3d normalMapNormal;
+    for (int i = 0; i < 3; ++i)
+    {
+        normalMapNormal(i) = a_model.frame[i][0] * texel.normal[0] +
+                             a_model.frame[i][1] * texel.normal[1] +
+                             a_model.frame[i][2] * texel.normal[2];
+    }
+    normalMapNormal.normalize();
+
+    double height = texel.height;
+    double penetrationDepth = (servoProxyPos - a_devicePos).length() + height + (1.0 - a_model.smoothness);
+    double perturbedNormalFactor = a_model.smoothness * height;
+
+    cVector3d force;
+    if (penetrationDepth > perturbedNormalFactor)
+    {
+        force = (penetrationDepth - perturbedNormalFactor) * normal + perturbedNormalFactor * normalMapNormal;
+    }
+    else
+    {
+        force = perturbedNormalFactor * normalMapNormal;
+    }
+
+    force = cVector3d(force.x(), force.y(), force.z() + (height * (1.5 - a_model.smoothness)));
+
+    if (a_model.frictionOn)
+    {
+        force += 0.25 * cVector3d(a_model.tangentialForce[0], a_model.tangentialForce[1], a_model.tangentialForce[2]);
+    }
+
+    force.normalize();
+    return (force * forceMagnitude);
+}
+
+
+//==============================================================================
+/*!
+    Constructor of ServoCollisionDevice.
+
+    \param  a_specifications  Specifications of the real device.
+    \param  a_pose            Poses published by the servo loop.
+*/
+//==============================================================================
+ServoCollisionDevice::ServoCollisionDevice(const cHapticDeviceInfo& a_specifications,
+                                           const SeqLock<ServoDeviceRecord>* a_pose) :
+    m_pose(a_pose),
+    m_hasPose(false)
+{
+    m_specifications = a_specifications;
+    m_deviceAvailable = true;
+    m_deviceReady = false;
+}
+
+
+//==============================================================================
+/*!
+    The servo loop opens the real device.
+
+    \return true.
+*/
+//==============================================================================
+bool ServoCollisionDevice::open()
+{
+    m_deviceReady = true;
+    return (true);
+}
+
+
+//==============================================================================
+/*!
+    The servo loop closes the real device.
+
+    \return true.
+*/
+//==============================================================================
+bool ServoCollisionDevice::close()
+{
+    m_deviceReady = false;
+    return (true);
+}
+
+
+//==============================================================================
+/*!
+    Nothing to calibrate.
+
+    \return true.
+*/
+//==============================================================================
+bool ServoCollisionDevice::calibrate(bool a_forceCalibration)
+{
+    return (true);
+}
+
+
+//==============================================================================
+/*!
+    Reads the pose the servo loop last published, in one attempt. While the
+    servo loop is publishing, the previous pose is returned instead, so the
+    collision loop never waits for the servo thread.
+
+    \return Pose, or NULL if the servo loop has not read the device yet.
+*/
+//==============================================================================
+const ServoDeviceRecord* ServoCollisionDevice::readPose()
+{
+    ServoDeviceRecord record;
+    if (m_pose->tryRead(record))
+    {
+        m_lastPose = record;
+        m_hasPose = true;
+    }
+
+    return (m_hasPose ? &m_lastPose : NULL);
+}
+
+
+//==============================================================================
+/*!
+    Returns the position the servo loop last read.
+
+    \param  a_position  Returned position.
+
+    \return true if the servo loop has read the device.
+*/
+//==============================================================================
+bool ServoCollisionDevice::getPosition(cVector3d& a_position)
+{
+    const ServoDeviceRecord* record = readPose();
+    if (record == NULL)
+    {
+        a_position.zero();
+        return (false);
+    }
+
+    a_position.set(record->position[0], record->position[1], record->position[2]);
+    estimateLinearVelocity(a_position);
+    return (true);
+}
+
+
+//==============================================================================
+/*!
+    Returns the orientation the servo loop last read.
+
+    \param  a_rotation  Returned orientation.
+
+    \return true if the servo loop has read the device.
+*/
+//==============================================================================
+bool ServoCollisionDevice::getRotation(cMatrix3d& a_rotation)
+{
+    const ServoDeviceRecord* record = readPose();
+    if (record == NULL)
+    {
+        a_rotation.identity();
+        return (false);
+    }
+
+    a_rotation.set(record->rotation[0][0], record->rotation[0][1], record->rotation[0][2],
+                   record->rotation[1][0], record->rotation[1][1], record->rotation[1][2],
+                   record->rotation[2][0], record->rotation[2][1], record->rotation[2][2]);
+    return (true);
+}
+
+
+//==============================================================================
+/*!
+    Returns the switches the servo loop last read.
+
+    \param  a_userSwitches  Returned switch states.
+
+    \return true if the servo loop has read the device.
+*/
+//==============================================================================
+bool ServoCollisionDevice::getUserSwitches(unsigned int& a_userSwitches)
+{
+    const ServoDeviceRecord* record = readPose();
+    if (record == NULL)
+    {
+        a_userSwitches = 0;
+        return (false);
+    }
+
+    a_userSwitches = record->userSwitches;
+    return (true);
+}
+
+
+//==============================================================================
+/*!
+    Drops the force commanded by the tool; the servo loop renders its own
+    from the contact model.
+
+    \param  a_force         Force commanded (ignored).
+    \param  a_torque        Torque commanded (ignored).
+    \param  a_gripperForce  Gripper force commanded (ignored).
+
+    \return true.
+*/
+//==============================================================================
+bool ServoCollisionDevice::setForceAndTorqueAndGripperForce(const cVector3d& a_force,
+                                                            const cVector3d& a_torque,
+                                                            double a_gripperForce)
+{
+    return (true);
+}
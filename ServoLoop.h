@@ -0,0 +1,211 @@
+//==============================================================================
+/*
+    CPSC 599.86 / 601.86 - Computer Haptics
+    Winter 2018, University of Calgary
+
+    High-rate servo loop rendering the textured force from a local model of
+    the contact (an intermediate representation). The collision loop
+    (HapticLoop, ~1 kHz) finds the contact and publishes a LocalContactModel:
+    the plane of the contact, the force it computed, and a patch of the
+    haptic texels around the contact. The servo loop (4 kHz by default)
+    reads the device, evaluates the force of the device position against
+    the latest model and sends it, so that fine textures are rendered at the
+    servo rate while collision detection runs at its own.
+
+    Only the servo loop talks to the device. The tool of the collision loop
+    is given getCollisionDevice() instead: it returns the poses the servo
+    loop last read, and drops the forces, which the servo loop renders.
+    Both directions go through SeqLock mailboxes, read with
+    SeqLock::tryRead(): a read that overlaps a publish fails at once, and
+    the reader keeps the pose or model it read last, so neither loop ever
+    waits for the other.
+*/
+//==============================================================================
+
+#ifndef SERVOLOOP_H
+#define SERVOLOOP_H
+
+#include "chai3d.h"
+#include "HapticTexelMap.h"
+#include "SeqLock.h"
+#include <atomic>
+#include <memory>
+#include <thread>
+
+//------------------------------------------------------------------------------
+
+//! Side of the patch of texels around the contact, in texels.
+const int C_CONTACT_PATCH_SIZE = 16;
+
+//! Published by the collision loop every tick.
+struct LocalContactModel
+{
+    //! false when the proxy touches nothing; the servo loop then renders no force.
+    bool inContact;
+
+    //! true if the texture is re-evaluated from the patch; otherwise the collision force is held and only its normal spring follows the device.
+    bool textured;
+
+    //! Friction toggle of the proxy when the model was published.
+    bool frictionOn;
+
+    //! Device to world: world = toolPos + workspaceScale * device position (the tool is never rotated).
+    double toolPos[3];
+    double workspaceScale;
+
+    //! Proxy and device positions in the world, and the shaded surface normal, when the model was published.
+    double proxyPos[3];
+    double devicePos[3];
+    double normal[3];
+
+    //! Force of the collision loop, and its base (untextured) and tangential parts.
+    double force[3];
+    double baseForce[3];
+    double tangentialForce[3];
+
+    //! Stiffness of the base force, and the smoothness of the material.
+    double stiffness;
+    double smoothness;
+
+    //! Axes of the R, G and B channels of the normal map at the contact in the world, by columns (tangent, -bitangent, normal; see TangentFrame::normalMapToMesh()).
+    double frame[3][3];
+
+    //! Texture coordinate of the contact, and its gradient along the surface per unit of world distance.
+    double texCoord[2];
+    double texCoordGradU[3];
+    double texCoordGradV[3];
+
+    //! Texels around the contact at the mip level of the stroke; texel (0, 0) is centred at patchOrigin.
+    double patchOrigin[2];
+    double patchTexelSize[2];
+    HapticTexel patch[C_CONTACT_PATCH_SIZE * C_CONTACT_PATCH_SIZE];
+};
+
+typedef SeqLock<LocalContactModel> ContactModelChannel;
+
+//! Published by the servo loop every step.
+struct ServoDeviceRecord
+{
+    double position[3];
+    double rotation[3][3];
+    unsigned int userSwitches;
+};
+
+//------------------------------------------------------------------------------
+
+class ServoCollisionDevice;
+
+class ServoLoop
+{
+public:
+
+    //! Constructor of ServoLoop. a_device is only used by the servo loop from now on.
+    ServoLoop(chai3d::cGenericHapticDevicePtr a_device);
+
+    //! Destructor of ServoLoop. Stops the thread.
+    ~ServoLoop();
+
+    //! Device to give the tool of the collision loop in place of the real one.
+    chai3d::cGenericHapticDevicePtr getCollisionDevice() const;
+
+    //! Channel the collision loop publishes the contact model to.
+    ContactModelChannel* getContactModelChannel() { return (&m_contactModel); }
+
+    //! Opens the device and reads its first pose. Call before the collision loop starts.
+    bool open();
+
+    //! Sends a zero force and closes the device.
+    void close();
+
+    //! Starts the servo thread.
+    void start(unsigned int a_rateHz = 4000);
+
+    //! Stops the servo thread.
+    void stop();
+
+    //! Runs one servo step: reads the device, evaluates the contact model and sends the force.
+    void step();
+
+    //! Number of steps run so far.
+    unsigned long long getNumSteps() const { return (m_numSteps.load(std::memory_order_relaxed)); }
+
+    //! Force of a device position against a contact model.
+    static chai3d::cVector3d evaluate(const LocalContactModel& a_model, const chai3d::cVector3d& a_devicePos);
+
+protected:
+
+    //! Body of the servo thread.
+    void run(unsigned int a_rateHz);
+
+    //! Reads the device and publishes its pose.
+    void readDevice(chai3d::cVector3d& a_position);
+
+    chai3d::cGenericHapticDevicePtr m_device;
+    std::shared_ptr<ServoCollisionDevice> m_collisionDevice;
+
+    //! Largest force the device renders.
+    double m_maxForce;
+
+    ContactModelChannel m_contactModel;
+    SeqLock<ServoDeviceRecord> m_devicePose;
+
+    //! Copy of the latest contact model (servo thread only), and the number of models published when it was copied.
+    std::unique_ptr<LocalContactModel> m_model;
+    unsigned int m_modelVersion;
+
+    //! Buffer a new model is read into; swapped with m_model once read whole.
+    std::unique_ptr<LocalContactModel> m_nextModel;
+
+    std::thread m_thread;
+    std::atomic<bool> m_running;
+    std::atomic<unsigned long long> m_numSteps;
+};
+
+//------------------------------------------------------------------------------
+
+//! Device of the collision loop's tool: poses are those the servo loop last read, forces are dropped.
+class ServoCollisionDevice : public chai3d::cGenericHapticDevice
+{
+public:
+
+    //! Constructor of ServoCollisionDevice.
+    ServoCollisionDevice(const chai3d::cHapticDeviceInfo& a_specifications,
+                         const SeqLock<ServoDeviceRecord>* a_pose);
+
+    //! The servo loop opens the real device.
+    virtual bool open();
+
+    //! The servo loop closes the real device.
+    virtual bool close();
+
+    //! Nothing to calibrate.
+    virtual bool calibrate(bool a_forceCalibration = false);
+
+    //! Position the servo loop last read.
+    virtual bool getPosition(chai3d::cVector3d& a_position);
+
+    //! Orientation the servo loop last read.
+    virtual bool getRotation(chai3d::cMatrix3d& a_rotation);
+
+    //! Switches the servo loop last read.
+    virtual bool getUserSwitches(unsigned int& a_userSwitches);
+
+    //! Drops the force; the servo loop renders its own.
+    virtual bool setForceAndTorqueAndGripperForce(const chai3d::cVector3d& a_force,
+                                                  const chai3d::cVector3d& a_torque,
+                                                  double a_gripperForce);
+
+protected:
+
+    //! Pose the servo loop last published, or the previous one while it is publishing; NULL before the first.
+    const ServoDeviceRecord* readPose();
+
+    const SeqLock<ServoDeviceRecord>* m_pose;
+
+    //! Last pose read whole (collision thread only).
+    ServoDeviceRecord m_lastPose;
+    bool m_hasPose;
+};
+
+//------------------------------------------------------------------------------
+#endif
@@ -0,0 +1,101 @@
+//==============================================================================
+/*
+    CPSC 599.86 / 601.86 - Computer Haptics
+    Winter 2018, University of Calgary
+
+    This class caches one orthonormal tangent frame (tangent, bitangent,
+    normal) per triangle of a mesh, built from the per-vertex frames that
+    cMesh::computeBTN() produces. The haptic thread uses it to bring a
+    tangent-space normal map normal into the mesh frame with a single 3x3
+    multiply.
+*/
+//==============================================================================
+
+#include "TangentFrames.h"
+
+using namespace chai3d;
+
+//------------------------------------------------------------------------------
+
+static void storeVector(const cVector3d& a_v, float a_out[3])
+{
+    a_out[0] = (float)a_v.x();
+    a_out[1] = (float)a_v.y();
+    a_out[2] = (float)a_v.z();
+}
+
+
+//==============================================================================
+/*!
+    Builds one frame per triangle by averaging the tangent, bitangent and
+    normal of its three vertices and orthonormalising the result. The
+    bitangent keeps the handedness of the texture mapping.
+
+    \param  a_mesh  Mesh whose BTN vectors have been computed.
+*/
+//==============================================================================
+TangentFrames::TangentFrames(cMesh* a_mesh)
+{
+    unsigned int numTriangles = a_mesh->getNumTriangles();
+    m_storage.resize(numTriangles);
+    m_frames = (numTriangles > 0) ? &m_storage[0] : NULL;
+    m_numFrames = numTriangles;
+
+    cVertexArrayPtr vertices = a_mesh->m_vertices;
+    cTriangleArrayPtr triangles = a_mesh->m_triangles;
+
+    for (unsigned int i = 0; i < numTriangles; ++i)
+    {
+        unsigned int v0 = triangles->getVertexIndex0(i);
+        unsigned int v1 = triangles->getVertexIndex1(i);
+        unsigned int v2 = triangles->getVertexIndex2(i);
+
+        cVector3d n = vertices->getNormal(v0) + vertices->getNormal(v1) + vertices->getNormal(v2);
+        cVector3d t = vertices->getTangent(v0) + vertices->getTangent(v1) + vertices->getTangent(v2);
+        cVector3d b = vertices->getBitangent(v0) + vertices->getBitangent(v1) + vertices->getBitangent(v2);
+
+        // fall back to the face normal if the vertex normals cancel out
+        if (n.lengthsq() < 1e-12)
+        {
+            cVector3d p0 = vertices->getLocalPos(v0);
+            n = cCross(vertices->getLocalPos(v1) - p0, vertices->getLocalPos(v2) - p0);
+        }
+        n.normalize();
+
+        // remove the normal component from the tangent (Gram-Schmidt)
+        t = t - n * cDot(n, t);
+        if (t.lengthsq() < 1e-12)
+        {
+            // no usable texture mapping: pick any direction in the plane
+            t = (fabs(n.x()) < 0.9) ? cCross(n, cVector3d(1.0, 0.0, 0.0)) : cCross(n, cVector3d(0.0, 1.0, 0.0));
+        }
+        t.normalize();
+
+        // the bitangent completes the frame with the handedness of the UV layout
+        cVector3d bitangent = cCross(n, t);
+        if (cDot(bitangent, b) < 0.0)
+        {
+            bitangent = -bitangent;
+        }
+
+        storeVector(t, m_storage[i].tangent);
+        storeVector(bitangent, m_storage[i].bitangent);
+        storeVector(n, m_storage[i].normal);
+    }
+}
+
+
+//==============================================================================
+/*!
+    Constructor of TangentFrames. Uses frames stored elsewhere, typically in
+    a mapped scene pack, without copying them.
+
+    \param  a_frames     Frames, one per triangle. Must outlive this object.
+    \param  a_numFrames  Number of frames.
+*/
+//==============================================================================
+TangentFrames::TangentFrames(const TangentFrame* a_frames, unsigned int a_numFrames)
+{
+    m_frames = a_frames;
+    m_numFrames = a_numFrames;
+}
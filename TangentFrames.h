@@ -0,0 +1,92 @@
+//==============================================================================
+/*
+    CPSC 599.86 / 601.86 - Computer Haptics
+    Winter 2018, University of Calgary
+
+    This class caches one orthonormal tangent frame (tangent, bitangent,
+    normal) per triangle of a mesh, built from the per-vertex frames that
+    cMesh::computeBTN() produces. The haptic thread uses it to bring a
+    tangent-space normal map normal into the mesh frame with a single 3x3
+    multiply.
+
+    The green channel of the normal maps points against the bitangent of
+    computeBTN() (down the V axis of the texture), which is how the acos /
+    rotation transform used before read them: on the flat tops of the trays
+    (tangent +y, bitangent -x) a texel (R, G, B) maps to (G, R, B) either
+    way.
+*/
+//==============================================================================
+
+#ifndef TANGENTFRAMES_H
+#define TANGENTFRAMES_H
+
+#include "chai3d.h"
+#include <vector>
+
+//------------------------------------------------------------------------------
+class TangentFrames;
+typedef std::shared_ptr<TangentFrames> TangentFramesPtr;
+//------------------------------------------------------------------------------
+
+//! Tangent frame of one triangle, stored by columns in the mesh frame.
+struct TangentFrame
+{
+    float tangent[3];
+    float bitangent[3];
+    float normal[3];
+
+    //! Transforms a tangent-space vector into the mesh frame.
+    inline chai3d::cVector3d toMesh(const float a_v[3]) const
+    {
+        return (chai3d::cVector3d(tangent[0] * a_v[0] + bitangent[0] * a_v[1] + normal[0] * a_v[2],
+                                  tangent[1] * a_v[0] + bitangent[1] * a_v[1] + normal[1] * a_v[2],
+                                  tangent[2] * a_v[0] + bitangent[2] * a_v[1] + normal[2] * a_v[2]));
+    }
+
+    //! Transforms a normal map normal into the mesh frame: R along the tangent, G against the bitangent, B along the normal.
+    inline chai3d::cVector3d normalMapToMesh(const float a_normal[3]) const
+    {
+        const float v[3] = { a_normal[0], -a_normal[1], a_normal[2] };
+        return (toMesh(v));
+    }
+};
+
+//------------------------------------------------------------------------------
+
+class TangentFrames
+{
+public:
+
+    //! Builds the per-triangle frames of a mesh. computeBTN() must have been called.
+    TangentFrames(chai3d::cMesh* a_mesh);
+
+    //! Uses frames stored elsewhere (e.g. a mapped scene pack) without copying them.
+    TangentFrames(const TangentFrame* a_frames, unsigned int a_numFrames);
+
+    //! Shared TangentFrames allocator.
+    static TangentFramesPtr create(chai3d::cMesh* a_mesh) { return (std::make_shared<TangentFrames>(a_mesh)); }
+
+    //! Shared TangentFrames allocator for frames stored elsewhere, which must outlive them.
+    static TangentFramesPtr create(const TangentFrame* a_frames, unsigned int a_numFrames) { return (std::make_shared<TangentFrames>(a_frames, a_numFrames)); }
+
+    //! Frame of triangle a_index.
+    inline const TangentFrame& getFrame(unsigned int a_index) const { return (m_frames[a_index]); }
+
+    //! Number of cached frames (one per triangle).
+    unsigned int getNumFrames() const { return (m_numFrames); }
+
+    //! Read-only access to the frame array.
+    const TangentFrame* getFrames() const { return (m_frames); }
+
+protected:
+
+    //! Frame storage owned by this object (empty for a view).
+    std::vector<TangentFrame> m_storage;
+
+    //! Frames used for lookups.
+    const TangentFrame* m_frames;
+    unsigned int m_numFrames;
+};
+
+//------------------------------------------------------------------------------
+#endif
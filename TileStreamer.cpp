@@ -0,0 +1,639 @@
+//==============================================================================
+/*
+    CPSC 599.86 / 601.86 - Computer Haptics
+    Winter 2018, University of Calgary
+
+    An unbounded world of trays, streamed in and out around the tool.
+*/
+//==============================================================================
+
+#include "TileStreamer.h"
+#include "HapticTelemetry.h"
+#include "SceneSetup.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+using namespace chai3d;
+using namespace std;
+
+//------------------------------------------------------------------------------
+
+namespace
+{
+    //! True if two boxes overlap.
+    inline bool overlaps(const cVector3d& a_minA, const cVector3d& a_maxA,
+                         const cVector3d& a_minB, const cVector3d& a_maxB)
+    {
+        return ((a_minA.x() <= a_maxB.x()) && (a_maxA.x() >= a_minB.x()) &&
+                (a_minA.y() <= a_maxB.y()) && (a_maxA.y() >= a_minB.y()) &&
+                (a_minA.z() <= a_maxB.z()) && (a_maxA.z() >= a_minB.z()));
+    }
+}
+
+
+//==============================================================================
+/*!
+    Constructor of TileStreamer.
+
+    \param  a_cache       Cache providing the meshes and maps of the tiles.
+    \param  a_library     Library providing the material parameters.
+    \param  a_toolRadius  Radius of the tool, used to build the collision trees.
+*/
+//==============================================================================
+TileStreamer::TileStreamer(AssetCache* a_cache, MaterialLibrary* a_library, double a_toolRadius) :
+    m_cache(a_cache),
+    m_library(a_library),
+    m_toolRadius(a_toolRadius),
+    m_loadRadius(2),
+    m_cacheSize(16),
+    m_hasStaticArea(false),
+    m_snapshot(NULL),
+    m_running(false),
+    m_numResident(0),
+    m_numLoads(0),
+    m_numCacheHits(0),
+    m_numDeletes(0)
+{
+    m_root = new cGenericObject();
+    m_root->setHapticEnabled(false);
+    m_staticArea[0] = m_staticArea[1] = m_staticArea[2] = m_staticArea[3] = 0;
+}
+
+
+//==============================================================================
+/*!
+    Destructor of TileStreamer. Call it once the haptic and rendering
+    threads have stopped, before deleting the world (which still owns the
+    root) and the asset cache. Every tile is removed from the root and
+    deleted.
+*/
+//==============================================================================
+TileStreamer::~TileStreamer()
+{
+    stop();
+
+    // the rendering thread is gone: apply what it left, then drop every tile
+    updateScene();
+
+    vector<Tile*> tiles;
+    for (map<TileKey, Tile*>::iterator it = m_resident.begin(); it != m_resident.end(); ++it)
+        tiles.push_back(it->second);
+    tiles.insert(tiles.end(), m_cached.begin(), m_cached.end());
+    for (size_t i = 0; i < m_retiredTiles.size(); ++i)
+        tiles.push_back(m_retiredTiles[i].pointer);
+
+    for (size_t i = 0; i < tiles.size(); ++i)
+    {
+        if (tiles[i]->inScene)
+        {
+            m_root->removeChild(tiles[i]->object);
+        }
+        m_cache->releaseInstance(tiles[i]->object);
+        delete tiles[i]->object;
+        delete tiles[i];
+    }
+
+    delete m_snapshot.load();
+    for (size_t i = 0; i < m_retiredSnapshots.size(); ++i)
+    {
+        delete m_retiredSnapshots[i].pointer;
+    }
+}
+
+
+//==============================================================================
+/*!
+    Sets the trays already in the world, which are never streamed.
+
+    \param  a_minI  First column.
+    \param  a_minJ  First row.
+    \param  a_maxI  Last column.
+    \param  a_maxJ  Last row.
+*/
+//==============================================================================
+void TileStreamer::setStaticArea(int a_minI, int a_minJ, int a_maxI, int a_maxJ)
+{
+    m_staticArea[0] = a_minI;
+    m_staticArea[1] = a_minJ;
+    m_staticArea[2] = a_maxI;
+    m_staticArea[3] = a_maxJ;
+    m_hasStaticArea = true;
+}
+
+
+//==============================================================================
+/*!
+    Starts the loader thread.
+
+    \param  a_periodMs  Period of the loader steps in milliseconds.
+*/
+//==============================================================================
+void TileStreamer::start(unsigned int a_periodMs)
+{
+    if (m_running.exchange(true))
+    {
+        return;
+    }
+
+    m_loader = thread(&TileStreamer::run, this, a_periodMs);
+}
+
+
+//==============================================================================
+/*!
+    Stops the loader thread.
+*/
+//==============================================================================
+void TileStreamer::stop()
+{
+    if (!m_running.exchange(false))
+    {
+        return;
+    }
+
+    m_loader.join();
+}
+
+
+//==============================================================================
+/*!
+    Body of the loader thread.
+
+    \param  a_periodMs  Period of the loader steps in milliseconds.
+*/
+//==============================================================================
+void TileStreamer::run(unsigned int a_periodMs)
+{
+    while (m_running.load())
+    {
+        step();
+        this_thread::sleep_for(chrono::milliseconds(a_periodMs));
+    }
+}
+
+
+//==============================================================================
+/*!
+    Publishes the position the tiles are streamed around.
+
+    \param  a_position  Position in the world, usually the proxy.
+*/
+//==============================================================================
+void TileStreamer::setFocus(const cVector3d& a_position)
+{
+    FocusRecord focus;
+    storeTelemetry(a_position, focus.position);
+    m_focus.publish(focus);
+}
+
+
+//==============================================================================
+/*!
+    Returns the column (or row) of the tray whose centre is nearest to a
+    coordinate. Trays are C_TRAY_SPACING apart, tray 0 centred at
+    -C_TRAY_SPACING.
+
+    \param  a_coordinate  x (or y) coordinate in the world.
+
+    \return Column (or row).
+*/
+//==============================================================================
+int TileStreamer::getTileIndex(double a_coordinate)
+{
+    return ((int)floor((a_coordinate + C_TRAY_SPACING) / C_TRAY_SPACING + 0.5));
+}
+
+
+//==============================================================================
+/*!
+    Tells whether a tray is part of the static area.
+
+    \param  a_i  Column.
+    \param  a_j  Row.
+
+    \return true if the tray is never streamed.
+*/
+//==============================================================================
+bool TileStreamer::isStatic(int a_i, int a_j) const
+{
+    return (m_hasStaticArea &&
+            (a_i >= m_staticArea[0]) && (a_i <= m_staticArea[2]) &&
+            (a_j >= m_staticArea[1]) && (a_j <= m_staticArea[3]));
+}
+
+
+//==============================================================================
+/*!
+    Creates a tile: the tray with its maps, material and kernel, its global
+    pose computed (the root sits at the origin) and its world bounds.
+
+    \param  a_i  Column.
+    \param  a_j  Row.
+
+    \return The tile.
+*/
+//==============================================================================
+TileStreamer::Tile* TileStreamer::loadTile(int a_i, int a_j)
+{
+    Tile* tile = new Tile();
+    tile->i = a_i;
+    tile->j = a_j;
+    tile->inScene = false;
+    tile->object = createTray(m_cache, m_library, m_toolRadius, a_i, a_j);
+
+    tile->object->computeGlobalPositions(true);
+    tile->object->computeBoundaryBox(true);
+    tile->boundsMin = tile->object->getLocalPos() + tile->object->getBoundaryMin();
+    tile->boundsMax = tile->object->getLocalPos() + tile->object->getBoundaryMax();
+
+    m_numLoads++;
+    return (tile);
+}
+
+
+//==============================================================================
+/*!
+    Takes a tile out of the LRU cache.
+
+    \param  a_i  Column.
+    \param  a_j  Row.
+
+    \return The tile, or NULL if it is not cached.
+*/
+//==============================================================================
+TileStreamer::Tile* TileStreamer::takeCachedTile(int a_i, int a_j)
+{
+    for (list<Tile*>::iterator it = m_cached.begin(); it != m_cached.end(); ++it)
+    {
+        if (((*it)->i == a_i) && ((*it)->j == a_j))
+        {
+            Tile* tile = *it;
+            m_cached.erase(it);
+            m_numCacheHits++;
+            return (tile);
+        }
+    }
+    return (NULL);
+}
+
+
+//==============================================================================
+/*!
+    Runs one loader step around the latest focus:
+    - resident tiles more than one tray beyond the load radius are evicted
+      to the LRU cache (the extra tray keeps a tool moving along a tile
+      border from loading and evicting the same tiles);
+    - missing tiles within the load radius are taken from the cache or
+      loaded, nearest rings first;
+    - if the resident set changed, a new snapshot is swapped in;
+    - tiles beyond the cache size are retired, and whatever the haptic
+      thread can no longer read is freed.
+*/
+//==============================================================================
+void TileStreamer::step()
+{
+    FocusRecord focus;
+    if (!m_focus.read(focus))
+    {
+        reclaim();
+        return;
+    }
+
+    int focusI = getTileIndex(focus.position[0]);
+    int focusJ = getTileIndex(focus.position[1]);
+    bool changed = false;
+
+    // evict the tiles left behind
+    int keepRadius = m_loadRadius + 1;
+    for (map<TileKey, Tile*>::iterator it = m_resident.begin(); it != m_resident.end(); )
+    {
+        Tile* tile = it->second;
+        if ((abs(tile->i - focusI) > keepRadius) || (abs(tile->j - focusJ) > keepRadius))
+        {
+            queueSceneOperation(SCENE_DETACH, tile);
+            m_cached.push_front(tile);
+            m_resident.erase(it++);
+            changed = true;
+        }
+        else
+        {
+            ++it;
+        }
+    }
+
+    // load the missing tiles around the focus, nearest ring first
+    for (int ring = 0; ring <= m_loadRadius; ++ring)
+    {
+        for (int i = focusI - ring; i <= focusI + ring; ++i)
+        {
+            for (int j = focusJ - ring; j <= focusJ + ring; ++j)
+            {
+                if ((max(abs(i - focusI), abs(j - focusJ)) != ring) || isStatic(i, j) ||
+                    (m_resident.find(TileKey(i, j)) != m_resident.end()))
+                {
+                    continue;
+                }
+
+                Tile* tile = takeCachedTile(i, j);
+                if (tile == NULL)
+                {
+                    tile = loadTile(i, j);
+                }
+
+                m_resident[TileKey(i, j)] = tile;
+                queueSceneOperation(SCENE_ATTACH, tile);
+                changed = true;
+            }
+        }
+    }
+
+    if (changed)
+    {
+        publishSnapshot();
+    }
+
+    // tiles falling out of the cache are no longer in any snapshot
+    while (m_cached.size() > m_cacheSize)
+    {
+        Retired<Tile> retired;
+        retired.pointer = m_cached.back();
+        m_hapticEpochs.stamp(retired.stamp);
+        m_retiredTiles.push_back(retired);
+        m_cached.pop_back();
+    }
+
+    reclaim();
+}
+
+
+//==============================================================================
+/*!
+    Builds the snapshot of the resident tiles, over the smallest window of
+    trays holding them, and swaps it in for the haptic thread. The previous
+    snapshot is retired.
+*/
+//==============================================================================
+void TileStreamer::publishSnapshot()
+{
+    Snapshot* snapshot = new Snapshot();
+    snapshot->minI = snapshot->minJ = 0;
+    snapshot->width = snapshot->height = 0;
+
+    if (!m_resident.empty())
+    {
+        int minI = m_resident.begin()->second->i;
+        int maxI = minI;
+        int minJ = m_resident.begin()->second->j;
+        int maxJ = minJ;
+        for (map<TileKey, Tile*>::iterator it = m_resident.begin(); it != m_resident.end(); ++it)
+        {
+            minI = min(minI, it->second->i);
+            maxI = max(maxI, it->second->i);
+            minJ = min(minJ, it->second->j);
+            maxJ = max(maxJ, it->second->j);
+        }
+
+        snapshot->minI = minI;
+        snapshot->minJ = minJ;
+        snapshot->width = maxI - minI + 1;
+        snapshot->height = maxJ - minJ + 1;
+        snapshot->tiles.assign(snapshot->width * snapshot->height, NULL);
+
+        for (map<TileKey, Tile*>::iterator it = m_resident.begin(); it != m_resident.end(); ++it)
+        {
+            Tile* tile = it->second;
+            snapshot->tiles[(tile->j - minJ) * snapshot->width + (tile->i - minI)] = tile;
+        }
+    }
+
+    Retired<const Snapshot> retired;
+    retired.pointer = m_snapshot.exchange(snapshot, memory_order_acq_rel);
+    m_hapticEpochs.stamp(retired.stamp);
+    if (retired.pointer != NULL)
+    {
+        m_retiredSnapshots.push_back(retired);
+    }
+
+    m_numResident = (unsigned int)m_resident.size();
+}
+
+
+//==============================================================================
+/*!
+    Frees the retired snapshots no haptic thread can still be reading,
+    and hands the retired tiles over to the rendering thread for deletion.
+    A tile waits one more tick than a snapshot: the proxy may still hold a
+    collision event pointing at it from the tick that saw it last.
+*/
+//==============================================================================
+void TileStreamer::reclaim()
+{
+    unsigned int kept = 0;
+    for (unsigned int i = 0; i < m_retiredSnapshots.size(); i++)
+    {
+        if (m_hapticEpochs.hasPassed(m_retiredSnapshots[i].stamp))
+            delete m_retiredSnapshots[i].pointer;
+        else
+            m_retiredSnapshots[kept++] = m_retiredSnapshots[i];
+    }
+    m_retiredSnapshots.resize(kept);
+
+    kept = 0;
+    for (unsigned int i = 0; i < m_retiredTiles.size(); i++)
+    {
+        if (m_hapticEpochs.hasPassed(m_retiredTiles[i].stamp, 1))
+        {
+            // the shared collision tree must survive the instance
+            m_cache->releaseInstance(m_retiredTiles[i].pointer->object);
+            queueSceneOperation(SCENE_DELETE, m_retiredTiles[i].pointer);
+        }
+        else
+        {
+            m_retiredTiles[kept++] = m_retiredTiles[i];
+        }
+    }
+    m_retiredTiles.resize(kept);
+}
+
+
+//==============================================================================
+/*!
+    Queues a scene graph change for the rendering thread.
+
+    \param  a_operation  Change.
+    \param  a_tile       Tile to attach, detach or delete.
+*/
+//==============================================================================
+void TileStreamer::queueSceneOperation(SceneOperation a_operation, Tile* a_tile)
+{
+    lock_guard<mutex> lock(m_sceneMutex);
+    m_sceneQueue.push_back(make_pair(a_operation, a_tile));
+}
+
+
+//==============================================================================
+/*!
+    Applies the scene graph changes queued by the loader, in order: attaches
+    new tiles to the root, detaches evicted ones, and deletes retired ones.
+    Only the thread that renders the world may call it, since it alone
+    reads the root's children. The lock is held just long enough to swap
+    the queue out.
+
+    \return true if the scene graph changed.
+*/
+//==============================================================================
+bool TileStreamer::updateScene()
+{
+    {
+        lock_guard<mutex> lock(m_sceneMutex);
+        if (m_sceneQueue.empty())
+        {
+            return (false);
+        }
+        m_sceneBatch.swap(m_sceneQueue);
+    }
+
+    for (size_t i = 0; i < m_sceneBatch.size(); ++i)
+    {
+        Tile* tile = m_sceneBatch[i].second;
+
+        switch (m_sceneBatch[i].first)
+        {
+            case SCENE_ATTACH:
+                if (!tile->inScene)
+                {
+                    m_root->addChild(tile->object);
+                    tile->inScene = true;
+                }
+                break;
+
+            case SCENE_DETACH:
+                if (tile->inScene)
+                {
+                    m_root->removeChild(tile->object);
+                    tile->inScene = false;
+                }
+                break;
+
+            case SCENE_DELETE:
+                if (tile->inScene)
+                {
+                    m_root->removeChild(tile->object);
+                }
+                delete tile->object;
+                delete tile;
+                m_numDeletes++;
+                break;
+        }
+    }
+
+    // keep the capacity for the next batch
+    m_sceneBatch.clear();
+    return (true);
+}
+
+
+//==============================================================================
+/*!
+    Collision query against the resident tiles of the current snapshot. Only
+    the trays whose index range overlaps the segment's box (grown by the
+    collision radius, and by one tray since a tray may be wider than the
+    spacing) are visited, and only those whose bounds overlap the box run
+    their own collision detection.
+
+    \param  a_segmentPointA  Start of the segment, in world coordinates.
+    \param  a_segmentPointB  End of the segment, in world coordinates.
+    \param  a_recorder       Recorder of the collisions.
+    \param  a_settings       Settings of the query.
+
+    \return true if a tile was hit.
+*/
+//==============================================================================
+bool TileStreamer::computeCollisionDetection(const cVector3d& a_segmentPointA,
+                                             const cVector3d& a_segmentPointB,
+                                             cCollisionRecorder& a_recorder,
+                                             cCollisionSettings& a_settings)
+{
+    const Snapshot* snapshot = m_snapshot.load(memory_order_acquire);
+    if ((snapshot == NULL) || snapshot->tiles.empty())
+    {
+        return (false);
+    }
+
+    double radius = a_settings.m_collisionRadius;
+    cVector3d queryMin, queryMax;
+    for (int k = 0; k < 3; ++k)
+    {
+        queryMin(k) = min(a_segmentPointA(k), a_segmentPointB(k)) - radius;
+        queryMax(k) = max(a_segmentPointA(k), a_segmentPointB(k)) + radius;
+    }
+
+    int firstI = max(getTileIndex(queryMin.x()) - 1, snapshot->minI);
+    int lastI = min(getTileIndex(queryMax.x()) + 1, snapshot->minI + snapshot->width - 1);
+    int firstJ = max(getTileIndex(queryMin.y()) - 1, snapshot->minJ);
+    int lastJ = min(getTileIndex(queryMax.y()) + 1, snapshot->minJ + snapshot->height - 1);
+
+    bool hit = false;
+    for (int j = firstJ; j <= lastJ; ++j)
+    {
+        for (int i = firstI; i <= lastI; ++i)
+        {
+            const Tile* tile = snapshot->tiles[(j - snapshot->minJ) * snapshot->width + (i - snapshot->minI)];
+            if ((tile != NULL) && overlaps(queryMin, queryMax, tile->boundsMin, tile->boundsMax))
+            {
+                hit = tile->object->computeCollisionDetection(a_segmentPointA, a_segmentPointB, a_recorder, a_settings) || hit;
+            }
+        }
+    }
+
+    return (hit);
+}
+
+
+//==============================================================================
+/*!
+    Interaction query of the potential field against the resident tiles of
+    the current snapshot: the tray under the tool and its neighbours, since
+    a tray may be wider than the spacing.
+
+    \param  a_toolPos       Position of the tool, in world coordinates.
+    \param  a_toolVel       Velocity of the tool.
+    \param  a_IDN           Identification number of the force algorithm.
+    \param  a_interactions  Recorder of the interactions.
+
+    \return Interaction force.
+*/
+//==============================================================================
+cVector3d TileStreamer::computeInteractions(const cVector3d& a_toolPos,
+                                            const cVector3d& a_toolVel,
+                                            const unsigned int a_IDN,
+                                            cInteractionRecorder& a_interactions)
+{
+    cVector3d force(0.0, 0.0, 0.0);
+
+    const Snapshot* snapshot = m_snapshot.load(memory_order_acquire);
+    if ((snapshot == NULL) || snapshot->tiles.empty())
+    {
+        return (force);
+    }
+
+    int firstI = max(getTileIndex(a_toolPos.x()) - 1, snapshot->minI);
+    int lastI = min(getTileIndex(a_toolPos.x()) + 1, snapshot->minI + snapshot->width - 1);
+    int firstJ = max(getTileIndex(a_toolPos.y()) - 1, snapshot->minJ);
+    int lastJ = min(getTileIndex(a_toolPos.y()) + 1, snapshot->minJ + snapshot->height - 1);
+
+    for (int j = firstJ; j <= lastJ; ++j)
+    {
+        for (int i = firstI; i <= lastI; ++i)
+        {
+            const Tile* tile = snapshot->tiles[(j - snapshot->minJ) * snapshot->width + (i - snapshot->minI)];
+            if (tile != NULL)
+            {
+                force.add(tile->object->computeInteractions(a_toolPos, a_toolVel, a_IDN, a_interactions));
+            }
+        }
+    }
+
+    return (force);
+}
@@ -0,0 +1,227 @@
+//==============================================================================
+/*
+    CPSC 599.86 / 601.86 - Computer Haptics
+    Winter 2018, University of Calgary
+
+    An unbounded world of trays, streamed in and out around the tool. The
+    tray pattern (see createTray()) repeats in every direction; a loader
+    thread keeps the tiles within a few trays of the tool resident, loads
+    the missing ones (mesh instance, maps, texels, material and kernel) as
+    the tool approaches, and evicts the ones it left behind. Evicted tiles
+    go to a small LRU cache, so that moving back and forth does not reload
+    them; tiles falling out of the cache are deleted. Memory therefore stays
+    bounded however far the avatar drifts.
+
+    No thread waits on another:
+    - the haptic thread sees the resident tiles through an immutable
+      snapshot behind an atomic pointer, like the material parameters: a
+      new snapshot is swapped in whenever the resident set changes, and the
+      old one (and any tile it held) is freed only once the haptic thread
+      has called quiescentState() after the swap;
+    - the rendering thread adds and removes the tiles in the scene graph,
+      under a root object it alone modifies, from a queue the loader fills
+      (updateScene());
+    - the loader is the only thread that creates tiles or touches the asset
+      cache once it has started.
+
+    The root must not be walked by the haptic thread: BroadPhaseWorld and
+    HapticLoop skip it once they are given the streamer.
+*/
+//==============================================================================
+
+#ifndef TILESTREAMER_H
+#define TILESTREAMER_H
+
+#include "chai3d.h"
+#include "AssetCache.h"
+#include "HapticEpochs.h"
+#include "MaterialLibrary.h"
+#include "SeqLock.h"
+#include <atomic>
+#include <list>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+//------------------------------------------------------------------------------
+
+class TileStreamer
+{
+public:
+
+    //! Constructor of TileStreamer.
+    TileStreamer(AssetCache* a_cache, MaterialLibrary* a_library, double a_toolRadius);
+
+    //! Destructor of TileStreamer. Stops the loader and deletes the tiles that are not in the scene graph.
+    ~TileStreamer();
+
+    //! Number of trays kept resident on each side of the tray under the tool. Call before start().
+    void setLoadRadius(int a_radius) { m_loadRadius = a_radius; }
+
+    //! Number of evicted tiles kept for reuse. Call before start().
+    void setCacheSize(unsigned int a_size) { m_cacheSize = a_size; }
+
+    //! Columns and rows of trays already in the world, which are never streamed. Call before start().
+    void setStaticArea(int a_minI, int a_minJ, int a_maxI, int a_maxJ);
+
+    //! Object holding the resident tiles in the scene graph; add it to the world.
+    chai3d::cGenericObject* getRoot() const { return (m_root); }
+
+    //! Starts the loader thread.
+    void start(unsigned int a_periodMs = 20);
+
+    //! Stops the loader thread.
+    void stop();
+
+    //! Runs one loader step: loads, evicts and publishes tiles around the focus. Called by the loader thread.
+    void step();
+
+    //! Position the tiles are streamed around, usually the proxy. Call from one thread only.
+    void setFocus(const chai3d::cVector3d& a_position);
+
+    //! Applies the pending scene graph changes. Rendering thread only; returns true if the scene changed.
+    bool updateScene();
+
+    //! Collision query against the resident tiles. Haptic thread only.
+    bool computeCollisionDetection(const chai3d::cVector3d& a_segmentPointA,
+                                   const chai3d::cVector3d& a_segmentPointB,
+                                   chai3d::cCollisionRecorder& a_recorder,
+                                   chai3d::cCollisionSettings& a_settings);
+
+    //! Interaction query of the potential field against the resident tiles around the tool. Haptic thread only.
+    chai3d::cVector3d computeInteractions(const chai3d::cVector3d& a_toolPos,
+                                          const chai3d::cVector3d& a_toolVel,
+                                          const unsigned int a_IDN,
+                                          chai3d::cInteractionRecorder& a_interactions);
+
+    //! Called by the haptic thread at the end of every tick; it holds no tile past this call.
+    void quiescentState(unsigned int a_thread = 0) { m_hapticEpochs.quiescentState(a_thread); }
+
+    //! Sets the number of haptic threads querying the tiles. Call before they start.
+    void setNumHapticThreads(unsigned int a_numThreads) { m_hapticEpochs.setNumThreads(a_numThreads); }
+
+    //! Number of tiles the haptic thread currently sees.
+    unsigned int getNumResidentTiles() const { return (m_numResident.load()); }
+
+    //! Number of tiles loaded from the asset cache so far.
+    unsigned int getNumLoads() const { return (m_numLoads.load()); }
+
+    //! Number of tiles brought back from the LRU cache so far.
+    unsigned int getNumCacheHits() const { return (m_numCacheHits.load()); }
+
+    //! Number of tiles deleted so far.
+    unsigned int getNumDeletes() const { return (m_numDeletes.load()); }
+
+protected:
+
+    //! A tray of the pattern, and its bounds in the world.
+    struct Tile
+    {
+        int i;
+        int j;
+        chai3d::cMultiMesh* object;
+        chai3d::cVector3d boundsMin;
+        chai3d::cVector3d boundsMax;
+
+        //! Whether the object is a child of the root; rendering thread only.
+        bool inScene;
+    };
+
+    //! Resident tiles over a window of columns and rows; immutable once published.
+    struct Snapshot
+    {
+        int minI;
+        int minJ;
+        int width;
+        int height;
+        std::vector<const Tile*> tiles;
+    };
+
+    enum SceneOperation { SCENE_ATTACH, SCENE_DETACH, SCENE_DELETE };
+
+    //! Position of the focus, published for the loader.
+    struct FocusRecord
+    {
+        double position[3];
+    };
+
+    template <class T> struct Retired
+    {
+        T* pointer;
+
+        //! Haptic epochs when it was retired; freed once every haptic thread has moved past them.
+        HapticEpochs::Stamp stamp;
+    };
+
+    typedef std::pair<int, int> TileKey;
+
+    //! Column or row of the tray under a coordinate.
+    static int getTileIndex(double a_coordinate);
+
+    //! Whether a tray is part of the static area.
+    bool isStatic(int a_i, int a_j) const;
+
+    //! Creates a tile. Loader thread only.
+    Tile* loadTile(int a_i, int a_j);
+
+    //! Takes a tile out of the LRU cache, or returns NULL. Loader thread only.
+    Tile* takeCachedTile(int a_i, int a_j);
+
+    //! Builds and swaps in the snapshot of the resident tiles. Loader thread only.
+    void publishSnapshot();
+
+    //! Frees what the haptic thread can no longer read. Loader thread only.
+    void reclaim();
+
+    //! Queues a scene graph change for the rendering thread.
+    void queueSceneOperation(SceneOperation a_operation, Tile* a_tile);
+
+    //! Body of the loader thread.
+    void run(unsigned int a_periodMs);
+
+    AssetCache* m_cache;
+    MaterialLibrary* m_library;
+    double m_toolRadius;
+
+    int m_loadRadius;
+    unsigned int m_cacheSize;
+    int m_staticArea[4];
+    bool m_hasStaticArea;
+
+    chai3d::cGenericObject* m_root;
+
+    SeqLock<FocusRecord> m_focus;
+
+    //! Tiles the latest snapshot holds, by tray (loader thread only).
+    std::map<TileKey, Tile*> m_resident;
+
+    //! Evicted tiles, most recently used first (loader thread only).
+    std::list<Tile*> m_cached;
+
+    //! Snapshot read by the haptic thread.
+    std::atomic<const Snapshot*> m_snapshot;
+
+    std::vector<Retired<const Snapshot> > m_retiredSnapshots;
+    std::vector<Retired<Tile> > m_retiredTiles;
+
+    //! Number of haptic ticks completed by each haptic thread.
+    HapticEpochs m_hapticEpochs;
+
+    //! Scene graph changes queued by the loader, and those being applied by the rendering thread.
+    std::mutex m_sceneMutex;
+    std::vector<std::pair<SceneOperation, Tile*> > m_sceneQueue;
+    std::vector<std::pair<SceneOperation, Tile*> > m_sceneBatch;
+
+    std::thread m_loader;
+    std::atomic<bool> m_running;
+
+    std::atomic<unsigned int> m_numResident;
+    std::atomic<unsigned int> m_numLoads;
+    std::atomic<unsigned int> m_numCacheHits;
+    std::atomic<unsigned int> m_numDeletes;
+};
+
+//------------------------------------------------------------------------------
+#endif
@@ -0,0 +1,144 @@
+//==============================================================================
+/*
+    CPSC 599.86 / 601.86 - Computer Haptics
+    Winter 2018, University of Calgary
+
+    Incremental update of the global poses of a world.
+*/
+//==============================================================================
+
+#include "TransformPropagator.h"
+#include <algorithm>
+
+using namespace chai3d;
+using namespace std;
+
+//==============================================================================
+/*!
+    Constructor of TransformPropagator.
+
+    \param  a_world  World whose global poses are kept up to date.
+*/
+//==============================================================================
+TransformPropagator::TransformPropagator(cWorld* a_world) :
+    m_world(a_world),
+    m_fullUpdate(true),
+    m_sharedWorld(false),
+    m_numFullUpdates(0),
+    m_numSubtreeUpdates(0)
+{
+}
+
+
+//==============================================================================
+/*!
+    Tracks an object whose local pose may change between updates. Its
+    subtree is recomputed whenever its own local pose changes; the local
+    poses of its children are not watched, so a child that moves on its
+    own must be tracked as well. Call this before the updates start.
+
+    \param  a_object  Object to track; it must already be in the world.
+*/
+//==============================================================================
+void TransformPropagator::addMovingObject(cGenericObject* a_object)
+{
+    MovingObject entry;
+    entry.object = a_object;
+    entry.localPos = a_object->getLocalPos();
+    entry.localRot = a_object->getLocalRot();
+    m_movingObjects.push_back(entry);
+
+    // its global pose is unknown until the next walk
+    invalidate();
+}
+
+
+//==============================================================================
+/*!
+    Recomputes the global poses of a tracked subtree from the global pose
+    of its parent, and remembers the local pose it used.
+
+    \param  a_entry  Tracked object.
+*/
+//==============================================================================
+void TransformPropagator::computeSubtree(MovingObject& a_entry)
+{
+    cGenericObject* object = a_entry.object;
+    cGenericObject* parent = object->getParent();
+
+    a_entry.localPos = object->getLocalPos();
+    a_entry.localRot = object->getLocalRot();
+
+    if (parent != NULL)
+    {
+        object->computeGlobalPositions(true, parent->getGlobalPos(), parent->getGlobalRot());
+    }
+    else
+    {
+        object->computeGlobalPositions(true);
+    }
+}
+
+
+//==============================================================================
+/*!
+    Recomputes the global poses that may have changed since the last update.
+    After invalidate() (or on the first update) the whole world, but for
+    the excluded children, is walked; otherwise only the subtrees of the
+    tracked objects whose local pose changed are. In a shared world, a full
+    update recomputes every tracked subtree instead of walking the world.
+*/
+//==============================================================================
+void TransformPropagator::update()
+{
+    if (m_sharedWorld && m_fullUpdate.exchange(false, memory_order_acquire))
+    {
+        for (size_t i = 0; i < m_movingObjects.size(); ++i)
+        {
+            computeSubtree(m_movingObjects[i]);
+        }
+
+        m_numFullUpdates++;
+        return;
+    }
+
+    if (m_fullUpdate.exchange(false, memory_order_acquire))
+    {
+        if (m_excludedObjects.empty())
+        {
+            m_world->computeGlobalPositions();
+        }
+        else
+        {
+            for (unsigned int i = 0; i < m_world->getNumChildren(); ++i)
+            {
+                cGenericObject* child = m_world->getChild(i);
+                if (find(m_excludedObjects.begin(), m_excludedObjects.end(), child) == m_excludedObjects.end())
+                {
+                    child->computeGlobalPositions(true, m_world->getGlobalPos(), m_world->getGlobalRot());
+                }
+            }
+        }
+
+        for (size_t i = 0; i < m_movingObjects.size(); ++i)
+        {
+            m_movingObjects[i].localPos = m_movingObjects[i].object->getLocalPos();
+            m_movingObjects[i].localRot = m_movingObjects[i].object->getLocalRot();
+        }
+
+        m_numFullUpdates++;
+        return;
+    }
+
+    for (size_t i = 0; i < m_movingObjects.size(); ++i)
+    {
+        MovingObject& entry = m_movingObjects[i];
+
+        if ((entry.object->getLocalPos() != entry.localPos) ||
+            (entry.object->getLocalRot() != entry.localRot))
+        {
+            computeSubtree(entry);
+            m_numSubtreeUpdates++;
+        }
+    }
+}
@@ -0,0 +1,90 @@
+//==============================================================================
+/*
+    CPSC 599.86 / 601.86 - Computer Haptics
+    Winter 2018, University of Calgary
+
+    Incremental update of the global poses of a world. Calling
+    cWorld::computeGlobalPositions() every haptic tick walks the whole scene
+    graph, although only the tool (and, when the avatar drifts, the camera)
+    moves. Here the objects that may move are tracked explicitly: each
+    update compares their local pose with the one seen last time and
+    recomputes the global poses of the subtrees that changed only. The cost
+    of an update depends on the number of moving objects, not on the size
+    of the world.
+
+    Objects outside the tracked subtrees are assumed static. Whoever adds,
+    removes or moves one of them calls invalidate(), and the next update
+    walks the whole world once. In a world shared by the haptic threads of
+    several tools, each thread tracks its own tool and never walks the
+    world (setSharedWorld()); the static poses are computed before the
+    threads start.
+*/
+//==============================================================================
+
+#ifndef TRANSFORMPROPAGATOR_H
+#define TRANSFORMPROPAGATOR_H
+
+#include "chai3d.h"
+#include <atomic>
+#include <vector>
+
+//------------------------------------------------------------------------------
+
+class TransformPropagator
+{
+public:
+
+    //! Constructor of TransformPropagator. The first update walks the whole world.
+    TransformPropagator(chai3d::cWorld* a_world);
+
+    //! Tracks an object (and its children) whose local pose may change between updates.
+    void addMovingObject(chai3d::cGenericObject* a_object);
+
+    //! Keeps a child of the world out of full walks, for subtrees other threads modify (e.g. the streamed tiles).
+    void excludeObject(chai3d::cGenericObject* a_object) { m_excludedObjects.push_back(a_object); }
+
+    //! Restricts every update to the tracked subtrees, full updates included. Call before the updates start.
+    void setSharedWorld(bool a_shared) { m_sharedWorld = a_shared; }
+
+    //! Makes the next update walk the whole world. Safe from any thread.
+    void invalidate() { m_fullUpdate.store(true, std::memory_order_release); }
+
+    //! Recomputes the global poses of the subtrees whose local pose changed.
+    void update();
+
+    //! Number of updates that walked the whole world.
+    unsigned long long getNumFullUpdates() const { return (m_numFullUpdates); }
+
+    //! Number of subtrees recomputed by incremental updates.
+    unsigned long long getNumSubtreeUpdates() const { return (m_numSubtreeUpdates); }
+
+protected:
+
+    //! A tracked object and the local pose its subtree was last computed from.
+    struct MovingObject
+    {
+        chai3d::cGenericObject* object;
+        chai3d::cVector3d localPos;
+        chai3d::cMatrix3d localRot;
+    };
+
+    //! Recomputes the global poses of a tracked subtree from those of its parent.
+    static void computeSubtree(MovingObject& a_entry);
+
+    chai3d::cWorld* m_world;
+    std::vector<MovingObject> m_movingObjects;
+
+    //! Children of the world skipped by full walks; they keep their global poses up to date themselves.
+    std::vector<chai3d::cGenericObject*> m_excludedObjects;
+
+    std::atomic<bool> m_fullUpdate;
+
+    //! True if other threads read the world; full updates then recompute the tracked subtrees only.
+    bool m_sharedWorld;
+
+    unsigned long long m_numFullUpdates;
+    unsigned long long m_numSubtreeUpdates;
+};
+
+//------------------------------------------------------------------------------
+#endif
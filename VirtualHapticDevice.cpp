@@ -0,0 +1,231 @@
+//==============================================================================
+/*
+    CPSC 599.86 / 601.86 - Computer Haptics
+    Winter 2018, University of Calgary
+
+    A haptic device with no hardware that plays back a trajectory and
+    records the forces commanded by the haptic loop.
+*/
+//==============================================================================
+
+#include "VirtualHapticDevice.h"
+#include <cstdio>
+
+using namespace chai3d;
+using namespace std;
+
+//------------------------------------------------------------------------------
+
+namespace
+{
+    // ticks per second reserved for the records when the device follows the wall clock
+    const double C_REAL_TIME_RECORD_RATE = 20000.0;
+}
+
+
+//==============================================================================
+/*!
+    Constructor of VirtualHapticDevice. The specifications are those of a
+    desktop device with a generous force range, so that the tool does not
+    clamp the forces of the scene.
+
+    \param  a_trajectory  Trajectory to play back; it is copied.
+    \param  a_realTime    true to follow the wall clock, false to advance by a_timeStep per tick.
+    \param  a_timeStep    Device time per tick in seconds, when not in real time.
+*/
+//==============================================================================
+VirtualHapticDevice::VirtualHapticDevice(const HapticTrajectory& a_trajectory, bool a_realTime, double a_timeStep) :
+    m_trajectory(a_trajectory),
+    m_realTime(a_realTime),
+    m_timeStep(a_timeStep),
+    m_time(0.0)
+{
+    m_specifications.m_model = C_HAPTIC_DEVICE_VIRTUAL;
+    m_specifications.m_modelName = "trajectory playback";
+    m_specifications.m_manufacturerName = "none";
+    m_specifications.m_maxLinearForce = 20.0;
+    m_specifications.m_maxLinearStiffness = 3000.0;
+    m_specifications.m_maxLinearDamping = 20.0;
+    m_specifications.m_workspaceRadius = 0.15;
+    m_specifications.m_sensedPosition = true;
+    m_specifications.m_sensedRotation = true;
+    m_specifications.m_actuatedPosition = true;
+    m_specifications.m_rightHand = true;
+    m_specifications.m_leftHand = true;
+
+    m_deviceAvailable = true;
+    m_deviceReady = false;
+
+    setTime(0.0);
+}
+
+
+//==============================================================================
+/*!
+    Starts the playback from the beginning of the trajectory and reserves
+    the records, so that the haptic loop does not allocate for them.
+
+    \return true.
+*/
+//==============================================================================
+bool VirtualHapticDevice::open()
+{
+    double ticksPerSecond = m_realTime ? C_REAL_TIME_RECORD_RATE : 1.0 / m_timeStep;
+
+    m_records.clear();
+    m_records.reserve((size_t)(m_trajectory.getDuration() * ticksPerSecond) + 2);
+
+    setTime(0.0);
+    m_clock.start(true);
+    m_deviceReady = true;
+    return (true);
+}
+
+
+//==============================================================================
+/*!
+    Stops the playback.
+
+    \return true.
+*/
+//==============================================================================
+bool VirtualHapticDevice::close()
+{
+    m_clock.stop();
+    m_deviceReady = false;
+    return (true);
+}
+
+
+//==============================================================================
+/*!
+    Nothing to calibrate.
+
+    \return true.
+*/
+//==============================================================================
+bool VirtualHapticDevice::calibrate(bool a_forceCalibration)
+{
+    return (true);
+}
+
+
+//==============================================================================
+/*!
+    Returns the position of the trajectory at the current device time.
+
+    \param  a_position  Returned position.
+
+    \return true.
+*/
+//==============================================================================
+bool VirtualHapticDevice::getPosition(cVector3d& a_position)
+{
+    a_position = m_position;
+    estimateLinearVelocity(a_position);
+    return (true);
+}
+
+
+//==============================================================================
+/*!
+    Returns the orientation of the trajectory at the current device time.
+
+    \param  a_rotation  Returned orientation.
+
+    \return true.
+*/
+//==============================================================================
+bool VirtualHapticDevice::getRotation(cMatrix3d& a_rotation)
+{
+    a_rotation = m_rotation;
+    return (true);
+}
+
+
+//==============================================================================
+/*!
+    No switch is ever pressed.
+
+    \param  a_userSwitches  Returned switch states (all released).
+
+    \return true.
+*/
+//==============================================================================
+bool VirtualHapticDevice::getUserSwitches(unsigned int& a_userSwitches)
+{
+    a_userSwitches = 0;
+    return (true);
+}
+
+
+//==============================================================================
+/*!
+    Records the force commanded by the haptic loop, then moves the device to
+    its next time: one time step later, or the wall-clock time in real time.
+    The poses read during a tick therefore all belong to the same time.
+
+    \param  a_force         Force commanded.
+    \param  a_torque        Torque commanded (ignored).
+    \param  a_gripperForce  Gripper force commanded (ignored).
+
+    \return true.
+*/
+//==============================================================================
+bool VirtualHapticDevice::setForceAndTorqueAndGripperForce(const cVector3d& a_force,
+                                                           const cVector3d& a_torque,
+                                                           double a_gripperForce)
+{
+    VirtualHapticDeviceRecord record;
+    record.time = m_time;
+    record.position = m_position;
+    record.force = a_force;
+    m_records.push_back(record);
+
+    setTime(m_realTime ? m_clock.getCurrentTimeSeconds() : m_time + m_timeStep);
+    return (true);
+}
+
+
+//==============================================================================
+/*!
+    Moves the device to a time of its trajectory.
+
+    \param  a_time  Device time in seconds.
+*/
+//==============================================================================
+void VirtualHapticDevice::setTime(double a_time)
+{
+    m_time = a_time;
+    m_trajectory.getSample(m_time, m_position, m_rotation);
+}
+
+
+//==============================================================================
+/*!
+    Writes the recorded forces, one tick per line.
+
+    \param  a_filename  CSV file to write.
+
+    \return true if the file was written.
+*/
+//==============================================================================
+bool VirtualHapticDevice::saveRecords(const string& a_filename) const
+{
+    FILE* file = fopen(a_filename.c_str(), "w");
+    if (file == NULL)
+    {
+        return (false);
+    }
+
+    fprintf(file, "time,x,y,z,fx,fy,fz\n");
+    for (unsigned int i = 0; i < m_records.size(); i++)
+    {
+        const VirtualHapticDeviceRecord& record = m_records[i];
+        fprintf(file, "%.6f,%.6f,%.6f,%.6f,%.6f,%.6f,%.6f\n", record.time,
+                record.position.x(), record.position.y(), record.position.z(),
+                record.force.x(), record.force.y(), record.force.z());
+    }
+
+    return (fclose(file) == 0);
+}
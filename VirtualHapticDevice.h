@@ -0,0 +1,107 @@
+//==============================================================================
+/*
+    CPSC 599.86 / 601.86 - Computer Haptics
+    Winter 2018, University of Calgary
+
+    A haptic device with no hardware. It plays back a HapticTrajectory and
+    records the force commanded at every tick, so that the haptic loop can
+    run without a device (see headless.cpp).
+
+    The device clock either follows the wall clock, like a real device
+    sampled by a free-running loop, or advances by a fixed time step every
+    time a force is commanded, so that the trajectory plays back as fast as
+    the loop runs.
+*/
+//==============================================================================
+
+#ifndef VIRTUALHAPTICDEVICE_H
+#define VIRTUALHAPTICDEVICE_H
+
+#include "chai3d.h"
+#include "HapticTrajectory.h"
+#include <memory>
+#include <string>
+#include <vector>
+
+//------------------------------------------------------------------------------
+
+class VirtualHapticDevice;
+typedef std::shared_ptr<VirtualHapticDevice> VirtualHapticDevicePtr;
+
+//! The device pose and the force commanded at one tick.
+struct VirtualHapticDeviceRecord
+{
+    double time;
+    chai3d::cVector3d position;
+    chai3d::cVector3d force;
+};
+
+//------------------------------------------------------------------------------
+
+class VirtualHapticDevice : public chai3d::cGenericHapticDevice
+{
+public:
+
+    //! Constructor of VirtualHapticDevice.
+    VirtualHapticDevice(const HapticTrajectory& a_trajectory, bool a_realTime, double a_timeStep = 0.001);
+
+    //! Shared allocator for VirtualHapticDevice.
+    static VirtualHapticDevicePtr create(const HapticTrajectory& a_trajectory, bool a_realTime, double a_timeStep = 0.001)
+    {
+        return (std::make_shared<VirtualHapticDevice>(a_trajectory, a_realTime, a_timeStep));
+    }
+
+    //! Starts the playback.
+    virtual bool open();
+
+    //! Stops the playback.
+    virtual bool close();
+
+    //! Nothing to calibrate.
+    virtual bool calibrate(bool a_forceCalibration = false);
+
+    //! Position of the trajectory at the current device time.
+    virtual bool getPosition(chai3d::cVector3d& a_position);
+
+    //! Orientation of the trajectory at the current device time.
+    virtual bool getRotation(chai3d::cMatrix3d& a_rotation);
+
+    //! No switch is ever pressed.
+    virtual bool getUserSwitches(unsigned int& a_userSwitches);
+
+    //! Records the force and moves the device to its next time.
+    virtual bool setForceAndTorqueAndGripperForce(const chai3d::cVector3d& a_force,
+                                                  const chai3d::cVector3d& a_torque,
+                                                  double a_gripperForce);
+
+    //! true once the device time has passed the end of the trajectory.
+    bool isFinished() const { return (m_time > m_trajectory.getDuration()); }
+
+    //! Number of forces commanded so far.
+    unsigned int getNumTicks() const { return ((unsigned int)m_records.size()); }
+
+    //! Writes the recorded forces as CSV (time, position, force).
+    bool saveRecords(const std::string& a_filename) const;
+
+protected:
+
+    //! Moves the device to a time of its trajectory.
+    void setTime(double a_time);
+
+    HapticTrajectory m_trajectory;
+
+    bool m_realTime;
+    double m_timeStep;
+
+    //! Device time, in seconds from open().
+    double m_time;
+    chai3d::cPrecisionClock m_clock;
+
+    chai3d::cVector3d m_position;
+    chai3d::cMatrix3d m_rotation;
+
+    std::vector<VirtualHapticDeviceRecord> m_records;
+};
+
+//------------------------------------------------------------------------------
+#endif
@@ -8,7 +8,24 @@
 #include "chai3d.h"
 #include "MyProxyAlgorithm.h"
 #include "MyMaterial.h"
+#include "HapticBenchmarks.h"
+#include "HapticDiagnostics.h"
+#include "AssetCache.h"
+#include "SceneAssets.h"
+#include "MaterialLibrary.h"
+#include "AllocationCounter.h"
+#include "SceneSetup.h"
+#include "BroadPhaseWorld.h"
+#include "TileStreamer.h"
+#include "HapticLoop.h"
+#include "ControlLoop.h"
+#include "HapticLatency.h"
+#include "ServoLoop.h"
+#include "HapticThreads.h"
+#include "HapticRealTime.h"
+#include <cstdlib>
 #include <iostream>
+#include <vector>
 
 //------------------------------------------------------------------------------
 #include <GLFW/glfw3.h>
@@ -41,8 +58,9 @@ bool mirroredDisplay = false;
 // DECLARED VARIABLES
 //------------------------------------------------------------------------------
 
-// a world that contains all objects of the virtual environment
-cWorld* world;
+// a world that contains all objects of the virtual environment, with a broad
+// phase over the trays for the proxy's collision queries
+BroadPhaseWorld* world;
 
 // a camera to render the world in the window display
 cCamera* camera;
@@ -68,6 +86,48 @@ MyProxyAlgorithm* proxyAlgorithm;
 // nine objects with different surface textures that we want to render
 cMultiMesh *objects[3][3];
 
+// meshes and textures shared by the objects
+AssetCache* assetCache;
+
+// material parameters, reloaded while the simulation runs
+MaterialLibrary* materialLibrary;
+
+// one tick of the haptics loop, run by the haptics thread
+HapticLoop* hapticLoop = NULL;
+
+// trays streamed in and out around the tool, beyond the 3x3 grid
+TileStreamer* tileStreamer = NULL;
+
+// mid-rate loop owning the workspace drift and the camera pose
+ControlLoop* controlLoop = NULL;
+
+// latency histograms of the stages of the haptics loop
+HapticLatencyMonitor* latencyMonitor = NULL;
+
+// high-rate loop rendering the force from the contact model of the haptics loop (--servo)
+ServoLoop* servoLoop = NULL;
+
+// the tools of the other haptic devices, each ticked by a thread of its own
+struct ExtraTool
+{
+	cGenericHapticDevicePtr device;
+	cToolCursor* tool;
+	MyProxyAlgorithm* proxyAlgorithm;
+	HapticLoop* loop;
+	HapticToolThread* thread;
+};
+std::vector<ExtraTool> extraTools;
+
+// number of tools, i.e. of haptic threads sharing the world
+unsigned int numTools = 1;
+
+// real-time mode of the haptic threads (--sched-fifo, --rt-priority, --rt-core, --rt-no-mlock)
+HapticRealTimeConfig realTimeConfig = getDefaultRealTimeConfig();
+
+// device poses recorded for replay by the headless simulation (--record-trajectory)
+HapticTrajectory recordedTrajectory;
+std::string recordedTrajectoryFile;
+
 // flag to indicate if the haptic simulation currently running
 bool simulationRunning = false;
 
@@ -119,13 +179,57 @@ cLabel *normalVectorLabel;
 cLabel *normalMapNormalLabel;
 cLabel *perturbedNormalVectorLabel;
 cLabel *infoLabel;
+cLabel *latencyLabel;
+
+
 
 
+// debug arrows, created once and moved to the contact every frame
+cMesh* normalMapNormalArrow = NULL;
+cMesh* surfaceNormalArrow = NULL;
+cMesh* globalForceArrow = NULL;
 
+// label texts, rebuilt only when what they show changes
+std::string ratesText;
+int displayedGraphicsRate = -1;
+int displayedHapticsRate = -1;
+std::string infoTexts[4];
+int displayedInfo = -1;
+std::string latencyText;
+unsigned int displayedLatencyReport = 0;
+unsigned int displayedCameraPose = 0;
 
-cMesh* normalMapNormalArrow = new cMesh();
-cMesh* surfaceNormalArrow = new cMesh();
-cMesh* globalForceArrow = new cMesh();
+// time and heap allocations of the graphics frames, printed at exit
+struct GraphicsFrameStats
+{
+	unsigned long long numFrames;
+	unsigned long long numAllocatingFrames;
+	unsigned long long numAllocations;
+	double totalTime;
+	double maxTime;
+	unsigned long long numShadowMapUpdates;
+};
+GraphicsFrameStats graphicsFrameStats = GraphicsFrameStats();
+unsigned long long graphicsFrameIndex = 0;
+cPrecisionClock graphicsFrameClock;
+
+// frames that set up GL resources and label texts before the graphics loop is steady
+const unsigned long long C_GRAPHICS_WARMUP_FRAMES = 100;
+
+// the shadow map holds the static casters (the trays) only; it is rebuilt when the
+// light or the trays change instead of every frame
+bool shadowMapDirty = true;
+bool cacheShadowMap = true;
+
+// blob shadow under the cursor, which moves every frame and stays out of the shadow map
+cMesh* cursorShadow = NULL;
+double cursorShadowHeight = 0.0;
+
+// fence after the GL commands of the previous frame, so that at most one frame is queued
+bool useFrameFence = true;
+#ifdef GLEW_VERSION
+GLsync frameFence = NULL;
+#endif
 
 
 bool showNormals;
@@ -147,6 +251,30 @@ void keyCallback(GLFWwindow* a_window, int a_key, int a_scancode, int a_action,
 // this function renders the scene
 void updateGraphics(void);
 
+// creates a debug arrow along z at the origin and adds it to the world, hidden
+cMesh* newDebugArrow(void);
+
+// points a debug arrow along a direction from a position, or hides it
+void placeDebugArrow(cMesh* a_arrow, const cVector3d& a_direction, const cVector3d& a_position, bool a_show);
+
+// returns the text of the info label
+std::string getInfoText(bool a_frictionOn, bool a_showNormals);
+
+// renders the static casters into the shadow map, keeping the objects that move out of it
+void updateStaticShadowMap(void);
+
+// places the blob shadow of the cursor where the light ray through the proxy meets the trays
+void placeCursorShadow(const cVector3d& a_position);
+
+// waits until the GPU has finished the previous frame
+void waitForPreviousFrame(void);
+
+// fences the GL commands of the frame just queued, or waits for them if fences are unavailable
+void fenceFrame(void);
+
+// renders frames with and without the shadow map cache and frame fences, and prints their times
+void benchmarkGraphicsFrames(int a_numFrames);
+
 // this function contains the main haptics simulation loop
 void updateHaptics(void);
 
@@ -168,6 +296,10 @@ int main(int argc, char* argv[])
 	// INITIALIZATION
 	//--------------------------------------------------------------------------
 
+	// wall-clock time from launch to the start of the simulation
+	cPrecisionClock startupClock;
+	startupClock.start(true);
+
 	cout << endl;
 	cout << "-----------------------------------" << endl;
 	cout << "CHAI3D" << endl;
@@ -178,6 +310,80 @@ int main(int argc, char* argv[])
 	cout << "[q] - Exit application" << endl;
 	cout << endl << endl;
 
+	// command line options
+	bool benchTexels = false;
+	bool benchMips = false;
+	bool benchProcedural = false;
+	bool benchFrames = false;
+	bool benchStartup = false;
+	bool benchGraphics = false;
+	bool benchTransforms = false;
+	double benchJitterSeconds = 0.0;
+	bool usePack = true;
+	unsigned int servoRate = 0;
+	int maxTools = (int)C_MAX_HAPTIC_THREADS;
+	for (int a = 1; a < argc; ++a)
+	{
+		// run the haptic texel sampling benchmark once the scene is built, then exit
+		if (string(argv[a]) == "--bench-texels")
+			benchTexels = true;
+
+		// compare full resolution and mip level haptic lookups along fast strokes, then exit
+		if (string(argv[a]) == "--bench-mips")
+			benchMips = true;
+
+		// compare the baked procedural texture profiles against evaluating them, then exit
+		if (string(argv[a]) == "--bench-procedural")
+			benchProcedural = true;
+
+		// run the tangent frame benchmark and accuracy check once the scene is built, then exit
+		if (string(argv[a]) == "--bench-frames")
+			benchFrames = true;
+
+		// compare loading the scene from the scene pack and from the source files, then exit
+		if (string(argv[a]) == "--bench-startup")
+			benchStartup = true;
+
+		// time incremental global pose updates against walking the whole world, then exit
+		if (string(argv[a]) == "--bench-transforms")
+			benchTransforms = true;
+
+		// time the graphics frames with and without shadow map caching, then exit
+		if (string(argv[a]) == "--bench-graphics")
+			benchGraphics = true;
+
+		// record the device poses, to replay them in the headless simulation
+		if ((string(argv[a]) == "--record-trajectory") && (a + 1 < argc))
+			recordedTrajectoryFile = argv[++a];
+
+		// load the scene from the source files even if a scene pack exists
+		if (string(argv[a]) == "--no-pack")
+			usePack = false;
+
+		// render the force from a servo loop at the given rate (4 kHz by default), decoupled from collision detection
+		if (string(argv[a]) == "--servo")
+		{
+			servoRate = 4000;
+			if ((a + 1 < argc) && (atoi(argv[a + 1]) > 0))
+				servoRate = (unsigned int)atoi(argv[++a]);
+		}
+
+		// drive at most this many tools, one per haptic device (all devices by default)
+		if ((string(argv[a]) == "--tools") && (a + 1 < argc))
+			maxTools = atoi(argv[++a]);
+
+		// compare the tick jitter of the haptics loop with and without the real-time mode (5 s per mode by default), then exit
+		if (string(argv[a]) == "--bench-jitter")
+		{
+			benchJitterSeconds = 5.0;
+			if ((a + 1 < argc) && (atof(argv[a + 1]) > 0.0))
+				benchJitterSeconds = atof(argv[++a]);
+		}
+
+		// run the haptic threads under SCHED_FIFO, pinned, with the memory locked
+		parseRealTimeOption(argc, argv, a, realTimeConfig);
+	}
+
 
 	//--------------------------------------------------------------------------
 	// OPENGL - WINDOW DISPLAY
@@ -259,7 +465,7 @@ int main(int argc, char* argv[])
 	//--------------------------------------------------------------------------
 
 	// create a new world.
-	world = new cWorld();
+	world = new BroadPhaseWorld();
 
 	// set the background color of the environment
 	world->m_backgroundColor.setBlack();
@@ -327,161 +533,61 @@ int main(int argc, char* argv[])
 	// [CPSC.86] TEXTURED OBJECTS
 	//--------------------------------------------------------------------------
 
-	const double objectSpacing = 0.09;
+	// materials of the grid, in row-major order (used by the benchmarks)
+	MyMaterial* gridMaterials[9];
+	std::string gridMaterialNames[9];
 
-	const std::string textureFiles[3][3] = 
-	{
-		{ "Organic_Scales_001_colour.jpg", "Bricks_color.jpg", "Fabric_002_colour.jpg" },
-		{ "bumps.png", "Metal_plate_001_colour.jpg", "friction.jpg" },
-		{ "Leather_padded_001_colour.jpg", "Cobblestone_color.jpg", "Cork_001_colour.jpg" }
-	};
+	// load the material parameters; edits to the file are picked up at runtime
+	materialLibrary = new MaterialLibrary();
+	if (!materialLibrary->load(materialConfigFile))
+		cout << "could not load " << materialConfigFile << ", using default material parameters" << endl;
 
-	const std::string normalMaps[3][3] =
-	{
-		{ "Organic_Scales_001_normal.jpg", "Bricks_normal.jpg", "Fabric_002_normal.jpg" },
-		{ "bumps.png", "Metal_plate_001_normal.jpg", "friction.jpg" },
-		{ "Leather_padded_001_normal.jpg", "Cobblestone_normal.jpg", "Cork_001_normal.jpg" }
-	};
+	// load each mesh and image once; objects share them by reference
+	assetCache = new AssetCache();
 
+	cPrecisionClock loadClock;
+	loadClock.start(true);
 
-	const std::string heightMaps[3][3] =
-	{
-		{ "Organic_Scales_001_height.jpg", "Bricks_height.jpg", "Fabric_002_height.jpg" },
-		{ "bumps.png", "Metal_plate_001_height.jpg", "friction.jpg" },
-		{ "Leather_padded_001_height.jpg", "Cobblestone_height.jpg", "Cork_001_height.jpg" }
-	};
+	// map the pre-baked scene pack if there is one (see scenepack.cpp); otherwise
+	// decode all maps concurrently. createTrayGrid() then only binds them.
+	if (usePack && assetCache->loadPack(scenePackFile))
+		cout << "loaded scene pack " << scenePackFile << endl;
+	else
+		assetCache->preloadTextures(getSceneImageFiles());
 
+	// the trays, with their materials and haptic kernels bound
+	createTrayGrid(world, assetCache, materialLibrary, toolRadius, objects, gridMaterials);
+	for (int i = 0; i < 9; ++i)
+		gridMaterialNames[i] = textureFiles[i / 3][i % 3];
 
-	const std::string roughnessMaps[3][3] =
+	cout << "scene loaded in " << loadClock.getCurrentTimeSeconds() * 1000.0 << " ms" << endl;
+	assetCache->printStatistics();
+
+	if (benchTexels || benchMips || benchProcedural || benchFrames || benchStartup || benchTransforms)
 	{
-		{ "Organic_Scales_001_roughness.jpg", "Bricks_roughness.jpg", "Fabric_002_roughness.jpg" },
-		{ "bumps.png", "Metal_plate_001_roughness.jpg", "friction.jpg" },
-		{ "Leather_padded_001_roughness.jpg", "Cobblestone_roughness.jpg", "Cork_001_roughness.jpg" }
-	};
+		// a failed accuracy check fails the run
+		int result = 0;
 
+		if (benchTexels)
+			benchmarkHapticTexels(gridMaterials, gridMaterialNames, 9);
 
+		if (benchMips)
+			benchmarkHapticMips(gridMaterials, gridMaterialNames, 9);
 
-	for (int i = 0; i < 3; ++i)
-	{
-		for (int j = 0; j < 3; ++j)
-		{
-			objects[i][j] = new cMultiMesh();
-			cMultiMesh* object = objects[i][j];
-
-			// load geometry from file and compute additional properties
-			object->loadFromFile("tray.obj");
-			object->createAABBCollisionDetector(toolRadius);
-			object->computeBTN();
-
-			// obtain the first (and only) mesh from the object
-			cMesh* mesh = object->getMesh(0);
-
-			// replace the object's material with a custom one
-			MyMaterialPtr material = MyMaterial::create();
-			mesh->m_material = material;
-			mesh->m_material->setWhite();
-			mesh->m_material->setUseHapticShading(true);
-			mesh->m_material->setUseHapticTexture(true);
-			object->setStiffness(2000.0, true);
-
-			// create a colour texture map for this mesh object
-			cTexture2dPtr albedoMap = cTexture2d::create();
-			albedoMap->loadFromFile("images/" + textureFiles[i][j]);
-			albedoMap->setWrapModeS(GL_REPEAT);
-			albedoMap->setWrapModeT(GL_REPEAT);
-			albedoMap->setUseMipmaps(true);
-
-
-			// assign textures to the mesh
-			mesh->m_texture = albedoMap;
-			mesh->setUseTexture(true);
-
-
-			cTexture2dPtr normalMap = cTexture2d::create();
-			normalMap->loadFromFile("images/" + normalMaps[i][j]);
-			normalMap->setWrapModeS(GL_REPEAT);
-			normalMap->setWrapModeT(GL_REPEAT);
-			normalMap->setUseMipmaps(true);
-
-			cTexture2dPtr heightMap = cTexture2d::create();
-			heightMap->loadFromFile("images/" + heightMaps[i][j]);
-			heightMap->setWrapModeS(GL_REPEAT);
-			heightMap->setWrapModeT(GL_REPEAT);
-			heightMap->setUseMipmaps(true);
-
-
-			cTexture2dPtr roughnessMap = cTexture2d::create();
-			roughnessMap->loadFromFile("images/" + roughnessMaps[i][j]);
-			roughnessMap->setWrapModeS(GL_REPEAT);
-			roughnessMap->setWrapModeT(GL_REPEAT);
-			roughnessMap->setUseMipmaps(true);
-
-
-			material->normalMap = normalMap;
-			material->heightMap = heightMap;
-			material->roughnessMap = roughnessMap;
-			material->objectID = i*3 + j;
-			material->baseStaticFriction = 0.3;
-			material->baseDynamicFriction = 0.1;
-			material->maxStaticFriction = 2.0;
-			material->maxDynamicFriction = 1.7;
-
-
-			switch (material->objectID)
-			{
-				case 0: // Scales
-					material->frictionFactor = 0.4;
-					material->smoothnessConstant = 0.6;
-					break;
-				case 1: // Bricks
-					material->frictionFactor = 0.5;
-					material->smoothnessConstant = 0.5;
-					break;
-				case 2: // Fabric
-					material->frictionFactor = 0.5;
-					material->smoothnessConstant = 0.8;
-					break;
-				case 3: // Procedural Bumps
-					material->frictionFactor = 0.0;
-					material->smoothnessConstant = 1.0;
-					break;
-				case 4: // Metal
-					material->frictionFactor = 0.4;
-					material->smoothnessConstant = 0.85;
-					break;
-				case 5: // Procedural Friction
-					material->frictionFactor = 1.0;
-					material->smoothnessConstant = 1.0;
-					break;
-				case 6: // Leather Padding
-					material->frictionFactor = 0.25;
-					material->smoothnessConstant = 0.4;
-					break;
-				case 7: // Cobblestone
-					material->frictionFactor = 0.5;
-					material->smoothnessConstant = 0.5;
-					break;
-				case 8: // Cork
-					material->frictionFactor = 0.8;
-					material->smoothnessConstant = 0.35;
-					break;
-
-				default:
-					material->frictionFactor = 1.0;
-					material->smoothnessConstant = 0.5;
-			}
-
-
-
-//			mesh->setShowNormals(true);
-
-			// set the position of this object
-			double xpos = -objectSpacing + i * objectSpacing;
-			double ypos = -objectSpacing + j * objectSpacing;
-			object->setLocalPos(xpos, ypos);
-
-			world->addChild(object);
-		}
+		if (benchProcedural)
+			benchmarkProceduralTextures();
+
+		if (benchFrames && !benchmarkTangentFrames(objects[0][0]->getMesh(0), *gridMaterials[0]->tangentFrames, *gridMaterials[0]->hapticTexels))
+			result = 1;
+
+		if (benchStartup)
+			benchmarkStartup(scenePackFile, toolRadius);
+
+		if (benchTransforms)
+			benchmarkTransformPropagation(96);
+
+		glfwTerminate();
+		return result;
 	}
 
 	//--------------------------------------------------------------------------
@@ -497,23 +603,71 @@ int main(int argc, char* argv[])
 	// if the device has a gripper, enable the gripper to simulate a user switch
 	hapticDevice->setEnableGripperUserSwitch(true);
 
-	tool = new cToolCursor(world);
-	world->addChild(tool);
-
-	// [CPSC.86] replace the tool's proxy rendering algorithm with our own
-	proxyAlgorithm = new MyProxyAlgorithm;
-	delete tool->m_hapticPoint->m_algorithmFingerProxy;
-	tool->m_hapticPoint->m_algorithmFingerProxy = proxyAlgorithm;
-
-	tool->m_hapticPoint->m_sphereProxy->m_material->setWhite();
-
-	tool->setRadius(0.001, toolRadius);
-
-	tool->setHapticDevice(hapticDevice);
+	// with a servo loop, only the servo loop talks to the device; the tool reads the
+	// poses it publishes and its forces are replaced by those of the servo loop
+	cGenericHapticDevicePtr toolDevice = hapticDevice;
+	if (servoRate > 0)
+	{
+		servoLoop = new ServoLoop(hapticDevice);
+		servoLoop->open();
+		toolDevice = servoLoop->getCollisionDevice();
+	}
 
-	tool->setWaitForSmallForce(true);
+	// [CPSC.86] the tool renders with our own proxy algorithm
+	tool = createTool(world, toolDevice, toolRadius, proxyAlgorithm);
+
+	// the control loop lets the avatar drift when the device leaves the workspace,
+	// and moves the camera along; the haptics loop only follows its drift target
+	controlLoop = new ControlLoop();
+	controlLoop->setCamera(cameraPosition, cameraLookAt);
+	controlLoop->setWorkspaceRadius(workspaceRadius);
+
+	hapticLoop = new HapticLoop(world, tool, toolDevice, materialLibrary);
+	hapticLoop->setControlLoop(controlLoop);
+	if (servoLoop != NULL)
+		hapticLoop->setServoLoop(servoLoop, proxyAlgorithm);
+
+	// the tray pattern goes on beyond the grid; the avatar can drift arbitrarily far
+	tileStreamer = new TileStreamer(assetCache, materialLibrary, toolRadius);
+	tileStreamer->setStaticArea(0, 0, 2, 2);
+	world->addChild(tileStreamer->getRoot());
+	world->setTileStreamer(tileStreamer);
+	hapticLoop->setTileStreamer(tileStreamer);
+	if (!recordedTrajectoryFile.empty())
+		hapticLoop->setRecording(&recordedTrajectory);
+
+	// time every stage of the haptics loop, down to the proxy algorithm
+	latencyMonitor = new HapticLatencyMonitor();
+	hapticLoop->setLatencyMonitor(latencyMonitor);
+	proxyAlgorithm->setLatencyMonitor(latencyMonitor);
+
+	// one more tool per haptic device; the other tools neither drift nor stream
+	numTools = (unsigned int)cClamp((int)handler->getNumDevices(), 1, cMax(maxTools, 1));
+	for (unsigned int i = 1; i < numTools; ++i)
+	{
+		ExtraTool extra;
+		handler->getDevice(extra.device, i);
+		extra.device->setEnableGripperUserSwitch(true);
+
+		extra.tool = createTool(world, extra.device, toolRadius, extra.proxyAlgorithm);
+
+		extra.loop = new HapticLoop(world, extra.tool, extra.device, materialLibrary);
+		extra.loop->setTileStreamer(tileStreamer);
+		extra.loop->setSharedWorld(i);
+		extra.thread = new HapticToolThread(extra.loop);
+		if (realTimeConfig.enabled)
+			extra.thread->setRealTime(realTimeConfig, i);
+		extraTools.push_back(extra);
+	}
 
-	tool->start();
+	// with several tools, each loop only poses its own tool in the world the others read
+	if (numTools > 1)
+	{
+		hapticLoop->setSharedWorld(0);
+		world->setSharedByTools(true);
+		materialLibrary->setNumHapticThreads(numTools);
+		tileStreamer->setNumHapticThreads(numTools);
+	}
 
 
 	//--------------------------------------------------------------------------
@@ -577,6 +731,54 @@ int main(int argc, char* argv[])
 	infoLabel->m_fontColor.setWhite();
 	camera->m_frontLayer->addChild(infoLabel);
 
+	// the info label shows one of four texts; build them once
+	for (int i = 0; i < 4; ++i)
+		infoTexts[i] = getInfoText((i & 2) != 0, (i & 1) != 0);
+
+	// room for the rates text, so that updating it does not allocate
+	ratesText.reserve(64);
+
+	// per-stage latencies of the haptics loop, refreshed once per report
+	latencyLabel = new cLabel(font);
+	latencyLabel->m_fontColor.setWhite();
+	camera->m_frontLayer->addChild(latencyLabel);
+	latencyText.reserve(2048);
+
+	// debug arrows for the normal map normal, the surface normal and the force
+	normalMapNormalArrow = newDebugArrow();
+	surfaceNormalArrow = newDebugArrow();
+	globalForceArrow = newDebugArrow();
+
+	normalMapNormalArrow->m_material->setGreenLime();
+	surfaceNormalArrow->m_material->setBlack();
+	globalForceArrow->m_material->setRedCrimson();
+
+	// blob shadow of the cursor, just above the top of the trays; sized like the drawn
+	// cursor, since the collision radius of the point avatar is zero
+	objects[0][0]->computeBoundaryBox(true);
+	cursorShadowHeight = objects[0][0]->getLocalPos().z() + objects[0][0]->getBoundaryMax().z() + 0.0002;
+
+	cursorShadow = new cMesh();
+	cCreateDisk(cursorShadow, C_CURSOR_DISPLAY_RADIUS, C_CURSOR_DISPLAY_RADIUS);
+	cursorShadow->m_material->setBlack();
+	cursorShadow->setUseTransparency(true);
+	cursorShadow->setTransparencyLevel(0.5);
+	cursorShadow->setHapticEnabled(false);
+	cursorShadow->setShowEnabled(false);
+	world->addChild(cursorShadow);
+
+	if (benchGraphics)
+	{
+		windowSizeCallback(window, width, height);
+		benchmarkGraphicsFrames(500);
+
+		tool->stop();
+		if (servoLoop != NULL)
+			servoLoop->close();
+		glfwTerminate();
+		return 0;
+	}
+
 
 
 
@@ -584,10 +786,49 @@ int main(int argc, char* argv[])
 	// START SIMULATION
 	//--------------------------------------------------------------------------
 
+	// index the trays for the proxy's collision queries, now that every child is in the world
+	world->buildBroadPhase();
+
+	if (benchJitterSeconds > 0.0)
+	{
+		benchmarkHapticJitter(hapticLoop, benchJitterSeconds, 1000, realTimeConfig);
+
+		tool->stop();
+		if (servoLoop != NULL)
+			servoLoop->close();
+		glfwTerminate();
+		return 0;
+	}
+
+	// stream the trays around the tool
+	tileStreamer->start();
+
+	// start printing diagnostics recorded by the haptics loop
+	HapticDiagnostics::start();
+
+	// report the haptics loop latencies every second, on screen and to a file
+	latencyMonitor->start("haptic_latency.txt");
+
+	cout << "startup took " << startupClock.getCurrentTimeSeconds() * 1000.0 << " ms" << endl;
+
+	// reload the material parameters whenever the file changes
+	materialLibrary->startWatching(materialConfigFile);
+
+	// start the workspace drift and camera control
+	controlLoop->start(200);
+
+	// start rendering the force ahead of the first contact model
+	if (servoLoop != NULL)
+		servoLoop->start(servoRate);
+
 	// create a thread which starts the main haptics rendering loop
 	hapticsThread = new cThread();
 	hapticsThread->start(updateHaptics, CTHREAD_PRIORITY_HAPTICS);
 
+	// and one pinned thread per other tool
+	for (unsigned int i = 0; i < extraTools.size(); ++i)
+		extraTools[i].thread->start(getHapticThreadCore(i + 1));
+
 	// setup callback when application exits
 	atexit(close);
 
@@ -694,6 +935,7 @@ void keyCallback(GLFWwindow* a_window, int a_key, int a_scancode, int a_action,
 	{
 		mirroredDisplay = !mirroredDisplay;
 		camera->setMirrorVertical(mirroredDisplay);
+		shadowMapDirty = true;
 	}
 	else if (a_key == GLFW_KEY_N)
 	{
@@ -704,6 +946,8 @@ void keyCallback(GLFWwindow* a_window, int a_key, int a_scancode, int a_action,
 		frictionOn = !frictionOn;
 
 		proxyAlgorithm->setFrictionOn(frictionOn);
+		for (unsigned int i = 0; i < extraTools.size(); ++i)
+			extraTools[i].proxyAlgorithm->setFrictionOn(frictionOn);
 	}
 
 
@@ -719,12 +963,79 @@ void close(void)
 	// wait for graphics and haptics loops to terminate
 	while (!simulationFinished) { cSleepMs(100); }
 
-	// close haptic device
-	hapticDevice->close();
+	// stop the other tools and close their devices
+	for (unsigned int i = 0; i < extraTools.size(); ++i)
+	{
+		extraTools[i].thread->stop();
+		extraTools[i].tool->stop();
+		printf("tool %u: %llu ticks in %.1f s\n", i + 1, extraTools[i].thread->getNumTicks(), extraTools[i].thread->getRunTime());
+		if (realTimeConfig.enabled)
+		{
+			std::string realTimeText;
+			formatHapticRealTimeReport(extraTools[i].thread->getRealTimeReport(), realTimeText);
+			printf("%s", realTimeText.c_str());
+		}
+	}
+
+	// close haptic device, after the servo loop stopped talking to it
+	if (servoLoop != NULL)
+	{
+		servoLoop->stop();
+		printf("servo steps: %llu\n", servoLoop->getNumSteps());
+		servoLoop->close();
+	}
+	else
+		hapticDevice->close();
+
+	// stop the workspace drift and camera control
+	controlLoop->stop();
+
+	// stop reloading material parameters
+	materialLibrary->stopWatching();
+
+	// print the remaining diagnostics
+	HapticDiagnostics::stop();
+
+	// stop reporting latencies and print those of the whole session
+	latencyMonitor->stop();
+	std::string latencyTotals;
+	latencyMonitor->formatTotals(latencyTotals);
+	printf("haptic loop latencies:\n%s", latencyTotals.c_str());
+
+	// report the steady-state graphics frames
+	if (graphicsFrameStats.numFrames > 0)
+		printf("graphics frames: %llu (after %llu warm-up frames), %llu with heap allocations (%llu allocations), mean %.2f ms, max %.2f ms\n",
+			graphicsFrameStats.numFrames, C_GRAPHICS_WARMUP_FRAMES,
+			graphicsFrameStats.numAllocatingFrames, graphicsFrameStats.numAllocations,
+			1000.0 * graphicsFrameStats.totalTime / graphicsFrameStats.numFrames,
+			1000.0 * graphicsFrameStats.maxTime);
+	printf("shadow map updates: %llu\n", graphicsFrameStats.numShadowMapUpdates);
+
+	// save the recorded device poses
+	if (!recordedTrajectoryFile.empty())
+	{
+		if (recordedTrajectory.save(recordedTrajectoryFile))
+			cout << "recorded " << recordedTrajectory.getNumSamples() << " device poses to " << recordedTrajectoryFile << endl;
+		else
+			cout << "could not write " << recordedTrajectoryFile << endl;
+	}
 
 	// delete resources
 	delete hapticsThread;
+	delete hapticLoop;
+	for (unsigned int i = 0; i < extraTools.size(); ++i)
+	{
+		delete extraTools[i].thread;
+		delete extraTools[i].loop;
+	}
+	delete controlLoop;
+	delete servoLoop;
+	delete latencyMonitor;
+	delete tileStreamer;
+	assetCache->releaseInstances();
 	delete world;
+	delete assetCache;
+	delete materialLibrary;
 	delete handler;
 }
 
@@ -732,228 +1043,335 @@ void close(void)
 
 void updateGraphics(void)
 {
+	// heap allocations made by this thread before the frame
+	unsigned long long allocationsBefore = getThreadAllocationCount();
+	graphicsFrameClock.start(true);
+
 	/////////////////////////////////////////////////////////////////////
 	// UPDATE WIDGETS
 	/////////////////////////////////////////////////////////////////////
 
-	if (normalMapNormalArrow != NULL)
-		world->deleteChild(normalMapNormalArrow);
-	if (surfaceNormalArrow != NULL)
-		world->deleteChild(surfaceNormalArrow);
-	if (globalForceArrow != NULL)
-		world->deleteChild(globalForceArrow);
-
-	normalMapNormalArrow = new cMesh();
-	surfaceNormalArrow = new cMesh();
-	globalForceArrow = new cMesh();
-
-	cCreateArrow(normalMapNormalArrow, 0.05, 0.0002, 0.001, 0.001, false, 32, proxyAlgorithm->normalMapNorm, proxyAlgorithm->getProxyGlobalPosition(), cColorf(0.0, 1.0, 0.0, 0.0));
-	cCreateArrow(surfaceNormalArrow, 0.05, 0.0002, 0.001, 0.001, false, 32, proxyAlgorithm->surfaceNorm, proxyAlgorithm->getProxyGlobalPosition(), cColorf(0.0, 1.0, 0.0, 0.0));
-	cCreateArrow(globalForceArrow, 0.05, 0.0002, 0.001, 0.001, false, 32, proxyAlgorithm->getForce(), proxyAlgorithm->getProxyGlobalPosition(), cColorf(0.0, 1.0, 0.0, 0.0));
+	// latest complete record published by the haptic thread
+	HapticTelemetryRecord telemetry = HapticTelemetryRecord();
+	proxyAlgorithm->getTelemetry().read(telemetry);
 
-	normalMapNormalArrow->m_material->setGreenLime();
-	surfaceNormalArrow->m_material->setBlack();
-	globalForceArrow->m_material->setRedCrimson();
+	cVector3d proxyPosition = loadTelemetry(telemetry.proxyGlobalPos);
 
-	if (showNormals)
-	{
-		world->addChild(normalMapNormalArrow);
-		world->addChild(surfaceNormalArrow);
-		world->addChild(globalForceArrow);
-	}
+	placeDebugArrow(normalMapNormalArrow, loadTelemetry(telemetry.normalMapNormal), proxyPosition, showNormals);
+	placeDebugArrow(surfaceNormalArrow, loadTelemetry(telemetry.surfaceNormal), proxyPosition, showNormals);
+	placeDebugArrow(globalForceArrow, loadTelemetry(telemetry.force), proxyPosition, showNormals);
 
+	placeCursorShadow(proxyPosition);
 
+	// stream the trays around the proxy; new or removed trays change the static shadow casters
+	tileStreamer->setFocus(proxyPosition);
+	if (tileStreamer->updateScene())
+		shadowMapDirty = true;
 
-	// update haptic and graphic rate data
-	labelRates->setText(cStr(freqCounterGraphics.getFrequency(), 0) + " Hz / " +
-		cStr(freqCounterHaptics.getFrequency(), 0) + " Hz");
-	labelRates->setLocalPos((int)(0.5 * (width - labelRates->getWidth())), 15);
 
-//	penDepthLabel->setText("Penetration Depth: " + to_string(proxyAlgorithm->penDepthDebug));
-//	penDepthLabel->setLocalPos((int)(0.5 * (width - penDepthLabel->getWidth())), 115);
 
-//	deltaHLabel->setText("DeltaH: " + proxyAlgorithm->deltaHVector.str());
-//	deltaHLabel->setLocalPos((int)(0.5 * (width - deltaHLabel->getWidth())), 95);
+	// update haptic and graphic rate data when a displayed rate changes
+	int graphicsRate = (int)(freqCounterGraphics.getFrequency() + 0.5);
+	int hapticsRate = (int)(freqCounterHaptics.getFrequency() + 0.5);
+	if ((graphicsRate != displayedGraphicsRate) || (hapticsRate != displayedHapticsRate))
+	{
+		char text[64];
+		snprintf(text, sizeof(text), "%d Hz / %d Hz", graphicsRate, hapticsRate);
+		ratesText.assign(text);
+		labelRates->setText(ratesText);
+
+		displayedGraphicsRate = graphicsRate;
+		displayedHapticsRate = hapticsRate;
+	}
+	labelRates->setLocalPos((int)(0.5 * (width - labelRates->getWidth())), 15);
 
-//	normalVectorLabel->setText("Mesh Normal At Collision: " + proxyAlgorithm->surfaceNorm.str());
+//	normalVectorLabel->setText("Mesh Normal At Collision: " + loadTelemetry(telemetry.surfaceNormal).str());
 //	normalVectorLabel->setLocalPos((int)(0.5 * (width - normalVectorLabel->getWidth())), 75);
 
-//	normalMapNormalLabel->setText("Normal Map Normal At Collision: " + proxyAlgorithm->normalMapNorm.str());
+//	normalMapNormalLabel->setText("Normal Map Normal At Collision: " + loadTelemetry(telemetry.normalMapNormal).str());
 //	normalMapNormalLabel->setLocalPos((int)(0.5 * (width - normalMapNormalLabel->getWidth())), 55);
 
-//	perturbedNormalVectorLabel->setText("Perturbed Normal At Collision: " + proxyAlgorithm->perturbedNorm.str());
-//	perturbedNormalVectorLabel->setLocalPos((int)(0.5 * (width - perturbedNormalVectorLabel->getWidth())), 35);
-
-	if (showNormals)
-		infoLabel->setText
-		(
-			"Friction is currently: " + string((frictionOn) ? "ON" : "OFF") + "\n" +
-			"    Press \"O\" to toggle friction." + "\n\n" +
-			"Render normals is currently: " + string((showNormals) ? "ON" : "OFF") + "\n" +
-			"    Press \"N\" to toggle normal rendering." + "\n" +
-			"    Red is the global force.\n    Black is the surface normal.\n    Green is the normal map normal."
-		);
-	else
-		infoLabel->setText
-		(
-			"Friction is currently: " + string((frictionOn) ? "ON" : "OFF") + "\n" +
-			"    Press \"O\" to toggle friction." + "\n\n" +
-			"Render normals is currently: " + string((showNormals) ? "ON" : "OFF") + "\n" +
-			"    Press \"N\" to toggle normal rendering." + "\n"
-		);
+	// switch the info text when a toggle changes
+	int info = (frictionOn ? 2 : 0) + (showNormals ? 1 : 0);
+	if (info != displayedInfo)
+	{
+		infoLabel->setText(infoTexts[info]);
+		displayedInfo = info;
+	}
 
 	infoLabel->setLocalPos(10, height - 200);
 
-//	cColorb color;
+	// show the latest latency report when the reporter publishes one
+	unsigned int latencyReport = latencyMonitor->getReportCount();
+	if (latencyReport != displayedLatencyReport)
+	{
+		latencyMonitor->getReport(latencyText);
+		latencyLabel->setText(latencyText);
+		displayedLatencyReport = latencyReport;
+	}
+	latencyLabel->setLocalPos(10, 40);
 
 	/*
-	color = proxyAlgorithm->m_colorAtCollision;
-	colorCollisionLabel->setText
-	(
-		"Color at collision: " +
-		to_string(color.getR()) + ", " + to_string(color.getG()) + ", " + to_string(color.getB())
-	);
-	colorCollisionLabel->setLocalPos((int)(0.1 * (width - colorCollisionLabel->getWidth())), height - 15);
-
-
-	color = proxyAlgorithm->m_heightAtCollision;
-	heightCollisionLabel->setText
-	(
-		"Height at collision: " +
-		to_string(color.getR()) + ", " + to_string(color.getG()) + ", " + to_string(color.getB())
-	);
+	heightCollisionLabel->setText("Height at collision: " + cStr(telemetry.height, 3));
 	heightCollisionLabel->setLocalPos((int)(0.1 * (width - heightCollisionLabel->getWidth())), height - 40);
 
-
-	color = proxyAlgorithm->m_roughnessAtCollision;
-	roughnessCollisionLabel->setText
-	(
-		"Roughness at collision: " +
-		to_string(color.getR()) + ", " + to_string(color.getG()) + ", " + to_string(color.getB())
-	);
+	roughnessCollisionLabel->setText("Roughness at collision: " + cStr(telemetry.roughness, 3));
 	roughnessCollisionLabel->setLocalPos((int)(0.1 * (width - roughnessCollisionLabel->getWidth())), height - 65);
-
-
-	color = proxyAlgorithm->m_normalColorAtCollision;
-	normalCollisionLabel->setText
-	(
-		"Normal at collision: " +
-		to_string(color.getR()) + ", " + to_string(color.getG()) + ", " + to_string(color.getB())
-	);
-	normalCollisionLabel->setLocalPos((int)(0.1 * (width - normalCollisionLabel->getWidth())), height - 90);
 	*/
 
 	/////////////////////////////////////////////////////////////////////
 	// RENDER SCENE
 	/////////////////////////////////////////////////////////////////////
 
-	// update shadow maps (if any)
-	world->updateShadowMaps(false, mirroredDisplay);
+	// follow the avatar with the latest camera pose of the control loop
+	unsigned int cameraPose = controlLoop->getNumCameraPoses();
+	if (cameraPose != displayedCameraPose)
+	{
+		if (controlLoop->readCameraPose(cameraPosition, cameraLookAt))
+		{
+			camera->set(cameraPosition, cameraLookAt, cVector3d(0.0, 0.0, 1.0));
+			camera->computeGlobalPositions(true, world->getGlobalPos(), world->getGlobalRot());
+		}
+		displayedCameraPose = cameraPose;
+	}
+
+	// update the shadow map only when the light or the static casters changed
+	if (!cacheShadowMap)
+	{
+		world->updateShadowMaps(false, mirroredDisplay);
+		graphicsFrameStats.numShadowMapUpdates++;
+	}
+	else if (shadowMapDirty)
+	{
+		updateStaticShadowMap();
+	}
+
+	// let the GPU finish the previous frame before queueing this one
+	waitForPreviousFrame();
 
 	// render world
 	camera->renderView(width, height);
 
-	// wait until all GL commands are completed
-	glFinish();
+	// fence this frame instead of blocking until it is drawn
+	fenceFrame();
 
 	// check for any OpenGL errors
 	GLenum err;
 	err = glGetError();
 	if (err != GL_NO_ERROR) cout << "Error:  %s\n" << gluErrorString(err);
+
+	// account for the frame once the graphics loop is steady
+	double frameTime = graphicsFrameClock.getCurrentTimeSeconds();
+	unsigned long long frameAllocations = getThreadAllocationCount() - allocationsBefore;
+
+	if (++graphicsFrameIndex > C_GRAPHICS_WARMUP_FRAMES)
+	{
+		graphicsFrameStats.numFrames++;
+		graphicsFrameStats.numAllocations += frameAllocations;
+		if (frameAllocations > 0)
+			graphicsFrameStats.numAllocatingFrames++;
+		graphicsFrameStats.totalTime += frameTime;
+		graphicsFrameStats.maxTime = cMax(graphicsFrameStats.maxTime, frameTime);
+	}
 }
 
 //------------------------------------------------------------------------------
 
-void updateHaptics(void)
+void updateStaticShadowMap(void)
 {
-	// simulation in now running
-	simulationRunning = true;
-	simulationFinished = false;
-
-	// main haptic simulation loop
-	while (simulationRunning)
+	// the cursor, its shadow and the debug arrows move every frame; keep them out
+	cGenericObject* dynamicObjects[4] = { cursorShadow, normalMapNormalArrow, surfaceNormalArrow, globalForceArrow };
+	bool shown[4];
+	for (int i = 0; i < 4; ++i)
 	{
-		/////////////////////////////////////////////////////////////////////
-		// READ HAPTIC DEVICE
-		/////////////////////////////////////////////////////////////////////
+		shown[i] = dynamicObjects[i]->getShowEnabled();
+		dynamicObjects[i]->setShowEnabled(false);
+	}
+	tool->setShowEnabled(false, false);
 
-		// read position 
-		cVector3d toolPos = tool->getLocalPos();
-		cVector3d position;
-		hapticDevice->getPosition(position);
+	world->updateShadowMaps(false, mirroredDisplay);
 
-		// read orientation 
-		cMatrix3d rotation;
-		hapticDevice->getRotation(rotation);
+	tool->setShowEnabled(true, false);
+	for (int i = 0; i < 4; ++i)
+		dynamicObjects[i]->setShowEnabled(shown[i]);
 
-		// read user-switch status (button 0)
-		bool button = false;
-		hapticDevice->getUserSwitch(0, button);
+	shadowMapDirty = false;
+	graphicsFrameStats.numShadowMapUpdates++;
+}
 
+//------------------------------------------------------------------------------
 
-		world->computeGlobalPositions();
+void placeCursorShadow(const cVector3d& a_position)
+{
+	// the light is a child of the world, so its local position is global
+	cVector3d lightPos = light->getLocalPos();
 
-		/////////////////////////////////////////////////////////////////////
-		// UPDATE 3D CURSOR MODEL
-		/////////////////////////////////////////////////////////////////////
+	// the cursor casts into the shadow map itself when the map is rebuilt every frame
+	if (!cacheShadowMap || (a_position.z() <= cursorShadowHeight) || (lightPos.z() <= a_position.z()))
+	{
+		cursorShadow->setShowEnabled(false);
+		return;
+	}
 
-		tool->updateFromDevice();
+	// project the proxy from the light onto the top of the trays
+	double t = (lightPos.z() - cursorShadowHeight) / (lightPos.z() - a_position.z());
+	cursorShadow->setLocalPos(lightPos + (a_position - lightPos) * t);
+	cursorShadow->setShowEnabled(true);
+}
 
+//------------------------------------------------------------------------------
 
-		/////////////////////////////////////////////////////////////////////
-		// UPDATE CAMERA WITH RESPECT TO AVATAR POSITION
-		/////////////////////////////////////////////////////////////////////
+void waitForPreviousFrame(void)
+{
+#ifdef GLEW_VERSION
+	if (frameFence != NULL)
+	{
+		// one second, in nanoseconds; only reached if the driver hangs
+		glClientWaitSync(frameFence, GL_SYNC_FLUSH_COMMANDS_BIT, (GLuint64)1000000000);
+		glDeleteSync(frameFence);
+		frameFence = NULL;
+	}
+#endif
+}
 
-		position = cVector3d(position.x(), position.y(), 0.0);
+//------------------------------------------------------------------------------
 
-		if (position.x() < 0.0)
-			position = cVector3d(position.x() - 0.01, position.y(), 0.0);
-		else
-			position = cVector3d(position.x() + 0.02, position.y(), 0.0);
+void fenceFrame(void)
+{
+#ifdef GLEW_VERSION
+	if (useFrameFence && GLEW_ARB_sync)
+	{
+		frameFence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		return;
+	}
+#endif
+
+	// no fences: wait until all GL commands are completed
+	glFinish();
+}
+
+//------------------------------------------------------------------------------
+
+void benchmarkGraphicsFrames(int a_numFrames)
+{
+	const char* modes[3] = { "shadow map every frame, glFinish", "cached shadow map, glFinish", "cached shadow map, fence" };
 
-		chai3d::cVector3d positionDirection = position;
-		positionDirection.normalize();
-		if (position.length() > workspaceRadius)
+	// render as fast as possible
+	glfwSwapInterval(0);
+
+	for (int mode = 0; mode < 3; ++mode)
+	{
+		cacheShadowMap = (mode > 0);
+		useFrameFence = (mode > 1);
+		shadowMapDirty = true;
+
+		// a few frames to set up GL resources before timing
+		cPrecisionClock clock;
+		for (int frame = -10; frame < a_numFrames; ++frame)
 		{
-			tool->setLocalPos(tool->getLocalPos() + positionDirection * min((max((position.length() - workspaceRadius) * 0.015, 0.00001)), 0.0001));
-			//			tool->setLocalPos(tool->getLocalPos() + positionDirection * (position.length() - workspaceRadius) * 0.01);
-
-			// A) The camera mimics the avatar's movement along the x and y plane.
-			cVector3d toolPosDxDy = tool->getLocalPos() - toolPos;
-			toolPosDxDy = cVector3d(toolPosDxDy.x(), toolPosDxDy.y(), 0.0);
-
-			cameraPosition = cameraPosition + toolPosDxDy;
-			cameraLookAt = cameraLookAt + toolPosDxDy;
-
-			camera->set
-			(
-				cameraPosition,				// camera position (eye)
-				cameraLookAt,				// look at position (target)
-				cVector3d(0.0, 0.0, 1.0)	// direction of the (up) vector
-			);
-			// End A)
+			if (frame == 0)
+				clock.start(true);
+
+			glfwGetWindowSize(window, &width, &height);
+			updateGraphics();
+			glfwSwapBuffers(window);
+			glfwPollEvents();
 		}
+		waitForPreviousFrame();
 
+		printf("%-34s %8.3f ms per frame\n", modes[mode], 1000.0 * clock.getCurrentTimeSeconds() / a_numFrames);
+	}
 
+	cacheShadowMap = true;
+	useFrameFence = true;
+	glfwSwapInterval(swapInterval);
+}
 
+//------------------------------------------------------------------------------
 
+cMesh* newDebugArrow(void)
+{
+	cMesh* arrow = new cMesh();
+	cCreateArrow(arrow, 0.05, 0.0002, 0.001, 0.001, false, 32, cVector3d(0.0, 0.0, 1.0), cVector3d(0.0, 0.0, 0.0), cColorf(0.0, 1.0, 0.0, 0.0));
 
-		/////////////////////////////////////////////////////////////////////
-		// COMPUTE FORCES
-		/////////////////////////////////////////////////////////////////////
+	// the arrows are only drawn; keep them out of the haptic rendering
+	arrow->setHapticEnabled(false);
+	arrow->setShowEnabled(false);
 
-		tool->computeInteractionForces();
+	world->addChild(arrow);
+	return arrow;
+}
 
-		cVector3d force(0, 0, 0);
-		cVector3d torque(0, 0, 0);
-		double gripperForce = 0.0;
+//------------------------------------------------------------------------------
 
+void placeDebugArrow(cMesh* a_arrow, const cVector3d& a_direction, const cVector3d& a_position, bool a_show)
+{
+	double length = a_direction.length();
+	if (!a_show || (length < C_SMALL))
+	{
+		a_arrow->setShowEnabled(false);
+		return;
+	}
+
+	// rotation taking the z axis of the arrow onto the direction
+	cVector3d z = a_direction / length;
+	cVector3d helper = (fabs(z.x()) < 0.9) ? cVector3d(1.0, 0.0, 0.0) : cVector3d(0.0, 1.0, 0.0);
+	cVector3d x = cCross(helper, z);
+	x.normalize();
+	cVector3d y = cCross(z, x);
+
+	cMatrix3d rotation;
+	rotation.setCol(x, y, z);
+
+	a_arrow->setLocalRot(rotation);
+	a_arrow->setLocalPos(a_position);
+	a_arrow->setShowEnabled(true);
+}
+
+//------------------------------------------------------------------------------
 
-		/////////////////////////////////////////////////////////////////////
-		// APPLY FORCES
-		/////////////////////////////////////////////////////////////////////
+std::string getInfoText(bool a_frictionOn, bool a_showNormals)
+{
+	std::string text =
+		"Friction is currently: " + string((a_frictionOn) ? "ON" : "OFF") + "\n" +
+		"    Press \"O\" to toggle friction." + "\n\n" +
+		"Render normals is currently: " + string((a_showNormals) ? "ON" : "OFF") + "\n" +
+		"    Press \"N\" to toggle normal rendering." + "\n";
+
+	if (a_showNormals)
+		text += "    Red is the global force.\n    Black is the surface normal.\n    Green is the normal map normal.";
+
+	return text;
+}
 
-		tool->applyToDevice();
+//------------------------------------------------------------------------------
+
+void updateHaptics(void)
+{
+	// simulation in now running
+	simulationRunning = true;
+	simulationFinished = false;
+
+	// in real-time mode, check and report what the thread obtained before the first tick
+	if (realTimeConfig.enabled)
+	{
+		HapticRealTimeReport realTimeReport;
+		enterHapticRealTime(realTimeConfig, 0, realTimeReport);
+
+		std::string realTimeText;
+		formatHapticRealTimeReport(realTimeReport, realTimeText);
+		cout << "haptics thread real-time mode:" << endl << realTimeText;
+	}
+
+	// with several tools, each haptic thread has a core of its own
+	else if (numTools > 1)
+		pinCurrentThreadToCore(getHapticThreadCore(0));
+
+	// main haptic simulation loop
+	while (simulationRunning)
+	{
+		// read the device, update the avatar and the camera, compute and apply forces
+		hapticLoop->tick();
 
 		// signal frequency counter
 		freqCounterHaptics.signal(1);
@@ -0,0 +1,740 @@
+//==============================================================================
+/*
+    CPSC 599.86 / 601.86 - Computer Haptics
+    Winter 2018, University of Calgary
+
+    Headless simulation. Builds the same trays and tool as the application,
+    with no window, camera or light, drives the tool with a
+    VirtualHapticDevice that plays back a trajectory, and runs the haptic
+    loop until the trajectory ends. The forces of every tick are written to
+    a CSV file, and the loop throughput and per-stage latencies are printed.
+
+    Without --trajectory the device strokes across each tray in turn. A
+    trajectory recorded with "application --record-trajectory FILE" can be
+    replayed instead.
+
+    --grid N repeats the trays over an N x N grid, to measure how the tick
+    scales with the number of objects; --no-broad-phase tests the proxy
+    against every tray, as CHAI3D's world does. --stream streams the tray
+    pattern in and out around the tool beyond the grid, as the application
+    does. --servo N renders the forces from a servo loop run N times per
+    tick of the collision loop, as "application --servo" does in its own
+    thread; the device then advances once per servo step.
+
+    --tools N drives N tools instead, each with its own virtual device
+    replaying the trajectory, its own proxy and its own haptic thread
+    pinned to a core, all querying the same trays. The tick rate of every
+    tool is printed, to see how the loop scales with the number of tools.
+
+    --sched-fifo runs the haptic threads under SCHED_FIFO, pinned, with the
+    memory locked (see HapticRealTime.h), and reports what they obtained.
+    --bench-jitter SECONDS ticks the loop at the rate of the time step
+    instead, first from a normal thread and then in real-time mode, and
+    compares the tick periods.
+
+    --bench-broad-phase plays the tray strokes back on grids of 3x3, 10x10,
+    30x30 and 100x100 trays, with and without the broad phase, and prints
+    the time per tick and the tick latencies of each run.
+
+    Usage: headless [--trajectory FILE] [--save-trajectory FILE] [--forces FILE]
+                    [--real-time] [--time-step SECONDS] [--friction] [--no-pack]
+                    [--grid N] [--no-broad-phase] [--stream] [--servo N] [--tools N]
+                    [--sched-fifo] [--rt-priority P] [--rt-core C] [--rt-no-mlock]
+                    [--bench-jitter SECONDS] [--bench-broad-phase]
+*/
+//==============================================================================
+
+#include "chai3d.h"
+#include "AssetCache.h"
+#include "BroadPhaseWorld.h"
+#include "HapticBenchmarks.h"
+#include "HapticDiagnostics.h"
+#include "HapticLatency.h"
+#include "HapticLoop.h"
+#include "HapticRealTime.h"
+#include "HapticThreads.h"
+#include "HapticTrajectory.h"
+#include "MaterialLibrary.h"
+#include "SceneAssets.h"
+#include "SceneSetup.h"
+#include "ServoLoop.h"
+#include "TileStreamer.h"
+#include "VirtualHapticDevice.h"
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace chai3d;
+using namespace std;
+
+//------------------------------------------------------------------------------
+
+namespace
+{
+    //! Height of the device above the trays between strokes.
+    const double C_HOVER_HEIGHT = 0.01;
+
+    //! Depth of the device below the top of a tray during a stroke.
+    const double C_STROKE_DEPTH = 0.001;
+
+    //! Speed of the device along a stroke in m/s.
+    const double C_STROKE_SPEED = 0.1;
+
+    //! Half length of a stroke across a tray.
+    const double C_STROKE_HALF_LENGTH = 0.03;
+
+
+    //==========================================================================
+    /*!
+        Scripts a trajectory that visits every tray: it moves above the
+        tray, presses into it, strokes across it and back along a diagonal,
+        and lifts off again. Device positions are world positions, since
+        the tool starts at the origin with a unit workspace scale.
+
+        \param  a_objects  Trays of the grid.
+
+        \return The trajectory.
+    */
+    //==========================================================================
+    HapticTrajectory createTrayStrokes(cMultiMesh* a_objects[3][3])
+    {
+        HapticTrajectory trajectory;
+
+        for (int i = 0; i < 3; ++i)
+        {
+            for (int j = 0; j < 3; ++j)
+            {
+                cMultiMesh* object = a_objects[i][j];
+                object->computeBoundaryBox(true);
+
+                cVector3d center = object->getLocalPos();
+                double top = center.z() + object->getBoundaryMax().z();
+                double hover = top + C_HOVER_HEIGHT;
+                double contact = top - C_STROKE_DEPTH;
+
+                cVector3d start = center + cVector3d(-C_STROKE_HALF_LENGTH, 0.0, 0.0);
+                cVector3d end = center + cVector3d(C_STROKE_HALF_LENGTH, 0.0, 0.0);
+                cVector3d back = center + cVector3d(-C_STROKE_HALF_LENGTH, 0.5 * C_STROKE_HALF_LENGTH, 0.0);
+
+                trajectory.moveTo(cVector3d(start.x(), start.y(), hover), 0.3);
+                trajectory.moveTo(cVector3d(start.x(), start.y(), contact), 0.2);
+                trajectory.moveTo(cVector3d(end.x(), end.y(), contact), (end - start).length() / C_STROKE_SPEED);
+                trajectory.moveTo(cVector3d(back.x(), back.y(), contact), (back - end).length() / C_STROKE_SPEED);
+                trajectory.moveTo(cVector3d(back.x(), back.y(), hover), 0.2);
+            }
+        }
+
+        return (trajectory);
+    }
+
+
+    //! Haptic thread of one of several tools; it ends with the trajectory of its device.
+    class VirtualToolThread : public HapticToolThread
+    {
+    public:
+
+        VirtualToolThread(HapticLoop* a_loop, VirtualHapticDevicePtr a_device) :
+            HapticToolThread(a_loop),
+            m_device(a_device)
+        {
+        }
+
+    protected:
+
+        virtual bool isFinished() { return (m_device->isFinished()); }
+
+        VirtualHapticDevicePtr m_device;
+    };
+
+
+    //==========================================================================
+    /*!
+        Returns the forces file of a tool: the file given on the command
+        line for the first tool, and the same name with the index of the
+        tool before the extension for the others.
+
+        \param  a_forcesFile  File given on the command line.
+        \param  a_tool        Index of the tool.
+
+        \return Name of the file.
+    */
+    //==========================================================================
+    string getToolForcesFile(const string& a_forcesFile, int a_tool)
+    {
+        if (a_tool == 0)
+        {
+            return (a_forcesFile);
+        }
+
+        size_t dot = a_forcesFile.find_last_of('.');
+        string suffix = "_" + to_string(a_tool);
+        if (dot == string::npos)
+        {
+            return (a_forcesFile + suffix);
+        }
+        return (a_forcesFile.substr(0, dot) + suffix + a_forcesFile.substr(dot));
+    }
+
+
+    //==========================================================================
+    /*!
+        Drives several tools through the same world, each from its own
+        haptic thread pinned to its own core, until every device has played
+        the trajectory back. The world is indexed and posed once before the
+        threads start, and only read by them afterwards.
+
+        \param  a_world           World holding the trays.
+        \param  a_library         Material parameters.
+        \param  a_trajectory      Trajectory every device plays back.
+        \param  a_realTime        Play back in real time.
+        \param  a_timeStep        Time step per tick otherwise.
+        \param  a_toolRadius      Radius of the tools.
+        \param  a_frictionOn      Friction of the proxies.
+        \param  a_numTools        Number of tools.
+        \param  a_forcesFile      Forces file of the first tool.
+        \param  a_realTimeConfig  Real-time mode of the haptic threads.
+
+        \return Exit code.
+    */
+    //==========================================================================
+    int runSharedTools(BroadPhaseWorld* a_world,
+                       MaterialLibrary* a_library,
+                       const HapticTrajectory& a_trajectory,
+                       bool a_realTime,
+                       double a_timeStep,
+                       double a_toolRadius,
+                       bool a_frictionOn,
+                       int a_numTools,
+                       const string& a_forcesFile,
+                       const HapticRealTimeConfig& a_realTimeConfig)
+    {
+        vector<VirtualHapticDevicePtr> devices;
+        vector<cToolCursor*> tools;
+        vector<HapticLoop*> loops;
+        vector<HapticLatencyMonitor*> monitors;
+        vector<VirtualToolThread*> threads;
+
+        for (int i = 0; i < a_numTools; ++i)
+        {
+            VirtualHapticDevicePtr device = VirtualHapticDevice::create(a_trajectory, a_realTime, a_timeStep);
+
+            MyProxyAlgorithm* proxyAlgorithm = NULL;
+            cToolCursor* tool = createTool(a_world, device, a_toolRadius, proxyAlgorithm);
+            proxyAlgorithm->setFrictionOn(a_frictionOn);
+            tool->setWorkspaceRadius(device->getSpecifications().m_workspaceRadius);
+
+            // each loop poses its own tool only, and reports its ticks as haptic thread i
+            HapticLoop* loop = new HapticLoop(a_world, tool, device, a_library);
+            loop->setSharedWorld(i);
+
+            HapticLatencyMonitor* monitor = new HapticLatencyMonitor();
+            loop->setLatencyMonitor(monitor);
+            proxyAlgorithm->setLatencyMonitor(monitor);
+
+            devices.push_back(device);
+            tools.push_back(tool);
+            loops.push_back(loop);
+            monitors.push_back(monitor);
+            threads.push_back(new VirtualToolThread(loop, device));
+            if (a_realTimeConfig.enabled)
+                threads.back()->setRealTime(a_realTimeConfig, i);
+        }
+
+        a_library->setNumHapticThreads(a_numTools);
+        a_world->setSharedByTools(true);
+
+        // the last writes to the shared world: index the trays and pose every object
+        a_world->buildBroadPhase();
+
+        cout << a_numTools << " tools on " << getNumCores() << " cores, playing back " << a_trajectory.getNumSamples()
+             << " samples each, " << (a_realTime ? "in real time" : "as fast as possible") << endl;
+
+        HapticDiagnostics::start();
+
+        for (int i = 0; i < a_numTools; ++i)
+        {
+            threads[i]->start(getHapticThreadCore(i));
+        }
+        for (int i = 0; i < a_numTools; ++i)
+        {
+            threads[i]->join();
+        }
+
+        HapticDiagnostics::stop();
+
+        unsigned long long totalTicks = 0;
+        for (int i = 0; i < a_numTools; ++i)
+        {
+            unsigned long long numTicks = threads[i]->getNumTicks();
+            double seconds = threads[i]->getRunTime();
+            totalTicks += numTicks;
+
+            string core = (threads[i]->getCore() >= 0) ? ("core " + to_string(threads[i]->getCore())) : string("unpinned");
+            printf("tool %d (%s): %llu ticks in %.3f s: %.1f kHz, %.2f us per tick\n", i, core.c_str(), numTicks, seconds,
+                   0.001 * numTicks / seconds, 1.0e6 * seconds / numTicks);
+
+            if (a_realTimeConfig.enabled)
+            {
+                string realTimeText;
+                formatHapticRealTimeReport(threads[i]->getRealTimeReport(), realTimeText);
+                printf("%s", realTimeText.c_str());
+            }
+        }
+        printf("%llu ticks over %d tools\n", totalTicks, a_numTools);
+
+        string latencyTotals;
+        monitors[0]->formatTotals(latencyTotals);
+        printf("tool 0:\n%s", latencyTotals.c_str());
+
+        for (int i = 0; i < a_numTools; ++i)
+        {
+            tools[i]->stop();
+
+            string forcesFile = getToolForcesFile(a_forcesFile, i);
+            if (devices[i]->saveRecords(forcesFile))
+                cout << "forces of tool " << i << " written to " << forcesFile << endl;
+            else
+                cout << "could not write " << forcesFile << endl;
+
+            delete threads[i];
+            delete loops[i];
+            delete monitors[i];
+        }
+
+        return (0);
+    }
+
+
+    //==========================================================================
+    /*!
+        Plays the tray strokes back as fast as possible on a fresh grid of
+        trays, ticking the full haptic loop, and prints one line of the
+        broad phase sweep: the time per tick and the percentiles of the
+        tick latency.
+
+        \param  a_cache          Cache providing the trays.
+        \param  a_library        Material parameters.
+        \param  a_toolRadius     Radius of the tool.
+        \param  a_timeStep       Time step per tick.
+        \param  a_frictionOn     Friction of the proxy.
+        \param  a_gridSize       Number of trays along a side of the grid.
+        \param  a_useBroadPhase  Index the trays, or walk every child.
+    */
+    //==========================================================================
+    void runBroadPhaseSweepCase(AssetCache* a_cache,
+                                MaterialLibrary* a_library,
+                                double a_toolRadius,
+                                double a_timeStep,
+                                bool a_frictionOn,
+                                int a_gridSize,
+                                bool a_useBroadPhase)
+    {
+        BroadPhaseWorld* world = new BroadPhaseWorld();
+
+        cMultiMesh* objects[3][3];
+        MyMaterial* materials[9];
+        createTrayGrid(world, a_cache, a_library, a_toolRadius, objects, materials);
+        if (a_gridSize > 3)
+            extendTrayGrid(world, a_cache, a_toolRadius, objects, a_gridSize);
+
+        VirtualHapticDevicePtr device = VirtualHapticDevice::create(createTrayStrokes(objects), false, a_timeStep);
+
+        MyProxyAlgorithm* proxyAlgorithm = NULL;
+        cToolCursor* tool = createTool(world, device, a_toolRadius, proxyAlgorithm);
+        proxyAlgorithm->setFrictionOn(a_frictionOn);
+        tool->setWorkspaceRadius(device->getSpecifications().m_workspaceRadius);
+
+        HapticLoop hapticLoop(world, tool, device, a_library);
+        HapticLatencyMonitor latencyMonitor;
+        hapticLoop.setLatencyMonitor(&latencyMonitor);
+        proxyAlgorithm->setLatencyMonitor(&latencyMonitor);
+
+        world->setUseBroadPhase(a_useBroadPhase);
+        if (a_useBroadPhase)
+            world->buildBroadPhase();
+
+        cPrecisionClock clock;
+        clock.start(true);
+
+        unsigned int numTicks = 0;
+        while (!device->isFinished())
+        {
+            hapticLoop.tick();
+            numTicks++;
+        }
+
+        double seconds = clock.getCurrentTimeSeconds();
+        tool->stop();
+
+        LatencySnapshot tick;
+        latencyMonitor.getTotals(HAPTIC_STAGE_TICK, tick);
+
+        printf("%6d  %-14s %8u %10.2f %9.1f %9.1f %9.1f %9.1f\n", a_gridSize * a_gridSize,
+               a_useBroadPhase ? "broad phase" : "every child", numTicks, 1.0e6 * seconds / numTicks,
+               0.001 * tick.getPercentile(0.5), 0.001 * tick.getPercentile(0.99),
+               0.001 * tick.getPercentile(0.999), 0.001 * tick.getMax());
+
+        a_cache->releaseInstances();
+        delete world;
+    }
+
+
+    //==========================================================================
+    /*!
+        Runs the headless simulation on tray grids of 3x3, 10x10, 30x30 and
+        100x100, with and without the broad phase, and prints the time per
+        tick and the tick latencies of each run.
+
+        \param  a_cache        Cache providing the trays.
+        \param  a_library      Material parameters.
+        \param  a_toolRadius   Radius of the tool.
+        \param  a_timeStep     Time step per tick.
+        \param  a_frictionOn   Friction of the proxy.
+    */
+    //==========================================================================
+    void runBroadPhaseSweep(AssetCache* a_cache,
+                            MaterialLibrary* a_library,
+                            double a_toolRadius,
+                            double a_timeStep,
+                            bool a_frictionOn)
+    {
+        const int gridSizes[] = { 3, 10, 30, 100 };
+
+        cout << "Broad phase sweep: tray strokes played back as fast as possible, tick latencies in us" << endl;
+        printf("%6s  %-14s %8s %10s %9s %9s %9s %9s\n", "trays", "collision", "ticks", "us/tick", "p50", "p99", "p99.9", "max");
+
+        for (int g = 0; g < 4; ++g)
+        {
+            runBroadPhaseSweepCase(a_cache, a_library, a_toolRadius, a_timeStep, a_frictionOn, gridSizes[g], true);
+            runBroadPhaseSweepCase(a_cache, a_library, a_toolRadius, a_timeStep, a_frictionOn, gridSizes[g], false);
+        }
+    }
+}
+
+
+//==============================================================================
+
+int main(int argc, char* argv[])
+{
+    string trajectoryFile;
+    string savedTrajectoryFile;
+    string forcesFile = "forces.csv";
+    bool realTime = false;
+    double timeStep = 0.001;
+    bool frictionOn = false;
+    bool usePack = true;
+    int gridSize = 3;
+    bool useBroadPhase = true;
+    bool stream = false;
+    int servoSteps = 0;
+    int numTools = 0;
+    HapticRealTimeConfig realTimeConfig = getDefaultRealTimeConfig();
+    double benchJitterSeconds = 0.0;
+    bool benchBroadPhase = false;
+
+    for (int a = 1; a < argc; ++a)
+    {
+        string option = argv[a];
+        bool hasValue = (a + 1 < argc);
+
+        if ((option == "--trajectory") && hasValue)
+            trajectoryFile = argv[++a];
+        else if ((option == "--save-trajectory") && hasValue)
+            savedTrajectoryFile = argv[++a];
+        else if ((option == "--forces") && hasValue)
+            forcesFile = argv[++a];
+        else if ((option == "--time-step") && hasValue)
+            timeStep = atof(argv[++a]);
+        else if (option == "--real-time")
+            realTime = true;
+        else if (option == "--friction")
+            frictionOn = true;
+        else if (option == "--no-pack")
+            usePack = false;
+        else if ((option == "--grid") && hasValue)
+            gridSize = atoi(argv[++a]);
+        else if (option == "--no-broad-phase")
+            useBroadPhase = false;
+        else if (option == "--stream")
+            stream = true;
+        else if ((option == "--servo") && hasValue)
+            servoSteps = atoi(argv[++a]);
+        else if ((option == "--tools") && hasValue)
+            numTools = atoi(argv[++a]);
+        else if ((option == "--bench-jitter") && hasValue)
+            benchJitterSeconds = atof(argv[++a]);
+        else if (option == "--bench-broad-phase")
+            benchBroadPhase = true;
+        else if (!parseRealTimeOption(argc, argv, a, realTimeConfig))
+        {
+            cout << "unknown option " << option << endl;
+            return (1);
+        }
+    }
+
+    if (timeStep <= 0.0)
+    {
+        cout << "the time step must be positive" << endl;
+        return (1);
+    }
+
+    if (gridSize < 3)
+    {
+        cout << "the grid must be at least 3 trays wide" << endl;
+        return (1);
+    }
+
+    if (servoSteps < 0)
+    {
+        cout << "the number of servo steps must not be negative" << endl;
+        return (1);
+    }
+
+    if ((numTools < 0) || (numTools > (int)C_MAX_HAPTIC_THREADS))
+    {
+        cout << "the number of tools must be between 1 and " << C_MAX_HAPTIC_THREADS << endl;
+        return (1);
+    }
+
+    // the tools share the trays through the broad phase, which their threads only read
+    if ((numTools > 0) && (stream || (servoSteps > 0) || !useBroadPhase))
+    {
+        cout << "--tools runs without --stream, --servo and --no-broad-phase" << endl;
+        return (1);
+    }
+
+    if ((numTools > 0) && (benchJitterSeconds > 0.0))
+    {
+        cout << "--bench-jitter runs a single tool" << endl;
+        return (1);
+    }
+
+    //--------------------------------------------------------------------------
+    // WORLD
+    //--------------------------------------------------------------------------
+
+    BroadPhaseWorld* world = new BroadPhaseWorld();
+
+    // use a point avatar for this scene
+    double toolRadius = 0.0;
+
+    MaterialLibrary* materialLibrary = new MaterialLibrary();
+    if (!materialLibrary->load(materialConfigFile))
+        cout << "could not load " << materialConfigFile << ", using default material parameters" << endl;
+
+    AssetCache* assetCache = new AssetCache();
+    if (usePack && assetCache->loadPack(scenePackFile))
+        cout << "loaded scene pack " << scenePackFile << endl;
+    else
+        assetCache->preloadTextures(getSceneImageFiles());
+
+    if (benchBroadPhase)
+    {
+        runBroadPhaseSweep(assetCache, materialLibrary, toolRadius, timeStep, frictionOn);
+
+        delete world;
+        delete assetCache;
+        delete materialLibrary;
+
+        return (0);
+    }
+
+    cMultiMesh* objects[3][3];
+    MyMaterial* materials[9];
+    createTrayGrid(world, assetCache, materialLibrary, toolRadius, objects, materials);
+    if (gridSize > 3)
+        extendTrayGrid(world, assetCache, toolRadius, objects, gridSize);
+
+    //--------------------------------------------------------------------------
+    // VIRTUAL DEVICE
+    //--------------------------------------------------------------------------
+
+    HapticTrajectory trajectory;
+    if (trajectoryFile.empty())
+    {
+        trajectory = createTrayStrokes(objects);
+    }
+    else if (!trajectory.load(trajectoryFile))
+    {
+        cout << "could not load trajectory " << trajectoryFile << endl;
+        return (1);
+    }
+
+    if (!savedTrajectoryFile.empty() && !trajectory.save(savedTrajectoryFile))
+        cout << "could not write " << savedTrajectoryFile << endl;
+
+    if (numTools > 0)
+    {
+        int result = runSharedTools(world, materialLibrary, trajectory, realTime, timeStep, toolRadius,
+                                    frictionOn, numTools, forcesFile, realTimeConfig);
+
+        assetCache->releaseInstances();
+        delete world;
+        delete assetCache;
+        delete materialLibrary;
+
+        return (result);
+    }
+
+    // with a servo loop the device advances once per servo step
+    double deviceTimeStep = (servoSteps > 0) ? timeStep / servoSteps : timeStep;
+    VirtualHapticDevicePtr device = VirtualHapticDevice::create(trajectory, realTime, deviceTimeStep);
+
+    // only the servo loop talks to the device; the tool reads the poses it publishes
+    ServoLoop* servoLoop = NULL;
+    cGenericHapticDevicePtr toolDevice = device;
+    if (servoSteps > 0)
+    {
+        servoLoop = new ServoLoop(device);
+        servoLoop->open();
+        toolDevice = servoLoop->getCollisionDevice();
+    }
+
+    MyProxyAlgorithm* proxyAlgorithm = NULL;
+    cToolCursor* tool = createTool(world, toolDevice, toolRadius, proxyAlgorithm);
+    proxyAlgorithm->setFrictionOn(frictionOn);
+
+    // device positions are world positions
+    tool->setWorkspaceRadius(device->getSpecifications().m_workspaceRadius);
+
+    // no control loop: the tool stays where the trajectory puts it, without drift
+    HapticLoop hapticLoop(world, tool, toolDevice, materialLibrary);
+    if (servoLoop != NULL)
+        hapticLoop.setServoLoop(servoLoop, proxyAlgorithm);
+
+    // the main loop plays the part of the rendering thread for the streamed trays
+    TileStreamer* tileStreamer = NULL;
+    if (stream)
+    {
+        tileStreamer = new TileStreamer(assetCache, materialLibrary, toolRadius);
+        tileStreamer->setStaticArea(0, 0, gridSize - 1, gridSize - 1);
+        world->addChild(tileStreamer->getRoot());
+        world->setTileStreamer(tileStreamer);
+        hapticLoop.setTileStreamer(tileStreamer);
+    }
+
+    // time every stage of the loop, down to the proxy algorithm
+    HapticLatencyMonitor latencyMonitor;
+    hapticLoop.setLatencyMonitor(&latencyMonitor);
+    proxyAlgorithm->setLatencyMonitor(&latencyMonitor);
+
+    //--------------------------------------------------------------------------
+    // SIMULATION
+    //--------------------------------------------------------------------------
+
+    // index the trays now that every child is in the world
+    if (useBroadPhase)
+        world->buildBroadPhase();
+
+    cout << gridSize * gridSize << " trays, " << (useBroadPhase ? "broad phase" : "no broad phase");
+    if (useBroadPhase)
+        cout << " (" << world->getNumIndexedObjects() << " objects in " << world->getNumCells() << " cells)";
+    cout << endl;
+
+    if (benchJitterSeconds > 0.0)
+    {
+        benchmarkHapticJitter(&hapticLoop, benchJitterSeconds, (unsigned int)(1.0 / timeStep + 0.5), realTimeConfig);
+
+        tool->stop();
+        if (servoLoop != NULL)
+            servoLoop->close();
+        delete servoLoop;
+        delete tileStreamer;
+        assetCache->releaseInstances();
+        delete world;
+        delete assetCache;
+        delete materialLibrary;
+
+        return (0);
+    }
+
+    if (tileStreamer != NULL)
+        tileStreamer->start();
+
+    cout << "playing back " << trajectory.getNumSamples() << " samples, " << trajectory.getDuration() << " s, "
+         << (realTime ? "in real time" : "as fast as possible") << endl;
+
+    // the main thread is the haptic thread here
+    if (realTimeConfig.enabled)
+    {
+        HapticRealTimeReport realTimeReport;
+        enterHapticRealTime(realTimeConfig, 0, realTimeReport);
+
+        string realTimeText;
+        formatHapticRealTimeReport(realTimeReport, realTimeText);
+        cout << "real-time mode:" << endl << realTimeText;
+    }
+
+    HapticDiagnostics::start();
+    latencyMonitor.start("haptic_latency.txt");
+
+    cPrecisionClock clock;
+    clock.start(true);
+
+    unsigned int numTicks = 0;
+    while (!device->isFinished())
+    {
+        hapticLoop.tick();
+        numTicks++;
+
+        if (servoLoop != NULL)
+        {
+            for (int i = 0; i < servoSteps; ++i)
+                servoLoop->step();
+        }
+
+        if ((tileStreamer != NULL) && (numTicks % 16 == 0))
+        {
+            tileStreamer->setFocus(tool->getDeviceGlobalPos());
+            tileStreamer->updateScene();
+        }
+    }
+
+    double seconds = clock.getCurrentTimeSeconds();
+
+    tool->stop();
+    if (servoLoop != NULL)
+        servoLoop->close();
+    HapticDiagnostics::stop();
+    latencyMonitor.stop();
+
+    printf("%u ticks in %.3f s: %.1f kHz, %.2f us per tick\n", numTicks, seconds,
+           0.001 * numTicks / seconds, 1.0e6 * seconds / numTicks);
+
+    if (servoLoop != NULL)
+    {
+        printf("%llu servo steps (%d per tick): %.1f kHz\n", servoLoop->getNumSteps(), servoSteps,
+               0.001 * servoLoop->getNumSteps() / seconds);
+    }
+
+    string latencyTotals;
+    latencyMonitor.formatTotals(latencyTotals);
+    printf("%s", latencyTotals.c_str());
+
+    if (tileStreamer != NULL)
+    {
+        printf("streamed trays: %u resident, %u loaded, %u from the cache, %u deleted\n",
+               tileStreamer->getNumResidentTiles(), tileStreamer->getNumLoads(),
+               tileStreamer->getNumCacheHits(), tileStreamer->getNumDeletes());
+    }
+
+    if (device->saveRecords(forcesFile))
+        cout << "forces written to " << forcesFile << endl;
+    else
+        cout << "could not write " << forcesFile << endl;
+
+    //--------------------------------------------------------------------------
+    // CLEAN UP
+    //--------------------------------------------------------------------------
+
+    delete servoLoop;
+    delete tileStreamer;
+    assetCache->releaseInstances();
+    delete world;
+    delete assetCache;
+    delete materialLibrary;
+
+    return (0);
+}
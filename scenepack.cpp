@@ -0,0 +1,46 @@
+//==============================================================================
+/*
+    CPSC 599.86 / 601.86 - Computer Haptics
+    Winter 2018, University of Calgary
+
+    Offline packer: loads every asset of the scene from the source files
+    (parsing the meshes, computing their BTN vectors and tangent frames,
+    decoding the images and baking the haptic texels) and writes them into
+    a single scene pack that the application maps at startup.
+
+    usage: scenepack [output file]      (default: scene.pack)
+
+    Run it from the application directory whenever tray.obj or an image in
+    images/ changes; the application checks the pack version and record
+    sizes but not whether the source files are newer than the pack.
+*/
+//==============================================================================
+
+#include "SceneAssets.h"
+#include <cstdio>
+
+using namespace chai3d;
+using namespace std;
+
+//------------------------------------------------------------------------------
+
+int main(int argc, char* argv[])
+{
+    string output = (argc > 1) ? string(argv[1]) : scenePackFile;
+
+    cPrecisionClock clock;
+    clock.start(true);
+
+    AssetCache cache;
+    loadSceneAssets(&cache, 0.0);
+    cache.printStatistics();
+
+    if (!cache.savePack(output))
+    {
+        printf("failed to write %s\n", output.c_str());
+        return (1);
+    }
+
+    printf("wrote %s in %.1f ms\n", output.c_str(), clock.getCurrentTimeSeconds() * 1000.0);
+    return (0);
+}